@@ -0,0 +1,334 @@
+#include <Wire.h>
+#include "em_device.h"
+#include "si7021.h"
+#include "veml6035.h"
+#include "sht30.h"
+#include "ltr329.h"
+#include "pins_arduino.h"
+#include <silabs_imu.h>
+#include "crc8.h"
+#include "i2c_register.h"
+#include "actigraphy.h"
+#include "ics43434.h"
+#include "th_fusion.h"
+
+// Driver benchmark: runs every driver call a few times and prints the
+// blocking time and CPU cycles spent per call over Serial, so driver hot
+// path regressions show up before flashing the devices in the field.
+
+// LTR329 shares its address with the on-board VEML6035, only enable it
+// when the board is wired without the collision
+#define BENCHMARK_LTR329 0
+
+const int RUNS = 10;
+
+SilabsIMU imu;
+Actigraphy actigraphy;
+SI7021 si7021_ths;
+VEML6035 veml6035_als;
+SHT30 sht30_ths;
+LTR329 ltr329_als;
+
+bool imuReady = false;
+bool si7021Ready = false;
+bool veml6035Ready = false;
+bool sht30Ready = false;
+bool ltr329Ready = false;
+
+// Failed calls of all measurements since the start
+int benchmarkFailures = 0;
+
+void enableCycleCounter()
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+// Calls fn RUNS times and prints average/worst time and cycles per call.
+// fn returns 0 on success, failed runs are counted but still timed.
+void measure(const char *name, int (*fn)())
+{
+  unsigned long totalMicros = 0, worstMicros = 0;
+  uint32_t totalCycles = 0, worstCycles = 0;
+  int failures = 0;
+
+#if I2C_REGISTER_STATS
+  i2cResetBusStats();
+#endif
+
+  for (int i = 0; i < RUNS; i++)
+  {
+    unsigned long startMicros = micros();
+    uint32_t startCycles = DWT->CYCCNT;
+
+    if (fn() != 0)
+    {
+      failures++;
+    }
+
+    uint32_t cycles = DWT->CYCCNT - startCycles;
+    unsigned long elapsed = micros() - startMicros;
+
+    totalMicros += elapsed;
+    totalCycles += cycles;
+    if (elapsed > worstMicros)
+      worstMicros = elapsed;
+    if (cycles > worstCycles)
+      worstCycles = cycles;
+  }
+
+  Serial.print(name);
+  Serial.print(": avg ");
+  Serial.print(totalMicros / RUNS);
+  Serial.print(" us, worst ");
+  Serial.print(worstMicros);
+  Serial.print(" us, avg ");
+  Serial.print(totalCycles / RUNS);
+  Serial.print(" cycles, worst ");
+  Serial.print(worstCycles);
+  Serial.print(" cycles, failures ");
+  Serial.println(failures);
+  benchmarkFailures += failures;
+
+#if I2C_REGISTER_STATS
+  // Bus conditions per call, only printed for calls that used the bus
+  if (i2cBusStats.starts > 0)
+  {
+    Serial.print("  I2C per call: ");
+    Serial.print((float)i2cBusStats.starts / RUNS);
+    Serial.print(" starts (");
+    Serial.print((float)i2cBusStats.repeated_starts / RUNS);
+    Serial.print(" repeated), ");
+    Serial.print((float)i2cBusStats.stops / RUNS);
+    Serial.print(" stops, ");
+    Serial.print((float)i2cBusStats.bytes / RUNS);
+    Serial.println(" bytes");
+  }
+#endif
+}
+
+// Separate from loop() so the host benchmark can run it with the LTR329
+// model in place of the VEML6035
+void benchmarkLtr329()
+{
+  measure("LTR329 readASLChannel0", []() -> int
+          {
+            uint16_t ch0;
+            return ltr329_als.readASLChannel0(&ch0) == 0 ? 0 : 1;
+          });
+  measure("LTR329 readChannels", []() -> int
+          {
+            uint16_t ch0, ch1;
+            return ltr329_als.readChannels(&ch0, &ch1) == 0 ? 0 : 1;
+          });
+  measure("LTR329 readLux", []() -> int
+          {
+            float lux;
+            return ltr329_als.readLux(&lux) == 0 ? 0 : 1;
+          });
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  while (!Serial)
+    ;
+
+  Wire.begin();
+  enableCycleCounter();
+
+  imuReady = imu.begin() && imu.enableFifo();
+  si7021Ready = si7021_ths.init() == 0;
+  sht30Ready = sht30_ths.init() == 0;
+  veml6035Ready = veml6035_als.init() == 0;
+#if BENCHMARK_LTR329
+  ltr329Ready = ltr329_als.init() == 0;
+#endif
+
+  Serial.println("=== Driver Benchmark ===");
+}
+
+void loop()
+{
+  if (si7021Ready)
+  {
+    measure("SI7021 readHumidity", []() -> int
+            { return si7021_ths.readHumidity() == -999 ? 1 : 0; });
+    measure("SI7021 readTemperature", []() -> int
+            { return si7021_ths.readTemperature() == -999 ? 1 : 0; });
+    measure("SI7021 readTemperatureFromHumidity", []() -> int
+            { return si7021_ths.readTemperatureFromHumidity() == -999 ? 1 : 0; });
+    measure("SI7021 readTempHumidity (no hold)", []() -> int
+            {
+              float t, h;
+              return si7021_ths.readTempHumidity(&t, &h);
+            });
+  }
+
+  if (sht30Ready)
+  {
+    measure("SHT30 readTempHumidity", []() -> int
+            {
+              float t, h;
+              return sht30_ths.readTempHumidity(&t, &h, SHT30_Repeatability::HIGH);
+            });
+    measure("SHT30 readTempHumidity (no stretch)", []() -> int
+            {
+              float t, h;
+              return sht30_ths.readTempHumidity(&t, &h, SHT30_Repeatability::HIGH, 0);
+            });
+  }
+
+  if (veml6035Ready)
+  {
+    measure("VEML6035 readAmbientLight", []() -> int
+            { return veml6035_als.readAmbientLight() == -999 ? 1 : 0; });
+    measure("VEML6035 fetchAmbientLight", []() -> int
+            { return veml6035_als.fetchAmbientLight() == -999 ? 1 : 0; });
+  }
+
+  if (ltr329Ready)
+  {
+    benchmarkLtr329();
+  }
+
+  if (imuReady)
+  {
+    measure("SilabsIMU readIMU", []() -> int
+            { return imu.readIMU() ? 0 : 1; });
+    // Clock rate only, the per-byte against block transfer comparison
+    // needs the SPI call counts of the host benchmark
+    measure("SilabsIMU readIMU (1 MHz)", []() -> int
+            {
+              imu.setSpiReadClock(IMU_SPI_REGISTER_CLOCK);
+              bool ok = imu.readIMU();
+              imu.setSpiReadClock(IMU_SPI_READ_CLOCK_MAX);
+              return ok ? 0 : 1;
+            });
+    measure("SilabsIMU readFifo + processFifo", []() -> int
+            {
+              int samples = imu.readFifo();
+              imu.processFifo();
+              return samples < 0 ? 1 : 0;
+            });
+    measure("SilabsIMU calculateMovement", []() -> int
+            {
+              imu.calculateMovement();
+              return 0;
+            });
+  }
+
+  // Movement kernel over a full ring against the float sqrt it replaced
+  measure("movementSquares (32 samples)", []() -> int
+          {
+            static int16_t samples[IMU_FIFO_RING_SAMPLES][3];
+            uint32_t squares[IMU_FIFO_RING_SAMPLES];
+            uint8_t moving = 0;
+            for (int i = 0; i < IMU_FIFO_RING_SAMPLES; i++)
+              samples[i][2] = i * 256;
+            movementSquares(samples, IMU_FIFO_RING_SAMPLES, squares);
+            for (int i = 0; i < IMU_FIFO_RING_SAMPLES; i++)
+              moving += movementClassify(squares[i]) != STILL;
+            return moving == 0 ? 1 : 0;
+          });
+  measure("float magnitude (32 samples)", []() -> int
+          {
+            static volatile float z = 1.0f;
+            uint8_t moving = 0;
+            for (int i = 0; i < IMU_FIFO_RING_SAMPLES; i++)
+            {
+              float az = z * i / 64.0f;
+              moving += sqrt(az * az) >= MOVEMENT_THRESHOLD;
+            }
+            return moving == 0 ? 1 : 0;
+          });
+
+  measure("PostureTracker update (50 samples)", []() -> int
+          {
+            static PostureTracker tracker;
+            int16_t dynamic[3];
+            for (int i = 0; i < 50; i++)
+              tracker.update(i, -i, 16384, dynamic);
+            return 0;
+          });
+
+  // Cycle budget of the sleep staging for one 30 s epoch
+  measure("Actigraphy epoch (1500 samples)", []() -> int
+          {
+            for (int i = 0; i < ACTIGRAPHY_EPOCH_SAMPLES; i++)
+            {
+              int16_t wobble = (i % 50) < 25 ? 400 : -400;
+              if (actigraphy.addSample(wobble, 0, 16384 + wobble))
+                return 0;
+            }
+            return 1;
+          });
+  // Per block cost of the mic capture, one block is 16 ms of audio
+  measure("ICS43434 unpack block (256 samples)", []() -> int
+          {
+            static uint32_t block[ICS43434_BLOCK_SAMPLES];
+            memset(block, 0x5A, ICS43434_BLOCK_SAMPLES * 3);
+            int32_t *samples = ics43434Unpack24(block, ICS43434_BLOCK_SAMPLES);
+            return samples[0] == 0x5A5A5A ? 0 : 1;
+          });
+  // Fixed point conversions against the double formulas they replaced,
+  // the doubles run in software on the single precision FPU
+  measure("SI7021/SHT30 centi conversions (64 raw)", []() -> int
+          {
+            static volatile uint16_t raw = 0x6A3C;
+            int32_t sum = 0;
+            for (int i = 0; i < 64; i++)
+            {
+              uint16_t r = raw + i;
+              sum += SI7021::convertTemperatureCenti(r) + SI7021::convertHumidityCenti(r);
+              sum += SHT30::convertTemperatureCenti(r) + SHT30::convertHumidityCenti(r);
+            }
+            return sum == 0 ? 1 : 0;
+          });
+  measure("SI7021/SHT30 double formulas (64 raw)", []() -> int
+          {
+            static volatile uint16_t raw = 0x6A3C;
+            float sum = 0;
+            for (int i = 0; i < 64; i++)
+            {
+              uint16_t r = raw + i;
+              sum += ((float)r * 175.72 / 65536.0) - 46.85 + ((float)r * 125.0 / 65536.0) - 6.0;
+              sum += -45.0 + 175.0 * ((float)r / 65535.0) + 100.0 * ((float)r / 65535.0);
+            }
+            return sum == 0 ? 1 : 0;
+          });
+  // Fusion cost per alternating SI7021/SHT30 sample, against the bus time
+  // of the sensor read it saves
+  measure("ThFusion addSample + getReading", []() -> int
+          {
+            static ThFusion fusion;
+            static unsigned long now = 0;
+            ThFusionReading reading;
+            now += 1000;
+            fusion.addSample((now / 1000) % 2, 2150 + (now / 1000) % 7, 4500, now);
+            return fusion.getReading(now, &reading) ? 0 : 1;
+          });
+  measure("CRC-8 check of one measurement", []() -> int
+          {
+            static volatile uint8_t measurement[6] = {0xBE, 0xEF, 0x92, 0xBE, 0xEF, 0x92};
+            uint8_t data[6];
+            for (int i = 0; i < 6; i++)
+              data[i] = measurement[i];
+            return crc8CheckWords(data, 2, CRC8_INIT_SHT30) ? 0 : 1;
+          });
+  measure("CRC-8 bitwise check of one measurement", []() -> int
+          {
+            static volatile uint8_t measurement[6] = {0xBE, 0xEF, 0x92, 0xBE, 0xEF, 0x92};
+            uint8_t data[6];
+            for (int i = 0; i < 6; i++)
+              data[i] = measurement[i];
+            for (int i = 0; i < 6; i += 3)
+              if (crc8UpdateBitwise(crc8UpdateBitwise(CRC8_INIT_SHT30, data[i]), data[i + 1]) != data[i + 2])
+                return 1;
+            return 0;
+          });
+
+  Serial.println("------------------------");
+  delay(10000);
+}
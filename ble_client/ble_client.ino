@@ -1,5 +1,9 @@
 #include <ArduinoBLE.h>
 #include "silabs_imu.h"
+#include "sensor_frame.h"
+#include "sensor_history.h"
+#include "sensor_json.h"
+#include "sensor_record.h"
 
 #include "pins_arduino.h"
 
@@ -20,6 +24,28 @@ const char IMU_MI_UUID[] = "12345678-1234-5678-1234-56789abcdef7";
 const char IMU_MPM_UUID[] = "12345678-1234-5678-1234-56789abcdef8";
 const char IMU_ILA_UUID[] = "12345678-1234-5678-1234-56789abcdef9";
 const char IMU_SDM_UUID[] = "12345678-1234-5678-1234-56789abcdee0";
+const char SENSOR_FRAME_UUID[] = "12345678-1234-5678-1234-56789abcdee1";
+const char HISTORY_CONTROL_UUID[] = "12345678-1234-5678-1234-56789abcdee2";
+const char HISTORY_DATA_UUID[] = "12345678-1234-5678-1234-56789abcdee3";
+
+SensorHistoryParser historyParser;
+
+// 1: COBS framed binary records (sensor_record.h) instead of JSON lines.
+// Status messages stay text, a decoder drops them as invalid frames.
+#define SERIAL_OUTPUT_BINARY 0
+
+#if SERIAL_OUTPUT_BINARY
+uint8_t binary[SENSOR_RECORD_MAX_ENCODED];
+#else
+// Output buffer of the JSON records, reused for every line
+char json[SENSOR_JSON_MAX_LENGTH];
+#endif
+
+// Every emitted record gets the next sequence number
+unsigned long recordSequence = 0;
+
+// Per-value notifications arriving within this window form one record
+const unsigned long coalesceWindow = 250;
 
 void setup()
 {
@@ -64,80 +90,20 @@ void loop()
       {
         Serial.println("Service and characteristics discovered");
 
-        BLECharacteristic si7021_t_char = server.characteristic(SI7021_T_UUID);
-        BLECharacteristic si7021_h_char = server.characteristic(SI7021_H_UUID);
-        BLECharacteristic sht30_t_char = server.characteristic(SHT30_T_UUID);
-        BLECharacteristic sht30_h_char = server.characteristic(SHT30_H_UUID);
-        BLECharacteristic veml6035_char = server.characteristic(VEML6035_UUID);
-        BLECharacteristic imu_cs_char = server.characteristic(IMU_CS_UUID);
-        BLECharacteristic imu_mi_char = server.characteristic(IMU_MI_UUID);
-        BLECharacteristic imu_mpm_char = server.characteristic(IMU_MPM_UUID);
-        BLECharacteristic imu_ila_char = server.characteristic(IMU_ILA_UUID);
-        BLECharacteristic imu_sdm_char = server.characteristic(IMU_SDM_UUID);
-
-        if (!si7021_t_char || !si7021_h_char || !sht30_t_char || !sht30_h_char || !veml6035_char || !imu_cs_char || !imu_mi_char || !imu_mpm_char || !imu_ila_char || !imu_sdm_char)
+        BLECharacteristic sensor_frame_char = server.characteristic(SENSOR_FRAME_UUID);
+
+        // Prefer the packed frame, fall back to the per-value characteristics
+        if (sensor_frame_char)
+        {
+          readSensorFrames(server, sensor_frame_char);
+        }
+        else if (!readLegacyCharacteristics(server))
         {
-          Serial.println("Failed to find characteristics!");
           server.disconnect();
           BLE.scanForName(DEVICE_NAME);
           return;
         }
 
-        // Enable notifications
-        si7021_t_char.subscribe();
-        si7021_h_char.subscribe();
-        sht30_t_char.subscribe();
-        sht30_h_char.subscribe();
-        veml6035_char.subscribe();
-        imu_cs_char.subscribe();
-        imu_mi_char.subscribe();
-        imu_mpm_char.subscribe();
-        imu_ila_char.subscribe();
-        imu_sdm_char.subscribe();
-
-        Serial.println("Subscribed to sensor notifications");
-        String command = "";
-        while (server.connected())
-        {
-          
-          BLE.poll(); // keep stack responsive
-
-          // Check for new values
-          if (si7021_t_char.valueUpdated() || si7021_h_char.valueUpdated() ||
-              sht30_t_char.valueUpdated() || sht30_h_char.valueUpdated() ||
-              veml6035_char.valueUpdated() || imu_cs_char.valueUpdated() || imu_mi_char.valueUpdated() || imu_mpm_char.valueUpdated() || imu_ila_char.valueUpdated() || imu_sdm_char.valueUpdated())
-          {
-
-            float si7021_t, si7021_h, sht30_t, sht30_h, veml6035_l;
-            uint8_t imu_cs;
-            float imu_mi;
-            int imu_mpm;
-            bool imu_ila;
-            unsigned long imu_sdm;
-
-            si7021_t_char.readValue((byte *)&si7021_t, sizeof(si7021_t));
-            si7021_h_char.readValue((byte *)&si7021_h, sizeof(si7021_h));
-            sht30_t_char.readValue((byte *)&sht30_t, sizeof(sht30_t));
-            sht30_h_char.readValue((byte *)&sht30_h, sizeof(sht30_h));
-            veml6035_char.readValue((byte *)&veml6035_l, sizeof(veml6035_l));
-            imu_cs_char.readValue((byte *)&imu_cs, sizeof(imu_cs));
-            imu_mi_char.readValue((byte *)&imu_mi, sizeof(imu_mi));
-            imu_mpm_char.readValue((byte *)&imu_mpm, sizeof(imu_mpm));
-            imu_ila_char.readValue((byte *)&imu_ila, sizeof(imu_ila));
-            imu_sdm_char.readValue((byte *)&imu_sdm, sizeof(imu_sdm));
-
-            // Send one JSON object
-            MovementData imu_data;
-            imu_data.current_state = (ActivityState)imu_cs;
-            imu_data.movement_intensity = imu_mi;
-            imu_data.movements_per_minute = imu_mpm;
-            imu_data.is_likely_asleep = imu_ila;
-            imu_data.still_duration_minutes = imu_sdm;
-            String json = toJson(si7021_t, si7021_h, sht30_t, sht30_h, veml6035_l, imu_data);
-            Serial.println(json);
-          }
-        }
-
         Serial.println("Server disconnected, scanning again...");
         BLE.scanForName(DEVICE_NAME);
       }
@@ -150,27 +116,230 @@ void loop()
   }
 }
 
-String toJson(float si7021_t, float si7021_h,
-              float sht30_t, float sht30_h,
-              float veml6035_l,
-              MovementData imu_data)
+void readSensorFrames(BLEDevice &server, BLECharacteristic &sensor_frame_char)
+{
+  sensor_frame_char.subscribe();
+
+  Serial.println("Subscribed to sensor frame notifications");
+
+  // Download what the server recorded while we were away
+  BLECharacteristic history_control_char = server.characteristic(HISTORY_CONTROL_UUID);
+  BLECharacteristic history_data_char = server.characteristic(HISTORY_DATA_UUID);
+  bool historyActive = false;
+  uint8_t historyChunkCounter = 0;
+  // Full size chunks first, the default MTU size if the link cuts them
+  uint8_t historyChunkSize = SENSOR_HISTORY_CHUNK_SIZE;
+  bool historyRestarted = false;
+
+  if (history_control_char && history_data_char)
+  {
+    history_data_char.subscribe();
+    historyActive = requestHistory(history_control_char, historyChunkSize);
+  }
+
+  while (server.connected())
+  {
+    BLE.poll(); // keep stack responsive
+
+    if (historyActive && history_data_char.valueUpdated())
+    {
+      const uint8_t *chunk = history_data_char.value();
+      int length = history_data_char.valueLength();
+
+      if (length < 1 || chunk[0] != historyChunkCounter)
+      {
+        // Chunks of the first attempt may still arrive after a restart
+        if (!historyRestarted || historyChunkCounter != 0)
+        {
+          Serial.println("History chunk lost, download aborted");
+          historyActive = false;
+        }
+      }
+      else
+      {
+        historyChunkCounter++;
+        historyParser.feed(&chunk[1], length - 1, printHistoryFrame, NULL);
+
+        if (historyParser.isComplete())
+        {
+          Serial.println("History download complete");
+          history_control_char.writeValue((uint8_t)SENSOR_HISTORY_CMD_CLEAR);
+          historyActive = false;
+        }
+        else if (length < historyChunkSize && historyChunkSize > SENSOR_HISTORY_MIN_CHUNK_SIZE)
+        {
+          // Only the last chunk is short, this one was cut to the MTU
+          Serial.println("History chunk truncated, restarting with small chunks");
+          historyChunkSize = SENSOR_HISTORY_MIN_CHUNK_SIZE;
+          historyChunkCounter = 0;
+          historyRestarted = true;
+          historyActive = requestHistory(history_control_char, historyChunkSize);
+        }
+        else if (historyParser.hasFailed() || length < historyChunkSize)
+        {
+          Serial.println("Invalid history block, download aborted");
+          historyActive = false;
+        }
+      }
+    }
+
+    if (sensor_frame_char.valueUpdated())
+    {
+      SensorFrame frame;
+      if (!sensorFrameDecode(sensor_frame_char.value(), sensor_frame_char.valueLength(), &frame))
+      {
+        Serial.println("Invalid sensor frame");
+        continue;
+      }
+
+      // A frame is already a coherent snapshot, no need to coalesce
+      printFrame(frame, SENSOR_RECORD_LIVE);
+    }
+  }
+}
+
+// Starts the history download in chunks of chunk_size bytes
+bool requestHistory(BLECharacteristic &history_control_char, uint8_t chunk_size)
 {
-  String json = "{";
-  json += "\"si7021_temp\":" + String(si7021_t, 2) + ",";
-  json += "\"si7021_hum\":" + String(si7021_h, 2) + ",";
-  // json += "\"sht30_temp\":"  + String(sht30_t, 2) + ",";
-  // json += "\"sht30_hum\":"   + String(sht30_h, 2) + ",";
-  json += "\"veml6035\":" + String(veml6035_l, 2) + ",";
-
-  // IMU data as nested object
-  json += "\"imu_data\":{";
-  json += "\"current_state\":" + String((int)imu_data.current_state) + ",";
-  json += "\"movement_intensity\":" + String(imu_data.movement_intensity, 2) + ",";
-  json += "\"movements_per_minute\":" + String(imu_data.movements_per_minute) + ",";
-  json += "\"is_likely_asleep\":" + String(imu_data.is_likely_asleep ? "true" : "false") + ",";
-  json += "\"still_duration_minutes\":" + String(imu_data.still_duration_minutes);
-  json += "}";
-
-  json += "}";
-  return json;
-}
\ No newline at end of file
+  uint8_t command[SENSOR_HISTORY_CMD_LENGTH] = {SENSOR_HISTORY_CMD_DOWNLOAD, chunk_size};
+
+  historyParser.reset();
+  return history_control_char.writeValue(command, sizeof(command));
+}
+
+// Writes one record in the selected output format
+void printFrame(const SensorFrame &frame, uint8_t type)
+{
+#if SERIAL_OUTPUT_BINARY
+  SensorRecord record;
+  record.type = type;
+  record.sequence = recordSequence++;
+  record.frame = frame;
+
+  size_t length = sensorRecordEncode(&record, binary, sizeof(binary));
+  Serial.write(binary, length);
+#else
+  SensorSnapshot snapshot;
+  sensorFrameToSnapshot(frame, &snapshot);
+
+  if (sensorJson(json, sizeof(json), recordSequence++, snapshot) == 0)
+  {
+    return;
+  }
+
+  // Historic frames carry the server's timestamp next to the values
+  if (type == SENSOR_RECORD_HISTORY)
+  {
+    Serial.print("{\"history_timestamp_ms\":");
+    Serial.print(frame.timestamp_ms);
+    Serial.print(",\"record\":");
+    Serial.print(json);
+    Serial.println("}");
+  }
+  else
+  {
+    Serial.println(json);
+  }
+#endif
+}
+
+void printHistoryFrame(const SensorFrame &frame, void *context)
+{
+  printFrame(frame, SENSOR_RECORD_HISTORY);
+}
+
+void printSnapshot(const SensorSnapshot &snapshot)
+{
+  SensorFrame frame;
+  sensorSnapshotToFrame(snapshot, &frame);
+  frame.timestamp_ms = millis();
+  printFrame(frame, SENSOR_RECORD_LIVE);
+}
+
+// Copies a notified value into the cache. valueUpdated() clears the flag,
+// so readValue() must not be used here: it would send a read request.
+bool copyUpdatedValue(BLECharacteristic &characteristic, void *value, int size)
+{
+  if (!characteristic.valueUpdated() || characteristic.valueLength() != size)
+  {
+    return false;
+  }
+
+  memcpy(value, characteristic.value(), size);
+  return true;
+}
+
+// Returns false if the server does not have all per-value characteristics
+bool readLegacyCharacteristics(BLEDevice &server)
+{
+  BLECharacteristic si7021_t_char = server.characteristic(SI7021_T_UUID);
+  BLECharacteristic si7021_h_char = server.characteristic(SI7021_H_UUID);
+  BLECharacteristic sht30_t_char = server.characteristic(SHT30_T_UUID);
+  BLECharacteristic sht30_h_char = server.characteristic(SHT30_H_UUID);
+  BLECharacteristic veml6035_char = server.characteristic(VEML6035_UUID);
+  BLECharacteristic imu_cs_char = server.characteristic(IMU_CS_UUID);
+  BLECharacteristic imu_mi_char = server.characteristic(IMU_MI_UUID);
+  BLECharacteristic imu_mpm_char = server.characteristic(IMU_MPM_UUID);
+  BLECharacteristic imu_ila_char = server.characteristic(IMU_ILA_UUID);
+  BLECharacteristic imu_sdm_char = server.characteristic(IMU_SDM_UUID);
+
+  if (!si7021_t_char || !si7021_h_char || !sht30_t_char || !sht30_h_char || !veml6035_char || !imu_cs_char || !imu_mi_char || !imu_mpm_char || !imu_ila_char || !imu_sdm_char)
+  {
+    Serial.println("Failed to find characteristics!");
+    return false;
+  }
+
+  // Enable notifications
+  si7021_t_char.subscribe();
+  si7021_h_char.subscribe();
+  sht30_t_char.subscribe();
+  sht30_h_char.subscribe();
+  veml6035_char.subscribe();
+  imu_cs_char.subscribe();
+  imu_mi_char.subscribe();
+  imu_mpm_char.subscribe();
+  imu_ila_char.subscribe();
+  imu_sdm_char.subscribe();
+
+  Serial.println("Subscribed to sensor notifications");
+
+  SensorSnapshot snapshot;
+  sensorSnapshotClear(&snapshot);
+  uint8_t imu_cs = 0;
+  bool pending = false;
+  unsigned long pendingSince = 0;
+
+  while (server.connected())
+  {
+    BLE.poll(); // keep stack responsive
+
+    // Only the notified characteristics are copied, the rest stays cached
+    bool updated = false;
+    updated |= copyUpdatedValue(si7021_t_char, &snapshot.si7021_t, sizeof(snapshot.si7021_t));
+    updated |= copyUpdatedValue(si7021_h_char, &snapshot.si7021_h, sizeof(snapshot.si7021_h));
+    updated |= copyUpdatedValue(sht30_t_char, &snapshot.sht30_t, sizeof(snapshot.sht30_t));
+    updated |= copyUpdatedValue(sht30_h_char, &snapshot.sht30_h, sizeof(snapshot.sht30_h));
+    updated |= copyUpdatedValue(veml6035_char, &snapshot.veml6035_l, sizeof(snapshot.veml6035_l));
+    updated |= copyUpdatedValue(imu_cs_char, &imu_cs, sizeof(imu_cs));
+    updated |= copyUpdatedValue(imu_mi_char, &snapshot.imu_data.movement_intensity, sizeof(snapshot.imu_data.movement_intensity));
+    updated |= copyUpdatedValue(imu_mpm_char, &snapshot.imu_data.movements_per_minute, sizeof(snapshot.imu_data.movements_per_minute));
+    updated |= copyUpdatedValue(imu_ila_char, &snapshot.imu_data.is_likely_asleep, sizeof(snapshot.imu_data.is_likely_asleep));
+    updated |= copyUpdatedValue(imu_sdm_char, &snapshot.imu_data.still_duration_minutes, sizeof(snapshot.imu_data.still_duration_minutes));
+
+    if (updated && !pending)
+    {
+      pending = true;
+      pendingSince = millis();
+    }
+
+    // Send one JSON object for the whole server tick
+    if (pending && millis() - pendingSince >= coalesceWindow)
+    {
+      pending = false;
+      snapshot.imu_data.current_state = (ActivityState)imu_cs;
+      printSnapshot(snapshot);
+    }
+  }
+
+  return true;
+}
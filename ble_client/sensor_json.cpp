@@ -0,0 +1,147 @@
+#include "sensor_json.h"
+#include <math.h>
+
+struct JsonBuffer
+{
+  char *data;
+  size_t capacity;
+  size_t length;
+  bool overflow;
+};
+
+static void appendChar(JsonBuffer &out, char c)
+{
+  // Keep one byte for the terminator
+  if (out.length + 1 >= out.capacity)
+  {
+    out.overflow = true;
+    return;
+  }
+  out.data[out.length++] = c;
+}
+
+static void appendText(JsonBuffer &out, const char *text)
+{
+  while (*text)
+  {
+    appendChar(out, *text++);
+  }
+}
+
+static void appendUnsigned(JsonBuffer &out, unsigned long value)
+{
+  char digits[10];
+  uint8_t count = 0;
+
+  do
+  {
+    digits[count++] = '0' + (value % 10);
+    value /= 10;
+  } while (value > 0);
+
+  while (count > 0)
+  {
+    appendChar(out, digits[--count]);
+  }
+}
+
+static void appendInteger(JsonBuffer &out, long value)
+{
+  if (value < 0)
+  {
+    appendChar(out, '-');
+    appendUnsigned(out, 0UL - (unsigned long)value);
+  }
+  else
+  {
+    appendUnsigned(out, value);
+  }
+}
+
+// Same output as String(value, 2) for the sensor value range
+static void appendFixed2(JsonBuffer &out, float value)
+{
+  if (isnan(value))
+  {
+    appendText(out, "nan");
+    return;
+  }
+  if (isinf(value))
+  {
+    appendText(out, value < 0 ? "-inf" : "inf");
+    return;
+  }
+
+  // Saturate instead of overflowing the 32 bit fixed point value
+  if (value > 21474836.0f)
+    value = 21474836.0f;
+  if (value < -21474836.0f)
+    value = -21474836.0f;
+
+  // A float times 100 is exact in double, so the ties round like printf()
+  // rounds the exact decimal value: 0.005f is 0.00499.. and prints 0.00
+  long hundredths = (long)nearbyint((double)value * 100.0);
+  unsigned long magnitude = hundredths < 0 ? 0UL - (unsigned long)hundredths : hundredths;
+
+  if (hundredths < 0)
+  {
+    appendChar(out, '-');
+  }
+  appendUnsigned(out, magnitude / 100);
+  appendChar(out, '.');
+  appendChar(out, '0' + (magnitude / 10) % 10);
+  appendChar(out, '0' + magnitude % 10);
+}
+
+size_t sensorJson(char *buffer, size_t capacity, unsigned long seq, const SensorSnapshot &snapshot)
+{
+  const MovementData &imu_data = snapshot.imu_data;
+  JsonBuffer out = {buffer, capacity, 0, false};
+
+  if (capacity == 0)
+  {
+    return 0;
+  }
+
+  appendText(out, "{\"seq\":");
+  appendUnsigned(out, seq);
+  appendText(out, ",\"si7021_temp\":");
+  appendFixed2(out, snapshot.si7021_t);
+  appendText(out, ",\"si7021_hum\":");
+  appendFixed2(out, snapshot.si7021_h);
+#if SENSOR_JSON_INCLUDE_SHT30
+  appendText(out, ",\"sht30_temp\":");
+  appendFixed2(out, snapshot.sht30_t);
+  appendText(out, ",\"sht30_hum\":");
+  appendFixed2(out, snapshot.sht30_h);
+#endif
+  // One value from both sensors, see th_fusion.h for the status bits
+  appendText(out, ",\"fused_temp\":");
+  appendFixed2(out, snapshot.fused_t);
+  appendText(out, ",\"fused_hum\":");
+  appendFixed2(out, snapshot.fused_h);
+  appendText(out, ",\"fusion_status\":");
+  appendUnsigned(out, snapshot.fusion_status);
+  appendText(out, ",\"veml6035\":");
+  appendFixed2(out, snapshot.veml6035_l);
+
+  // IMU data as nested object
+  appendText(out, ",\"imu_data\":{\"current_state\":");
+  appendInteger(out, (int)imu_data.current_state);
+  appendText(out, ",\"movement_intensity\":");
+  appendFixed2(out, imu_data.movement_intensity);
+  appendText(out, ",\"movements_per_minute\":");
+  appendInteger(out, imu_data.movements_per_minute);
+  appendText(out, ",\"is_likely_asleep\":");
+  appendText(out, imu_data.is_likely_asleep ? "true" : "false");
+  appendText(out, ",\"still_duration_minutes\":");
+  appendUnsigned(out, imu_data.still_duration_minutes);
+  appendText(out, "},\"sleep_stage\":");
+  appendUnsigned(out, snapshot.sleep_stage);
+  appendText(out, ",\"posture\":");
+  appendUnsigned(out, snapshot.posture);
+  appendChar(out, '}');
+
+  buffer[out.length] = '\0';
+  return out.overflow ? 0 : out.length;
+}
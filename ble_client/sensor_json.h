@@ -0,0 +1,18 @@
+#ifndef SENSOR_JSON_H
+#define SENSOR_JSON_H
+
+#include <stddef.h>
+#include "sensor_record.h"
+
+// The SHT30 values were left out of the JSON so far, enable to emit them
+#define SENSOR_JSON_INCLUDE_SHT30 0
+
+// Longest record, including the SHT30 fields and the terminator
+#define SENSOR_JSON_MAX_LENGTH 423
+
+// Writes one JSON record into buffer without any heap allocation, floats
+// are printed as fixed point with two decimals. Returns the length
+// without the terminator, 0 if the record does not fit.
+size_t sensorJson(char *buffer, size_t capacity, unsigned long seq, const SensorSnapshot &snapshot);
+
+#endif
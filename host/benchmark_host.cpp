@@ -0,0 +1,224 @@
+#include "mock_hardware.h"
+#include "si7021_model.h"
+#include "sht30_model.h"
+#include "veml6035_model.h"
+#include "icm20689_model.h"
+#include "ltr329_model.h"
+
+// The driver benchmark sketch as a host executable: the drivers run
+// against the device models, so the printed times are bus and sensor
+// times of the fake clock and the cycles are the ones of the host CPU.
+#include "../benchmark/benchmark.ino"
+
+// SilabsIMU::readRegisters before the block transfers: one SPI.transfer()
+// per byte, at the same clocks so only the call pattern differs
+static void readRegistersBytewise(uint8_t reg, uint8_t* buffer, uint8_t length,
+                                  uint32_t clock_hz = IMU_SPI_READ_CLOCK_MAX)
+{
+  SPI.beginTransaction(SPISettings(clock_hz, MSBFIRST, SPI_MODE0));
+  digitalWrite(IMU_CS_PIN, LOW);
+  SPI.transfer(reg | SPI_READ_BIT);
+  for (uint8_t i = 0; i < length; i++)
+  {
+    buffer[i] = SPI.transfer(0x00);
+  }
+  digitalWrite(IMU_CS_PIN, HIGH);
+  SPI.endTransaction();
+}
+
+// readFifo() with the per-byte reads, the status is a single register
+// read at the register clock either way
+static int readFifoBytewise()
+{
+  static uint8_t data[IMU_FIFO_RING_SAMPLES * IMU_FIFO_SAMPLE_BYTES];
+  uint8_t status;
+  uint8_t count[2];
+  readRegistersBytewise(ICM20689_INT_STATUS, &status, 1, IMU_SPI_REGISTER_CLOCK);
+  readRegistersBytewise(ICM20689_FIFO_COUNTH, count, 2);
+  uint16_t samples = (((count[0] & 0x1F) << 8) | count[1]) / IMU_FIFO_SAMPLE_BYTES;
+  if (samples > IMU_FIFO_RING_SAMPLES)
+    samples = IMU_FIFO_RING_SAMPLES;
+  readRegistersBytewise(ICM20689_FIFO_R_W, data, samples * IMU_FIFO_SAMPLE_BYTES);
+  return samples;
+}
+
+// Runs fn RUNS times, prepare before each run outside the counts, and
+// prints the SPI calls, bytes, wire time and host cycles per call
+static void measureSpi(const char *name, int (*fn)(), void (*prepare)() = NULL)
+{
+  uint32_t calls = 0, bytes = 0, cycles = 0;
+  uint64_t bus_ns = 0;
+  long samples = 0;
+  for (int i = 0; i < RUNS; i++)
+  {
+    if (prepare != NULL)
+      prepare();
+    MockBusStats before = mockBusStats;
+    uint32_t start = DWT->CYCCNT;
+    samples += fn();
+    cycles += DWT->CYCCNT - start;
+    calls += mockBusStats.spi_calls - before.spi_calls;
+    bytes += mockBusStats.spi_bytes - before.spi_bytes;
+    bus_ns += mockBusStats.bus_ns - before.bus_ns;
+  }
+
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print((float)calls / RUNS);
+  Serial.print(" SPI calls, ");
+  Serial.print((float)bytes / RUNS);
+  Serial.print(" bytes, ");
+  Serial.print((float)bus_ns / 1000 / RUNS);
+  Serial.print(" us on the wire, ");
+  Serial.print(cycles / RUNS);
+  Serial.print(" cycles, ");
+  Serial.print((float)samples / RUNS);
+  Serial.println(" samples");
+}
+
+// Drains the FIFO and lets a full ring of samples arrive at 50 Hz
+static void fillFifo()
+{
+  imu.readFifo();
+  imu.processFifo();
+  mockAdvanceMillis(IMU_FIFO_RING_SAMPLES * (1 + IMU_FIFO_DEFAULT_DIVIDER));
+}
+
+static void compareSpiReads()
+{
+  Serial.println("=== Per-byte against block SPI reads ===");
+  measureSpi("readIMU per byte", []() -> int
+             {
+               uint8_t buffer[6];
+               readRegistersBytewise(ICM20689_ACCEL_XOUT_H, buffer, 6);
+               return 1;
+             });
+  measureSpi("readIMU block", []() -> int
+             { return imu.readIMU() ? 1 : 0; });
+  measureSpi("readFifo per byte", readFifoBytewise, fillFifo);
+  measureSpi("readFifo block", []() -> int
+             { return imu.readFifo(); }, fillFifo);
+}
+
+// A register read the way the drivers did it before I2CRegisters: the
+// pointer write ends with a STOP, the read is a transaction of its own
+static uint8_t legacyRead(uint8_t address, const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length)
+{
+  Wire.beginTransmission(address);
+  Wire.write(tx, tx_length);
+  if (Wire.endTransmission() != 0)
+    return I2C_ERROR_NACK;
+  if (Wire.requestFrom(address, rx_length) != rx_length)
+    return I2C_ERROR_NO_DATA;
+  for (uint8_t i = 0; i < rx_length; i++)
+    rx[i] = Wire.read();
+  return I2C_OK;
+}
+
+// Runs one read RUNS times, prints the STARTs and STOPs per read as the
+// simulated bus saw them
+static void measureI2C(const char *name, uint8_t address, const uint8_t* tx, uint8_t tx_length,
+                       uint8_t rx_length, bool legacy)
+{
+  I2CRegisters bus(address);
+  uint8_t rx[8];
+  int failures = 0;
+  MockBusStats before = mockBusStats;
+  for (int i = 0; i < RUNS; i++)
+  {
+    uint8_t result = legacy ? legacyRead(address, tx, tx_length, rx, rx_length)
+                            : bus.transfer(tx, tx_length, rx, rx_length);
+    if (result != I2C_OK)
+      failures++;
+  }
+
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print((float)(mockBusStats.i2c_starts - before.i2c_starts) / RUNS);
+  Serial.print(" starts, ");
+  Serial.print((float)(mockBusStats.i2c_transactions - before.i2c_transactions) / RUNS);
+  Serial.print(" stops, ");
+  Serial.print((float)(mockBusStats.i2c_bytes - before.i2c_bytes) / RUNS);
+  Serial.print(" bytes, ");
+  Serial.print((float)(mockBusStats.bus_ns - before.bus_ns) / 1000 / RUNS);
+  Serial.print(" us on the wire, failures ");
+  Serial.println(failures);
+  benchmarkFailures += failures;
+}
+
+static void compareI2CReads()
+{
+  static const uint8_t als[] = {VEML6035_ALS_OUTPUT};
+  static const uint8_t status[] = {SHT30_CMD_STATUS_REGISTER >> 8, SHT30_CMD_STATUS_REGISTER & 0xFF};
+
+  Serial.println("=== endTransmission() + requestFrom against I2CRegisters::transfer ===");
+  measureI2C("VEML6035 ALS register, STOP before the read", VEML6035_ADDRESS, als, 1, 2, true);
+  measureI2C("VEML6035 ALS register, repeated start", VEML6035_ADDRESS, als, 1, 2, false);
+  measureI2C("SHT30 status register, STOP before the read", SHT30_ADDRESS_A, status, 2, 3, true);
+  measureI2C("SHT30 status register, repeated start", SHT30_ADDRESS_A, status, 2, 3, false);
+}
+
+int main()
+{
+  mockReset();
+
+  SI7021Model si7021;
+  SHT30Model sht30;
+  VEML6035Model veml6035;
+  ICM20689Model icm20689;
+  si7021.attach();
+  sht30.attach();
+  veml6035.attach();
+  icm20689.attach();
+
+  setup();
+  mockResetBusStats();
+  loop();
+
+  // Totals of one benchmark round as the simulated buses saw them
+  Serial.print("Bus totals: ");
+  Serial.print((unsigned long)mockBusStats.i2c_transactions);
+  Serial.print(" I2C transactions, ");
+  Serial.print((unsigned long)mockBusStats.i2c_starts);
+  Serial.print(" starts, ");
+  Serial.print((unsigned long)mockBusStats.i2c_bytes);
+  Serial.print(" I2C bytes, ");
+  Serial.print((unsigned long)mockBusStats.i2c_nacks);
+  Serial.print(" NACKs, ");
+  Serial.print((unsigned long)mockBusStats.spi_transactions);
+  Serial.print(" SPI transactions, ");
+  Serial.print((unsigned long)mockBusStats.spi_bytes);
+  Serial.print(" SPI bytes, ");
+  Serial.print((unsigned long)(mockBusStats.bus_ns / 1000));
+  Serial.println(" us on the wires");
+
+  if (imuReady)
+  {
+    compareSpiReads();
+  }
+
+  if (veml6035Ready && sht30Ready)
+  {
+    compareI2CReads();
+  }
+
+  // Both light sensors answer at 0x29, the LTR329 gets the address for
+  // its own round after its first conversion
+  Serial.println("=== LTR329 in place of the VEML6035 ===");
+  LTR329Model ltr329;
+  mockDetachI2C(VEML6035_ADDRESS);
+  ltr329.attach();
+  ltr329Ready = ltr329_als.init() == 0;
+  mockAdvanceMillis(500);
+  if (ltr329Ready)
+  {
+    benchmarkLtr329();
+  }
+
+  if (!imuReady || !si7021Ready || !sht30Ready || !veml6035Ready || !ltr329Ready)
+  {
+    Serial.println("A sensor failed to initialize");
+    return 1;
+  }
+  return benchmarkFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Host stand-in for the Silabs Arduino core: the subset of the Arduino API
+// the libraries use, on top of a fake clock and simulated pins and buses
+// (mock_hardware.h). Nothing in here talks to real hardware.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "WString.h"
+
+typedef uint8_t byte;
+
+// Enums like in ArduinoCore-API, so the names stay usable as members,
+// e.g. SHT30_Repeatability::HIGH
+enum PinStatus { LOW = 0, HIGH = 1, CHANGE = 2, FALLING = 3, RISING = 4 };
+enum PinMode { INPUT = 0, OUTPUT = 1, INPUT_PULLUP = 2 };
+
+#define DEC 10
+#define HEX 16
+
+// Pin numbers encode the GPIO port in bits 4 and up, like the xG24 core
+#define PA5 5
+#define PA7 7
+#define PB4 20
+#define PC8 40
+#define PC9 41
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+
+void attachInterrupt(int interrupt, void (*isr)(), int mode);
+void detachInterrupt(int interrupt);
+inline int digitalPinToInterrupt(int pin) { return pin; }
+
+void noInterrupts();
+void interrupts();
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    size_t write(const uint8_t* buffer, size_t size);
+
+    size_t print(const char* text);
+    size_t print(const String& text) { return print(text.c_str()); }
+    size_t print(char c);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    size_t println();
+    template <typename T>
+    size_t println(T value) { size_t n = print(value); return n + println(); }
+    template <typename T>
+    size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+// Writes to stdout, unless mockSerialQuiet() is set
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud) { (void)baud; }
+    operator bool() const { return true; }
+    int available() { return 0; }
+    int read() { return -1; }
+    void flush() {}
+    size_t write(uint8_t c) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef SPI_H
+#define SPI_H
+
+#include <Arduino.h>
+
+#define SPI_MODE0 0
+#define SPI_MODE1 1
+#define SPI_MODE2 2
+#define SPI_MODE3 3
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+class SPISettings {
+  public:
+    uint32_t clock;
+    uint8_t bit_order;
+    uint8_t data_mode;
+
+    SPISettings(uint32_t clock = 4000000, uint8_t bit_order = MSBFIRST, uint8_t data_mode = SPI_MODE0)
+      : clock(clock), bit_order(bit_order), data_mode(data_mode) {}
+};
+
+// SPI master on the simulated bus: the bytes go to the device model whose
+// chip select pin is low (mock_hardware.h), each one advances the fake
+// clock at the clock of the current transaction.
+class SPIClass {
+  private:
+    uint32_t clock_hz = 4000000;
+
+  public:
+    void begin() {}
+    void end() {}
+    void beginTransaction(SPISettings settings) { clock_hz = settings.clock; }
+    void endTransaction() {}
+
+    uint8_t transfer(uint8_t value);
+    // Full duplex in place
+    void transfer(void* buffer, size_t length);
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef WSTRING_H
+#define WSTRING_H
+
+#include <stddef.h>
+
+// Heap backed String like the one of ArduinoCore-API, for comparisons with
+// code that still builds text with it. Every buffer (re)allocation is
+// counted in mockStringAllocations (mock_hardware.h).
+class String {
+  private:
+    char* buffer;
+    unsigned int capacity;
+    unsigned int len;
+
+    bool reserve(unsigned int size);
+    void copy(const char* text, unsigned int length);
+    void append(const char* text, unsigned int length);
+
+  public:
+    String(const char* text = "");
+    String(const String& other);
+    String(String&& other);
+    explicit String(char c);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    // dtostrf() formatting, at least decimals + 2 characters wide
+    explicit String(float value, unsigned char decimals = 2);
+    explicit String(double value, unsigned char decimals = 2);
+    ~String();
+
+    String& operator=(const String& other);
+    String& operator=(String&& other);
+    String& operator=(const char* text);
+
+    String& operator+=(const String& other);
+    String& operator+=(const char* text);
+    String& operator+=(char c);
+
+    unsigned int length() const { return len; }
+    const char* c_str() const { return buffer != NULL ? buffer : ""; }
+    bool operator==(const char* text) const;
+
+    friend String operator+(const String& a, const String& b);
+    friend String operator+(const String& a, const char* b);
+    friend String operator+(const char* a, const String& b);
+};
+
+#endif
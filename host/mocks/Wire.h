@@ -0,0 +1,41 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <Arduino.h>
+
+#define WIRE_BUFFER_SIZE 32
+
+// I2C master on the simulated bus: every transaction goes to the device
+// model attached at its address (mock_hardware.h) and advances the fake
+// clock by its time on the wire.
+class TwoWire {
+  private:
+    uint32_t clock_hz = 100000;
+
+    uint8_t tx_address = 0;
+    uint8_t tx_buffer[WIRE_BUFFER_SIZE];
+    uint8_t tx_length = 0;
+
+    uint8_t rx_buffer[WIRE_BUFFER_SIZE];
+    uint8_t rx_length = 0;
+    uint8_t rx_index = 0;
+
+  public:
+    void begin() {}
+    void setClock(uint32_t hz) { clock_hz = hz; }
+    uint32_t getClock() const { return clock_hz; }
+
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t value);
+    size_t write(const uint8_t* data, size_t length);
+    // 0 success, 2 address NACK, 3 data NACK, like the Arduino API
+    uint8_t endTransmission(bool stop = true);
+
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, bool stop = true);
+    int available() { return rx_length - rx_index; }
+    int read() { return rx_index < rx_length ? rx_buffer[rx_index++] : -1; }
+};
+
+extern TwoWire Wire;
+
+#endif
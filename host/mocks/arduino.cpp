@@ -0,0 +1,269 @@
+#include "Arduino.h"
+#include "em_device.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+#include "mock_hardware.h"
+#include "mock_internal.h"
+#include <stdio.h>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define MOCK_PINS 64
+#define MOCK_CLOCK_HOOKS 8
+
+HardwareSerial Serial;
+
+static uint64_t now_ns = 0;
+static uint32_t clock_step_ns = 1000;
+
+struct MockPin {
+  int level;
+  int mode;
+  bool driven;
+  void (*isr)();
+  int isr_mode;
+};
+
+static MockPin pins[MOCK_PINS];
+
+struct MockClockHook {
+  void (*hook)(void* context);
+  void* context;
+};
+
+static MockClockHook clock_hooks[MOCK_CLOCK_HOOKS];
+static bool running_hooks = false;
+static bool serial_quiet = false;
+
+static DWT_Type dwt;
+static CoreDebug_Type core_debug;
+DWT_Type* const DWT = &dwt;
+CoreDebug_Type* const CoreDebug = &core_debug;
+
+static GPIO_TypeDef gpio;
+static USART_TypeDef usart0;
+GPIO_TypeDef* const GPIO = &gpio;
+USART_TypeDef* const USART0 = &usart0;
+
+static bool validPin(int pin) {
+  return pin >= 0 && pin < MOCK_PINS;
+}
+
+void mockReset() {
+  now_ns = 0;
+  clock_step_ns = 1000;
+  memset(pins, 0, sizeof(pins));
+  memset(clock_hooks, 0, sizeof(clock_hooks));
+  mockResetBuses();
+  mockResetBusStats();
+  mockResetEmlib();
+  mockStringAllocations = 0;
+}
+
+uint64_t mockNanos() {
+  return now_ns;
+}
+
+static void runClockHooks() {
+  // A hook that drives a pin may run an ISR, but never the hooks again
+  if (running_hooks) {
+    return;
+  }
+
+  running_hooks = true;
+  for (int i = 0; i < MOCK_CLOCK_HOOKS; i++) {
+    if (clock_hooks[i].hook != NULL) {
+      clock_hooks[i].hook(clock_hooks[i].context);
+    }
+  }
+  running_hooks = false;
+}
+
+void mockAdvanceNanos(uint64_t ns) {
+  now_ns += ns;
+  runClockHooks();
+}
+
+void mockSetClockStep(uint32_t ns) {
+  clock_step_ns = ns;
+}
+
+void mockAddClockHook(void (*hook)(void* context), void* context) {
+  for (int i = 0; i < MOCK_CLOCK_HOOKS; i++) {
+    if (clock_hooks[i].hook == NULL) {
+      clock_hooks[i].hook = hook;
+      clock_hooks[i].context = context;
+      return;
+    }
+  }
+}
+
+void mockRemoveClockHook(void* context) {
+  for (int i = 0; i < MOCK_CLOCK_HOOKS; i++) {
+    if (clock_hooks[i].context == context) {
+      clock_hooks[i].hook = NULL;
+      clock_hooks[i].context = NULL;
+    }
+  }
+}
+
+unsigned long millis() {
+  mockAdvanceNanos(clock_step_ns);
+  return (unsigned long)(now_ns / 1000000);
+}
+
+unsigned long micros() {
+  mockAdvanceNanos(clock_step_ns);
+  return (unsigned long)(now_ns / 1000);
+}
+
+void delay(unsigned long ms) {
+  mockAdvanceNanos((uint64_t)ms * 1000000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  mockAdvanceNanos((uint64_t)us * 1000);
+}
+
+uint32_t mockCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+  return (uint32_t)__rdtsc();
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void pinMode(int pin, int mode) {
+  if (!validPin(pin)) {
+    return;
+  }
+
+  pins[pin].mode = mode;
+  if (mode == INPUT_PULLUP && !pins[pin].driven) {
+    pins[pin].level = HIGH;
+  }
+}
+
+static void setLevel(int pin, int level) {
+  int previous = pins[pin].level;
+  pins[pin].level = level ? HIGH : LOW;
+  mockPinChanged(pin, previous, pins[pin].level);
+
+  if (pins[pin].isr == NULL || previous == pins[pin].level) {
+    return;
+  }
+
+  bool rising = pins[pin].level == HIGH;
+  if (pins[pin].isr_mode == CHANGE || (pins[pin].isr_mode == RISING) == rising) {
+    pins[pin].isr();
+  }
+}
+
+void digitalWrite(int pin, int value) {
+  if (validPin(pin)) {
+    setLevel(pin, value);
+  }
+}
+
+int digitalRead(int pin) {
+  return validPin(pin) ? pins[pin].level : LOW;
+}
+
+void mockSetPin(int pin, int level) {
+  if (validPin(pin)) {
+    pins[pin].driven = true;
+    setLevel(pin, level);
+  }
+}
+
+int mockGetPin(int pin) {
+  return digitalRead(pin);
+}
+
+int mockGetPinMode(int pin) {
+  return validPin(pin) ? pins[pin].mode : INPUT;
+}
+
+bool mockIsInterruptAttached(int pin) {
+  return validPin(pin) && pins[pin].isr != NULL;
+}
+
+void attachInterrupt(int interrupt, void (*isr)(), int mode) {
+  if (validPin(interrupt)) {
+    pins[interrupt].isr = isr;
+    pins[interrupt].isr_mode = mode;
+  }
+}
+
+void detachInterrupt(int interrupt) {
+  if (validPin(interrupt)) {
+    pins[interrupt].isr = NULL;
+  }
+}
+
+void noInterrupts() {}
+
+void interrupts() {}
+
+void mockSerialQuiet(bool quiet) {
+  serial_quiet = quiet;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (!serial_quiet) {
+    putchar(c);
+  }
+  return 1;
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    write(buffer[i]);
+  }
+  return size;
+}
+
+size_t Print::print(const char* text) {
+  return write((const uint8_t*)text, strlen(text));
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(int value, int base) {
+  return print((long)value, base);
+}
+
+size_t Print::print(unsigned int value, int base) {
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(long value, int base) {
+  if (base == DEC) {
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", value);
+    return print(text);
+  }
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  char text[24];
+  snprintf(text, sizeof(text), base == HEX ? "%lX" : "%lu", value);
+  return print(text);
+}
+
+size_t Print::print(double value, int digits) {
+  char text[48];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return print(text);
+}
+
+size_t Print::println() {
+  return print("\r\n");
+}
@@ -0,0 +1,19 @@
+#ifndef ARM_ACLE_H
+#define ARM_ACLE_H
+
+#include <stdint.h>
+
+// The ACLE intrinsics the libraries use, in plain C++ with the result
+// wrapping like the instruction. Only included when a test defines the
+// __ARM_FEATURE_* macros to build the DSP paths on the host.
+
+typedef int32_t int16x2_t;
+
+// Dual signed 16 bit multiply, low * low + high * high. Overflow (only
+// -32768 squared twice) wraps and would set the Q flag.
+inline int32_t __smuad(int16x2_t a, int16x2_t b) {
+  int64_t sum = (int64_t)(int16_t)a * (int16_t)b + (int64_t)(int16_t)(a >> 16) * (int16_t)(b >> 16);
+  return (int32_t)(uint32_t)sum;
+}
+
+#endif
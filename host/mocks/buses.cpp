@@ -0,0 +1,197 @@
+#include "Wire.h"
+#include "SPI.h"
+#include "mock_hardware.h"
+#include "mock_internal.h"
+
+#define MOCK_SPI_DEVICES 4
+
+TwoWire Wire;
+SPIClass SPI;
+
+MockBusStats mockBusStats;
+
+static MockI2CDevice* i2c_devices[128];
+
+struct MockSPISlot {
+  int cs_pin;
+  MockSPIDevice* device;
+  bool selected;
+};
+
+static MockSPISlot spi_devices[MOCK_SPI_DEVICES];
+
+void mockResetBuses() {
+  memset(i2c_devices, 0, sizeof(i2c_devices));
+  memset(spi_devices, 0, sizeof(spi_devices));
+  Wire = TwoWire();
+  SPI = SPIClass();
+}
+
+void mockResetBusStats() {
+  memset(&mockBusStats, 0, sizeof(mockBusStats));
+}
+
+void mockAttachI2C(uint8_t address, MockI2CDevice* device) {
+  i2c_devices[address & 0x7F] = device;
+}
+
+void mockDetachI2C(uint8_t address) {
+  i2c_devices[address & 0x7F] = NULL;
+}
+
+void mockAttachSPI(int cs_pin, MockSPIDevice* device) {
+  mockDetachSPI(cs_pin);
+  for (int i = 0; i < MOCK_SPI_DEVICES; i++) {
+    if (spi_devices[i].device == NULL) {
+      spi_devices[i].cs_pin = cs_pin;
+      spi_devices[i].device = device;
+      spi_devices[i].selected = false;
+      return;
+    }
+  }
+}
+
+void mockDetachSPI(int cs_pin) {
+  for (int i = 0; i < MOCK_SPI_DEVICES; i++) {
+    if (spi_devices[i].device != NULL && spi_devices[i].cs_pin == cs_pin) {
+      spi_devices[i].device = NULL;
+    }
+  }
+}
+
+// START, 9 clocks per byte with the acknowledge, STOP
+uint64_t mockI2CPhaseNanos(size_t length, uint32_t clock_hz) {
+  return (2 + 9 * (uint64_t)(1 + length)) * 1000000000ULL / clock_hz;
+}
+
+static void countI2C(size_t bytes, bool stop, bool nack, uint32_t clock_hz, bool advance) {
+  uint64_t ns = mockI2CPhaseNanos(bytes - 1, clock_hz);
+  // Every phase begins with a START or a repeated start
+  mockBusStats.i2c_starts++;
+  mockBusStats.i2c_bytes += bytes;
+  mockBusStats.bus_ns += ns;
+  if (stop) {
+    mockBusStats.i2c_transactions++;
+  }
+  if (nack) {
+    mockBusStats.i2c_nacks++;
+  }
+  if (advance) {
+    mockAdvanceNanos(ns);
+  }
+}
+
+uint8_t mockI2CWrite(uint8_t address, const uint8_t* data, size_t length, bool stop, uint32_t clock_hz,
+                     bool advance) {
+  MockI2CDevice* device = i2c_devices[address & 0x7F];
+
+  // A NACK ends the transaction with a STOP right away
+  if (device == NULL) {
+    countI2C(1, true, true, clock_hz, advance);
+    return 2;
+  }
+
+  bool acked = device->write(data, length, stop);
+  countI2C(1 + length, stop || !acked, !acked, clock_hz, advance);
+  return acked ? 0 : 3;
+}
+
+size_t mockI2CRead(uint8_t address, uint8_t* data, size_t length, uint32_t clock_hz, bool advance) {
+  MockI2CDevice* device = i2c_devices[address & 0x7F];
+  size_t received = device != NULL ? device->read(data, length) : 0;
+
+  if (received > length) {
+    received = length;
+  }
+  countI2C(1 + received, true, received == 0, clock_hz, advance);
+  return received;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  tx_address = address;
+  tx_length = 0;
+}
+
+size_t TwoWire::write(uint8_t value) {
+  if (tx_length >= WIRE_BUFFER_SIZE) {
+    return 0;
+  }
+  tx_buffer[tx_length++] = value;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t length) {
+  size_t written = 0;
+  while (written < length && write(data[written]) == 1) {
+    written++;
+  }
+  return written;
+}
+
+uint8_t TwoWire::endTransmission(bool stop) {
+  uint8_t result = mockI2CWrite(tx_address, tx_buffer, tx_length, stop, clock_hz);
+  tx_length = 0;
+  return result;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, bool stop) {
+  (void)stop;
+  if (quantity > WIRE_BUFFER_SIZE) {
+    quantity = WIRE_BUFFER_SIZE;
+  }
+
+  rx_index = 0;
+  rx_length = (uint8_t)mockI2CRead(address, rx_buffer, quantity, clock_hz);
+  return rx_length;
+}
+
+void mockPinChanged(int pin, int previous, int level) {
+  if (previous == level) {
+    return;
+  }
+
+  for (int i = 0; i < MOCK_SPI_DEVICES; i++) {
+    MockSPISlot& slot = spi_devices[i];
+    if (slot.device == NULL || slot.cs_pin != pin) {
+      continue;
+    }
+
+    if (level == LOW) {
+      slot.selected = true;
+      mockBusStats.spi_transactions++;
+      slot.device->select();
+    } else if (slot.selected) {
+      slot.selected = false;
+      slot.device->deselect();
+    }
+  }
+}
+
+static uint8_t transferByte(uint8_t value, uint32_t clock_hz) {
+  uint8_t received = 0xFF;
+
+  for (int i = 0; i < MOCK_SPI_DEVICES; i++) {
+    if (spi_devices[i].device != NULL && spi_devices[i].selected) {
+      received = spi_devices[i].device->transfer(value);
+    }
+  }
+
+  uint64_t ns = 8 * 1000000000ULL / clock_hz;
+  mockBusStats.spi_bytes++;
+  mockBusStats.bus_ns += ns;
+  mockAdvanceNanos(ns);
+  return received;
+}
+
+uint8_t SPIClass::transfer(uint8_t value) {
+  mockBusStats.spi_calls++;
+  return transferByte(value, clock_hz);
+}
+
+void SPIClass::transfer(void* buffer, size_t length) {
+  uint8_t* bytes = (uint8_t*)buffer;
+  mockBusStats.spi_calls++;
+  for (size_t i = 0; i < length; i++) {
+    bytes[i] = transferByte(bytes[i], clock_hz);
+  }
+}
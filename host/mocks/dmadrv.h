@@ -0,0 +1,37 @@
+#ifndef DMADRV_H
+#define DMADRV_H
+
+#include <stdint.h>
+
+// LDMA ping-pong transfers of the DMA driver. The simulated channel does
+// not move data by itself, mockDmaCompleteBlock() (mock_hardware.h) fills
+// the next buffer and runs the callback like the LDMA interrupt would.
+
+typedef uint32_t Ecode_t;
+
+#define ECODE_EMDRV_DMADRV_OK                  0
+#define ECODE_EMDRV_DMADRV_PARAM_ERROR         1
+#define ECODE_EMDRV_DMADRV_ALREADY_INITIALIZED 2
+#define ECODE_EMDRV_DMADRV_CHANNELS_EXHAUSTED  3
+
+typedef bool (*DMADRV_Callback_t)(unsigned int channel, unsigned int sequence, void* user_param);
+
+typedef enum {
+  dmadrvPeripheralSignal_USART0_RXDATAV
+} DMADRV_PeripheralSignal_t;
+
+typedef enum {
+  dmadrvDataSize1 = 1,
+  dmadrvDataSize2 = 2,
+  dmadrvDataSize4 = 4
+} DMADRV_DataSize_t;
+
+Ecode_t DMADRV_Init(void);
+Ecode_t DMADRV_AllocateChannel(unsigned int* channel, void* capabilities);
+Ecode_t DMADRV_FreeChannel(unsigned int channel);
+Ecode_t DMADRV_StopTransfer(unsigned int channel);
+Ecode_t DMADRV_PeripheralMemoryPingPong(unsigned int channel, DMADRV_PeripheralSignal_t signal,
+                                        void* dst0, void* dst1, void* src, bool dst_inc, int len,
+                                        DMADRV_DataSize_t size, DMADRV_Callback_t callback, void* user_param);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef EM_CORE_H
+#define EM_CORE_H
+
+// The host has no interrupts that could preempt, the critical sections
+// only have to compile
+
+#define CORE_DECLARE_IRQ_STATE int core_irq_state = 0
+#define CORE_ENTER_ATOMIC()    (void)core_irq_state
+#define CORE_EXIT_ATOMIC()     (void)core_irq_state
+#define CORE_ATOMIC_SECTION(code) { code }
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef EM_DEVICE_H
+#define EM_DEVICE_H
+
+#include <stdint.h>
+
+// Core debug registers of the Cortex-M33. CYCCNT reads the host's cycle
+// counter, so the cycle counts of the benchmark compare calls with each
+// other; the board's own numbers only come from the board.
+
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk     (1UL << 0)
+
+uint32_t mockCycleCounter();
+
+struct MockCycleCounter {
+  uint32_t offset = 0;
+
+  operator uint32_t() const { return mockCycleCounter() - offset; }
+  MockCycleCounter& operator=(uint32_t value) {
+    offset = mockCycleCounter() - value;
+    return *this;
+  }
+};
+
+struct DWT_Type {
+  uint32_t CTRL;
+  MockCycleCounter CYCCNT;
+};
+
+struct CoreDebug_Type {
+  uint32_t DEMCR;
+};
+
+extern DWT_Type* const DWT;
+extern CoreDebug_Type* const CoreDebug;
+
+typedef enum {
+  I2C0_IRQn = 27,
+  I2C1_IRQn = 28
+} IRQn_Type;
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+
+#endif
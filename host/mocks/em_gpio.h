@@ -0,0 +1,53 @@
+#ifndef EM_GPIO_H
+#define EM_GPIO_H
+
+#include <stdint.h>
+
+typedef enum {
+  gpioPortA = 0,
+  gpioPortB = 1,
+  gpioPortC = 2,
+  gpioPortD = 3
+} GPIO_Port_TypeDef;
+
+typedef enum {
+  gpioModeDisabled,
+  gpioModeInput,
+  gpioModePushPull
+} GPIO_Mode_TypeDef;
+
+inline void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out) {
+  (void)port;
+  (void)pin;
+  (void)mode;
+  (void)out;
+}
+
+typedef struct {
+  volatile uint32_t ROUTEEN;
+  volatile uint32_t CSROUTE;
+  volatile uint32_t CTSROUTE;
+  volatile uint32_t RTSROUTE;
+  volatile uint32_t RXROUTE;
+  volatile uint32_t CLKROUTE;
+  volatile uint32_t TXROUTE;
+} GPIO_USARTROUTE_TypeDef;
+
+typedef struct {
+  GPIO_USARTROUTE_TypeDef USARTROUTE[1];
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef* const GPIO;
+
+#define GPIO_USART_ROUTEEN_CSPEN  (1UL << 0)
+#define GPIO_USART_ROUTEEN_RXPEN  (1UL << 2)
+#define GPIO_USART_ROUTEEN_CLKPEN (1UL << 4)
+
+#define _GPIO_USART_RXROUTE_PORT_SHIFT  0
+#define _GPIO_USART_RXROUTE_PIN_SHIFT   16
+#define _GPIO_USART_CLKROUTE_PORT_SHIFT 0
+#define _GPIO_USART_CLKROUTE_PIN_SHIFT  16
+#define _GPIO_USART_CSROUTE_PORT_SHIFT  0
+#define _GPIO_USART_CSROUTE_PIN_SHIFT   16
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef EM_I2C_H
+#define EM_I2C_H
+
+#include <stdint.h>
+#include "em_device.h"
+
+// emlib I2C transfer API on the simulated bus. I2C_TransferInit() starts
+// the sequence, I2C_Transfer() reports it in progress until the fake clock
+// passed its time on the wire and only then exchanges the bytes with the
+// device model, so queued transactions finish in simulated time.
+
+typedef struct {
+  volatile uint32_t CMD;
+  volatile uint32_t IF;
+  volatile uint32_t IEN;
+} I2C_TypeDef;
+
+extern I2C_TypeDef* const I2C0;
+extern I2C_TypeDef* const I2C1;
+
+#define I2C_CMD_ABORT  0x00000020UL
+#define _I2C_IF_MASK   0x001FFFFFUL
+#define _I2C_IEN_MASK  0x001FFFFFUL
+
+#define I2C_FLAG_WRITE       0x0001
+#define I2C_FLAG_READ        0x0002
+#define I2C_FLAG_WRITE_READ  0x0004
+#define I2C_FLAG_WRITE_WRITE 0x0008
+
+typedef enum {
+  i2cTransferInProgress = 1,
+  i2cTransferDone = 0,
+  i2cTransferNack = -1,
+  i2cTransferBusErr = -2,
+  i2cTransferArbLost = -3,
+  i2cTransferUsageFault = -4,
+  i2cTransferSwFault = -5
+} I2C_TransferReturn_TypeDef;
+
+typedef struct {
+  uint16_t addr;
+  uint16_t flags;
+  struct {
+    uint8_t* data;
+    uint16_t len;
+  } buf[2];
+} I2C_TransferSeq_TypeDef;
+
+I2C_TransferReturn_TypeDef I2C_TransferInit(I2C_TypeDef* i2c, I2C_TransferSeq_TypeDef* seq);
+I2C_TransferReturn_TypeDef I2C_Transfer(I2C_TypeDef* i2c);
+
+void I2C_IntClear(I2C_TypeDef* i2c, uint32_t flags);
+void I2C_IntDisable(I2C_TypeDef* i2c, uint32_t flags);
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef EM_USART_H
+#define EM_USART_H
+
+#include <stdint.h>
+
+typedef struct {
+  volatile uint32_t RXDATA;
+} USART_TypeDef;
+
+extern USART_TypeDef* const USART0;
+
+#define USART_NUM(usart) 0
+
+typedef enum {
+  usartDisable,
+  usartEnableRx,
+  usartEnableTx,
+  usartEnable
+} USART_Enable_TypeDef;
+
+typedef enum {
+  usartDatabits8
+} USART_Databits_TypeDef;
+
+typedef struct {
+  USART_Enable_TypeDef enable;
+  uint32_t refFreq;
+  uint32_t baudrate;
+  USART_Databits_TypeDef databits;
+  bool master;
+  bool msbf;
+  int clockMode;
+  bool prsRxEnable;
+  int prsRxCh;
+  bool autoTx;
+  bool autoCsEnable;
+} USART_InitSync_TypeDef;
+
+typedef enum {
+  usartI2sFormatW32D24
+} USART_I2sFormat_TypeDef;
+
+typedef enum {
+  usartI2sJustifyLeft
+} USART_I2sJustify_TypeDef;
+
+typedef struct {
+  USART_InitSync_TypeDef sync;
+  USART_I2sFormat_TypeDef format;
+  bool delay;
+  bool dmaSplit;
+  USART_I2sJustify_TypeDef justify;
+  bool mono;
+} USART_InitI2s_TypeDef;
+
+#define USART_INITI2S_DEFAULT {}
+
+inline void USART_InitI2s(USART_TypeDef* usart, const USART_InitI2s_TypeDef* init) {
+  (void)usart;
+  (void)init;
+}
+
+inline void USART_Enable(USART_TypeDef* usart, USART_Enable_TypeDef enable) {
+  (void)usart;
+  (void)enable;
+}
+
+inline void USART_Reset(USART_TypeDef* usart) {
+  (void)usart;
+}
+
+#endif
@@ -0,0 +1,196 @@
+#include "em_i2c.h"
+#include "dmadrv.h"
+#include "Wire.h"
+#include "mock_hardware.h"
+#include "mock_internal.h"
+
+static I2C_TypeDef i2c0;
+static I2C_TypeDef i2c1;
+I2C_TypeDef* const I2C0 = &i2c0;
+I2C_TypeDef* const I2C1 = &i2c1;
+
+// Enabled interrupts by IRQ number
+static bool irq_enabled[64];
+
+struct MockI2CTransfer {
+  I2C_TypeDef* i2c;
+  I2C_TransferSeq_TypeDef* seq;
+  uint64_t end_ns;
+};
+
+static MockI2CTransfer transfer;
+static bool hang = false;
+static uint32_t transfer_count = 0;
+
+struct MockDma {
+  bool initialized;
+  bool running;
+  uint8_t* buffers[2];
+  size_t length;
+  unsigned int sequence;
+  DMADRV_Callback_t callback;
+  void* user_param;
+};
+
+static MockDma dma;
+
+void mockResetEmlib() {
+  memset(&i2c0, 0, sizeof(i2c0));
+  memset(&i2c1, 0, sizeof(i2c1));
+  memset(irq_enabled, 0, sizeof(irq_enabled));
+  memset(&transfer, 0, sizeof(transfer));
+  memset(&dma, 0, sizeof(dma));
+  hang = false;
+  transfer_count = 0;
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+  irq_enabled[irq] = true;
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq) {
+  irq_enabled[irq] = false;
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq) {
+  (void)irq;
+}
+
+bool mockIsIrqEnabled(int irq) {
+  return irq >= 0 && irq < 64 && irq_enabled[irq];
+}
+
+void mockI2CSetHang(bool value) {
+  hang = value;
+}
+
+uint32_t mockI2CTransferCount() {
+  return transfer_count;
+}
+
+void I2C_IntClear(I2C_TypeDef* i2c, uint32_t flags) {
+  i2c->IF &= ~flags;
+}
+
+void I2C_IntDisable(I2C_TypeDef* i2c, uint32_t flags) {
+  i2c->IEN &= ~flags;
+}
+
+I2C_TransferReturn_TypeDef I2C_TransferInit(I2C_TypeDef* i2c, I2C_TransferSeq_TypeDef* seq) {
+  uint32_t clock_hz = Wire.getClock();
+  uint64_t ns = mockI2CPhaseNanos(seq->buf[0].len, clock_hz);
+
+  if (seq->flags == I2C_FLAG_WRITE_READ || seq->flags == I2C_FLAG_WRITE_WRITE) {
+    ns += mockI2CPhaseNanos(seq->buf[1].len, clock_hz);
+  }
+
+  i2c->CMD = 0;
+  i2c->IEN = _I2C_IEN_MASK;
+  transfer.i2c = i2c;
+  transfer.seq = seq;
+  transfer.end_ns = mockNanos() + ns;
+  transfer_count++;
+  return i2cTransferInProgress;
+}
+
+// The bytes are exchanged once the transfer's time on the wire is over
+I2C_TransferReturn_TypeDef I2C_Transfer(I2C_TypeDef* i2c) {
+  if (transfer.i2c != i2c || transfer.seq == NULL) {
+    return i2cTransferUsageFault;
+  }
+
+  if (hang || (i2c->CMD & I2C_CMD_ABORT) || mockNanos() < transfer.end_ns) {
+    return i2cTransferInProgress;
+  }
+
+  I2C_TransferSeq_TypeDef* seq = transfer.seq;
+  uint8_t address = seq->addr >> 1;
+  uint32_t clock_hz = Wire.getClock();
+  I2C_TransferReturn_TypeDef status = i2cTransferDone;
+
+  transfer.seq = NULL;
+  i2c->IEN = 0;
+
+  if (seq->flags == I2C_FLAG_READ) {
+    size_t received = mockI2CRead(address, seq->buf[0].data, seq->buf[0].len, clock_hz, false);
+    if (received == 0) {
+      status = i2cTransferNack;
+    } else if (received < seq->buf[0].len) {
+      memset(seq->buf[0].data + received, 0xFF, seq->buf[0].len - received);
+    }
+    return status;
+  }
+
+  bool read = seq->flags == I2C_FLAG_WRITE_READ;
+  if (mockI2CWrite(address, seq->buf[0].data, seq->buf[0].len, !read, clock_hz, false) != 0) {
+    return i2cTransferNack;
+  }
+
+  if (read) {
+    size_t received = mockI2CRead(address, seq->buf[1].data, seq->buf[1].len, clock_hz, false);
+    if (received == 0) {
+      status = i2cTransferNack;
+    } else if (received < seq->buf[1].len) {
+      memset(seq->buf[1].data + received, 0xFF, seq->buf[1].len - received);
+    }
+  }
+
+  return status;
+}
+
+Ecode_t DMADRV_Init(void) {
+  if (dma.initialized) {
+    return ECODE_EMDRV_DMADRV_ALREADY_INITIALIZED;
+  }
+  dma.initialized = true;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+Ecode_t DMADRV_AllocateChannel(unsigned int* channel, void* capabilities) {
+  (void)capabilities;
+  *channel = 0;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+Ecode_t DMADRV_FreeChannel(unsigned int channel) {
+  (void)channel;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+Ecode_t DMADRV_StopTransfer(unsigned int channel) {
+  (void)channel;
+  dma.running = false;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+Ecode_t DMADRV_PeripheralMemoryPingPong(unsigned int channel, DMADRV_PeripheralSignal_t signal,
+                                        void* dst0, void* dst1, void* src, bool dst_inc, int len,
+                                        DMADRV_DataSize_t size, DMADRV_Callback_t callback, void* user_param) {
+  (void)channel;
+  (void)signal;
+  (void)src;
+  (void)dst_inc;
+
+  dma.running = true;
+  dma.buffers[0] = (uint8_t*)dst0;
+  dma.buffers[1] = (uint8_t*)dst1;
+  dma.length = (size_t)len * size;
+  dma.sequence = 0;
+  dma.callback = callback;
+  dma.user_param = user_param;
+  return ECODE_EMDRV_DMADRV_OK;
+}
+
+bool mockDmaCompleteBlock(const uint8_t* data, size_t length) {
+  if (!dma.running) {
+    return false;
+  }
+
+  uint8_t* buffer = dma.buffers[dma.sequence % 2];
+  memcpy(buffer, data, length < dma.length ? length : dma.length);
+  dma.sequence++;
+  if (dma.callback != NULL) {
+    dma.callback(0, dma.sequence, dma.user_param);
+  }
+  return true;
+}
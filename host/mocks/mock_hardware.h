@@ -0,0 +1,108 @@
+#ifndef MOCK_HARDWARE_H
+#define MOCK_HARDWARE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Control side of the host mocks: the fake clock, the pins and the device
+// models on the simulated I2C and SPI buses. Tests and the host benchmark
+// set them up, the libraries only see the Arduino and emlib APIs.
+
+// --- Fake clock ---
+
+// Back to time 0, all pins low, no devices, no interrupts, zero stats
+void mockReset();
+
+uint64_t mockNanos();
+inline uint64_t mockMicros64() { return mockNanos() / 1000; }
+
+void mockAdvanceNanos(uint64_t ns);
+inline void mockAdvanceMicros(uint64_t us) { mockAdvanceNanos(us * 1000); }
+inline void mockAdvanceMillis(uint64_t ms) { mockAdvanceNanos(ms * 1000000); }
+
+// Time every millis()/micros() read adds, the CPU time of a polling loop.
+// Busy waits on the clock need it to end, 1 us by default; tests that
+// count microseconds exactly set 0.
+void mockSetClockStep(uint32_t ns);
+
+// Runs hook after every clock advance until mockReset() or removal, for
+// models that drive pins on their own, e.g. an interrupt line
+void mockAddClockHook(void (*hook)(void* context), void* context);
+void mockRemoveClockHook(void* context);
+
+// --- Pins ---
+
+// Drives an input pin from the outside, an interrupt attached to it runs
+// on the matching edge
+void mockSetPin(int pin, int level);
+int mockGetPin(int pin);
+int mockGetPinMode(int pin);
+bool mockIsInterruptAttached(int pin);
+
+// --- Buses ---
+
+// A device on the I2C bus. The master writes with or without a STOP (no
+// STOP is followed by a repeated start into a read) and reads after a
+// START. Returning false or 0 bytes NACKs, a model may advance the clock
+// while it stretches the bus.
+class MockI2CDevice {
+  public:
+    virtual ~MockI2CDevice() {}
+    virtual bool write(const uint8_t* data, size_t length, bool stop) = 0;
+    virtual size_t read(uint8_t* data, size_t length) = 0;
+};
+
+// A device on the SPI bus, selected while its chip select pin is low
+class MockSPIDevice {
+  public:
+    virtual ~MockSPIDevice() {}
+    virtual void select() {}
+    virtual uint8_t transfer(uint8_t value) = 0;
+    virtual void deselect() {}
+};
+
+void mockAttachI2C(uint8_t address, MockI2CDevice* device);
+void mockDetachI2C(uint8_t address);
+void mockAttachSPI(int cs_pin, MockSPIDevice* device);
+void mockDetachSPI(int cs_pin);
+
+struct MockBusStats {
+  uint32_t i2c_transactions;  // ended by a STOP, repeated starts included
+  uint32_t i2c_starts;        // START conditions, repeated starts included
+  uint32_t i2c_bytes;         // address, written and read bytes
+  uint32_t i2c_nacks;
+  uint32_t spi_transactions;  // chip select low periods
+  uint32_t spi_calls;         // SPI.transfer() calls, a buffer counts once
+  uint32_t spi_bytes;
+  uint64_t bus_ns;            // time on the wires
+};
+
+extern MockBusStats mockBusStats;
+
+void mockResetBusStats();
+
+// --- I2C peripheral of I2CAsync ---
+
+// While set, transfers stay in progress until they are aborted
+void mockI2CSetHang(bool hang);
+bool mockIsIrqEnabled(int irq);
+// Transfers started through I2C_TransferInit() since mockReset()
+uint32_t mockI2CTransferCount();
+
+// --- LDMA ---
+
+// Copies length bytes into the next ping-pong buffer of the running
+// transfer and runs its callback. Returns false without a transfer.
+bool mockDmaCompleteBlock(const uint8_t* data, size_t length);
+
+// --- Heap ---
+
+// Buffer allocations and reallocations of String since mockReset()
+extern uint32_t mockStringAllocations;
+
+// --- Serial ---
+
+// Drops the Serial output, e.g. for tests that print nothing useful
+void mockSerialQuiet(bool quiet);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef MOCK_INTERNAL_H
+#define MOCK_INTERNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Glue between the mock translation units, not for tests
+
+void mockResetBuses();
+void mockResetEmlib();
+
+// Chip select handling of the SPI bus
+void mockPinChanged(int pin, int previous, int level);
+
+// Runs one phase of an I2C transaction with the device at address and
+// counts it, advance also moves the clock by its time on the wire.
+// Returns 0, 2 for an address NACK or 3 for a data NACK.
+uint8_t mockI2CWrite(uint8_t address, const uint8_t* data, size_t length, bool stop, uint32_t clock_hz,
+                     bool advance = true);
+// Returns the bytes the device sent, 0 for a NACKed read header
+size_t mockI2CRead(uint8_t address, uint8_t* data, size_t length, uint32_t clock_hz, bool advance = true);
+
+// Time on the wire of an I2C phase with a START, the address and length bytes
+uint64_t mockI2CPhaseNanos(size_t length, uint32_t clock_hz);
+
+#endif
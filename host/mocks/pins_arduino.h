@@ -0,0 +1,10 @@
+#ifndef PINS_ARDUINO_H
+#define PINS_ARDUINO_H
+
+#include <Arduino.h>
+
+// Power switches of the xG24 dev kit
+#define PIN_SENSOR_ENABLE PC9
+#define PIN_MIC_ENABLE    PC8
+
+#endif
@@ -0,0 +1,155 @@
+#include "WString.h"
+#include "mock_hardware.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint32_t mockStringAllocations = 0;
+
+bool String::reserve(unsigned int size) {
+  if (buffer != NULL && capacity >= size) {
+    return true;
+  }
+
+  char* grown = (char*)realloc(buffer, size + 1);
+  if (grown == NULL) {
+    return false;
+  }
+  mockStringAllocations++;
+  if (buffer == NULL) {
+    grown[0] = '\0';
+  }
+  buffer = grown;
+  capacity = size;
+  return true;
+}
+
+void String::copy(const char* text, unsigned int length) {
+  if (!reserve(length)) {
+    return;
+  }
+  memcpy(buffer, text, length);
+  buffer[length] = '\0';
+  len = length;
+}
+
+void String::append(const char* text, unsigned int length) {
+  if (!reserve(len + length)) {
+    return;
+  }
+  memmove(buffer + len, text, length);
+  len += length;
+  buffer[len] = '\0';
+}
+
+String::String(const char* text) : buffer(NULL), capacity(0), len(0) {
+  copy(text, strlen(text));
+}
+
+String::String(const String& other) : buffer(NULL), capacity(0), len(0) {
+  copy(other.c_str(), other.len);
+}
+
+String::String(String&& other) : buffer(other.buffer), capacity(other.capacity), len(other.len) {
+  other.buffer = NULL;
+  other.capacity = 0;
+  other.len = 0;
+}
+
+String::String(char c) : buffer(NULL), capacity(0), len(0) {
+  copy(&c, 1);
+}
+
+String::String(int value, unsigned char base) : String((long)value, base) {}
+
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+
+String::String(long value, unsigned char base) : buffer(NULL), capacity(0), len(0) {
+  char text[24];
+  if (base == 10) {
+    snprintf(text, sizeof(text), "%ld", value);
+  } else {
+    snprintf(text, sizeof(text), base == 16 ? "%lx" : "%lu", (unsigned long)value);
+  }
+  copy(text, strlen(text));
+}
+
+String::String(unsigned long value, unsigned char base) : buffer(NULL), capacity(0), len(0) {
+  char text[24];
+  snprintf(text, sizeof(text), base == 16 ? "%lx" : "%lu", value);
+  copy(text, strlen(text));
+}
+
+String::String(float value, unsigned char decimals) : String((double)value, decimals) {}
+
+String::String(double value, unsigned char decimals) : buffer(NULL), capacity(0), len(0) {
+  char text[48];
+  snprintf(text, sizeof(text), "%*.*f", decimals + 2, decimals, value);
+  copy(text, strlen(text));
+}
+
+String::~String() {
+  free(buffer);
+}
+
+String& String::operator=(const String& other) {
+  if (this != &other) {
+    copy(other.c_str(), other.len);
+  }
+  return *this;
+}
+
+String& String::operator=(String&& other) {
+  if (this != &other) {
+    free(buffer);
+    buffer = other.buffer;
+    capacity = other.capacity;
+    len = other.len;
+    other.buffer = NULL;
+    other.capacity = 0;
+    other.len = 0;
+  }
+  return *this;
+}
+
+String& String::operator=(const char* text) {
+  copy(text, strlen(text));
+  return *this;
+}
+
+String& String::operator+=(const String& other) {
+  append(other.c_str(), other.len);
+  return *this;
+}
+
+String& String::operator+=(const char* text) {
+  append(text, strlen(text));
+  return *this;
+}
+
+String& String::operator+=(char c) {
+  append(&c, 1);
+  return *this;
+}
+
+bool String::operator==(const char* text) const {
+  return strcmp(c_str(), text) == 0;
+}
+
+String operator+(const String& a, const String& b) {
+  String sum(a);
+  sum += b;
+  return sum;
+}
+
+String operator+(const String& a, const char* b) {
+  String sum(a);
+  sum += b;
+  return sum;
+}
+
+String operator+(const char* a, const String& b) {
+  String sum(a);
+  sum += b;
+  return sum;
+}
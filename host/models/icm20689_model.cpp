@@ -0,0 +1,246 @@
+#include "icm20689_model.h"
+
+#define PWR_MGMT_1_RESET 0x80
+#define PWR_MGMT_1_SLEEP 0x40
+#define PWR_MGMT_2_ACCEL_STBY 0x38
+#define ICM20689_FIFO_COUNTL 0x73
+// WOM threshold LSB in counts at +-2 g, 4 mg
+#define WOM_LSB_COUNTS (16384 * 4 / 1000)
+
+ICM20689Model::ICM20689Model() {
+  accel[0] = 0;
+  accel[1] = 0;
+  accel[2] = 16384;
+  sample_fn = NULL;
+  sample_context = NULL;
+  first_byte = false;
+  reading = false;
+  address = 0;
+  reset();
+}
+
+void ICM20689Model::reset() {
+  memset(registers, 0, sizeof(registers));
+  registers[ICM20689_WHO_AM_I] = ICM20689_WHO_AM_I_VAL;
+  registers[ICM20689_PWR_MGMT_1] = PWR_MGMT_1_SLEEP;
+  fifo_head = 0;
+  fifo_count = 0;
+  fifo_count_latch = 0;
+  has_previous = false;
+  sampling = false;
+  next_sample_ns = 0;
+}
+
+void ICM20689Model::attach(int cs_pin) {
+  mockAttachSPI(cs_pin, this);
+  mockAddClockHook(clockHook, this);
+  restartSampling();
+}
+
+void ICM20689Model::detach() {
+  mockDetachSPI(IMU_CS_PIN);
+  mockRemoveClockHook(this);
+}
+
+void ICM20689Model::clockHook(void* context) {
+  ((ICM20689Model*)context)->update();
+}
+
+void ICM20689Model::setAccel(int16_t x, int16_t y, int16_t z) {
+  accel[0] = x;
+  accel[1] = y;
+  accel[2] = z;
+  sample_fn = NULL;
+}
+
+void ICM20689Model::setSampleSource(ICM20689SampleFn fn, void* context) {
+  sample_fn = fn;
+  sample_context = context;
+}
+
+bool ICM20689Model::isSampling() const {
+  return !(registers[ICM20689_PWR_MGMT_1] & PWR_MGMT_1_SLEEP) &&
+         (registers[ICM20689_PWR_MGMT_2] & PWR_MGMT_2_ACCEL_STBY) != PWR_MGMT_2_ACCEL_STBY;
+}
+
+uint64_t ICM20689Model::periodNanos() const {
+  return (1 + (uint64_t)registers[ICM20689_SMPLRT_DIV]) * 1000000ULL;
+}
+
+void ICM20689Model::restartSampling() {
+  sampling = isSampling();
+  next_sample_ns = mockNanos() + periodNanos();
+}
+
+void ICM20689Model::update() {
+  if (!sampling) {
+    return;
+  }
+
+  while (mockNanos() >= next_sample_ns) {
+    sample();
+    next_sample_ns += periodNanos();
+  }
+}
+
+void ICM20689Model::pushFifo(const uint8_t* bytes) {
+  if (fifo_count + IMU_FIFO_SAMPLE_BYTES > ICM20689_MODEL_FIFO_SIZE) {
+    registers[ICM20689_INT_STATUS] |= ICM20689_INT_STATUS_FIFO_OFLOW;
+    overflows++;
+    if (registers[ICM20689_CONFIG] & ICM20689_CONFIG_FIFO_MODE) {
+      return;
+    }
+    fifo_head = (fifo_head + IMU_FIFO_SAMPLE_BYTES) % ICM20689_MODEL_FIFO_SIZE;
+    fifo_count -= IMU_FIFO_SAMPLE_BYTES;
+  }
+
+  for (int i = 0; i < IMU_FIFO_SAMPLE_BYTES; i++) {
+    fifo[(fifo_head + fifo_count) % ICM20689_MODEL_FIFO_SIZE] = bytes[i];
+    fifo_count++;
+  }
+}
+
+void ICM20689Model::sample() {
+  int16_t xyz[3] = {accel[0], accel[1], accel[2]};
+  uint8_t bytes[IMU_FIFO_SAMPLE_BYTES];
+
+  if (sample_fn != NULL) {
+    sample_fn(samples, xyz, sample_context);
+  }
+  samples++;
+
+  for (int i = 0; i < 3; i++) {
+    bytes[2 * i] = (uint16_t)xyz[i] >> 8;
+    bytes[2 * i + 1] = (uint8_t)xyz[i];
+  }
+  memcpy(&registers[ICM20689_ACCEL_XOUT_H], bytes, sizeof(bytes));
+
+  if ((registers[ICM20689_USER_CTRL] & ICM20689_USER_CTRL_FIFO_EN) &&
+      (registers[ICM20689_FIFO_EN] & ICM20689_FIFO_EN_ACCEL)) {
+    pushFifo(bytes);
+  }
+
+  if ((registers[ICM20689_ACCEL_INTEL_CTRL] & ICM20689_ACCEL_INTEL_EN) && has_previous) {
+    static const uint8_t thresholds[3] = {ICM20689_ACCEL_WOM_X_THR, ICM20689_ACCEL_WOM_Y_THR,
+                                          ICM20689_ACCEL_WOM_Z_THR};
+    for (int i = 0; i < 3; i++) {
+      int32_t difference = (int32_t)xyz[i] - previous[i];
+      if (difference < 0) {
+        difference = -difference;
+      }
+      if (difference > registers[thresholds[i]] * WOM_LSB_COUNTS) {
+        registers[ICM20689_INT_STATUS] |= 0x80 >> i;
+      }
+    }
+  }
+
+  memcpy(previous, xyz, sizeof(previous));
+  has_previous = true;
+  updatePin();
+}
+
+void ICM20689Model::updatePin() {
+  if (int_pin < 0) {
+    return;
+  }
+
+  bool pending = (registers[ICM20689_INT_STATUS] & registers[ICM20689_INT_ENABLE]) != 0;
+  if (mockGetPin(int_pin) != (pending ? HIGH : LOW)) {
+    mockSetPin(int_pin, pending ? HIGH : LOW);
+  }
+}
+
+uint8_t ICM20689Model::readRegister(uint8_t reg) {
+  switch (reg) {
+    case ICM20689_INT_STATUS: {
+      uint8_t status = registers[reg];
+      registers[reg] = 0;
+      int_status_reads++;
+      updatePin();
+      return status;
+    }
+    case ICM20689_FIFO_COUNTH:
+      fifo_count_latch = (uint16_t)fifo_count;
+      return (fifo_count_latch >> 8) & 0x1F;
+    case ICM20689_FIFO_COUNTL:
+      return (uint8_t)fifo_count_latch;
+    case ICM20689_FIFO_R_W: {
+      if (fifo_count == 0) {
+        return 0xFF;
+      }
+      uint8_t value = fifo[fifo_head];
+      fifo_head = (fifo_head + 1) % ICM20689_MODEL_FIFO_SIZE;
+      fifo_count--;
+      return value;
+    }
+    default:
+      return registers[reg];
+  }
+}
+
+void ICM20689Model::writeRegister(uint8_t reg, uint8_t value) {
+  switch (reg) {
+    case ICM20689_WHO_AM_I:
+    case ICM20689_INT_STATUS:
+      return;
+    case ICM20689_PWR_MGMT_1:
+      if (value & PWR_MGMT_1_RESET) {
+        reset();
+        return;
+      }
+      registers[reg] = value;
+      restartSampling();
+      return;
+    case ICM20689_USER_CTRL:
+      if (value & ICM20689_USER_CTRL_FIFO_RST) {
+        fifo_head = 0;
+        fifo_count = 0;
+        fifo_resets++;
+      }
+      // FIFO_RST clears itself
+      registers[reg] = value & ~ICM20689_USER_CTRL_FIFO_RST;
+      return;
+    case ICM20689_PWR_MGMT_2:
+    case ICM20689_SMPLRT_DIV:
+      registers[reg] = value;
+      restartSampling();
+      return;
+    case ICM20689_ACCEL_INTEL_CTRL:
+      registers[reg] = value;
+      has_previous = false;
+      return;
+    default:
+      registers[reg] = value;
+      return;
+  }
+}
+
+void ICM20689Model::select() {
+  update();
+  first_byte = true;
+}
+
+uint8_t ICM20689Model::transfer(uint8_t value) {
+  if (first_byte) {
+    first_byte = false;
+    reading = (value & SPI_READ_BIT) != 0;
+    address = value & 0x7F;
+    return 0x00;
+  }
+
+  if (reading) {
+    uint8_t data = readRegister(address);
+    if (address != ICM20689_FIFO_R_W) {
+      address = (address + 1) & 0x7F;
+    }
+    return data;
+  }
+
+  writeRegister(address, value);
+  address = (address + 1) & 0x7F;
+  return 0x00;
+}
+
+void ICM20689Model::deselect() {
+  first_byte = false;
+}
@@ -0,0 +1,84 @@
+#ifndef ICM20689_MODEL_H
+#define ICM20689_MODEL_H
+
+#include "mock_hardware.h"
+#include "silabs_imu.h"
+
+#define ICM20689_MODEL_FIFO_SIZE 4096
+
+// Accelerometer sample number index (from 0 since the last reset) in
+// counts at +-2 g
+typedef void (*ICM20689SampleFn)(uint64_t index, int16_t* xyz, void* context);
+
+// ICM-20689 on the simulated SPI bus. The first byte of a transaction is
+// the register with the read bit, the following ones auto increment,
+// except on FIFO_R_W which pops the FIFO. While the accelerometer runs it
+// samples at 1 kHz / (1 + SMPLRT_DIV); the samples update ACCEL_*OUT and,
+// with the FIFO and its accel source enabled, are pushed to the 4 kB FIFO.
+// A full FIFO sets FIFO_OFLOW, in CONFIG FIFO_MODE it keeps the old data,
+// otherwise it drops the oldest sample. Wake on motion compares each
+// sample with the one before and latches the WOM bits of INT_STATUS, the
+// active high INT line follows the enabled status bits until INT_STATUS is
+// read.
+class ICM20689Model : public MockSPIDevice {
+  public:
+    int int_pin = -1;
+
+    uint64_t samples = 0;
+    uint32_t overflows = 0;
+    uint32_t int_status_reads = 0;
+    uint32_t fifo_resets = 0;
+
+    ICM20689Model();
+
+    void attach(int cs_pin = IMU_CS_PIN);
+    void detach();
+
+    // Constant acceleration, or a source called for every sample
+    void setAccel(int16_t x, int16_t y, int16_t z);
+    void setSampleSource(ICM20689SampleFn fn, void* context);
+
+    // Runs the samples due by the fake clock
+    void update();
+
+    uint8_t getRegister(uint8_t reg) const { return registers[reg]; }
+    size_t getFifoCount() const { return fifo_count; }
+
+    void select() override;
+    uint8_t transfer(uint8_t value) override;
+    void deselect() override;
+
+  private:
+    uint8_t registers[128];
+    uint8_t fifo[ICM20689_MODEL_FIFO_SIZE];
+    size_t fifo_head;
+    size_t fifo_count;
+    uint16_t fifo_count_latch;
+
+    int16_t accel[3];
+    int16_t previous[3];
+    bool has_previous;
+    ICM20689SampleFn sample_fn;
+    void* sample_context;
+
+    uint64_t next_sample_ns;
+    bool sampling;
+
+    bool first_byte;
+    bool reading;
+    uint8_t address;
+
+    void reset();
+    bool isSampling() const;
+    uint64_t periodNanos() const;
+    void restartSampling();
+    void sample();
+    void pushFifo(const uint8_t* bytes);
+    uint8_t readRegister(uint8_t reg);
+    void writeRegister(uint8_t reg, uint8_t value);
+    void updatePin();
+
+    static void clockHook(void* context);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "ltr329_model.h"
+
+void LTR329Model::reset() {
+  memset(registers, 0, sizeof(registers));
+  registers[LTR329_ALS_MEAS_RATE] = ALS_MEAS_RATE_RESET_VALUE;
+  registers[LTR329_PART_ID] = PART_ID_RESET_VALUE;
+  registers[LTR329_MANUFAC_ID] = MANUFAC_ID_RESET_VALUE;
+  initialized = true;
+}
+
+uint64_t LTR329Model::periodNanos() const {
+  static const uint16_t RATES_MS[8] = {50, 100, 200, 500, 1000, 2000, 2000, 2000};
+  return RATES_MS[registers[LTR329_ALS_MEAS_RATE] & 0x07] * 1000000ULL;
+}
+
+void LTR329Model::update() {
+  if (!initialized) {
+    reset();
+  }
+
+  // Standby until ALS_MODE is set
+  if ((registers[LTR329_ALS_CONTR] & 0x01) == 0 || mockNanos() < next_conversion_ns) {
+    return;
+  }
+
+  registers[LTR329_ALS_DATA_CH1_0] = (uint8_t)ch1;
+  registers[LTR329_ALS_DATA_CH1_1] = ch1 >> 8;
+  registers[LTR329_ALS_DATA_CH0_0] = (uint8_t)ch0;
+  registers[LTR329_ALS_DATA_CH0_1] = ch0 >> 8;
+
+  uint8_t gain = (registers[LTR329_ALS_CONTR] >> LTR329_CONTR_GAIN_SHIFT) & 0x07;
+  registers[LTR329_ALS_STATUS] = (gain << 4) | LTR329_STATUS_NEW_DATA | (invalid ? LTR329_STATUS_INVALID : 0);
+  conversions++;
+
+  uint64_t period = periodNanos();
+  next_conversion_ns += ((mockNanos() - next_conversion_ns) / period + 1) * period;
+}
+
+bool LTR329Model::write(const uint8_t* data, size_t length, bool stop) {
+  (void)stop;
+
+  update();
+  if (length == 0) {
+    return true;
+  }
+
+  pointer = data[0];
+  for (size_t i = 1; i < length; i++, pointer++) {
+    if (pointer == LTR329_ALS_CONTR) {
+      // SW_RESET clears the registers and reads back 0
+      if (data[i] & 0x02) {
+        reset();
+        continue;
+      }
+      if ((data[i] & 0x01) && !(registers[LTR329_ALS_CONTR] & 0x01)) {
+        next_conversion_ns = mockNanos() + periodNanos();
+      }
+      registers[pointer] = data[i];
+    } else if (pointer == LTR329_ALS_MEAS_RATE) {
+      registers[pointer] = data[i];
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t LTR329Model::read(uint8_t* data, size_t length) {
+  update();
+
+  for (size_t i = 0; i < length; i++, pointer++) {
+    data[i] = registers[pointer];
+
+    // The data stays locked from CH1_0 until CH0_1 was read
+    if (pointer == LTR329_ALS_DATA_CH0_1) {
+      registers[LTR329_ALS_STATUS] &= ~LTR329_STATUS_NEW_DATA;
+    }
+  }
+  return length;
+}
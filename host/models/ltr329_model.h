@@ -0,0 +1,38 @@
+#ifndef LTR329_MODEL_H
+#define LTR329_MODEL_H
+
+#include "mock_hardware.h"
+#include "ltr329.h"
+
+// LTR-329ALS on the simulated bus: 8 bit registers with auto increment.
+// In active mode a new conversion of ch0/ch1 is latched every measurement
+// period and flagged in ALS_STATUS until the data registers were read.
+class LTR329Model : public MockI2CDevice {
+  public:
+    // Raw counts the next conversions report
+    uint16_t ch0 = 1000;
+    uint16_t ch1 = 300;
+    // Flags the next conversions invalid, as after a saturation
+    bool invalid = false;
+
+    uint32_t conversions = 0;
+
+    void attach() { mockAttachI2C(LTR329_ADDRESS, this); }
+
+    uint8_t getRegister(uint8_t reg) const { return registers[reg]; }
+
+    bool write(const uint8_t* data, size_t length, bool stop) override;
+    size_t read(uint8_t* data, size_t length) override;
+
+  private:
+    uint8_t registers[256] = {};
+    uint8_t pointer = 0;
+    bool initialized = false;
+    uint64_t next_conversion_ns = 0;
+
+    void reset();
+    void update();
+    uint64_t periodNanos() const;
+};
+
+#endif
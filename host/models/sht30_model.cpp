@@ -0,0 +1,218 @@
+#include "sht30_model.h"
+#include "crc8.h"
+
+#define SHT30_MODEL_PERIODIC_MS 15
+
+static uint16_t clampRaw(double raw) {
+  if (raw < 0) {
+    return 0;
+  }
+  if (raw > 65535) {
+    return 65535;
+  }
+  return (uint16_t)lround(raw);
+}
+
+// Datasheet: T = -45 + 175 * raw / 65535, RH = 100 * raw / 65535
+uint16_t SHT30Model::rawTemperature(float temperature) {
+  return clampRaw((temperature + 45.0) * 65535.0 / 175.0);
+}
+
+uint16_t SHT30Model::rawHumidity(float humidity) {
+  return clampRaw(humidity * 65535.0 / 100.0);
+}
+
+void SHT30Model::powerCycle() {
+  state = IDLE;
+  period_ms = 0;
+  result_valid = false;
+  status = SHT30_STATUS_ALERT_PENDING | SHT30_STATUS_RESET_DETECTED;
+}
+
+uint32_t SHT30Model::measurementMs(uint16_t command) const {
+  switch (command) {
+    case SHT30_CMD_MEASURE_LOW_REP_STRETCH:
+    case SHT30_CMD_MEASURE_LOW_REP_NOSTRETCH:
+      return 4;
+    case SHT30_CMD_MEASURE_MEDIUM_REP_STRETCH:
+    case SHT30_CMD_MEASURE_MEDIUM_REP_NOSTRETCH:
+      return 6;
+    default:
+      return 15;
+  }
+}
+
+// Results finished since the periodic mode started, the first one a
+// measurement time after the start
+uint64_t SHT30Model::periodicResults() const {
+  uint64_t first = periodic_start_ns + SHT30_MODEL_PERIODIC_MS * 1000000ULL;
+  if (mockNanos() < first) {
+    return 0;
+  }
+  return (mockNanos() - first) / (period_ms * 1000000ULL) + 1;
+}
+
+bool SHT30Model::startPeriodic(uint16_t command) {
+  // Upper byte 0x20..0x27 is the rate, the lower one the repeatability
+  switch (command >> 8) {
+    case 0x20: period_ms = 2000; break;
+    case 0x21: period_ms = 1000; break;
+    case 0x22: period_ms = 500; break;
+    case 0x23: period_ms = 250; break;
+    case 0x27: period_ms = 100; break;
+    default:
+      if (command != SHT30_CMD_ART) {
+        return false;
+      }
+      period_ms = 250;
+      break;
+  }
+
+  periodic_start_ns = mockNanos();
+  fetched_results = 0;
+  state = IDLE;
+  return true;
+}
+
+bool SHT30Model::write(const uint8_t* data, size_t length, bool stop) {
+  (void)stop;
+
+  if (length == 0) {
+    return true;
+  }
+  if (length != 2) {
+    nacked_commands++;
+    status |= SHT30_STATUS_COMMAND_FAILED;
+    return false;
+  }
+
+  uint16_t command = (data[0] << 8) | data[1];
+
+  if (command == nack_command && nack_count > 0) {
+    nack_count--;
+    nacked_commands++;
+    return false;
+  }
+
+  if (isPeriodic()) {
+    switch (command) {
+      case SHT30_CMD_FETCH_DATA:
+        state = FETCH;
+        return true;
+      case SHT30_CMD_BREAK:
+        period_ms = 0;
+        state = IDLE;
+        return true;
+      case SHT30_CMD_SOFT_RESET:
+        break;
+      default:
+        nacked_commands++;
+        return false;
+    }
+  }
+
+  switch (command) {
+    case SHT30_CMD_MEASURE_HIGH_REP_STRETCH:
+    case SHT30_CMD_MEASURE_MEDIUM_REP_STRETCH:
+    case SHT30_CMD_MEASURE_LOW_REP_STRETCH:
+    case SHT30_CMD_MEASURE_HIGH_REP_NOSTRETCH:
+    case SHT30_CMD_MEASURE_MEDIUM_REP_NOSTRETCH:
+    case SHT30_CMD_MEASURE_LOW_REP_NOSTRETCH:
+      done_ns = mockNanos() + measurementMs(command) * 1000000ULL;
+      result_valid = true;
+      measurements++;
+      state = (command >> 8) == 0x2C ? STRETCH : NO_STRETCH;
+      return true;
+    case SHT30_CMD_SOFT_RESET:
+      period_ms = 0;
+      result_valid = false;
+      state = IDLE;
+      status |= SHT30_STATUS_RESET_DETECTED;
+      return true;
+    case SHT30_CMD_STATUS_REGISTER:
+      state = STATUS;
+      return true;
+    case SHT30_CMD_CLEAR_STATUS:
+      status &= ~(SHT30_STATUS_ALERT_PENDING | SHT30_STATUS_RESET_DETECTED |
+                  SHT30_STATUS_COMMAND_FAILED | SHT30_STATUS_CHECKSUM_FAILED);
+      return true;
+    case SHT30_CMD_HEATER_ENABLE:
+      status |= SHT30_STATUS_HEATER_ON;
+      return true;
+    case SHT30_CMD_HEATER_DISABLE:
+      status &= ~SHT30_STATUS_HEATER_ON;
+      return true;
+    case SHT30_CMD_BREAK:
+      return true;
+    case SHT30_CMD_FETCH_DATA:
+      // Not in periodic mode, nothing to fetch
+      state = IDLE;
+      return true;
+    default:
+      if (startPeriodic(command)) {
+        return true;
+      }
+      nacked_commands++;
+      status |= SHT30_STATUS_COMMAND_FAILED;
+      return false;
+  }
+}
+
+size_t SHT30Model::sendWords(const uint16_t* words, size_t count, uint8_t* data, size_t length) {
+  uint8_t bytes[6];
+
+  for (size_t i = 0; i < count; i++) {
+    bytes[3 * i] = words[i] >> 8;
+    bytes[3 * i + 1] = (uint8_t)words[i];
+    bytes[3 * i + 2] = crc8(&bytes[3 * i], 2, CRC8_INIT_SHT30) ^ (corrupt_crc ? 0x01 : 0x00);
+  }
+
+  size_t sent = 3 * count < length ? 3 * count : length;
+  memcpy(data, bytes, sent);
+  return sent;
+}
+
+size_t SHT30Model::sendMeasurement(uint8_t* data, size_t length) {
+  uint16_t words[2] = {rawTemperature(temperature), rawHumidity(humidity)};
+  return sendWords(words, 2, data, length);
+}
+
+size_t SHT30Model::read(uint8_t* data, size_t length) {
+  uint8_t current = state;
+
+  switch (current) {
+    case STRETCH:
+      if (mockNanos() < done_ns) {
+        mockAdvanceNanos(done_ns - mockNanos());
+      }
+      state = IDLE;
+      result_valid = false;
+      return sendMeasurement(data, length);
+    case NO_STRETCH:
+      // Polling the result NACKs until the measurement is done, then the
+      // result is read once
+      if (mockNanos() < done_ns || !result_valid) {
+        return 0;
+      }
+      state = IDLE;
+      result_valid = false;
+      return sendMeasurement(data, length);
+    case FETCH: {
+      state = IDLE;
+      uint64_t results = periodicResults();
+      if (results <= fetched_results) {
+        empty_fetches++;
+        return 0;
+      }
+      fetched_results = results;
+      fetches++;
+      measurements++;
+      return sendMeasurement(data, length);
+    }
+    case STATUS:
+      state = IDLE;
+      return sendWords(&status, 1, data, length);
+    default:
+      return 0;
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef SHT30_MODEL_H
+#define SHT30_MODEL_H
+
+#include "mock_hardware.h"
+#include "sht30.h"
+
+// SHT3x on the simulated bus, at the command level of the datasheet:
+// single shot with and without clock stretching, periodic acquisition
+// with fetch/break, ART, the status register and soft reset. In periodic
+// mode every other command is NACKed, a fetch without a new result NACKs
+// its read header.
+class SHT30Model : public MockI2CDevice {
+  public:
+    float temperature = 22.0f;
+    float humidity = 40.0f;
+
+    bool corrupt_crc = false;
+
+    // NACKs the next nack_count writes of nack_command, a disturbed bus
+    uint16_t nack_command = 0;
+    uint32_t nack_count = 0;
+
+    uint16_t status = SHT30_STATUS_ALERT_PENDING | SHT30_STATUS_RESET_DETECTED;
+
+    uint32_t measurements = 0;
+    uint32_t fetches = 0;
+    uint32_t empty_fetches = 0;
+    uint32_t nacked_commands = 0;
+
+    explicit SHT30Model(uint8_t address = SHT30_ADDRESS_A) : address(address) {}
+
+    void attach() { mockAttachI2C(address, this); }
+
+    // Supply dip or brown-out: back to idle single shot mode with the
+    // reset flag set, like after power up
+    void powerCycle();
+
+    bool isPeriodic() const { return period_ms != 0; }
+    uint32_t getPeriodMs() const { return period_ms; }
+
+    static uint16_t rawTemperature(float temperature);
+    static uint16_t rawHumidity(float humidity);
+
+    bool write(const uint8_t* data, size_t length, bool stop) override;
+    size_t read(uint8_t* data, size_t length) override;
+
+  private:
+    static const uint8_t IDLE = 0;
+    static const uint8_t STRETCH = 1;     // single shot, read stretches
+    static const uint8_t NO_STRETCH = 2;  // single shot, read NACKs until done
+    static const uint8_t FETCH = 3;       // periodic result requested
+    static const uint8_t STATUS = 4;
+
+    uint8_t address;
+    uint8_t state = IDLE;
+    uint64_t done_ns = 0;
+    bool result_valid = false;
+
+    uint32_t period_ms = 0;
+    uint64_t periodic_start_ns = 0;
+    uint64_t fetched_results = 0;
+
+    uint32_t measurementMs(uint16_t command) const;
+    uint64_t periodicResults() const;
+    bool startPeriodic(uint16_t command);
+    size_t sendMeasurement(uint8_t* data, size_t length);
+    size_t sendWords(const uint16_t* words, size_t count, uint8_t* data, size_t length);
+};
+
+#endif
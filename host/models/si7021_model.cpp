@@ -0,0 +1,105 @@
+#include "si7021_model.h"
+#include "crc8.h"
+
+static uint16_t clampRaw(double raw) {
+  if (raw < 0) {
+    return 0;
+  }
+  if (raw > 65535) {
+    return 65535;
+  }
+  return (uint16_t)lround(raw);
+}
+
+// Datasheet: RH = 125 * raw / 65536 - 6, T = 175.72 * raw / 65536 - 46.85
+uint16_t SI7021Model::rawHumidity(float humidity) {
+  return clampRaw((humidity + 6.0) * 65536.0 / 125.0);
+}
+
+uint16_t SI7021Model::rawTemperature(float temperature) {
+  return clampRaw((temperature + 46.85) * 65536.0 / 175.72);
+}
+
+void SI7021Model::startConversion(bool humidity_conversion, uint8_t next_state) {
+  uint32_t us = humidity_conversion ? humidity_conversion_us : temperature_conversion_us;
+
+  done_ns = mockNanos() + (uint64_t)us * 1000;
+  if (humidity_conversion) {
+    result = rawHumidity(humidity);
+    rh_temperature = rawTemperature(temperature);
+  } else {
+    result = rawTemperature(temperature);
+  }
+  state = next_state;
+  conversions++;
+}
+
+bool SI7021Model::write(const uint8_t* data, size_t length, bool stop) {
+  (void)stop;
+
+  // Address only, e.g. a probe
+  if (length == 0) {
+    return true;
+  }
+
+  switch (data[0]) {
+    case SI7021_RESET:
+      state = IDLE;
+      resets++;
+      return true;
+    case SI7021_MEASURE_HUMIDITY_HOLD:
+      startConversion(true, HOLD);
+      return true;
+    case SI7021_MEASURE_TEMP_HOLD:
+      startConversion(false, HOLD);
+      return true;
+    case SI7021_MEASURE_HUMIDITY_NO_HOLD:
+      startConversion(true, NO_HOLD);
+      return true;
+    case SI7021_MEASURE_TEMP_NO_HOLD:
+      startConversion(false, NO_HOLD);
+      return true;
+    case SI7021_READ_TEMP_FROM_RH:
+      state = RH_TEMP;
+      return true;
+    default:
+      return false;
+  }
+}
+
+size_t SI7021Model::sendWord(uint16_t word, uint8_t* data, size_t length, bool checksum) {
+  uint8_t bytes[3] = {(uint8_t)(word >> 8), (uint8_t)word, 0};
+  size_t count = checksum ? 3 : 2;
+
+  bytes[2] = crc8(bytes, 2, CRC8_INIT_SI7021) ^ (corrupt_crc ? 0x01 : 0x00);
+  if (count > length) {
+    count = length;
+  }
+  memcpy(data, bytes, count);
+  return count;
+}
+
+size_t SI7021Model::read(uint8_t* data, size_t length) {
+  uint8_t current = state;
+
+  switch (current) {
+    case HOLD:
+      // The chip holds SCL low until the conversion is done
+      if (mockNanos() < done_ns) {
+        mockAdvanceNanos(done_ns - mockNanos());
+      }
+      state = IDLE;
+      return sendWord(result, data, length, true);
+    case NO_HOLD:
+      if (mockNanos() < done_ns) {
+        return 0;
+      }
+      state = IDLE;
+      return sendWord(result, data, length, true);
+    case RH_TEMP:
+      state = IDLE;
+      return sendWord(rh_temperature, data, length, false);
+    default:
+      return 0;
+  }
+}
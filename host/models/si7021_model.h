@@ -0,0 +1,48 @@
+#ifndef SI7021_MODEL_H
+#define SI7021_MODEL_H
+
+#include "mock_hardware.h"
+#include "si7021.h"
+
+// Si7021 on the simulated bus: hold mode commands stretch the read until
+// the conversion is done, no-hold commands NACK the read header until
+// then. Every conversion measures the values set at its start.
+class SI7021Model : public MockI2CDevice {
+  public:
+    float temperature = 21.5f;
+    float humidity = 45.0f;
+
+    // Datasheet typical times, the RH conversion includes the temperature
+    uint32_t humidity_conversion_us = 17000;
+    uint32_t temperature_conversion_us = 7000;
+
+    // Flips a bit of every checksum sent
+    bool corrupt_crc = false;
+
+    uint32_t conversions = 0;
+    uint32_t resets = 0;
+
+    void attach() { mockAttachI2C(SI7021_ADDRESS, this); }
+
+    static uint16_t rawHumidity(float humidity);
+    static uint16_t rawTemperature(float temperature);
+
+    bool write(const uint8_t* data, size_t length, bool stop) override;
+    size_t read(uint8_t* data, size_t length) override;
+
+  private:
+    static const uint8_t IDLE = 0;
+    static const uint8_t HOLD = 1;      // read stretches until done
+    static const uint8_t NO_HOLD = 2;   // read NACKs until done
+    static const uint8_t RH_TEMP = 3;   // temperature of the last RH conversion
+
+    uint8_t state = IDLE;
+    uint64_t done_ns = 0;
+    uint16_t result = 0;
+    uint16_t rh_temperature = 0;
+
+    void startConversion(bool humidity_conversion, uint8_t next_state);
+    size_t sendWord(uint16_t word, uint8_t* data, size_t length, bool checksum);
+};
+
+#endif
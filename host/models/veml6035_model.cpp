@@ -0,0 +1,158 @@
+#include "veml6035_model.h"
+
+#define CONFIG_SD 0x0001
+
+void VEML6035Model::attach() {
+  mockAttachI2C(VEML6035_ADDRESS, this);
+  mockAddClockHook(clockHook, this);
+  next_done_ns = mockNanos() + periodNanos();
+  updatePin();
+}
+
+void VEML6035Model::detach() {
+  mockDetachI2C(VEML6035_ADDRESS);
+  mockRemoveClockHook(this);
+}
+
+void VEML6035Model::clockHook(void* context) {
+  ((VEML6035Model*)context)->update();
+}
+
+// Datasheet table: 0.0128 lux/count at 100 ms, GAIN=0, DG=0, SENS=0,
+// halved per doubled integration time, by GAIN and by DG, 8 times with SENS
+uint32_t VEML6035Model::resolution(uint16_t config) {
+  uint32_t it_ms = integrationMs(config);
+  uint32_t value = 128 * 100 / it_ms;
+
+  if (config & 0x0400) {
+    value /= 2;
+  }
+  if (config & 0x0800) {
+    value /= 2;
+  }
+  if (config & 0x1000) {
+    value *= 8;
+  }
+  return value;
+}
+
+uint32_t VEML6035Model::integrationMs(uint16_t config) {
+  switch ((config >> 6) & 0x0F) {
+    case 0x0C: return 25;
+    case 0x08: return 50;
+    case 0x01: return 200;
+    case 0x02: return 400;
+    case 0x03: return 800;
+    default: return 100;
+  }
+}
+
+uint16_t VEML6035Model::counts(float lux, uint16_t config) {
+  double value = lux * 10000.0 / resolution(config);
+  if (value < 0) {
+    return 0;
+  }
+  return value > 65535 ? 65535 : (uint16_t)lround(value);
+}
+
+uint64_t VEML6035Model::periodNanos() const {
+  uint64_t ms = integrationMs(registers[VEML6035_CONFIG_ADDRESS]);
+  uint16_t psm = registers[VEML6035_PSM_ADDRESS];
+
+  // Power save mode waits 0.4, 0.8, 1.6 or 3.2 s between conversions
+  if (psm & 0x0001) {
+    ms += 400 << ((psm >> 1) & 0x03);
+  }
+  return ms * 1000000ULL;
+}
+
+void VEML6035Model::convert() {
+  uint16_t config = registers[VEML6035_CONFIG_ADDRESS];
+  uint16_t output = counts(lux, config);
+
+  registers[VEML6035_ALS_OUTPUT] = output;
+  registers[VEML6035_WCH_OUTPUT] = output;
+  conversions++;
+
+  if (config & VEML6035_CONFIG_INT_EN) {
+    if (output > registers[VEML6035_HTW_ADDRESS]) {
+      registers[VEML6035_INT_STATUS] |= VEML6035_INT_TH_HIGH;
+    }
+    if (output < registers[VEML6035_LTW_ADDRESS]) {
+      registers[VEML6035_INT_STATUS] |= VEML6035_INT_TH_LOW;
+    }
+  }
+}
+
+void VEML6035Model::update() {
+  if (registers[VEML6035_CONFIG_ADDRESS] & CONFIG_SD) {
+    return;
+  }
+
+  uint64_t now = mockNanos();
+  uint64_t period = periodNanos();
+  if (now < next_done_ns) {
+    return;
+  }
+
+  // The light is constant in between, one conversion stands for all
+  uint64_t missed = (now - next_done_ns) / period;
+  convert();
+  conversions += (uint32_t)missed;
+  next_done_ns += (missed + 1) * period;
+  updatePin();
+}
+
+void VEML6035Model::updatePin() {
+  if (int_pin < 0) {
+    return;
+  }
+
+  bool pending = (registers[VEML6035_INT_STATUS] & (VEML6035_INT_TH_HIGH | VEML6035_INT_TH_LOW)) != 0;
+  if (mockGetPin(int_pin) != (pending ? LOW : HIGH)) {
+    mockSetPin(int_pin, pending ? LOW : HIGH);
+  }
+}
+
+bool VEML6035Model::write(const uint8_t* data, size_t length, bool stop) {
+  (void)stop;
+
+  if (length == 0) {
+    return true;
+  }
+  if (data[0] >= REGISTER_COUNT) {
+    return false;
+  }
+
+  update();
+  pointer = data[0];
+  if (length == 1) {
+    return true;
+  }
+  if (length != 3 || pointer >= VEML6035_ALS_OUTPUT) {
+    return false;
+  }
+
+  registers[pointer] = data[1] | (data[2] << 8);
+
+  // A new configuration starts a new integration
+  if (pointer == VEML6035_CONFIG_ADDRESS || pointer == VEML6035_PSM_ADDRESS) {
+    next_done_ns = mockNanos() + periodNanos();
+  }
+  return true;
+}
+
+size_t VEML6035Model::read(uint8_t* data, size_t length) {
+  update();
+
+  uint16_t value = registers[pointer];
+  if (pointer == VEML6035_INT_STATUS) {
+    registers[VEML6035_INT_STATUS] = 0;
+    updatePin();
+  }
+
+  uint8_t bytes[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+  size_t sent = length < 2 ? length : 2;
+  memcpy(data, bytes, sent);
+  return sent;
+}
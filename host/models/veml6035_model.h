@@ -0,0 +1,54 @@
+#ifndef VEML6035_MODEL_H
+#define VEML6035_MODEL_H
+
+#include "mock_hardware.h"
+#include "veml6035.h"
+
+// VEML6035 on the simulated bus: 16 bit registers, LSB first. The sensor
+// converts continuously, the output only changes at the end of each
+// integration period (plus the power save wait time in PSM) and a config
+// write starts a new integration. With INT_EN a conversion outside the
+// threshold window sets the status bits and pulls the optional INT line
+// low until the status is read. Persistence is not modelled.
+class VEML6035Model : public MockI2CDevice {
+  public:
+    // Illuminance the conversions measure
+    float lux = 100.0f;
+
+    // Active low INT line, -1 without
+    int int_pin = -1;
+
+    uint32_t conversions = 0;
+
+    void attach();
+    void detach();
+
+    // Brings the output up to the fake clock
+    void update();
+
+    uint16_t getRegister(uint8_t reg) const { return registers[reg]; }
+
+    // lux per count of a configuration after the datasheet, in 0.1 mlux
+    static uint32_t resolution(uint16_t config);
+    static uint32_t integrationMs(uint16_t config);
+    static uint16_t counts(float lux, uint16_t config);
+
+    bool write(const uint8_t* data, size_t length, bool stop) override;
+    size_t read(uint8_t* data, size_t length) override;
+
+  private:
+    static const uint8_t REGISTER_COUNT = 7;
+
+    // Shut down until the first config write, like after power up
+    uint16_t registers[REGISTER_COUNT] = {0x0001, 0, 0, 0, 0, 0, 0};
+    uint8_t pointer = 0;
+    uint64_t next_done_ns = 0;
+
+    uint64_t periodNanos() const;
+    void convert();
+    void updatePin();
+
+    static void clockHook(void* context);
+};
+
+#endif
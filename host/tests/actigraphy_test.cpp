@@ -0,0 +1,170 @@
+#include <string.h>
+#include <math.h>
+#include "host_test.h"
+#include "actigraphy.h"
+
+// Sleep staging on a synthetic night: walking, a still night with turns
+// and breathing, walking again. The same trace at other sample rates
+// has to give the same stages, rates the filters cannot run at are
+// rejected.
+
+#define COUNTS_PER_MG (ACTIGRAPHY_COUNTS_PER_G / 1000.0)
+
+// Phases of the trace in minutes
+#define TRACE_WALK_MINUTES  20
+#define TRACE_SLEEP_MINUTES 90
+#define TRACE_WAKE_MINUTES  10
+#define TRACE_MINUTES       (TRACE_WALK_MINUTES + TRACE_SLEEP_MINUTES + TRACE_WAKE_MINUTES)
+#define TRACE_EPOCHS        (TRACE_MINUTES * 60 / ACTIGRAPHY_EPOCH_SECONDS)
+
+// Turning over every 20 minutes while asleep, for 3 s
+#define TRACE_TURN_PERIOD_S 1200
+#define TRACE_TURN_S        3
+
+struct Trace {
+  float rate_hz;
+  uint32_t seed;
+};
+
+static float noise(Trace* trace) {
+  trace->seed = trace->seed * 1103515245 + 12345;
+  return ((trace->seed >> 16) & 0x7FFF) / 32768.0f - 0.5f;
+}
+
+static void traceSample(Trace* trace, uint32_t index, int16_t* xyz) {
+  double t = index / trace->rate_hz;
+  double minute = t / 60;
+  double x = 0, y = 0, z = 1000;
+
+  if (minute < TRACE_WALK_MINUTES || minute >= TRACE_WALK_MINUTES + TRACE_SLEEP_MINUTES) {
+    // Steps at 1.8 Hz, 300 mg vertical and some sway
+    z += 300 * sin(2 * M_PI * 1.8 * t);
+    x += 80 * sin(2 * M_PI * 0.9 * t);
+    y += 20 * noise(trace);
+  } else {
+    double asleep = t - TRACE_WALK_MINUTES * 60;
+    // Breathing, 2 mg at 0.25 Hz
+    z += 2 * sin(2 * M_PI * 0.25 * t);
+    if (fmod(asleep, TRACE_TURN_PERIOD_S) > TRACE_TURN_PERIOD_S - TRACE_TURN_S) {
+      x += 600 * sin(2 * M_PI * 0.7 * t);
+      z -= 300 * sin(2 * M_PI * 0.7 * t);
+    }
+  }
+
+  // Sensor noise, about 1 mg
+  xyz[0] = (int16_t)lround(x * COUNTS_PER_MG + 16 * noise(trace));
+  xyz[1] = (int16_t)lround(y * COUNTS_PER_MG + 16 * noise(trace));
+  xyz[2] = (int16_t)lround(z * COUNTS_PER_MG + 16 * noise(trace));
+}
+
+// Stage of every epoch, shifted back by the scoring delay
+static void runTrace(float rate_hz, uint8_t* stages) {
+  Actigraphy actigraphy;
+  Trace trace = {rate_hz, 1};
+  int16_t xyz[3];
+  uint32_t epochs = 0;
+
+  memset(stages, SleepStage::UNKNOWN, TRACE_EPOCHS);
+  CHECK(actigraphy.setSampleRate(rate_hz));
+  actigraphy.reset();
+
+  uint32_t samples = (uint32_t)TRACE_EPOCHS * actigraphy.getEpochSamples();
+  for (uint32_t i = 0; i < samples; i++) {
+    traceSample(&trace, i, xyz);
+    if (actigraphy.addSample(xyz[0], xyz[1], xyz[2])) {
+      const ActigraphyEpoch& epoch = actigraphy.getLastEpoch();
+      CHECK_EQ(epoch.index, epochs);
+      if (epoch.index >= ACTIGRAPHY_WINDOW_FUTURE) {
+        stages[epoch.index - ACTIGRAPHY_WINDOW_FUTURE] = epoch.stage;
+      }
+      epochs++;
+    }
+  }
+  CHECK_EQ(epochs, TRACE_EPOCHS);
+}
+
+static void testNightTrace() {
+  uint8_t stages[TRACE_EPOCHS];
+  const int sleep_start = TRACE_WALK_MINUTES * 60 / ACTIGRAPHY_EPOCH_SECONDS;
+  const int sleep_end = sleep_start + TRACE_SLEEP_MINUTES * 60 / ACTIGRAPHY_EPOCH_SECONDS;
+  runTrace(ACTIGRAPHY_SAMPLE_RATE_HZ, stages);
+
+  // Scored once the window is full, the last epochs never are
+  for (int i = 0; i < ACTIGRAPHY_WINDOW_PAST; i++) {
+    CHECK_EQ(stages[i], SleepStage::UNKNOWN);
+  }
+  for (int i = TRACE_EPOCHS - ACTIGRAPHY_WINDOW_FUTURE; i < TRACE_EPOCHS; i++) {
+    CHECK_EQ(stages[i], SleepStage::UNKNOWN);
+  }
+
+  int wrong = 0;
+  for (int i = ACTIGRAPHY_WINDOW_PAST; i < sleep_start; i++) {
+    wrong += stages[i] != SleepStage::WAKE;
+  }
+  for (int i = sleep_end; i < TRACE_EPOCHS - ACTIGRAPHY_WINDOW_FUTURE; i++) {
+    wrong += stages[i] != SleepStage::WAKE;
+  }
+  CHECK_EQ(wrong, 0);
+
+  // Never awake while lying still and neither walk is in the window,
+  // deep once still for long enough
+  const int asleep = sleep_start + ACTIGRAPHY_WINDOW_PAST;
+  int deep = 0;
+  for (int i = asleep; i < sleep_end - ACTIGRAPHY_WINDOW_FUTURE; i++) {
+    CHECK(stages[i] == SleepStage::LIGHT || stages[i] == SleepStage::DEEP);
+    deep += stages[i] == SleepStage::DEEP;
+  }
+  CHECK(deep >= (sleep_end - asleep) * 2 / 3);
+  for (int i = asleep; i < asleep + ACTIGRAPHY_DEEP_MIN_EPOCHS - 1; i++) {
+    CHECK_EQ(stages[i], SleepStage::LIGHT);
+  }
+
+  // Turning over drops back to light sleep
+  for (int turn = TRACE_TURN_PERIOD_S; turn < TRACE_SLEEP_MINUTES * 60; turn += TRACE_TURN_PERIOD_S) {
+    int epoch = sleep_start + (turn - 1) / ACTIGRAPHY_EPOCH_SECONDS;
+    CHECK_EQ(stages[epoch - 1], SleepStage::DEEP);
+    CHECK_EQ(stages[epoch], SleepStage::LIGHT);
+  }
+}
+
+static void testOtherRates() {
+  uint8_t reference[TRACE_EPOCHS];
+  uint8_t stages[TRACE_EPOCHS];
+  runTrace(ACTIGRAPHY_SAMPLE_RATE_HZ, reference);
+
+  // FIFO dividers 99, 39, 20, 9, 4 and 0
+  static const float RATES[] = {10, 25, 1000.0f / 21, 100, 200, 1000};
+  for (float rate : RATES) {
+    runTrace(rate, stages);
+    int differences = 0;
+    for (int i = 0; i < TRACE_EPOCHS; i++) {
+      differences += stages[i] != reference[i];
+    }
+    // At most the epoch at the edge of the walk
+    CHECK(differences <= 1);
+  }
+}
+
+static void testRejectedRates() {
+  Actigraphy actigraphy;
+  CHECK_NEAR(actigraphy.getSampleRate(), ACTIGRAPHY_SAMPLE_RATE_HZ, 0);
+  CHECK_EQ(actigraphy.getEpochSamples(), ACTIGRAPHY_EPOCH_SAMPLES);
+
+  CHECK(!actigraphy.setSampleRate(ACTIGRAPHY_MIN_RATE_HZ - 1));
+  CHECK(!actigraphy.setSampleRate(ACTIGRAPHY_MAX_RATE_HZ + 1));
+  CHECK(!actigraphy.setSampleRate(0));
+  CHECK(!actigraphy.setSampleRate(NAN));
+  CHECK_EQ(actigraphy.getEpochSamples(), ACTIGRAPHY_EPOCH_SAMPLES);
+
+  CHECK(actigraphy.setSampleRate(100));
+  CHECK_EQ(actigraphy.getEpochSamples(), 100 * ACTIGRAPHY_EPOCH_SECONDS);
+  CHECK(actigraphy.setSampleRate(ACTIGRAPHY_MAX_RATE_HZ));
+  CHECK_EQ(actigraphy.getEpochSamples(), ACTIGRAPHY_MAX_RATE_HZ * ACTIGRAPHY_EPOCH_SECONDS);
+}
+
+int main() {
+  RUN_TEST(testNightTrace);
+  RUN_TEST(testOtherRates);
+  RUN_TEST(testRejectedRates);
+  return hostTestResult();
+}
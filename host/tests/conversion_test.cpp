@@ -0,0 +1,86 @@
+#include "host_test.h"
+#include "si7021.h"
+#include "sht30.h"
+#include "veml6035.h"
+
+// Fixed point conversions against the datasheet formulas in double, for
+// every raw value. The results are rounded, so they stay within half of
+// their LSB.
+
+// Largest difference over all raw values, checked once at the worst one
+struct WorstCase {
+  double error;
+  uint32_t raw;
+  double actual;
+  double expected;
+};
+
+static void track(WorstCase* worst, uint32_t raw, double actual, double expected) {
+  double error = fabs(actual - expected);
+  if (error >= worst->error) {
+    *worst = {error, raw, actual, expected};
+  }
+}
+
+static double clamp(double value, double low, double high) {
+  return value < low ? low : value > high ? high : value;
+}
+
+static void testSI7021() {
+  WorstCase temperature = {};
+  WorstCase humidity = {};
+
+  for (uint32_t raw = 0; raw <= 0xFFFF; raw++) {
+    double t = 175.72 * raw / 65536.0 - 46.85;
+    double rh = clamp(125.0 * raw / 65536.0 - 6.0, 0.0, 100.0);
+    track(&temperature, raw, SI7021::convertTemperatureCenti(raw), t * 100);
+    track(&humidity, raw, SI7021::convertHumidityCenti(raw), rh * 100);
+  }
+
+  CHECK_NEAR(temperature.actual, temperature.expected, 0.5 + 1e-9);
+  CHECK_NEAR(humidity.actual, humidity.expected, 0.5 + 1e-9);
+
+  // Both ends of the humidity clamp
+  CHECK_EQ(SI7021::convertHumidityCenti(0), 0);
+  CHECK_EQ(SI7021::convertHumidityCenti(0xFFFF), 10000);
+  CHECK_EQ(SI7021::convertTemperatureCenti(0), -4685);
+}
+
+static void testSHT30() {
+  WorstCase temperature = {};
+  WorstCase humidity = {};
+
+  for (uint32_t raw = 0; raw <= 0xFFFF; raw++) {
+    double t = -45.0 + 175.0 * (raw / 65535.0);
+    double rh = 100.0 * (raw / 65535.0);
+    track(&temperature, raw, SHT30::convertTemperatureCenti(raw), t * 100);
+    track(&humidity, raw, SHT30::convertHumidityCenti(raw), rh * 100);
+  }
+
+  CHECK_NEAR(temperature.actual, temperature.expected, 0.5 + 1e-9);
+  CHECK_NEAR(humidity.actual, humidity.expected, 0.5 + 1e-9);
+
+  CHECK_EQ(SHT30::convertTemperatureCenti(0), -4500);
+  CHECK_EQ(SHT30::convertTemperatureCenti(0xFFFF), 13000);
+  CHECK_EQ(SHT30::convertHumidityCenti(0xFFFF), 10000);
+}
+
+static void testVEML6035() {
+  // Resolutions in 0.1 mlux/count from the finest to the coarsest range
+  static const uint16_t resolutions[] = {4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096};
+
+  for (uint16_t resolution : resolutions) {
+    WorstCase millilux = {};
+    for (uint32_t raw = 0; raw <= 0xFFFF; raw++) {
+      track(&millilux, raw, VEML6035::countsToMilliLux(raw, resolution), raw * (resolution / 10.0));
+    }
+    CHECK_NEAR(millilux.actual, millilux.expected, 0.5 + 1e-9);
+  }
+}
+
+int main() {
+  RUN_TEST(testSI7021);
+  RUN_TEST(testSHT30);
+  RUN_TEST(testVEML6035);
+  return hostTestResult();
+}
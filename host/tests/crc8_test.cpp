@@ -0,0 +1,102 @@
+#include <string.h>
+#include "host_test.h"
+#include "crc8.h"
+
+// Table CRC against the bitwise reference, built once with the 256 entry
+// table (crc8) and once with CRC8_NIBBLE_TABLE (crc8_nibble)
+
+// Every state and byte, 64k steps, evaluated by the compiler here only
+// instead of in every translation unit including crc8.h
+constexpr bool crc8TableMatchesBitwise() {
+  for (unsigned crc = 0; crc < 256; crc++) {
+    for (unsigned data = 0; data < 256; data++) {
+      if (crc8Update(crc, data) != crc8UpdateBitwise(crc, data)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static_assert(crc8TableMatchesBitwise(), "CRC-8 table differs from the bitwise CRC");
+
+static uint8_t crc8Bitwise(const uint8_t* data, size_t length, uint8_t init) {
+  uint8_t crc = init;
+  for (size_t i = 0; i < length; i++) {
+    crc = crc8UpdateBitwise(crc, data[i]);
+  }
+  return crc;
+}
+
+static void testTable() {
+  int mismatches = 0;
+  for (unsigned crc = 0; crc < 256; crc++) {
+    for (unsigned data = 0; data < 256; data++) {
+      if (crc8Update(crc, data) != crc8UpdateBitwise(crc, data)) {
+        mismatches++;
+      }
+    }
+  }
+  CHECK_EQ(mismatches, 0);
+  CHECK_EQ(sizeof(CRC8_TABLE.entries), CRC8_TABLE_SIZE);
+}
+
+static void testDatasheetExamples() {
+  // SHT3x: 0xBEEF -> 0x92
+  static const uint8_t sht30[] = {0xBE, 0xEF};
+  CHECK_EQ(crc8(sht30, 2, CRC8_INIT_SHT30), 0x92);
+
+  // Standard check value of CRC-8/NRSC-5 (poly 0x31, init 0xFF)
+  const char* check = "123456789";
+  CHECK_EQ(crc8((const uint8_t*)check, strlen(check), CRC8_INIT_SHT30), 0xF7);
+
+  CHECK_EQ(crc8(NULL, 0, CRC8_INIT_SHT30), CRC8_INIT_SHT30);
+  CHECK_EQ(crc8(NULL, 0, CRC8_INIT_SI7021), CRC8_INIT_SI7021);
+}
+
+static void testRandomBuffers() {
+  uint32_t seed = 12345;
+  uint8_t buffer[64];
+  int mismatches = 0;
+
+  for (int run = 0; run < 2000; run++) {
+    size_t length = run % sizeof(buffer);
+    for (size_t i = 0; i < length; i++) {
+      seed = seed * 1103515245 + 12345;
+      buffer[i] = seed >> 16;
+    }
+    uint8_t init = (run & 1) ? CRC8_INIT_SHT30 : CRC8_INIT_SI7021;
+    if (crc8(buffer, length, init) != crc8Bitwise(buffer, length, init)) {
+      mismatches++;
+    }
+  }
+  CHECK_EQ(mismatches, 0);
+}
+
+static void testCheckWords() {
+  // Two measurement words as the SHT3x sends them
+  uint8_t words[6] = {0x66, 0x5A, 0, 0x8F, 0x12, 0};
+  words[2] = crc8Bitwise(&words[0], 2, CRC8_INIT_SHT30);
+  words[5] = crc8Bitwise(&words[3], 2, CRC8_INIT_SHT30);
+  CHECK(crc8CheckWords(words, 2, CRC8_INIT_SHT30));
+  CHECK(!crc8CheckWords(words, 2, CRC8_INIT_SI7021));
+
+  // Any single bit error is detected
+  int missed = 0;
+  for (int bit = 0; bit < 48; bit++) {
+    words[bit / 8] ^= 1 << (bit % 8);
+    if (crc8CheckWords(words, 2, CRC8_INIT_SHT30)) {
+      missed++;
+    }
+    words[bit / 8] ^= 1 << (bit % 8);
+  }
+  CHECK_EQ(missed, 0);
+}
+
+int main() {
+  RUN_TEST(testTable);
+  RUN_TEST(testDatasheetExamples);
+  RUN_TEST(testRandomBuffers);
+  RUN_TEST(testCheckWords);
+  return hostTestResult();
+}
@@ -0,0 +1,19 @@
+#include "host_test.h"
+#include "mock_hardware.h"
+
+int hostTestFailures = 0;
+
+void hostTestBegin(const char* name) {
+  printf("- %s\n", name);
+  mockReset();
+  mockSerialQuiet(true);
+}
+
+int hostTestResult() {
+  if (hostTestFailures > 0) {
+    printf("%d checks failed\n", hostTestFailures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
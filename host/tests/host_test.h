@@ -0,0 +1,52 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include <math.h>
+
+// Minimal checks for the host tests: a failed check prints its location
+// and the test executable returns non-zero from hostTestResult().
+
+extern int hostTestFailures;
+
+#define CHECK(condition)                                                  \
+  do {                                                                    \
+    if (!(condition)) {                                                   \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      hostTestFailures++;                                                 \
+    }                                                                     \
+  } while (0)
+
+#define CHECK_EQ(actual, expected)                                                \
+  do {                                                                            \
+    long long check_actual = (long long)(actual);                                 \
+    long long check_expected = (long long)(expected);                             \
+    if (check_actual != check_expected) {                                         \
+      printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual,   \
+             check_actual, check_expected);                                       \
+      hostTestFailures++;                                                         \
+    }                                                                             \
+  } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)                                   \
+  do {                                                                            \
+    double check_actual = (double)(actual);                                       \
+    double check_expected = (double)(expected);                                   \
+    if (!(fabs(check_actual - check_expected) <= (tolerance))) {                  \
+      printf("%s:%d: %s is %g, expected %g +- %g\n", __FILE__, __LINE__, #actual, \
+             check_actual, check_expected, (double)(tolerance));                  \
+      hostTestFailures++;                                                         \
+    }                                                                             \
+  } while (0)
+
+// Runs one test function on a fresh mock state
+#define RUN_TEST(test)     \
+  do {                     \
+    hostTestBegin(#test);  \
+    test();                \
+  } while (0)
+
+void hostTestBegin(const char* name);
+int hostTestResult();
+
+#endif
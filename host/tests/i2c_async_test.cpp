@@ -0,0 +1,409 @@
+#include <string.h>
+#include "host_test.h"
+#include "mock_hardware.h"
+#include "i2c_async.h"
+
+// I2CAsync queue semantics on the simulated peripheral: callback order,
+// the watchdog with a fast and a slow loop(), cancelled requests, blocking transfers next to the queue
+// and from inside callbacks, and the interrupt handed back to Wire
+
+#define DEVICE_ADDRESS 0x50
+
+// 8 bit registers with an auto incrementing pointer, logs the register
+// of every write so tests see the order on the bus
+class RegisterDevice : public MockI2CDevice {
+  public:
+    uint8_t registers[256];
+    uint8_t pointer = 0;
+    uint8_t log[64];
+    int log_length = 0;
+
+    RegisterDevice() {
+      for (int i = 0; i < 256; i++) {
+        registers[i] = (uint8_t)(i ^ 0xA5);
+      }
+    }
+
+    bool write(const uint8_t* data, size_t length, bool stop) override {
+      (void)stop;
+      if (length == 0) {
+        return true;
+      }
+      pointer = data[0];
+      if (log_length < 64) {
+        log[log_length++] = pointer;
+      }
+      for (size_t i = 1; i < length; i++) {
+        registers[pointer++] = data[i];
+      }
+      return true;
+    }
+
+    size_t read(uint8_t* data, size_t length) override {
+      for (size_t i = 0; i < length; i++) {
+        data[i] = registers[pointer++];
+      }
+      return length;
+    }
+};
+
+struct Completion {
+  uint8_t results[16];
+  int order[16];
+  int count;
+};
+
+struct Job {
+  Completion* completion;
+  int id;
+};
+
+static void record(uint8_t result, void* context) {
+  Job* job = (Job*)context;
+  Completion* completion = job->completion;
+  completion->results[completion->count] = result;
+  completion->order[completion->count++] = job->id;
+}
+
+static void drain() {
+  for (int i = 0; i < 100000 && !i2cAsync.isIdle(); i++) {
+    i2cAsync.service();
+  }
+}
+
+static void testBeginEnd() {
+  CHECK_EQ(I2C_ASYNC_OWN_IRQ, 0);
+  NVIC_EnableIRQ(I2C0_IRQn);
+
+  // Polled: the core's handler must not see the queue's transfers
+  CHECK_EQ(i2cAsync.begin(), 0);
+  CHECK(i2cAsync.isRunning());
+  CHECK(!mockIsIrqEnabled(I2C0_IRQn));
+  CHECK(i2cTransferHook != NULL);
+
+  i2cAsync.end();
+  CHECK(!i2cAsync.isRunning());
+  CHECK(mockIsIrqEnabled(I2C0_IRQn));
+  CHECK(i2cTransferHook == NULL);
+
+  CHECK(i2cAsync.begin((I2C_TypeDef*)NULL) != 0);
+  uint8_t reg = 0;
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, &reg, 1, NULL, 0, NULL, NULL), -1);
+}
+
+static void testOrder() {
+  RegisterDevice device;
+  Completion completion = {};
+  Job jobs[I2C_ASYNC_QUEUE_SIZE];
+  uint8_t rx[I2C_ASYNC_QUEUE_SIZE][2];
+  mockAttachI2C(DEVICE_ADDRESS, &device);
+  CHECK_EQ(i2cAsync.begin(), 0);
+
+  // Reads, writes and the address only, mixed
+  for (int i = 0; i < I2C_ASYNC_QUEUE_SIZE; i++) {
+    uint8_t tx[3] = {(uint8_t)(0x10 * i), 0x11, 0x22};
+    jobs[i] = {&completion, i};
+    int result = i % 3 == 0 ? i2cAsync.submit(DEVICE_ADDRESS, tx, 1, rx[i], 2, record, &jobs[i])
+               : i % 3 == 1 ? i2cAsync.submit(DEVICE_ADDRESS, tx, 3, NULL, 0, record, &jobs[i])
+                            : i2cAsync.submit(DEVICE_ADDRESS, NULL, 0, NULL, 0, record, &jobs[i]);
+    CHECK_EQ(result, 0);
+  }
+  CHECK_EQ(i2cAsync.getQueued(), I2C_ASYNC_QUEUE_SIZE);
+
+  // Full, and a write longer than the slot
+  uint8_t reg = 0;
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, &reg, 1, NULL, 0, NULL, NULL), -1);
+  uint8_t too_long[I2C_ASYNC_MAX_TX + 1] = {};
+  CHECK(i2cAsync.transfer(DEVICE_ADDRESS, too_long, sizeof(too_long), NULL, 0) == I2C_ERROR_BUS);
+
+  // Only one transfer at a time on the bus, nothing runs without polls
+  CHECK_EQ(mockI2CTransferCount(), 1);
+  CHECK_EQ(completion.count, 0);
+
+  drain();
+  CHECK_EQ(completion.count, I2C_ASYNC_QUEUE_SIZE);
+  CHECK_EQ(mockI2CTransferCount(), I2C_ASYNC_QUEUE_SIZE);
+  for (int i = 0; i < I2C_ASYNC_QUEUE_SIZE; i++) {
+    CHECK_EQ(completion.order[i], i);
+    CHECK_EQ(completion.results[i], I2C_OK);
+  }
+  CHECK_EQ(device.log_length, 6);
+  CHECK_EQ(device.log[0], 0x00);
+  CHECK_EQ(device.log[1], 0x10);
+  CHECK_EQ(device.log[2], 0x30);
+  CHECK_EQ(device.log[3], 0x40);
+  CHECK_EQ(rx[0][0], 0x00 ^ 0xA5);
+  CHECK_EQ(rx[3][0], 0x30 ^ 0xA5);
+  CHECK_EQ(device.registers[0x10], 0x11);
+  CHECK_EQ(device.registers[0x11], 0x22);
+
+  i2cAsync.end();
+}
+
+static void testErrors() {
+  Completion completion = {};
+  Job write = {&completion, 0};
+  Job read = {&completion, 1};
+  uint8_t tx = 0;
+  uint8_t rx[2];
+  CHECK_EQ(i2cAsync.begin(), 0);
+
+  // Nobody at the address: the write is NACKed, a read counts as no data
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, &tx, 1, NULL, 0, record, &write), 0);
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, NULL, 0, rx, 2, record, &read), 0);
+  drain();
+  CHECK_EQ(completion.count, 2);
+  CHECK_EQ(completion.results[0], I2C_ERROR_NACK);
+  CHECK_EQ(completion.results[1], I2C_ERROR_NO_DATA);
+  CHECK_EQ(i2cAsync.getErrorCount(), 2);
+  CHECK_EQ(i2cAsync.transfer(DEVICE_ADDRESS, &tx, 1, NULL, 0), I2C_ERROR_NACK);
+  CHECK_EQ(i2cAsync.getErrorCount(), 3);
+
+  i2cAsync.end();
+}
+
+static void testTimeout() {
+  RegisterDevice device;
+  Completion completion = {};
+  Job stuck = {&completion, 0};
+  Job behind = {&completion, 1};
+  uint8_t tx = 0x20;
+  uint8_t rx[2];
+  mockAttachI2C(DEVICE_ADDRESS, &device);
+  mockSetClockStep(0);
+  CHECK_EQ(i2cAsync.begin(), 0);
+
+  mockI2CSetHang(true);
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, &tx, 1, rx, 2, record, &stuck), 0);
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, &tx, 1, rx, 2, record, &behind), 0);
+
+  // Polled, past the timeout it still gets its polls
+  mockAdvanceMillis(I2C_ASYNC_TIMEOUT_MS - 1);
+  CHECK_EQ(i2cAsync.service(), 0);
+  mockAdvanceMillis(1);
+  for (int i = 1; i < I2C_ASYNC_TIMEOUT_POLLS + 3; i++) {
+    CHECK_EQ(i2cAsync.service(), 0);
+  }
+  CHECK_EQ(i2cAsync.getTimeoutCount(), 0);
+
+  // The stuck one is aborted, the next one gets the bus
+  CHECK_EQ(i2cAsync.service(), 1);
+  CHECK_EQ(completion.results[0], I2C_ERROR_TIMEOUT);
+  CHECK_EQ(i2cAsync.getTimeoutCount(), 1);
+  mockI2CSetHang(false);
+  mockAdvanceMillis(1);
+  CHECK_EQ(i2cAsync.service(), 1);
+  CHECK_EQ(completion.order[1], 1);
+  CHECK_EQ(completion.results[1], I2C_OK);
+
+  // A blocking transfer on a hung bus returns once the watchdog fired,
+  // the clock keeps running while it polls
+  mockSetClockStep(1000);
+  mockI2CSetHang(true);
+  uint64_t start = mockMicros64();
+  CHECK_EQ(i2cAsync.transfer(DEVICE_ADDRESS, &tx, 1, rx, 2), I2C_ERROR_TIMEOUT);
+  uint64_t waited = mockMicros64() - start;
+  CHECK(waited >= I2C_ASYNC_TIMEOUT_MS * 1000ULL && waited <= (I2C_ASYNC_TIMEOUT_MS + 2) * 1000ULL);
+  CHECK_EQ(i2cAsync.getTimeoutCount(), 2);
+
+  mockI2CSetHang(false);
+  CHECK_EQ(i2cAsync.transfer(DEVICE_ADDRESS, &tx, 1, rx, 2), I2C_OK);
+  CHECK_EQ(rx[0], 0x20 ^ 0xA5);
+
+  i2cAsync.end();
+}
+
+// loop() passes slower than the watchdog: the queue only moves in
+// service(), a finished transfer must not be taken for a stuck one
+static void testDelayedService() {
+  RegisterDevice device;
+  Completion completion = {};
+  Job jobs[3] = {{&completion, 0}, {&completion, 1}, {&completion, 2}};
+  uint8_t tx[3] = {0x10, 0x20, 0x30};
+  uint8_t rx[3][2];
+  mockAttachI2C(DEVICE_ADDRESS, &device);
+  mockSetClockStep(0);
+  CHECK_EQ(i2cAsync.begin(), 0);
+  unsigned long timeouts = i2cAsync.getTimeoutCount();
+
+  // One pass of 200 ms after the submit
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, &tx[0], 1, rx[0], 2, record, &jobs[0]), 0);
+  mockAdvanceMillis(4 * I2C_ASYNC_TIMEOUT_MS);
+  CHECK_EQ(i2cAsync.service(), 1);
+  CHECK_EQ(completion.results[0], I2C_OK);
+  CHECK_EQ(rx[0][0], 0x10 ^ 0xA5);
+
+  // Queued behind each other, one step per 80 ms pass
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, &tx[1], 1, rx[1], 2, record, &jobs[1]), 0);
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, &tx[2], 1, rx[2], 2, record, &jobs[2]), 0);
+  for (int i = 0; i < 4 && !i2cAsync.isIdle(); i++) {
+    mockAdvanceMillis(80);
+    i2cAsync.service();
+  }
+  CHECK(i2cAsync.isIdle());
+  CHECK_EQ(completion.count, 3);
+  CHECK_EQ(completion.results[1], I2C_OK);
+  CHECK_EQ(completion.results[2], I2C_OK);
+  CHECK_EQ(rx[2][1], 0x31 ^ 0xA5);
+  CHECK_EQ(i2cAsync.getTimeoutCount(), timeouts);
+
+  // A hung bus is still aborted once the polls are used up: 1 byte
+  // written, 2 read
+  mockI2CSetHang(true);
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, &tx[0], 1, rx[0], 2, record, &jobs[0]), 0);
+  for (int i = 0; i < I2C_ASYNC_TIMEOUT_POLLS + 3; i++) {
+    mockAdvanceMillis(80);
+    CHECK_EQ(i2cAsync.service(), 0);
+  }
+  CHECK_EQ(i2cAsync.getTimeoutCount(), timeouts);
+  mockAdvanceMillis(80);
+  CHECK_EQ(i2cAsync.service(), 1);
+  CHECK_EQ(completion.results[3], I2C_ERROR_TIMEOUT);
+  CHECK_EQ(i2cAsync.getTimeoutCount(), timeouts + 1);
+
+  mockI2CSetHang(false);
+  i2cAsync.end();
+}
+
+static void testCancel() {
+  RegisterDevice device;
+  I2CAsyncRequest request;
+  uint8_t tx = 0x30;
+  uint8_t rx[2];
+  mockAttachI2C(DEVICE_ADDRESS, &device);
+  CHECK_EQ(i2cAsync.begin(), 0);
+
+  CHECK(request.submit(DEVICE_ADDRESS, &tx, 1, rx, 2));
+  CHECK(request.isBusy());
+  CHECK(!request.submit(DEVICE_ADDRESS, &tx, 1, rx, 2));
+
+  // The result of a cancelled transaction is dropped, the request is free
+  request.cancel();
+  drain();
+  CHECK(!request.isBusy());
+  CHECK(!request.isDone());
+
+  CHECK(request.submit(DEVICE_ADDRESS, &tx, 1, rx, 2));
+  drain();
+  CHECK(request.isDone());
+  CHECK_EQ(request.take(), I2C_OK);
+  CHECK(!request.isDone());
+
+  // Cancelling a finished one frees it as well
+  CHECK(request.submit(DEVICE_ADDRESS, &tx, 1, rx, 2));
+  drain();
+  request.cancel();
+  CHECK(!request.isDone());
+  CHECK(request.submit(DEVICE_ADDRESS, &tx, 1, rx, 2));
+  drain();
+
+  i2cAsync.end();
+}
+
+static RegisterDevice* reentrant_device;
+static Completion reentrant_completion;
+static uint8_t reentrant_value;
+static uint8_t reentrant_result;
+static int reentrant_seen;
+static Job reentrant_refill = {&reentrant_completion, 99};
+
+// A driver callback that reads on with the blocking calls and queues
+// its next transaction
+static void blockingFromCallback(uint8_t result, void* context) {
+  record(result, context);
+  reentrant_seen = reentrant_completion.count;
+
+  I2CRegisters bus(DEVICE_ADDRESS);
+  reentrant_result = bus.readU8(0x42, &reentrant_value);
+
+  // No callback ran inside the blocking read
+  CHECK_EQ(reentrant_completion.count, reentrant_seen);
+
+  uint8_t tx = 0x43;
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, &tx, 1, NULL, 0, record, &reentrant_refill), 0);
+}
+
+static void testReentrancy() {
+  RegisterDevice device;
+  Job first = {&reentrant_completion, 0};
+  Job second = {&reentrant_completion, 1};
+  uint8_t tx = 0x10;
+  reentrant_device = &device;
+  memset(&reentrant_completion, 0, sizeof(reentrant_completion));
+  mockAttachI2C(DEVICE_ADDRESS, &device);
+  CHECK_EQ(i2cAsync.begin(), 0);
+
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, &tx, 1, NULL, 0, blockingFromCallback, &first), 0);
+  CHECK_EQ(i2cAsync.submit(DEVICE_ADDRESS, &tx, 1, NULL, 0, record, &second), 0);
+  drain();
+
+  CHECK_EQ(reentrant_result, I2C_OK);
+  CHECK_EQ(reentrant_value, 0x42 ^ 0xA5);
+  CHECK_EQ(reentrant_completion.count, 3);
+  CHECK_EQ(reentrant_completion.order[0], 0);
+  CHECK_EQ(reentrant_completion.order[1], 1);
+  CHECK_EQ(reentrant_completion.order[2], 99);
+
+  // On the bus: both queued ones, the blocking read, then the refill
+  CHECK_EQ(device.log_length, 4);
+  CHECK_EQ(device.log[2], 0x42);
+  CHECK_EQ(device.log[3], 0x43);
+
+  i2cAsync.end();
+}
+
+static bool interrupt_submitted;
+static Completion interrupt_completion;
+static Job interrupt_job = {&interrupt_completion, 7};
+static uint32_t transfers_at_submit;
+
+// Submits from "interrupt context" while a blocking transfer is on the bus
+static void submitFromInterrupt(void* context) {
+  (void)context;
+  static uint8_t tx = 0x55;
+  if (!interrupt_submitted && mockI2CTransferCount() == 1) {
+    interrupt_submitted = true;
+    transfers_at_submit = mockI2CTransferCount();
+    i2cAsync.submit(DEVICE_ADDRESS, &tx, 1, NULL, 0, record, &interrupt_job);
+  }
+}
+
+static void testBlockingBeforeQueue() {
+  RegisterDevice device;
+  uint8_t tx = 0x60;
+  uint8_t rx[2];
+  interrupt_submitted = false;
+  memset(&interrupt_completion, 0, sizeof(interrupt_completion));
+  mockAttachI2C(DEVICE_ADDRESS, &device);
+  CHECK_EQ(i2cAsync.begin(), 0);
+
+  // A submit while the blocking transfer is on the bus waits for it
+  mockAddClockHook(submitFromInterrupt, &interrupt_job);
+  CHECK_EQ(i2cAsync.transfer(DEVICE_ADDRESS, &tx, 1, rx, 2), I2C_OK);
+  mockRemoveClockHook(&interrupt_job);
+  CHECK(interrupt_submitted);
+  CHECK_EQ(transfers_at_submit, 1);
+  CHECK_EQ(device.log_length, 1);
+  CHECK_EQ(rx[0], 0x60 ^ 0xA5);
+
+  // It started once the blocking one was done, its callback runs later
+  CHECK_EQ(mockI2CTransferCount(), 2);
+  CHECK_EQ(interrupt_completion.count, 0);
+  drain();
+  CHECK_EQ(interrupt_completion.count, 1);
+  CHECK_EQ(device.log[1], 0x55);
+
+  i2cAsync.end();
+}
+
+int main() {
+  RUN_TEST(testBeginEnd);
+  RUN_TEST(testOrder);
+  RUN_TEST(testErrors);
+  RUN_TEST(testTimeout);
+  RUN_TEST(testDelayedService);
+  RUN_TEST(testCancel);
+  RUN_TEST(testReentrancy);
+  RUN_TEST(testBlockingBeforeQueue);
+  return hostTestResult();
+}
@@ -0,0 +1,205 @@
+#include <string.h>
+#include <stdlib.h>
+#include "host_test.h"
+#include "mock_hardware.h"
+#include "ics43434.h"
+
+// ICS-43434 capture against WAV fixtures (16 kHz, mono, 24 bit PCM in
+// host/tests/fixtures): the samples are packed the way the I2S receiver
+// writes them, 3 bytes MSB first, then unpacked in place and, through the
+// DMA mock, handed out block by block by the driver.
+//
+// sine_1khz_24bit.wav: 1 kHz at -6 dBFS, 1024 samples
+// edges_24bit.wav:     full scale, sign and byte boundary values, then
+//                      random 24 bit samples, 512 in total
+
+#define FIXTURE_MAX_SAMPLES 4096
+
+struct Fixture {
+  int32_t samples[FIXTURE_MAX_SAMPLES];
+  size_t count;
+};
+
+static uint32_t readLe(const uint8_t* bytes, int length) {
+  uint32_t value = 0;
+  for (int i = length - 1; i >= 0; i--) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+// Minimal RIFF parser, accepts only the format of the mic
+static bool loadWav(const char* name, Fixture* fixture) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", HOST_TEST_FIXTURES, name);
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    printf("cannot open %s\n", path);
+    return false;
+  }
+
+  static uint8_t data[12 + 8 * 4 + 16 + 3 * FIXTURE_MAX_SAMPLES];
+  size_t length = fread(data, 1, sizeof(data), file);
+  fclose(file);
+
+  if (length < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(&data[8], "WAVE", 4) != 0) {
+    return false;
+  }
+
+  bool format_ok = false;
+  for (size_t offset = 12; offset + 8 <= length;) {
+    uint32_t chunk = readLe(&data[offset + 4], 4);
+    const uint8_t* body = &data[offset + 8];
+    if (offset + 8 + chunk > length) {
+      return false;
+    }
+
+    if (memcmp(&data[offset], "fmt ", 4) == 0 && chunk >= 16) {
+      format_ok = readLe(&body[0], 2) == 1 && readLe(&body[2], 2) == 1 &&
+                  readLe(&body[4], 4) == ICS43434_DEFAULT_SAMPLE_RATE && readLe(&body[14], 2) == 24;
+    } else if (memcmp(&data[offset], "data", 4) == 0) {
+      if (!format_ok || chunk % 3 != 0 || chunk / 3 > FIXTURE_MAX_SAMPLES) {
+        return false;
+      }
+      fixture->count = chunk / 3;
+      for (size_t i = 0; i < fixture->count; i++) {
+        fixture->samples[i] = (int32_t)(readLe(&body[3 * i], 3) << 8) >> 8;
+      }
+      return true;
+    }
+    offset += 8 + chunk + (chunk & 1);
+  }
+
+  return false;
+}
+
+// What the LDMA stores for count samples
+static void packI2S(const int32_t* samples, size_t count, uint8_t* buffer) {
+  for (size_t i = 0; i < count; i++) {
+    buffer[3 * i] = (uint8_t)(samples[i] >> 16);
+    buffer[3 * i + 1] = (uint8_t)(samples[i] >> 8);
+    buffer[3 * i + 2] = (uint8_t)samples[i];
+  }
+}
+
+static void testUnpackFixtures() {
+  static const char* FIXTURES[] = {"sine_1khz_24bit.wav", "edges_24bit.wav"};
+  static Fixture fixture;
+  static uint32_t buffer[FIXTURE_MAX_SAMPLES];
+
+  for (const char* name : FIXTURES) {
+    CHECK(loadWav(name, &fixture));
+    CHECK(fixture.count > 0);
+
+    int mismatches = 0;
+    packI2S(fixture.samples, fixture.count, (uint8_t*)buffer);
+    int32_t* samples = ics43434Unpack24(buffer, fixture.count);
+    CHECK((void*)samples == (void*)buffer);
+    for (size_t i = 0; i < fixture.count; i++) {
+      mismatches += samples[i] != fixture.samples[i];
+    }
+    CHECK_EQ(mismatches, 0);
+
+    // The upper 16 bits, i.e. the sample shifted down with its sign
+    packI2S(fixture.samples, fixture.count, (uint8_t*)buffer);
+    int16_t* samples16 = ics43434Unpack24To16(buffer, fixture.count);
+    for (size_t i = 0; i < fixture.count; i++) {
+      mismatches += samples16[i] != (fixture.samples[i] >> 8);
+    }
+    CHECK_EQ(mismatches, 0);
+  }
+
+  // Full scale ends of the edge fixture
+  CHECK(loadWav("edges_24bit.wav", &fixture));
+  packI2S(fixture.samples, 2, (uint8_t*)buffer);
+  int32_t* samples = ics43434Unpack24(buffer, 2);
+  CHECK_EQ(samples[0], 8388607);
+  CHECK_EQ(samples[1], -8388608);
+}
+
+static Fixture received;
+
+static void collect(const int32_t* samples, size_t count, void* context) {
+  (void)context;
+  for (size_t i = 0; i < count && received.count < FIXTURE_MAX_SAMPLES; i++) {
+    received.samples[received.count++] = samples[i];
+  }
+}
+
+// Feeds the fixture through the DMA mock one block at a time after the
+// settling blocks, with count blocks between two service() calls
+static void capture(ICS43434& mic, const Fixture& fixture, int blocks_per_service) {
+  uint8_t block[3 * ICS43434_BLOCK_SAMPLES];
+  int pending = 0;
+
+  // The output before the mic settled, dropped by the driver
+  memset(block, 0x5A, sizeof(block));
+  for (int i = 0; i < ICS43434_STARTUP_BLOCKS; i++) {
+    CHECK(mockDmaCompleteBlock(block, sizeof(block)));
+    CHECK_EQ(mic.service(), 0);
+  }
+
+  for (size_t offset = 0; offset < fixture.count; offset += ICS43434_BLOCK_SAMPLES) {
+    packI2S(&fixture.samples[offset], ICS43434_BLOCK_SAMPLES, block);
+    CHECK(mockDmaCompleteBlock(block, sizeof(block)));
+    if (++pending == blocks_per_service) {
+      mic.service();
+      pending = 0;
+    }
+  }
+  mic.service();
+}
+
+static void testCaptureFixture() {
+  static Fixture fixture;
+  ICS43434 mic;
+  CHECK(loadWav("sine_1khz_24bit.wav", &fixture));
+  CHECK_EQ(fixture.count % ICS43434_BLOCK_SAMPLES, 0);
+
+  received.count = 0;
+  mic.setBlockCallback(collect, NULL);
+  CHECK_EQ(mic.init(), 0);
+  CHECK(mic.isRunning());
+
+  capture(mic, fixture, 1);
+  CHECK_EQ(received.count, fixture.count);
+  CHECK_EQ(memcmp(received.samples, fixture.samples, fixture.count * sizeof(int32_t)), 0);
+  CHECK_EQ(mic.getOverrunCount(), 0);
+
+  // -6 dBFS: the peaks at 2^22
+  int32_t peak = 0;
+  for (size_t i = 0; i < received.count; i++) {
+    peak = abs(received.samples[i]) > peak ? abs(received.samples[i]) : peak;
+  }
+  CHECK_EQ(peak, 1 << 22);
+
+  mic.end();
+  CHECK(!mic.isRunning());
+  CHECK(!mockDmaCompleteBlock((const uint8_t*)received.samples, 3));
+}
+
+static void testOverrun() {
+  static Fixture fixture;
+  ICS43434 mic;
+  CHECK(loadWav("sine_1khz_24bit.wav", &fixture));
+
+  received.count = 0;
+  mic.setBlockCallback(collect, NULL);
+  CHECK_EQ(mic.init(), 0);
+
+  // All four blocks before one service(): the first two were overwritten,
+  // the DMA is already filling the buffer of the third
+  capture(mic, fixture, 4);
+  CHECK_EQ(mic.getOverrunCount(), 3);
+  CHECK_EQ(received.count, ICS43434_BLOCK_SAMPLES);
+  CHECK_EQ(memcmp(received.samples, &fixture.samples[3 * ICS43434_BLOCK_SAMPLES],
+                  ICS43434_BLOCK_SAMPLES * sizeof(int32_t)), 0);
+  mic.end();
+}
+
+int main() {
+  RUN_TEST(testUnpackFixtures);
+  RUN_TEST(testCaptureFixture);
+  RUN_TEST(testOverrun);
+  return hostTestResult();
+}
@@ -0,0 +1,127 @@
+#include "host_test.h"
+#include "mock_hardware.h"
+#include "icm20689_model.h"
+#include "silabs_imu.h"
+
+// SilabsIMU FIFO mode against the ICM-20689 model: ring capacity, sample
+// order, and the overflow path that drops the FIFO to stay aligned
+
+static int16_t received[256];
+static int received_count;
+
+static void indexSource(uint64_t index, int16_t* xyz, void* context) {
+  (void)context;
+  xyz[0] = (int16_t)(index & 0x3FFF);
+  xyz[1] = 0;
+  xyz[2] = 16384;
+}
+
+static void recordSample(int16_t x, int16_t y, int16_t z, void* context) {
+  (void)y;
+  (void)z;
+  (void)context;
+  if (received_count < 256) {
+    received[received_count++] = x;
+  }
+}
+
+static bool isSequence(int from, int count) {
+  for (int i = 1; i < count; i++) {
+    if (received[from + i] != received[from + i - 1] + 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void setUp(ICM20689Model& model, SilabsIMU& imu) {
+  model.setSampleSource(indexSource, NULL);
+  model.attach();
+  received_count = 0;
+  CHECK(imu.begin());
+  CHECK(imu.enableFifo());
+  imu.setSampleCallback(recordSample, NULL);
+}
+
+static void testRingFull() {
+  ICM20689Model model;
+  SilabsIMU imu;
+  setUp(model, imu);
+
+  // 100 samples at 50 Hz, more than the ring holds
+  mockAdvanceMillis(2000);
+  CHECK_EQ(model.getFifoCount(), 100 * IMU_FIFO_SAMPLE_BYTES);
+
+  CHECK_EQ(imu.readFifo(), IMU_FIFO_RING_SAMPLES);
+  CHECK_EQ(imu.readFifo(), 0);
+  CHECK_EQ(model.getFifoCount(), (100 - IMU_FIFO_RING_SAMPLES) * IMU_FIFO_SAMPLE_BYTES);
+
+  CHECK_EQ(imu.processFifo(), IMU_FIFO_RING_SAMPLES);
+  CHECK_EQ(imu.processFifo(), 0);
+
+  // The rest follows in order in the next bursts
+  int total = IMU_FIFO_RING_SAMPLES;
+  while (total < 100) {
+    int samples = imu.readFifo();
+    CHECK(samples > 0);
+    if (samples <= 0) {
+      break;
+    }
+    total += samples;
+    imu.processFifo();
+  }
+  CHECK_EQ(total, 100);
+  CHECK_EQ(received_count, 100);
+  CHECK(isSequence(0, received_count));
+  CHECK_EQ(imu.getFifoOverflowCount(), 0);
+}
+
+static void testSteadyDrain() {
+  ICM20689Model model;
+  SilabsIMU imu;
+  setUp(model, imu);
+
+  // Draining every 200 ms keeps up without losing a sample
+  for (int i = 0; i < 20; i++) {
+    mockAdvanceMillis(200);
+    CHECK(imu.readFifo() >= 0);
+    imu.processFifo();
+  }
+  CHECK(received_count >= 195);
+  CHECK(isSequence(0, received_count));
+  CHECK_EQ(imu.getFifoOverflowCount(), 0);
+}
+
+static void testOverflow() {
+  ICM20689Model model;
+  SilabsIMU imu;
+  setUp(model, imu);
+
+  // 4096 bytes hold 682 samples, 15 s at 50 Hz is 750
+  mockAdvanceMillis(15000);
+  CHECK(model.overflows > 0);
+  CHECK(model.getRegister(ICM20689_INT_STATUS) & ICM20689_INT_STATUS_FIFO_OFLOW);
+
+  uint32_t resets = model.fifo_resets;
+  CHECK_EQ(imu.readFifo(), -1);
+  CHECK_EQ(imu.getFifoOverflowCount(), 1);
+  CHECK_EQ(model.fifo_resets, resets + 1);
+  CHECK_EQ(model.getFifoCount(), 0);
+  CHECK_EQ(received_count, 0);
+
+  // Sampling restarts aligned on the reset FIFO
+  mockAdvanceMillis(200);
+  int samples = imu.readFifo();
+  CHECK(samples >= 9 && samples <= 10);
+  CHECK_EQ(imu.processFifo(), samples);
+  CHECK(isSequence(0, received_count));
+  CHECK(received[0] > 682);
+  CHECK_EQ(imu.getFifoOverflowCount(), 1);
+}
+
+int main() {
+  RUN_TEST(testRingFull);
+  RUN_TEST(testSteadyDrain);
+  RUN_TEST(testOverflow);
+  return hostTestResult();
+}
@@ -0,0 +1,148 @@
+#include "host_test.h"
+#include "mock_hardware.h"
+#include "icm20689_model.h"
+#include "silabs_imu.h"
+
+// SilabsIMU wake on motion against the ICM-20689 model, with the INT line
+// on a pin interrupt and with INT_STATUS polling: wake ups, the burst
+// timeout and the bus traffic while the wearer is still
+
+#define WOM_INT_PIN 5
+#define BURST_MS    2000
+#define TICK_MS     10
+
+static void setUp(ICM20689Model& model, SilabsIMU& imu, int int_pin) {
+  mockSetClockStep(0);
+  model.int_pin = int_pin;
+  model.attach();
+  CHECK(imu.begin());
+  CHECK(imu.enableFifo());
+  CHECK(imu.enableWakeOnMotion(IMU_WOM_DEFAULT_THRESHOLD_MG, int_pin, BURST_MS));
+  CHECK_EQ(imu.getPowerMode(), IMUPowerMode::WAKE_ON_MOTION);
+}
+
+// Services the IMU like the scheduler task for the given time, returns
+// the time in ms until it left wake on motion or -1
+static long run(SilabsIMU& imu, unsigned long ms) {
+  long woke = -1;
+  for (unsigned long t = 0; t < ms; t += TICK_MS) {
+    mockAdvanceMillis(TICK_MS);
+    if (imu.serviceWakeOnMotion() != IMUPowerMode::WAKE_ON_MOTION) {
+      if (woke < 0) {
+        woke = t + TICK_MS;
+      }
+      imu.readFifo();
+      imu.processFifo();
+    }
+  }
+  return woke;
+}
+
+// 1 g on z, a step of the given size on x
+static void setStep(ICM20689Model& model, int16_t mg) {
+  model.setAccel((int16_t)((int32_t)mg * 16384 / 1000), 0, 16384);
+}
+
+static void testInterruptWake() {
+  ICM20689Model model;
+  SilabsIMU imu;
+  setUp(model, imu, WOM_INT_PIN);
+  CHECK(mockIsInterruptAttached(WOM_INT_PIN));
+
+  // Still: no bus traffic at all while waiting for the interrupt
+  uint32_t reads = model.int_status_reads;
+  uint32_t transactions = mockBusStats.spi_transactions;
+  CHECK_EQ(run(imu, 60000), -1);
+  CHECK_EQ(model.int_status_reads, reads);
+  CHECK_EQ(mockBusStats.spi_transactions, transactions);
+  CHECK_EQ(imu.getWakeCount(), 0);
+
+  // Below the threshold
+  setStep(model, IMU_WOM_DEFAULT_THRESHOLD_MG / 2);
+  CHECK_EQ(run(imu, 1000), -1);
+  CHECK_EQ(mockGetPin(WOM_INT_PIN), LOW);
+
+  // A step wakes it on the next low power sample (10 Hz) and tick
+  setStep(model, 200);
+  long woke = run(imu, 500);
+  CHECK(woke > 0 && woke <= 100 + TICK_MS);
+  CHECK_EQ(imu.getWakeCount(), 1);
+  CHECK(imu.isFifoEnabled());
+  CHECK_EQ(mockGetPin(WOM_INT_PIN), LOW);
+
+  // Back to sleep once the burst saw no movement for burst_ms
+  CHECK_EQ(imu.getPowerMode(), IMUPowerMode::BURST);
+  run(imu, BURST_MS + 500);
+  CHECK_EQ(imu.getPowerMode(), IMUPowerMode::WAKE_ON_MOTION);
+  CHECK(!imu.isFifoEnabled());
+
+  imu.disableWakeOnMotion();
+  CHECK(!mockIsInterruptAttached(WOM_INT_PIN));
+  CHECK_EQ(imu.getPowerMode(), IMUPowerMode::FULL);
+  CHECK(imu.isFifoEnabled());
+}
+
+static void movingSource(uint64_t index, int16_t* xyz, void* context) {
+  (void)context;
+  // 0.3 g square wave on x, two samples per level at any rate
+  xyz[0] = index % 4 < 2 ? 4915 : -4915;
+  xyz[1] = 0;
+  xyz[2] = 16384;
+}
+
+static void testBurstExtends() {
+  ICM20689Model model;
+  SilabsIMU imu;
+  setUp(model, imu, WOM_INT_PIN);
+
+  model.setSampleSource(movingSource, NULL);
+  CHECK(run(imu, 500) > 0);
+
+  // Keeps moving for three burst times, stays awake
+  run(imu, 3 * BURST_MS);
+  CHECK_EQ(imu.getPowerMode(), IMUPowerMode::BURST);
+  CHECK_EQ(imu.getWakeCount(), 1);
+
+  model.setAccel(0, 0, 16384);
+  run(imu, BURST_MS + 500);
+  CHECK_EQ(imu.getPowerMode(), IMUPowerMode::WAKE_ON_MOTION);
+}
+
+static void testPolledWake() {
+  ICM20689Model model;
+  SilabsIMU imu;
+  setUp(model, imu, -1);
+  CHECK(!mockIsInterruptAttached(WOM_INT_PIN));
+
+  // Still for a minute: one INT_STATUS read per tick and nothing else
+  uint32_t reads = model.int_status_reads;
+  uint32_t transactions = mockBusStats.spi_transactions;
+  CHECK_EQ(run(imu, 60000), -1);
+  CHECK_EQ(model.int_status_reads - reads, 60000 / TICK_MS);
+  CHECK_EQ(mockBusStats.spi_transactions - transactions, 60000 / TICK_MS);
+
+  // The latched status is seen on the tick after the next low power sample
+  setStep(model, 200);
+  long woke = run(imu, 500);
+  CHECK(woke > 0 && woke <= 100 + TICK_MS);
+  CHECK_EQ(imu.getWakeCount(), 1);
+
+  run(imu, BURST_MS + 500);
+  CHECK_EQ(imu.getPowerMode(), IMUPowerMode::WAKE_ON_MOTION);
+
+  // A step between two ticks still wakes it, the bits latch
+  setStep(model, 0);
+  mockAdvanceMillis(150);
+  setStep(model, 200);
+  mockAdvanceMillis(150);
+  setStep(model, 0);
+  CHECK_EQ(run(imu, TICK_MS), TICK_MS);
+  CHECK_EQ(imu.getWakeCount(), 2);
+}
+
+int main() {
+  RUN_TEST(testInterruptWake);
+  RUN_TEST(testBurstExtends);
+  RUN_TEST(testPolledWake);
+  return hostTestResult();
+}
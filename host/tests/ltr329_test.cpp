@@ -0,0 +1,134 @@
+#include "host_test.h"
+#include "mock_hardware.h"
+#include "ltr329_model.h"
+#include "ltr329.h"
+
+// LTR329 driver against the register model: both channels in one burst
+// from 0x88, the error returns and the regions of the lux formula
+
+// 0.01 lux, well above the float rounding of the formula
+#define LUX_TOLERANCE 0.01
+
+// Initializes the sensor and lets the first conversion land
+static void setUp(LTR329Model& model, LTR329& sensor) {
+  mockSetClockStep(0);
+  model.attach();
+  CHECK_EQ(sensor.init(), 0);
+  mockAdvanceMillis(500);
+}
+
+static void testBurstRead() {
+  LTR329Model model;
+  LTR329 sensor;
+  uint16_t ch0;
+  uint16_t ch1;
+  model.ch0 = 0x1234;
+  model.ch1 = 0x0567;
+  setUp(model, sensor);
+  CHECK_EQ(sensor.isNewDataAndValid(), 0);
+
+  // Register, repeated start and the four data bytes in one transaction
+  mockResetBusStats();
+  CHECK_EQ(sensor.readChannels(&ch0, &ch1), 0);
+  CHECK_EQ(ch0, 0x1234);
+  CHECK_EQ(ch1, 0x0567);
+  CHECK_EQ(mockBusStats.i2c_transactions, 1);
+  CHECK_EQ(mockBusStats.i2c_bytes, 7);
+  CHECK_EQ(mockBusStats.i2c_nacks, 0);
+
+  // Reading up to CH0_1 released the conversion
+  CHECK_EQ(sensor.isNewDataAndValid(), 1);
+
+  // The single channel reads take one transaction each
+  mockResetBusStats();
+  CHECK_EQ(sensor.readASLChannel0(&ch0), 0);
+  CHECK_EQ(sensor.readASLChannel1(&ch1), 0);
+  CHECK_EQ(ch0, 0x1234);
+  CHECK_EQ(ch1, 0x0567);
+  CHECK_EQ(mockBusStats.i2c_transactions, 2);
+}
+
+static void testErrors() {
+  LTR329Model model;
+  LTR329 sensor;
+  uint16_t ch0 = 0xBEEF;
+  uint16_t ch1 = 0xBEEF;
+  float lux = 12.5f;
+  mockSetClockStep(0);
+
+  // Nothing answers: every call fails and leaves the outputs alone
+  CHECK_EQ(sensor.init(), -1);
+  CHECK_EQ(sensor.readChannels(&ch0, &ch1), -1);
+  CHECK_EQ(sensor.readASLChannel0(&ch0), -1);
+  CHECK_EQ(sensor.readASLChannel1(&ch1), -1);
+  CHECK_EQ(sensor.readLux(&lux), -1);
+  CHECK_EQ(sensor.isNewDataAndValid(), -1);
+  CHECK_EQ(sensor.setGain(ALSGain::X_8 << LTR329_CONTR_GAIN_SHIFT | 0x01), -1);
+  CHECK_EQ(ch0, 0xBEEF);
+  CHECK_EQ(ch1, 0xBEEF);
+  CHECK_EQ(lux, 12.5f);
+  CHECK(mockBusStats.i2c_nacks > 0);
+
+  // A conversion flagged invalid is not reported as new valid data
+  setUp(model, sensor);
+  model.invalid = true;
+  mockAdvanceMillis(500);
+  CHECK_EQ(sensor.isNewDataAndValid(), 1);
+
+  model.invalid = false;
+  mockAdvanceMillis(500);
+  CHECK_EQ(sensor.isNewDataAndValid(), 0);
+}
+
+static void testLuxRegions() {
+  // Gain 1 and 100 ms: the divisor is 1, the counts are the lux
+  // CH1 / (CH0 + CH1) below 0.45: 1.7743 * CH0 + 1.1059 * CH1
+  CHECK_NEAR(LTR329::computeLux(1000, 300, ALSGain::X_1, ALSIntegrationTime::MS_100),
+             1774.3 + 331.77, LUX_TOLERANCE);
+  // 0.45 up to 0.64: 4.2785 * CH0 - 1.9548 * CH1, from exactly 0.45 on
+  CHECK_NEAR(LTR329::computeLux(55, 45, ALSGain::X_1, ALSIntegrationTime::MS_100),
+             4.2785 * 55 - 1.9548 * 45, LUX_TOLERANCE);
+  CHECK_NEAR(LTR329::computeLux(500, 500, ALSGain::X_1, ALSIntegrationTime::MS_100),
+             4.2785 * 500 - 1.9548 * 500, LUX_TOLERANCE);
+  // 0.64 up to 0.85: 0.5926 * CH0 + 0.1185 * CH1
+  CHECK_NEAR(LTR329::computeLux(300, 700, ALSGain::X_1, ALSIntegrationTime::MS_100),
+             0.5926 * 300 + 0.1185 * 700, LUX_TOLERANCE);
+  // From 0.85 on, and in the dark
+  CHECK_EQ(LTR329::computeLux(15, 85, ALSGain::X_1, ALSIntegrationTime::MS_100), 0.0f);
+  CHECK_EQ(LTR329::computeLux(100, 900, ALSGain::X_1, ALSIntegrationTime::MS_100), 0.0f);
+  CHECK_EQ(LTR329::computeLux(0, 0, ALSGain::X_1, ALSIntegrationTime::MS_100), 0.0f);
+
+  // Divided by the gain and the integration time in 100 ms
+  CHECK_NEAR(LTR329::computeLux(1000, 300, ALSGain::X_96, ALSIntegrationTime::MS_400),
+             (1774.3 + 331.77) / (96 * 4), LUX_TOLERANCE);
+  CHECK_NEAR(LTR329::computeLux(1000, 300, ALSGain::X_2, ALSIntegrationTime::MS_50),
+             (1774.3 + 331.77) / (2 * 0.5), LUX_TOLERANCE);
+}
+
+static void testReadLux() {
+  LTR329Model model;
+  LTR329 sensor;
+  float lux;
+  setUp(model, sensor);
+
+  // readLux() uses the gain and integration time last written
+  CHECK_EQ(sensor.setGain(1, 0, ALSGain::X_48), 0);
+  CHECK_EQ(sensor.setMeasurementRate(ALSMeasurementRate::MS_500, ALSIntegrationTime::MS_200), 0);
+  mockAdvanceMillis(500);
+  model.ch0 = 800;
+  model.ch1 = 600;
+  mockAdvanceMillis(500);
+
+  mockResetBusStats();
+  CHECK_EQ(sensor.readLux(&lux), 0);
+  CHECK_EQ(mockBusStats.i2c_transactions, 1);
+  CHECK_NEAR(lux, (1.7743 * 800 + 1.1059 * 600) / (48 * 2), LUX_TOLERANCE);
+}
+
+int main() {
+  RUN_TEST(testBurstRead);
+  RUN_TEST(testErrors);
+  RUN_TEST(testLuxRegions);
+  RUN_TEST(testReadLux);
+  return hostTestResult();
+}
@@ -0,0 +1,141 @@
+#include <string.h>
+#include <math.h>
+#include "host_test.h"
+#include "movement_kernel.h"
+
+// The SMUAD path of movementSquares() built on the host with the
+// arm_acle.h mock, bit exact against the scalar kernel and a 64 bit
+// reference. Renamed so both kernels link into one test.
+#define __ARM_FEATURE_DSP 1
+#define __ARM_FEATURE_SIMD32 1
+#define movementSquares movementSquaresDsp
+#include "movement_kernel.cpp"
+#undef movementSquares
+#undef __ARM_FEATURE_DSP
+#undef __ARM_FEATURE_SIMD32
+
+static_assert(MOVEMENT_KERNEL_DSP, "the DSP kernel is not built");
+
+#define BLOCK 32
+
+static uint32_t referenceSquare(const int16_t* xyz) {
+  uint64_t sum = 0;
+  for (int i = 0; i < 3; i++) {
+    sum += (int64_t)xyz[i] * xyz[i];
+  }
+  return (uint32_t)sum;
+}
+
+// Runs a block through both kernels, returns the number of mismatches
+static int compareBlock(const int16_t (*xyz)[3], uint8_t count) {
+  uint32_t scalar[BLOCK];
+  uint32_t dsp[BLOCK];
+  int mismatches = 0;
+
+  movementSquares(xyz, count, scalar);
+  movementSquaresDsp(xyz, count, dsp);
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t reference = referenceSquare(xyz[i]);
+    if (scalar[i] != reference || dsp[i] != reference) {
+      if (mismatches == 0) {
+        printf("(%d, %d, %d): scalar %u, DSP %u, expected %u\n", xyz[i][0], xyz[i][1], xyz[i][2],
+               scalar[i], dsp[i], reference);
+      }
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+static void testEveryX() {
+  // Every x against the y and z values at the edges of the range
+  static const int16_t EDGES[] = {-32768, -32767, -16384, -1, 0, 1, 16384, 32767};
+  int16_t xyz[BLOCK][3];
+  int mismatches = 0;
+  uint8_t count = 0;
+
+  for (int32_t x = -32768; x <= 32767; x++) {
+    for (int16_t y : EDGES) {
+      for (int16_t z : EDGES) {
+        xyz[count][0] = x;
+        xyz[count][1] = y;
+        xyz[count][2] = z;
+        if (++count == BLOCK) {
+          mismatches += compareBlock(xyz, count);
+          count = 0;
+        }
+      }
+    }
+  }
+  mismatches += compareBlock(xyz, count);
+  CHECK_EQ(mismatches, 0);
+}
+
+static void testFullScale() {
+  // 3 * 32768^2 is the largest square, x^2 + y^2 alone wraps int32
+  const int16_t xyz[1][3] = {{-32768, -32768, -32768}};
+  uint32_t square;
+  movementSquaresDsp(xyz, 1, &square);
+  CHECK_EQ(square, 3UL * 32768 * 32768);
+  CHECK_EQ(compareBlock(xyz, 1), 0);
+}
+
+static void testRandomBlocks() {
+  int16_t xyz[BLOCK][3];
+  uint32_t seed = 1;
+  int mismatches = 0;
+
+  for (int run = 0; run < 100000; run++) {
+    for (int i = 0; i < BLOCK; i++) {
+      for (int axis = 0; axis < 3; axis++) {
+        seed = seed * 1103515245 + 12345;
+        xyz[i][axis] = (int16_t)(seed >> 16);
+      }
+    }
+    mismatches += compareBlock(xyz, run % (BLOCK + 1));
+  }
+  CHECK_EQ(mismatches, 0);
+}
+
+static void testSquareRoot() {
+  int mismatches = 0;
+  uint32_t seed = 7;
+
+  for (uint32_t root = 0; root < 65536; root++) {
+    uint32_t square = root * root;
+    if (isqrt32(square) != root ||
+        (square > 0 && isqrt32(square - 1) != root - 1)) {
+      mismatches++;
+    }
+  }
+  CHECK_EQ(isqrt32(0xFFFFFFFF), 65535);
+
+  for (int run = 0; run < 100000; run++) {
+    seed = seed * 1103515245 + 12345;
+    uint32_t value = seed;
+    uint32_t root = isqrt32(value);
+    if ((uint64_t)root * root > value || (uint64_t)(root + 1) * (root + 1) <= value) {
+      mismatches++;
+    }
+  }
+  CHECK_EQ(mismatches, 0);
+}
+
+static void testClassifyThresholds() {
+  // The squared thresholds sit exactly at the g thresholds
+  uint32_t still = (uint32_t)ceil(MOVEMENT_THRESHOLD * MOVEMENT_COUNTS_PER_G);
+  uint32_t active = (uint32_t)ceil(ACTIVE_THRESHOLD * MOVEMENT_COUNTS_PER_G);
+  CHECK_EQ(movementClassify((still - 1) * (still - 1)), STILL);
+  CHECK_EQ(movementClassify(still * still), MOVING);
+  CHECK_EQ(movementClassify((active - 1) * (active - 1)), MOVING);
+  CHECK_EQ(movementClassify(active * active), ACTIVE);
+}
+
+int main() {
+  RUN_TEST(testEveryX);
+  RUN_TEST(testFullScale);
+  RUN_TEST(testRandomBlocks);
+  RUN_TEST(testSquareRoot);
+  RUN_TEST(testClassifyThresholds);
+  return hostTestResult();
+}
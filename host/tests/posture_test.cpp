@@ -0,0 +1,175 @@
+#include <string.h>
+#include <math.h>
+#include "host_test.h"
+#include "posture.h"
+#include "movement_kernel.h"
+#include "sensor_frame.h"
+
+// PostureTracker on rotation traces at 50 Hz: the board turned through
+// every posture, slow rolls that keep |a| at 1 g, short tilts below the
+// hold time and the posture field of the frame
+
+#define RATE_HZ 50
+#define COUNTS_PER_G 16384
+
+// Gravity along a unit vector in board coordinates: z out of the top
+// side, x towards the left, y towards the head
+struct Direction {
+  float x, y, z;
+  uint8_t posture;
+};
+
+static const Direction POSTURES[] = {
+    {0, 0, 1, Posture::SUPINE},  {0, 0, -1, Posture::PRONE},   {-1, 0, 0, Posture::LEFT},
+    {1, 0, 0, Posture::RIGHT},   {0, 1, 0, Posture::UPRIGHT},  {0, -1, 0, Posture::INVERTED},
+};
+
+static bool feed(PostureTracker* tracker, float x, float y, float z, int16_t* dynamic) {
+  return tracker->update((int16_t)lroundf(x * COUNTS_PER_G), (int16_t)lroundf(y * COUNTS_PER_G),
+                         (int16_t)lroundf(z * COUNTS_PER_G), dynamic);
+}
+
+// Holds a direction for the given time, returns the sample count at
+// which the posture changed or -1
+static int hold(PostureTracker* tracker, const Direction& d, float seconds) {
+  int16_t dynamic[3];
+  int changed = -1;
+  for (int i = 0; i < seconds * RATE_HZ; i++) {
+    if (feed(tracker, d.x, d.y, d.z, dynamic) && changed < 0) {
+      changed = i;
+    }
+  }
+  return changed;
+}
+
+static void testEveryPosture() {
+  for (const Direction& from : POSTURES) {
+    for (const Direction& to : POSTURES) {
+      if (from.posture == to.posture) {
+        continue;
+      }
+      PostureTracker tracker;
+      tracker.setSampleRate(RATE_HZ);
+      hold(&tracker, from, 5);
+      CHECK_EQ(tracker.getPosture(), from.posture);
+
+      // A change once the filter crossed over plus the hold time
+      int changed = hold(&tracker, to, 5);
+      CHECK_EQ(tracker.getPosture(), to.posture);
+      CHECK(changed >= POSTURE_HOLD_SECONDS * RATE_HZ);
+      CHECK(changed <= (POSTURE_HOLD_SECONDS + 2) * RATE_HZ);
+      CHECK_EQ(tracker.getChangeCount(), 2);
+    }
+  }
+}
+
+// Turns the board about its y axis (roll) or x axis (pitch) at a
+// constant rate, one full turn, and records the postures passed
+static int rotate(PostureTracker* tracker, bool roll, float seconds, uint8_t* seen, int16_t* worst) {
+  int16_t dynamic[3];
+  int count = 0;
+  int samples = seconds * RATE_HZ;
+  *worst = 0;
+
+  for (int i = 0; i <= samples; i++) {
+    float angle = 2 * (float)M_PI * i / samples;
+    float across = sinf(angle);
+    float z = cosf(angle);
+    bool changed = roll ? feed(tracker, across, 0, z, dynamic) : feed(tracker, 0, across, z, dynamic);
+    if (changed) {
+      seen[count++] = tracker->getPosture();
+    }
+    for (int axis = 0; axis < 3; axis++) {
+      int16_t level = dynamic[axis] < 0 ? -dynamic[axis] : dynamic[axis];
+      if (level > *worst) {
+        *worst = level;
+      }
+    }
+  }
+  return count;
+}
+
+static void testRotationTraces() {
+  uint8_t seen[16];
+  int16_t worst;
+
+  // Rolling over in bed: back, right side, front, left side, back
+  {
+    PostureTracker tracker;
+    tracker.setSampleRate(RATE_HZ);
+    hold(&tracker, POSTURES[0], 5);
+    CHECK_EQ(rotate(&tracker, true, 60, seen, &worst), 4);
+    CHECK_EQ(seen[0], Posture::RIGHT);
+    CHECK_EQ(seen[1], Posture::PRONE);
+    CHECK_EQ(seen[2], Posture::LEFT);
+    CHECK_EQ(seen[3], Posture::SUPINE);
+    // A slow roll is gravity, not movement
+    CHECK(worst < MOVEMENT_THRESHOLD * COUNTS_PER_G);
+  }
+
+  // Pitching forward: back, standing, front, head down, back
+  {
+    PostureTracker tracker;
+    tracker.setSampleRate(RATE_HZ);
+    hold(&tracker, POSTURES[0], 5);
+    CHECK_EQ(rotate(&tracker, false, 60, seen, &worst), 4);
+    CHECK_EQ(seen[0], Posture::UPRIGHT);
+    CHECK_EQ(seen[1], Posture::PRONE);
+    CHECK_EQ(seen[2], Posture::INVERTED);
+    CHECK_EQ(seen[3], Posture::SUPINE);
+    CHECK(worst < MOVEMENT_THRESHOLD * COUNTS_PER_G);
+  }
+
+  // Too fast to hold any posture for two seconds
+  {
+    PostureTracker tracker;
+    tracker.setSampleRate(RATE_HZ);
+    hold(&tracker, POSTURES[0], 5);
+    CHECK_EQ(rotate(&tracker, true, 4, seen, &worst), 0);
+    CHECK_EQ(tracker.getPosture(), Posture::SUPINE);
+  }
+}
+
+static void testShortTilt() {
+  PostureTracker tracker;
+  tracker.setSampleRate(RATE_HZ);
+  hold(&tracker, POSTURES[4], 5);
+
+  // Bending down for a second does not count as lying down
+  CHECK_EQ(hold(&tracker, POSTURES[1], 1), -1);
+  CHECK_EQ(hold(&tracker, POSTURES[4], 5), -1);
+  CHECK_EQ(tracker.getPosture(), Posture::UPRIGHT);
+  CHECK_EQ(tracker.getChangeCount(), 1);
+
+  // 45 degrees between two axes is ambiguous and keeps the posture
+  Direction diagonal = {0, 0.7071f, 0.7071f, Posture::UNKNOWN};
+  CHECK_EQ(hold(&tracker, diagonal, 10), -1);
+  CHECK_EQ(tracker.getPosture(), Posture::UPRIGHT);
+}
+
+static void testFramePosture() {
+  SensorFrame frame, decoded;
+  uint8_t buffer[SENSOR_FRAME_SIZE];
+
+  // Every posture fits the 3 bit field next to the sleep stage
+  for (uint8_t posture = Posture::UNKNOWN; posture <= Posture::INVERTED; posture++) {
+    memset(&frame, 0, sizeof(frame));
+    frame.version = SENSOR_FRAME_VERSION;
+    frame.posture = posture;
+    frame.sleep_stage = 3;
+    frame.imu_state = 2;
+    CHECK_EQ(sensorFrameEncode(&frame, buffer, sizeof(buffer)), SENSOR_FRAME_SIZE);
+    CHECK(sensorFrameDecode(buffer, sizeof(buffer), &decoded));
+    CHECK_EQ(decoded.posture, posture);
+    CHECK_EQ(decoded.sleep_stage, 3);
+    CHECK_EQ(decoded.imu_state, 2);
+  }
+}
+
+int main() {
+  RUN_TEST(testEveryPosture);
+  RUN_TEST(testRotationTraces);
+  RUN_TEST(testShortTilt);
+  RUN_TEST(testFramePosture);
+  return hostTestResult();
+}
@@ -0,0 +1,146 @@
+#include <string.h>
+#include "host_test.h"
+#include "sensor_config.h"
+
+// Sampling policy as written over BLE and kept in non-volatile memory:
+// encode/decode round trip, range validation and stored copy checks
+
+static void makeConfig(SensorConfig* config) {
+  config->si7021_period_ms = 60000;
+  config->sht30_period_ms = 30000;
+  config->veml6035_period_ms = 1000;
+  config->imu_period_ms = 200;
+  config->update_period_ms = 0x12345678 % SENSOR_CONFIG_MAX_PERIOD_MS;
+}
+
+static bool sameConfig(const SensorConfig& a, const SensorConfig& b) {
+  return a.si7021_period_ms == b.si7021_period_ms && a.sht30_period_ms == b.sht30_period_ms &&
+         a.veml6035_period_ms == b.veml6035_period_ms && a.imu_period_ms == b.imu_period_ms &&
+         a.update_period_ms == b.update_period_ms;
+}
+
+static void testRoundTrip() {
+  SensorConfig config, decoded;
+  uint8_t buffer[SENSOR_CONFIG_SIZE];
+
+  sensorConfigDefaults(&config);
+  CHECK_EQ(sensorConfigEncode(&config, buffer, sizeof(buffer)), SENSOR_CONFIG_SIZE);
+  memset(&decoded, 0, sizeof(decoded));
+  CHECK(sensorConfigDecode(buffer, sizeof(buffer), &decoded));
+  CHECK(sameConfig(config, decoded));
+
+  makeConfig(&config);
+  CHECK_EQ(sensorConfigEncode(&config, buffer, sizeof(buffer)), SENSOR_CONFIG_SIZE);
+  CHECK(sensorConfigDecode(buffer, sizeof(buffer), &decoded));
+  CHECK(sameConfig(config, decoded));
+}
+
+static void testLayout() {
+  SensorConfig config;
+  uint8_t buffer[SENSOR_CONFIG_SIZE];
+
+  makeConfig(&config);
+  config.sht30_period_ms = 0x00012345;
+  sensorConfigEncode(&config, buffer, sizeof(buffer));
+
+  // Version first, then the periods little endian
+  CHECK_EQ(buffer[0], SENSOR_CONFIG_VERSION);
+  CHECK_EQ(buffer[1], 60000 & 0xFF);
+  CHECK_EQ(buffer[2], 60000 >> 8);
+  CHECK_EQ(buffer[5], 0x45);
+  CHECK_EQ(buffer[6], 0x23);
+  CHECK_EQ(buffer[7], 0x01);
+  CHECK_EQ(buffer[8], 0x00);
+  CHECK_EQ(buffer[13], 200);
+
+  CHECK_EQ(sensorConfigEncode(&config, buffer, SENSOR_CONFIG_SIZE - 1), 0);
+}
+
+static void testValidation() {
+  SensorConfig config, decoded;
+  uint8_t buffer[SENSOR_CONFIG_SIZE];
+
+  makeConfig(&config);
+  sensorConfigDefaults(&decoded);
+  SensorConfig defaults = decoded;
+
+  // Truncated or unknown version
+  sensorConfigEncode(&config, buffer, sizeof(buffer));
+  CHECK(!sensorConfigDecode(buffer, SENSOR_CONFIG_SIZE - 1, &decoded));
+  buffer[0] = SENSOR_CONFIG_VERSION + 1;
+  CHECK(!sensorConfigDecode(buffer, sizeof(buffer), &decoded));
+
+  // Every period has a lower bound, the IMU one also a tighter upper bound
+  uint32_t* periods[] = {&config.si7021_period_ms, &config.sht30_period_ms, &config.veml6035_period_ms,
+                         &config.imu_period_ms, &config.update_period_ms};
+  for (int i = 0; i < 5; i++) {
+    makeConfig(&config);
+    uint32_t max_ms = (i == 3) ? SENSOR_CONFIG_MAX_IMU_PERIOD_MS : SENSOR_CONFIG_MAX_PERIOD_MS;
+
+    *periods[i] = SENSOR_CONFIG_MIN_PERIOD_MS;
+    sensorConfigEncode(&config, buffer, sizeof(buffer));
+    CHECK(sensorConfigDecode(buffer, sizeof(buffer), &decoded));
+
+    *periods[i] = max_ms;
+    sensorConfigEncode(&config, buffer, sizeof(buffer));
+    CHECK(sensorConfigDecode(buffer, sizeof(buffer), &decoded));
+
+    *periods[i] = SENSOR_CONFIG_MIN_PERIOD_MS - 1;
+    sensorConfigEncode(&config, buffer, sizeof(buffer));
+    CHECK(!sensorConfigDecode(buffer, sizeof(buffer), &decoded));
+
+    *periods[i] = max_ms + 1;
+    sensorConfigEncode(&config, buffer, sizeof(buffer));
+    CHECK(!sensorConfigDecode(buffer, sizeof(buffer), &decoded));
+
+    *periods[i] = 0;
+    sensorConfigEncode(&config, buffer, sizeof(buffer));
+    CHECK(!sensorConfigDecode(buffer, sizeof(buffer), &decoded));
+  }
+
+  // A rejected config leaves the previous one untouched
+  sensorConfigDefaults(&decoded);
+  CHECK(sameConfig(decoded, defaults));
+  makeConfig(&config);
+  config.imu_period_ms = 10;
+  sensorConfigEncode(&config, buffer, sizeof(buffer));
+  CHECK(!sensorConfigDecode(buffer, sizeof(buffer), &decoded));
+  CHECK(sameConfig(decoded, defaults));
+}
+
+static void testStoreLoad() {
+  SensorConfig config, loaded;
+  uint8_t stored[SENSOR_CONFIG_STORED_SIZE];
+
+  makeConfig(&config);
+  CHECK_EQ(sensorConfigStore(&config, stored, sizeof(stored)), SENSOR_CONFIG_STORED_SIZE);
+  CHECK_EQ(sensorConfigStore(&config, stored, sizeof(stored) - 1), 0);
+  CHECK(sensorConfigLoad(stored, sizeof(stored), &loaded));
+  CHECK(sameConfig(config, loaded));
+  CHECK(!sensorConfigLoad(stored, sizeof(stored) - 1, &loaded));
+
+  // Erased flash
+  uint8_t erased[SENSOR_CONFIG_STORED_SIZE];
+  memset(erased, 0xFF, sizeof(erased));
+  CHECK(!sensorConfigLoad(erased, sizeof(erased), &loaded));
+
+  // Any single bit flip in the magic, config or CRC is rejected
+  int accepted = 0;
+  for (size_t bit = 0; bit < 8 * sizeof(stored); bit++) {
+    stored[bit / 8] ^= 1 << (bit % 8);
+    if (sensorConfigLoad(stored, sizeof(stored), &loaded)) {
+      accepted++;
+    }
+    stored[bit / 8] ^= 1 << (bit % 8);
+  }
+  CHECK_EQ(accepted, 0);
+  CHECK(sensorConfigLoad(stored, sizeof(stored), &loaded));
+}
+
+int main() {
+  RUN_TEST(testRoundTrip);
+  RUN_TEST(testLayout);
+  RUN_TEST(testValidation);
+  RUN_TEST(testStoreLoad);
+  return hostTestResult();
+}
@@ -0,0 +1,260 @@
+#include <string.h>
+#include "host_test.h"
+#include "sensor_frame.h"
+#include "actigraphy.h"
+#include "posture.h"
+
+// SensorFrame encoder and decoder: the byte layout of sensor_frame.h,
+// every field through a round trip, version 1 frames and the buffers the
+// decoder must reject
+
+static SensorFrame makeFrame() {
+  SensorFrame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.version = SENSOR_FRAME_VERSION;
+  frame.valid = SENSOR_FRAME_SI7021_VALID | SENSOR_FRAME_SHT30_VALID | SENSOR_FRAME_VEML6035_VALID |
+                SENSOR_FRAME_IMU_VALID | SENSOR_FRAME_FUSED_VALID;
+  frame.sequence = 0x1234;
+  frame.timestamp_ms = 0x89ABCDEF;
+  frame.si7021_temp_centi = -1234;
+  frame.si7021_hum_centi = 4567;
+  frame.sht30_temp_centi = 2150;
+  frame.sht30_hum_centi = 10000;
+  frame.veml6035_millilux = 123456789;
+  frame.imu_state = 2;
+  frame.imu_asleep = true;
+  frame.sleep_stage = SleepStage::DEEP;
+  frame.posture = Posture::INVERTED;
+  frame.imu_intensity_milli = 0xBEEF;
+  frame.imu_movements_per_minute = 42;
+  frame.imu_still_minutes = 65535;
+  frame.fused_temp_centi = -4500;
+  frame.fused_hum_centi = 4499;
+  frame.fusion_status = 0x0C;
+  return frame;
+}
+
+static void checkFramesEqual(const SensorFrame& a, const SensorFrame& b) {
+  CHECK_EQ(a.version, b.version);
+  CHECK_EQ(a.valid, b.valid);
+  CHECK_EQ(a.sequence, b.sequence);
+  CHECK_EQ(a.timestamp_ms, b.timestamp_ms);
+  CHECK_EQ(a.si7021_temp_centi, b.si7021_temp_centi);
+  CHECK_EQ(a.si7021_hum_centi, b.si7021_hum_centi);
+  CHECK_EQ(a.sht30_temp_centi, b.sht30_temp_centi);
+  CHECK_EQ(a.sht30_hum_centi, b.sht30_hum_centi);
+  CHECK_EQ(a.veml6035_millilux, b.veml6035_millilux);
+  CHECK_EQ(a.imu_state, b.imu_state);
+  CHECK_EQ(a.imu_asleep, b.imu_asleep);
+  CHECK_EQ(a.sleep_stage, b.sleep_stage);
+  CHECK_EQ(a.posture, b.posture);
+  CHECK_EQ(a.imu_intensity_milli, b.imu_intensity_milli);
+  CHECK_EQ(a.imu_movements_per_minute, b.imu_movements_per_minute);
+  CHECK_EQ(a.imu_still_minutes, b.imu_still_minutes);
+  CHECK_EQ(a.fused_temp_centi, b.fused_temp_centi);
+  CHECK_EQ(a.fused_hum_centi, b.fused_hum_centi);
+  CHECK_EQ(a.fusion_status, b.fusion_status);
+}
+
+static void testLayout() {
+  static const uint8_t expected[SENSOR_FRAME_SIZE] = {
+    0x02, 0x1F, 0x34, 0x12, 0xEF, 0xCD, 0xAB, 0x89,  // version, valid, sequence, timestamp
+    0x2E, 0xFB, 0xD7, 0x11, 0x66, 0x08, 0x10, 0x27,  // SI7021, SHT30
+    0x15, 0xCD, 0x5B, 0x07,                          // VEML6035
+    0xDE, 0xEF, 0xBE, 0x2A, 0x00, 0xFF, 0xFF,        // IMU
+    0x6C, 0xEE, 0x93, 0x11, 0x0C,                    // fusion
+  };
+  SensorFrame frame = makeFrame();
+  uint8_t buffer[SENSOR_FRAME_SIZE + 4];
+  memset(buffer, 0xAA, sizeof(buffer));
+
+  CHECK_EQ(sensorFrameEncode(&frame, buffer, sizeof(buffer)), SENSOR_FRAME_SIZE);
+  CHECK(memcmp(buffer, expected, SENSOR_FRAME_SIZE) == 0);
+  // Nothing written past the frame
+  CHECK_EQ(buffer[SENSOR_FRAME_SIZE], 0xAA);
+
+  CHECK_EQ(sensorFrameSize(1), SENSOR_FRAME_V1_SIZE);
+  CHECK_EQ(sensorFrameSize(2), SENSOR_FRAME_SIZE);
+}
+
+static void testRoundTrip() {
+  SensorFrame frame = makeFrame();
+  SensorFrame decoded;
+  uint8_t buffer[SENSOR_FRAME_SIZE];
+
+  CHECK_EQ(sensorFrameEncode(&frame, buffer, sizeof(buffer)), SENSOR_FRAME_SIZE);
+  CHECK(sensorFrameDecode(buffer, sizeof(buffer), &decoded));
+  checkFramesEqual(decoded, frame);
+
+  // Both ends of every signed and unsigned range
+  frame.si7021_temp_centi = -32768;
+  frame.sht30_temp_centi = 32767;
+  frame.fused_temp_centi = -1;
+  frame.si7021_hum_centi = 0;
+  frame.sht30_hum_centi = 65535;
+  frame.veml6035_millilux = 0xFFFFFFFF;
+  frame.imu_intensity_milli = 0;
+  frame.imu_asleep = false;
+  frame.valid = 0;
+  CHECK_EQ(sensorFrameEncode(&frame, buffer, sizeof(buffer)), SENSOR_FRAME_SIZE);
+  CHECK(sensorFrameDecode(buffer, sizeof(buffer), &decoded));
+  checkFramesEqual(decoded, frame);
+
+  // The encoder always writes the current version
+  frame.version = 1;
+  sensorFrameEncode(&frame, buffer, sizeof(buffer));
+  CHECK_EQ(buffer[0], SENSOR_FRAME_VERSION);
+}
+
+static void testWrap() {
+  SensorFrame frame = makeFrame();
+  SensorFrame decoded;
+  uint8_t buffer[SENSOR_FRAME_SIZE];
+
+  // Sequence and timestamp wrap to 0 like their counters do
+  uint16_t sequence = 65534;
+  uint32_t timestamp = 0xFFFFFFFF - 1000;
+  for (int i = 0; i < 4; i++) {
+    frame.sequence = sequence;
+    frame.timestamp_ms = timestamp;
+    sensorFrameEncode(&frame, buffer, sizeof(buffer));
+    CHECK(sensorFrameDecode(buffer, sizeof(buffer), &decoded));
+    CHECK_EQ(decoded.sequence, sequence);
+    CHECK_EQ(decoded.timestamp_ms, timestamp);
+    sequence++;
+    timestamp += 1000;
+  }
+  CHECK_EQ(decoded.sequence, 1);
+  CHECK_EQ(decoded.timestamp_ms, 1999);
+}
+
+static void testImuBits() {
+  SensorFrame frame = makeFrame();
+  SensorFrame decoded;
+  uint8_t buffer[SENSOR_FRAME_SIZE];
+
+  for (uint8_t state = 0; state < 4; state++) {
+    for (uint8_t asleep = 0; asleep < 2; asleep++) {
+      for (uint8_t stage = 0; stage < 4; stage++) {
+        for (uint8_t posture = 0; posture < 8; posture++) {
+          frame.imu_state = state;
+          frame.imu_asleep = asleep != 0;
+          frame.sleep_stage = stage;
+          frame.posture = posture;
+          sensorFrameEncode(&frame, buffer, sizeof(buffer));
+          CHECK_EQ(buffer[20], state | (asleep << 2) | (stage << 3) | (posture << 5));
+          CHECK(sensorFrameDecode(buffer, sizeof(buffer), &decoded));
+          CHECK_EQ(decoded.imu_state, state);
+          CHECK_EQ(decoded.imu_asleep, asleep != 0);
+          CHECK_EQ(decoded.sleep_stage, stage);
+          CHECK_EQ(decoded.posture, posture);
+        }
+      }
+    }
+  }
+
+  // Values wider than their field are cut, not spilled into the neighbours
+  frame.imu_state = 0xFF;
+  frame.imu_asleep = false;
+  frame.sleep_stage = 0;
+  frame.posture = 0;
+  sensorFrameEncode(&frame, buffer, sizeof(buffer));
+  CHECK_EQ(buffer[20], SENSOR_FRAME_IMU_STATE_MASK);
+  frame.imu_state = 0;
+  frame.sleep_stage = 0xFF;
+  sensorFrameEncode(&frame, buffer, sizeof(buffer));
+  CHECK_EQ(buffer[20], SENSOR_FRAME_SLEEP_STAGE_MASK);
+  frame.sleep_stage = 0;
+  frame.posture = 0xFF;
+  sensorFrameEncode(&frame, buffer, sizeof(buffer));
+  CHECK_EQ(buffer[20], SENSOR_FRAME_POSTURE_MASK);
+}
+
+static void testVersion1() {
+  static const uint8_t v1[SENSOR_FRAME_V1_SIZE] = {
+    0x01, 0x0F, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00,
+    0x18, 0xFC, 0x00, 0x00, 0xFF, 0xFF, 0x10, 0x27,
+    0x01, 0x00, 0x00, 0x00,
+    0xBD, 0x34, 0x12, 0x01, 0x00, 0x3C, 0x00,
+  };
+  SensorFrame decoded;
+  memset(&decoded, 0x55, sizeof(decoded));
+
+  CHECK(sensorFrameDecode(v1, sizeof(v1), &decoded));
+  CHECK_EQ(decoded.version, 1);
+  CHECK_EQ(decoded.valid, 0x0F);
+  CHECK_EQ(decoded.sequence, 65535);
+  CHECK_EQ(decoded.timestamp_ms, 0);
+  CHECK_EQ(decoded.si7021_temp_centi, -1000);
+  CHECK_EQ(decoded.si7021_hum_centi, 0);
+  CHECK_EQ(decoded.sht30_temp_centi, -1);
+  CHECK_EQ(decoded.sht30_hum_centi, 10000);
+  CHECK_EQ(decoded.veml6035_millilux, 1);
+  CHECK_EQ(decoded.imu_state, 1);
+  CHECK(decoded.imu_asleep);
+  CHECK_EQ(decoded.sleep_stage, SleepStage::DEEP);
+  CHECK_EQ(decoded.posture, Posture::UPRIGHT);
+  CHECK_EQ(decoded.imu_intensity_milli, 0x1234);
+  CHECK_EQ(decoded.imu_movements_per_minute, 1);
+  CHECK_EQ(decoded.imu_still_minutes, 60);
+  // Fields a version 1 frame does not have are cleared
+  CHECK_EQ(decoded.fused_temp_centi, 0);
+  CHECK_EQ(decoded.fused_hum_centi, 0);
+  CHECK_EQ(decoded.fusion_status, 0);
+
+  // Version 2 only appended, its first 27 bytes are a version 1 frame
+  SensorFrame frame = makeFrame();
+  SensorFrame expected = frame;
+  uint8_t buffer[SENSOR_FRAME_SIZE];
+  sensorFrameEncode(&frame, buffer, sizeof(buffer));
+  buffer[0] = 1;
+  CHECK(sensorFrameDecode(buffer, SENSOR_FRAME_V1_SIZE, &decoded));
+  expected.version = 1;
+  expected.fused_temp_centi = 0;
+  expected.fused_hum_centi = 0;
+  expected.fusion_status = 0;
+  checkFramesEqual(decoded, expected);
+}
+
+static void testRejected() {
+  SensorFrame frame = makeFrame();
+  SensorFrame decoded;
+  uint8_t buffer[SENSOR_FRAME_SIZE + 1];
+
+  // The encoder needs room for the whole frame
+  CHECK_EQ(sensorFrameEncode(&frame, buffer, SENSOR_FRAME_SIZE - 1), 0);
+  CHECK_EQ(sensorFrameEncode(&frame, buffer, 0), 0);
+
+  sensorFrameEncode(&frame, buffer, sizeof(buffer));
+  CHECK(!sensorFrameDecode(buffer, 0, &decoded));
+  CHECK(!sensorFrameDecode(buffer, 1, &decoded));
+  CHECK(!sensorFrameDecode(buffer, SENSOR_FRAME_V1_SIZE, &decoded));
+  CHECK(!sensorFrameDecode(buffer, SENSOR_FRAME_SIZE - 1, &decoded));
+  CHECK(sensorFrameDecode(buffer, SENSOR_FRAME_SIZE, &decoded));
+
+  buffer[0] = 1;
+  CHECK(!sensorFrameDecode(buffer, SENSOR_FRAME_V1_SIZE - 1, &decoded));
+  CHECK(sensorFrameDecode(buffer, SENSOR_FRAME_V1_SIZE, &decoded));
+
+  // Version 0 never existed
+  buffer[0] = 0;
+  CHECK(!sensorFrameDecode(buffer, SENSOR_FRAME_SIZE, &decoded));
+
+  // A newer version appends, its known prefix decodes
+  buffer[0] = SENSOR_FRAME_VERSION + 1;
+  buffer[SENSOR_FRAME_SIZE] = 0x77;
+  CHECK(sensorFrameDecode(buffer, sizeof(buffer), &decoded));
+  CHECK_EQ(decoded.version, SENSOR_FRAME_VERSION + 1);
+  CHECK_EQ(decoded.fusion_status, frame.fusion_status);
+  CHECK(!sensorFrameDecode(buffer, SENSOR_FRAME_SIZE - 1, &decoded));
+}
+
+int main() {
+  RUN_TEST(testLayout);
+  RUN_TEST(testRoundTrip);
+  RUN_TEST(testWrap);
+  RUN_TEST(testImuBits);
+  RUN_TEST(testVersion1);
+  RUN_TEST(testRejected);
+  return hostTestResult();
+}
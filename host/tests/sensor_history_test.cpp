@@ -0,0 +1,197 @@
+#include "host_test.h"
+#include "sensor_history.h"
+#include <stdlib.h>
+#include <string.h>
+
+// SensorHistory block ring, download stream and parser round trip, in
+// chunk sizes of the MTUs the download protocol supports
+
+#define MAX_FRAMES 1500
+
+static SensorHistory history;
+static SensorFrame received[MAX_FRAMES];
+static int received_count;
+
+static SensorFrame makeFrame(int i) {
+  SensorFrame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.version = SENSOR_FRAME_VERSION;
+  frame.valid = 0x1F;
+  frame.sequence = (uint16_t)(65500 + i);
+  frame.timestamp_ms = i * 60000u;
+  frame.si7021_temp_centi = 2100 + rand() % 20 - 10;
+  frame.si7021_hum_centi = 4500 + rand() % 50;
+  frame.sht30_temp_centi = -5 + rand() % 10;
+  frame.sht30_hum_centi = 4400;
+  frame.veml6035_millilux = (i % 100 < 50) ? rand() % 100 : 300000 + rand() % 1000;
+  frame.imu_state = rand() % 3;
+  frame.imu_asleep = i > 100;
+  frame.sleep_stage = i % 4;
+  frame.posture = i % 7;
+  frame.imu_intensity_milli = rand() % 200;
+  frame.imu_movements_per_minute = rand() % 10;
+  frame.imu_still_minutes = i % 60;
+  frame.fused_temp_centi = 2050 + rand() % 10;
+  frame.fused_hum_centi = 4480;
+  frame.fusion_status = i % 7 == 0 ? 2 : 0;
+  return frame;
+}
+
+static bool framesEqual(const SensorFrame& a, const SensorFrame& b) {
+  return a.version == b.version && a.valid == b.valid && a.sequence == b.sequence &&
+         a.timestamp_ms == b.timestamp_ms && a.si7021_temp_centi == b.si7021_temp_centi &&
+         a.si7021_hum_centi == b.si7021_hum_centi && a.sht30_temp_centi == b.sht30_temp_centi &&
+         a.sht30_hum_centi == b.sht30_hum_centi && a.veml6035_millilux == b.veml6035_millilux &&
+         a.imu_state == b.imu_state && a.imu_asleep == b.imu_asleep && a.sleep_stage == b.sleep_stage &&
+         a.posture == b.posture && a.imu_intensity_milli == b.imu_intensity_milli &&
+         a.imu_movements_per_minute == b.imu_movements_per_minute &&
+         a.imu_still_minutes == b.imu_still_minutes && a.fused_temp_centi == b.fused_temp_centi &&
+         a.fused_hum_centi == b.fused_hum_centi && a.fusion_status == b.fusion_status;
+}
+
+static void receiveFrame(const SensorFrame& frame, void* context) {
+  (void)context;
+  if (received_count < MAX_FRAMES) {
+    received[received_count++] = frame;
+  }
+}
+
+// Downloads like main.ino and ble_client.ino: [counter][stream bytes]
+// chunks of chunk_size, all full except the last one. Returns the number
+// of chunks.
+static int download(size_t chunk_size, SensorHistoryParser& parser) {
+  SensorHistoryReader reader;
+  uint8_t chunk[SENSOR_HISTORY_CHUNK_SIZE];
+  size_t length;
+  int chunks = 0;
+  bool short_chunk = false;
+
+  received_count = 0;
+  parser.reset();
+  reader.begin(history);
+
+  while ((length = reader.read(&chunk[1], chunk_size - 1)) > 0) {
+    chunk[0] = (uint8_t)chunks++;
+    CHECK(!short_chunk);
+    short_chunk = length + 1 < chunk_size;
+    parser.feed(&chunk[1], length, receiveFrame, NULL);
+  }
+
+  CHECK(!reader.isActive());
+  return chunks;
+}
+
+static void testRoundTrip() {
+  static SensorFrame sent[1500];
+  SensorHistoryParser parser;
+
+  srand(1);
+  history.clear();
+  for (int i = 0; i < 1500; i++) {
+    sent[i] = makeFrame(i);
+    history.append(sent[i]);
+  }
+
+  // The ring dropped the oldest blocks and kept whole blocks of the rest
+  uint32_t stored = history.getRecordCount();
+  CHECK(stored < 1500);
+  CHECK(stored > 600);
+  CHECK(history.getStoredBytes() <= SENSOR_HISTORY_BLOCKS * SENSOR_HISTORY_BLOCK_SIZE);
+  CHECK(history.getStoredBytes() < stored * SENSOR_FRAME_SIZE);
+
+  const size_t sizes[] = {SENSOR_HISTORY_CHUNK_SIZE, 100, SENSOR_HISTORY_MIN_CHUNK_SIZE};
+  for (size_t size : sizes) {
+    int chunks = download(size, parser);
+    CHECK(parser.isComplete());
+    CHECK(!parser.hasFailed());
+    CHECK_EQ(received_count, stored);
+    CHECK(chunks >= (int)(history.getStoredBytes() / (size - 1)));
+
+    int mismatches = 0;
+    for (int i = 0; i < received_count; i++) {
+      mismatches += !framesEqual(received[i], sent[1500 - stored + i]);
+    }
+    CHECK_EQ(mismatches, 0);
+  }
+}
+
+static void testEmpty() {
+  SensorHistoryParser parser;
+
+  history.clear();
+  CHECK_EQ(download(SENSOR_HISTORY_MIN_CHUNK_SIZE, parser), 1);
+  CHECK(parser.isComplete());
+  CHECK_EQ(received_count, 0);
+}
+
+static void testSealedDuringDownload() {
+  SensorHistoryParser parser;
+  SensorHistoryReader reader;
+  uint8_t buffer[64];
+
+  srand(2);
+  history.clear();
+  for (int i = 0; i < 20; i++) {
+    history.append(makeFrame(i));
+  }
+
+  // Frames appended during the download start a new block behind the end
+  received_count = 0;
+  reader.begin(history);
+  size_t length = reader.read(buffer, sizeof(buffer));
+  parser.feed(buffer, length, receiveFrame, NULL);
+  for (int i = 20; i < 30; i++) {
+    history.append(makeFrame(i));
+  }
+  while ((length = reader.read(buffer, sizeof(buffer))) > 0) {
+    parser.feed(buffer, length, receiveFrame, NULL);
+  }
+  CHECK(parser.isComplete());
+  CHECK_EQ(received_count, 20);
+  CHECK_EQ(history.getRecordCount(), 30);
+}
+
+static void testMalformed() {
+  SensorHistoryParser parser;
+
+  // A block longer than the block size
+  const uint8_t oversized[] = {0xFF, 0x7F, 0x01};
+  CHECK(!parser.feed(oversized, sizeof(oversized), receiveFrame, NULL));
+  CHECK(parser.hasFailed());
+  CHECK(!parser.isComplete());
+
+  // A delta record cut inside a varint
+  SensorFrame frame = makeFrame(0);
+  uint8_t block[SENSOR_FRAME_SIZE + 1];
+  CHECK_EQ(sensorFrameEncode(&frame, block, sizeof(block)), SENSOR_FRAME_SIZE);
+  block[SENSOR_FRAME_SIZE] = 0x80;
+  received_count = 0;
+  CHECK_EQ(sensorHistoryDecodeBlock(block, sizeof(block), receiveFrame, NULL), -1);
+
+  uint8_t stream[2 + sizeof(block)] = {sizeof(block), 0};
+  memcpy(&stream[2], block, sizeof(block));
+  parser.reset();
+  CHECK(!parser.feed(stream, sizeof(stream), receiveFrame, NULL));
+  CHECK(parser.hasFailed());
+}
+
+static void testChunkSize() {
+  const uint8_t legacy[] = {SENSOR_HISTORY_CMD_DOWNLOAD};
+  const uint8_t small[] = {SENSOR_HISTORY_CMD_DOWNLOAD, 5};
+  const uint8_t medium[] = {SENSOR_HISTORY_CMD_DOWNLOAD, 100};
+  const uint8_t large[] = {SENSOR_HISTORY_CMD_DOWNLOAD, 250};
+
+  CHECK_EQ(sensorHistoryChunkSize(legacy, sizeof(legacy)), SENSOR_HISTORY_MIN_CHUNK_SIZE);
+  CHECK_EQ(sensorHistoryChunkSize(small, sizeof(small)), SENSOR_HISTORY_MIN_CHUNK_SIZE);
+  CHECK_EQ(sensorHistoryChunkSize(medium, sizeof(medium)), 100);
+  CHECK_EQ(sensorHistoryChunkSize(large, sizeof(large)), SENSOR_HISTORY_CHUNK_SIZE);
+}
+
+int main() {
+  RUN_TEST(testRoundTrip);
+  RUN_TEST(testEmpty);
+  RUN_TEST(testSealedDuringDownload);
+  RUN_TEST(testMalformed);
+  RUN_TEST(testChunkSize);
+  return hostTestResult();
+}
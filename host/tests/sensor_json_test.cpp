@@ -0,0 +1,281 @@
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include "host_test.h"
+#include "mock_hardware.h"
+#include "sensor_json.h"
+
+// sensorJson() against the String based toJson() it replaced: the same
+// text for every field, the schema of the old records, the buffer too
+// small path, and the throughput and heap allocations of both
+
+// toJson() of the baseline client, only these fields existed then
+static String baselineToJson(float si7021_t, float si7021_h,
+                             float sht30_t, float sht30_h,
+                             float veml6035_l,
+                             MovementData imu_data)
+{
+  (void)sht30_t;
+  (void)sht30_h;
+  String json = "{";
+  json += "\"si7021_temp\":" + String(si7021_t, 2) + ",";
+  json += "\"si7021_hum\":" + String(si7021_h, 2) + ",";
+  json += "\"veml6035\":" + String(veml6035_l, 2) + ",";
+
+  json += "\"imu_data\":{";
+  json += "\"current_state\":" + String((int)imu_data.current_state) + ",";
+  json += "\"movement_intensity\":" + String(imu_data.movement_intensity, 2) + ",";
+  json += "\"movements_per_minute\":" + String(imu_data.movements_per_minute) + ",";
+  json += "\"is_likely_asleep\":" + String(imu_data.is_likely_asleep ? "true" : "false") + ",";
+  json += "\"still_duration_minutes\":" + String(imu_data.still_duration_minutes);
+  json += "}";
+
+  json += "}";
+  return json;
+}
+
+// The same String code with the fields added since, in sensorJson() order
+static String stringToJson(unsigned long seq, const SensorSnapshot &snapshot)
+{
+  const MovementData &imu_data = snapshot.imu_data;
+  String json = "{";
+  json += "\"seq\":" + String(seq) + ",";
+  json += "\"si7021_temp\":" + String(snapshot.si7021_t, 2) + ",";
+  json += "\"si7021_hum\":" + String(snapshot.si7021_h, 2) + ",";
+#if SENSOR_JSON_INCLUDE_SHT30
+  json += "\"sht30_temp\":" + String(snapshot.sht30_t, 2) + ",";
+  json += "\"sht30_hum\":" + String(snapshot.sht30_h, 2) + ",";
+#endif
+  json += "\"fused_temp\":" + String(snapshot.fused_t, 2) + ",";
+  json += "\"fused_hum\":" + String(snapshot.fused_h, 2) + ",";
+  json += "\"fusion_status\":" + String((unsigned int)snapshot.fusion_status) + ",";
+  json += "\"veml6035\":" + String(snapshot.veml6035_l, 2) + ",";
+
+  json += "\"imu_data\":{";
+  json += "\"current_state\":" + String((int)imu_data.current_state) + ",";
+  json += "\"movement_intensity\":" + String(imu_data.movement_intensity, 2) + ",";
+  json += "\"movements_per_minute\":" + String(imu_data.movements_per_minute) + ",";
+  json += "\"is_likely_asleep\":" + String(imu_data.is_likely_asleep ? "true" : "false") + ",";
+  json += "\"still_duration_minutes\":" + String(imu_data.still_duration_minutes);
+  json += "},";
+  json += "\"sleep_stage\":" + String((unsigned int)snapshot.sleep_stage) + ",";
+  json += "\"posture\":" + String((unsigned int)snapshot.posture);
+
+  json += "}";
+  return json;
+}
+
+// Flattens a record into "key=value" fields, nested keys as "outer.inner"
+static void flatten(const char *&text, const std::string &prefix, std::vector<std::string> &fields)
+{
+  CHECK(*text == '{');
+  text++;
+  while (*text != '}' && *text != '\0')
+  {
+    CHECK(*text == '"');
+    const char *end = strchr(text + 1, '"');
+    std::string key = prefix + std::string(text + 1, end);
+    text = end + 1;
+    CHECK(*text == ':');
+    text++;
+    if (*text == '{')
+    {
+      flatten(text, key + ".", fields);
+    }
+    else
+    {
+      const char *value = text;
+      while (*text != ',' && *text != '}' && *text != '\0')
+        text++;
+      fields.push_back(key + "=" + std::string(value, text));
+    }
+    if (*text == ',')
+      text++;
+  }
+  CHECK(*text == '}');
+  if (*text == '}')
+    text++;
+}
+
+static std::vector<std::string> fieldsOf(const char *json)
+{
+  std::vector<std::string> fields;
+  flatten(json, "", fields);
+  CHECK(*json == '\0');
+  return fields;
+}
+
+static SensorFrame makeFrame(int i)
+{
+  SensorFrame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.version = SENSOR_FRAME_VERSION;
+  frame.valid = i % 5 == 4 ? SENSOR_FRAME_IMU_VALID : 0x1F;
+  frame.si7021_temp_centi = (int16_t)(-4685 + i % 17500);
+  frame.si7021_hum_centi = (uint16_t)(i % 10001);
+  frame.sht30_temp_centi = (int16_t)(-4500 - i % 100);
+  frame.sht30_hum_centi = (uint16_t)(10000 - i % 10001);
+  frame.veml6035_millilux = (uint32_t)i * 7;
+  frame.imu_state = i % 3;
+  frame.imu_asleep = i % 2 == 0;
+  frame.sleep_stage = i % 4;
+  frame.posture = i % 7;
+  frame.imu_intensity_milli = (uint16_t)i;
+  frame.imu_movements_per_minute = (uint16_t)(i % 300);
+  frame.imu_still_minutes = (uint16_t)(i / 7);
+  frame.fused_temp_centi = (int16_t)(-i % 5000);
+  frame.fused_hum_centi = (uint16_t)(i % 10001);
+  frame.fusion_status = i % 16;
+  return frame;
+}
+
+#define SWEEP 65536
+
+static void testSameText()
+{
+  char json[SENSOR_JSON_MAX_LENGTH];
+  int mismatches = 0;
+
+  // Every value the frames can carry in the swept ranges, the first
+  // mismatch is printed
+  for (int i = 0; i < SWEEP; i++)
+  {
+    SensorSnapshot snapshot;
+    sensorFrameToSnapshot(makeFrame(i), &snapshot);
+    size_t length = sensorJson(json, sizeof(json), 0xFFFFFFF0UL + i, snapshot);
+    String expected = stringToJson(0xFFFFFFF0UL + i, snapshot);
+    CHECK_EQ(length, expected.length());
+    if (strcmp(json, expected.c_str()) != 0 && mismatches++ == 0)
+    {
+      printf("  %s\n  %s\n", json, expected.c_str());
+    }
+  }
+  CHECK_EQ(mismatches, 0);
+}
+
+static void testBaselineSchema()
+{
+  char json[SENSOR_JSON_MAX_LENGTH];
+  static const char *const added[] = {
+    "seq", "fused_temp", "fused_hum", "fusion_status", "sleep_stage", "posture",
+#if SENSOR_JSON_INCLUDE_SHT30
+    "sht30_temp", "sht30_hum",
+#endif
+  };
+
+  for (int i = 0; i < 1000; i += 37)
+  {
+    SensorSnapshot snapshot;
+    sensorFrameToSnapshot(makeFrame(i * 61), &snapshot);
+    CHECK(sensorJson(json, sizeof(json), i, snapshot) > 0);
+    String baseline = baselineToJson(snapshot.si7021_t, snapshot.si7021_h, snapshot.sht30_t,
+                                     snapshot.sht30_h, snapshot.veml6035_l, snapshot.imu_data);
+
+    // Every field of the old records, with the same value and in the
+    // same order, the rest are the fields added since
+    std::vector<std::string> fields = fieldsOf(json);
+    std::vector<std::string> old_fields = fieldsOf(baseline.c_str());
+    size_t next = 0;
+    for (const std::string &field : fields)
+    {
+      if (next < old_fields.size() && field == old_fields[next])
+      {
+        next++;
+        continue;
+      }
+      std::string key = field.substr(0, field.find('='));
+      bool known = false;
+      for (const char *name : added)
+        known = known || key == name;
+      CHECK(known);
+    }
+    CHECK_EQ(next, old_fields.size());
+    CHECK_EQ(fields.size(), old_fields.size() + sizeof(added) / sizeof(added[0]));
+  }
+}
+
+static void testTooSmall()
+{
+  char json[SENSOR_JSON_MAX_LENGTH + 8];
+  SensorSnapshot snapshot;
+  sensorFrameToSnapshot(makeFrame(12345), &snapshot);
+  size_t length = sensorJson(json, sizeof(json), 42, snapshot);
+  CHECK(length > 0);
+
+  // Nothing is written past the capacity and the text stays terminated
+  for (size_t capacity = 0; capacity <= length; capacity++)
+  {
+    memset(json, '#', sizeof(json));
+    CHECK_EQ(sensorJson(json, capacity, 42, snapshot), 0);
+    CHECK_EQ(json[capacity], '#');
+    if (capacity > 0)
+    {
+      CHECK(memchr(json, '\0', capacity) != NULL);
+    }
+  }
+  CHECK_EQ(sensorJson(json, length + 1, 42, snapshot), length);
+
+  // The longest record the frames can produce fits the client's buffer
+  SensorSnapshot longest;
+  SensorFrame frame = makeFrame(0);
+  frame.si7021_temp_centi = -32768;
+  frame.si7021_hum_centi = 65535;
+  frame.sht30_temp_centi = -32768;
+  frame.sht30_hum_centi = 65535;
+  frame.fused_temp_centi = -32768;
+  frame.fused_hum_centi = 65535;
+  frame.fusion_status = 255;
+  frame.veml6035_millilux = 0xFFFFFFFF;
+  frame.imu_intensity_milli = 65535;
+  frame.imu_movements_per_minute = 65535;
+  frame.imu_still_minutes = 65535;
+  frame.imu_state = 3;
+  frame.sleep_stage = 3;
+  frame.posture = 7;
+  sensorFrameToSnapshot(frame, &longest);
+  char buffer[SENSOR_JSON_MAX_LENGTH];
+  length = sensorJson(buffer, sizeof(buffer), 0xFFFFFFFFUL, longest);
+  CHECK(length > 0);
+  CHECK_EQ(length, stringToJson(0xFFFFFFFFUL, longest).length());
+}
+
+// Records per second and heap allocations per record of both
+static void testThroughput()
+{
+  const int records = 20000;
+  char json[SENSOR_JSON_MAX_LENGTH];
+  SensorSnapshot snapshots[16];
+  size_t bytes = 0;
+  for (int i = 0; i < 16; i++)
+    sensorFrameToSnapshot(makeFrame(i * 4099), &snapshots[i]);
+
+  mockStringAllocations = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < records; i++)
+    bytes += sensorJson(json, sizeof(json), i, snapshots[i % 16]);
+  double fixed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  CHECK_EQ(mockStringAllocations, 0);
+
+  size_t string_bytes = 0;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < records; i++)
+    string_bytes += stringToJson(i, snapshots[i % 16]).length();
+  double string_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  CHECK_EQ(bytes, string_bytes);
+  CHECK(mockStringAllocations > (uint32_t)records);
+
+  printf("  sensorJson: %.1f MB/s, 0 allocations per record\n", bytes / fixed_s / 1e6);
+  printf("  String toJson: %.1f MB/s, %.1f allocations per record\n", string_bytes / string_s / 1e6,
+         (double)mockStringAllocations / records);
+}
+
+int main()
+{
+  RUN_TEST(testSameText);
+  RUN_TEST(testBaselineSchema);
+  RUN_TEST(testTooSmall);
+  RUN_TEST(testThroughput);
+  return hostTestResult();
+}
@@ -0,0 +1,220 @@
+#include "host_test.h"
+#include "sensor_record.h"
+#include <stdlib.h>
+#include <string.h>
+
+// SensorRecord COBS framing over a byte stream: round trips, zero bytes
+// inside records, noise and truncated frames in between, v1 and v2 frames
+
+static SensorRecordDecoder decoder;
+
+static SensorRecord makeRecord(int i) {
+  SensorRecord record;
+  memset(&record, 0, sizeof(record));
+  record.type = i & 1 ? SENSOR_RECORD_HISTORY : SENSOR_RECORD_LIVE;
+  record.sequence = i * 7919u;
+  record.frame.version = SENSOR_FRAME_VERSION;
+  record.frame.valid = rand() & 0x1F;
+  record.frame.sequence = (uint16_t)i;
+  record.frame.timestamp_ms = rand();
+  // Mostly zero values, so records are full of bytes COBS has to replace
+  record.frame.si7021_temp_centi = (int16_t)(rand() % 3 ? 0 : rand());
+  record.frame.veml6035_millilux = i % 5 ? 0 : rand();
+  record.frame.imu_state = rand() & 3;
+  record.frame.imu_asleep = rand() & 1;
+  record.frame.posture = rand() % 7;
+  record.frame.imu_still_minutes = (uint16_t)rand();
+  record.frame.fused_temp_centi = (int16_t)(i % 2 ? 0 : -rand() % 3000);
+  record.frame.fusion_status = i % 4;
+  return record;
+}
+
+static bool recordsEqual(const SensorRecord& a, const SensorRecord& b) {
+  return a.type == b.type && a.sequence == b.sequence && a.frame.version == b.frame.version &&
+         a.frame.valid == b.frame.valid && a.frame.sequence == b.frame.sequence &&
+         a.frame.timestamp_ms == b.frame.timestamp_ms &&
+         a.frame.si7021_temp_centi == b.frame.si7021_temp_centi &&
+         a.frame.veml6035_millilux == b.frame.veml6035_millilux && a.frame.imu_state == b.frame.imu_state &&
+         a.frame.imu_asleep == b.frame.imu_asleep && a.frame.posture == b.frame.posture &&
+         a.frame.imu_still_minutes == b.frame.imu_still_minutes &&
+         a.frame.fused_temp_centi == b.frame.fused_temp_centi && a.frame.fusion_status == b.frame.fusion_status;
+}
+
+// Feeds bytes, returns the number of completed records
+static int feed(const uint8_t* data, size_t length) {
+  int records = 0;
+  for (size_t i = 0; i < length; i++) {
+    records += decoder.feed(data[i]);
+  }
+  return records;
+}
+
+static int feedText(const char* text) {
+  return feed((const uint8_t*)text, strlen(text));
+}
+
+// COBS encodes payload + CRC with delimiters, like sensorRecordEncode()
+static size_t encodeRaw(const uint8_t* payload, size_t length, uint8_t* out) {
+  uint8_t raw[SENSOR_RECORD_PAYLOAD_SIZE + 2];
+  memcpy(raw, payload, length);
+  uint16_t crc = sensorRecordCrc16(payload, length);
+  raw[length] = crc & 0xFF;
+  raw[length + 1] = crc >> 8;
+
+  size_t n = 0;
+  out[n++] = 0x00;
+  size_t code_index = n++;
+  uint8_t code = 1;
+  for (size_t i = 0; i < length + 2; i++) {
+    if (raw[i] == 0) {
+      out[code_index] = code;
+      code_index = n++;
+      code = 1;
+    } else {
+      out[n++] = raw[i];
+      code++;
+    }
+  }
+  out[code_index] = code;
+  out[n++] = 0x00;
+  return n;
+}
+
+static void testCrc() {
+  const uint8_t check[] = "123456789";
+  CHECK_EQ(sensorRecordCrc16(check, 9), 0x29B1);
+}
+
+static void testStreamRoundTrip() {
+  uint8_t buffer[SENSOR_RECORD_MAX_ENCODED];
+  int mismatches = 0;
+  int zero_records = 0;
+
+  srand(3);
+  decoder.reset();
+  uint32_t errors = decoder.getErrorCount();
+  for (int i = 0; i < 1000; i++) {
+    SensorRecord record = makeRecord(i);
+    size_t length = sensorRecordEncode(&record, buffer, sizeof(buffer));
+    CHECK(length > 2 && length <= SENSOR_RECORD_MAX_ENCODED);
+    CHECK_EQ(buffer[0], 0x00);
+    CHECK_EQ(buffer[length - 1], 0x00);
+    CHECK(memchr(&buffer[1], 0x00, length - 2) == NULL);
+
+    bool payload_zeros = record.frame.veml6035_millilux == 0 || record.frame.si7021_temp_centi == 0;
+    zero_records += payload_zeros;
+
+    // Status lines of the client end up in the same stream
+    if (i % 50 == 0) {
+      CHECK_EQ(feedText("Connected to server\r\n"), 0);
+    }
+
+    if (feed(buffer, length) != 1) {
+      mismatches++;
+    } else {
+      mismatches += !recordsEqual(decoder.getRecord(), record);
+    }
+  }
+  CHECK_EQ(mismatches, 0);
+  CHECK(zero_records > 500);
+
+  // Text is no valid record, but also costs none
+  CHECK_EQ(decoder.getErrorCount(), errors + 20);
+
+  // Too small a buffer
+  SensorRecord record = makeRecord(0);
+  CHECK_EQ(sensorRecordEncode(&record, buffer, SENSOR_RECORD_MAX_ENCODED - 5), 0);
+}
+
+static void testTruncated() {
+  uint8_t first[SENSOR_RECORD_MAX_ENCODED];
+  uint8_t second[SENSOR_RECORD_MAX_ENCODED];
+
+  srand(4);
+  decoder.reset();
+  SensorRecord a = makeRecord(1);
+  SensorRecord b = makeRecord(2);
+  size_t a_length = sensorRecordEncode(&a, first, sizeof(first));
+  size_t b_length = sensorRecordEncode(&b, second, sizeof(second));
+
+  // A record cut by a reset of the sender, the next one starts with its
+  // delimiter and is intact
+  for (size_t cut = 2; cut < a_length - 1; cut += 7) {
+    uint32_t errors = decoder.getErrorCount();
+    CHECK_EQ(feed(first, cut), 0);
+    CHECK_EQ(feed(second, b_length), 1);
+    CHECK(recordsEqual(decoder.getRecord(), b));
+    CHECK_EQ(decoder.getErrorCount(), errors + 1);
+  }
+
+  // A flipped bit fails the CRC
+  first[10] ^= 0x10;
+  uint32_t errors = decoder.getErrorCount();
+  CHECK_EQ(feed(first, a_length), 0);
+  CHECK_EQ(decoder.getErrorCount(), errors + 1);
+
+  // A lost byte breaks the COBS codes or the length
+  first[10] ^= 0x10;
+  uint8_t shortened[SENSOR_RECORD_MAX_ENCODED];
+  memcpy(shortened, first, 20);
+  memcpy(&shortened[20], &first[21], a_length - 21);
+  CHECK_EQ(feed(shortened, a_length - 1), 0);
+
+  // Runs of garbage longer than a record do not overflow the decoder
+  uint8_t garbage[200];
+  memset(garbage, 0x55, sizeof(garbage));
+  CHECK_EQ(feed(garbage, sizeof(garbage)), 0);
+  CHECK_EQ(feed(first, a_length), 1);
+  CHECK(recordsEqual(decoder.getRecord(), a));
+}
+
+static void testFrameVersions() {
+  uint8_t encoded[SENSOR_RECORD_MAX_ENCODED];
+  uint8_t payload[SENSOR_RECORD_PAYLOAD_SIZE];
+
+  decoder.reset();
+  SensorRecord record;
+  memset(&record, 0, sizeof(record));
+  record.type = SENSOR_RECORD_HISTORY;
+  record.sequence = 9;
+  record.frame.version = 1;
+  record.frame.valid = SENSOR_FRAME_SI7021_VALID;
+  record.frame.si7021_temp_centi = 2100;
+
+  // A version 1 frame is 5 bytes shorter and has no fused values
+  payload[0] = record.type;
+  payload[1] = 9;
+  payload[2] = payload[3] = payload[4] = 0;
+  CHECK_EQ(sensorFrameEncode(&record.frame, &payload[5], SENSOR_FRAME_SIZE), SENSOR_FRAME_SIZE);
+  payload[5] = 1;
+  size_t length = encodeRaw(payload, 5 + SENSOR_FRAME_V1_SIZE, encoded);
+  CHECK_EQ(feed(encoded, length), 1);
+  CHECK_EQ(decoder.getRecord().frame.version, 1);
+  CHECK_EQ(decoder.getRecord().sequence, 9);
+  CHECK_EQ(decoder.getRecord().frame.si7021_temp_centi, 2100);
+  CHECK_EQ(decoder.getRecord().frame.fused_temp_centi, 0);
+
+  // Version 2 carries the fusion
+  record.frame.version = SENSOR_FRAME_VERSION;
+  record.frame.valid |= SENSOR_FRAME_FUSED_VALID;
+  record.frame.fused_temp_centi = -1234;
+  record.frame.fusion_status = 5;
+  length = sensorRecordEncode(&record, encoded, sizeof(encoded));
+  CHECK_EQ(feed(encoded, length), 1);
+  CHECK(recordsEqual(decoder.getRecord(), record));
+
+  // Newer versions only append, a newer frame of the v1 length is broken
+  uint32_t errors = decoder.getErrorCount();
+  payload[5] = SENSOR_FRAME_VERSION + 1;
+  length = encodeRaw(payload, 5 + SENSOR_FRAME_V1_SIZE, encoded);
+  CHECK_EQ(feed(encoded, length), 0);
+  CHECK_EQ(decoder.getErrorCount(), errors + 1);
+}
+
+int main() {
+  RUN_TEST(testCrc);
+  RUN_TEST(testStreamRoundTrip);
+  RUN_TEST(testTruncated);
+  RUN_TEST(testFrameVersions);
+  return hostTestResult();
+}
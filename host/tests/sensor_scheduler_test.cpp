@@ -0,0 +1,247 @@
+#include "host_test.h"
+#include "mock_hardware.h"
+#include "sensor_scheduler.h"
+
+// SensorScheduler on the fake clock: deadline order, the start/ready/fetch
+// failure paths and the loop latency statistics
+
+static char order[8];
+static int order_length;
+static bool a_ready;
+static int fetch_result;
+static int fetches;
+static unsigned long step_cost_us;
+
+static void resetCallbacks() {
+  memset(order, 0, sizeof(order));
+  order_length = 0;
+  a_ready = true;
+  fetch_result = SENSOR_TASK_OK;
+  fetches = 0;
+  step_cost_us = 0;
+}
+
+static int startA() { return SENSOR_TASK_OK; }
+static int startB() { return SENSOR_TASK_OK; }
+static int startFails() { return SENSOR_TASK_ERROR; }
+static bool readyA() { return a_ready; }
+static bool neverReady() { return false; }
+
+static int fetchA() {
+  order[order_length++] = 'A';
+  return SENSOR_TASK_OK;
+}
+
+static int fetchB() {
+  order[order_length++] = 'B';
+  return SENSOR_TASK_OK;
+}
+
+static int fetchCounted() {
+  fetches++;
+  mockAdvanceMicros(step_cost_us);
+  return fetch_result;
+}
+
+static void testDeadlineOrder() {
+  SensorScheduler scheduler;
+  resetCallbacks();
+  mockSetClockStep(0);
+
+  // Both start at 0, B converts faster and is more overdue at 60 ms
+  scheduler.addTask("A", 1000, startA, NULL, fetchA, 50);
+  scheduler.addTask("B", 1000, startB, NULL, fetchB, 20);
+  scheduler.tick();
+  CHECK_EQ(order_length, 0);
+
+  mockAdvanceMillis(30);
+  scheduler.tick();
+  CHECK_EQ(order_length, 1);
+  CHECK_EQ(order[0], 'B');
+
+  mockAdvanceMillis(30);
+  scheduler.tick();
+  CHECK_EQ(order_length, 2);
+  CHECK_EQ(order[1], 'A');
+
+  // Both overdue in the same tick: the older deadline goes first
+  mockAdvanceMillis(940);
+  scheduler.tick();
+  mockAdvanceMillis(60);
+  order_length = 0;
+  scheduler.tick();
+  CHECK_EQ(order_length, 2);
+  CHECK_EQ(order[0], 'B');
+  CHECK_EQ(order[1], 'A');
+}
+
+static void testPeriodGrid() {
+  SensorScheduler scheduler;
+  resetCallbacks();
+  mockSetClockStep(0);
+
+  int task = scheduler.addTask("counted", 100, NULL, NULL, fetchCounted);
+  for (int ms = 0; ms < 1000; ms += 10) {
+    scheduler.tick();
+    mockAdvanceMillis(10);
+  }
+  CHECK_EQ(fetches, 10);
+
+  // Missed periods are not caught up on
+  mockAdvanceMillis(550);
+  scheduler.tick();
+  scheduler.tick();
+  CHECK_EQ(fetches, 11);
+
+  CHECK_EQ(scheduler.setPeriod(task, 200), 0);
+  CHECK_EQ(scheduler.getPeriod(task), 200);
+  CHECK(scheduler.setPeriod(8, 200) != 0);
+}
+
+static void testStartFailure() {
+  SensorScheduler scheduler;
+  resetCallbacks();
+  mockSetClockStep(0);
+
+  int task = scheduler.addTask("fails", 100, startFails, NULL, fetchCounted, 10);
+  scheduler.tick();
+  mockAdvanceMillis(50);
+  scheduler.tick();
+  CHECK_EQ(scheduler.getErrorCount(task), 1);
+  CHECK_EQ(fetches, 0);
+
+  // Retried on the next period, not on every tick
+  mockAdvanceMillis(50);
+  scheduler.tick();
+  CHECK_EQ(scheduler.getErrorCount(task), 2);
+}
+
+static void testReadyTimeout() {
+  SensorScheduler scheduler;
+  resetCallbacks();
+  mockSetClockStep(0);
+
+  int task = scheduler.addTask("stuck", 1000, startA, neverReady, fetchCounted, 10, 100);
+  scheduler.tick();
+  for (int ms = 0; ms < 90; ms += 10) {
+    mockAdvanceMillis(10);
+    scheduler.tick();
+  }
+  CHECK_EQ(scheduler.getErrorCount(task), 0);
+
+  mockAdvanceMillis(10);
+  scheduler.tick();
+  CHECK_EQ(scheduler.getErrorCount(task), 1);
+  CHECK_EQ(fetches, 0);
+
+  // Idle again until the next period
+  mockAdvanceMillis(100);
+  scheduler.tick();
+  CHECK_EQ(scheduler.getErrorCount(task), 1);
+}
+
+static void testReadyWithoutStart() {
+  SensorScheduler scheduler;
+  resetCallbacks();
+  mockSetClockStep(0);
+
+  int task = scheduler.addTask("waits", 1000, NULL, readyA, fetchCounted, 0, 100);
+  a_ready = false;
+  scheduler.tick();
+  mockAdvanceMillis(20);
+  scheduler.tick();
+  CHECK_EQ(fetches, 0);
+
+  a_ready = true;
+  mockAdvanceMillis(20);
+  scheduler.tick();
+  CHECK_EQ(fetches, 1);
+  CHECK_EQ(scheduler.getErrorCount(task), 0);
+}
+
+static void testFetchTimeout() {
+  SensorScheduler scheduler;
+  resetCallbacks();
+  mockSetClockStep(0);
+
+  // A fetch that keeps restarting the conversion runs into the timeout
+  fetch_result = SENSOR_TASK_PENDING;
+  int task = scheduler.addTask("pending", 1000, startA, NULL, fetchCounted, 20, 100);
+  for (int ms = 0; ms <= 200; ms += 20) {
+    scheduler.tick();
+    mockAdvanceMillis(20);
+  }
+  CHECK_EQ(fetches, 4);
+  CHECK_EQ(scheduler.getErrorCount(task), 1);
+
+  fetch_result = SENSOR_TASK_ERROR;
+  mockAdvanceMillis(1000);
+  scheduler.tick();
+  mockAdvanceMillis(20);
+  scheduler.tick();
+  CHECK_EQ(scheduler.getErrorCount(task), 2);
+}
+
+static void testLoopLatency() {
+  SensorScheduler scheduler;
+  resetCallbacks();
+  mockSetClockStep(0);
+
+  int task = scheduler.addTask("slow", 100, NULL, NULL, fetchCounted);
+  step_cost_us = 3000;
+
+  scheduler.tick();
+  mockAdvanceMillis(5);
+  scheduler.tick();
+  mockAdvanceMillis(12);
+  scheduler.tick();
+  mockAdvanceMillis(7);
+  scheduler.tick();
+
+  // The first gap includes the 3 ms step of the first tick
+  CHECK_EQ(scheduler.getWorstLoopLatencyMicros(), 12000);
+  CHECK_EQ(scheduler.getWorstTickMicros(), 3000);
+  CHECK_EQ(scheduler.getBusyMicros(task), 3000);
+
+  scheduler.resetStats();
+  CHECK_EQ(scheduler.getWorstLoopLatencyMicros(), 0);
+  CHECK_EQ(scheduler.getBusyMicros(task), 0);
+  scheduler.tick();
+  mockAdvanceMillis(2);
+  scheduler.tick();
+  CHECK_EQ(scheduler.getWorstLoopLatencyMicros(), 2000);
+}
+
+static void testDutyCycleLongRun() {
+  SensorScheduler scheduler;
+  resetCallbacks();
+  mockSetClockStep(0);
+
+  // 2 ms every 100 ms for three hours without a central resetting the
+  // statistics, past the 71 minute wrap of micros() on the 32 bit target.
+  // unsigned long is 64 bit here, so this checks the per tick sums.
+  scheduler.addTask("slow", 100, NULL, NULL, fetchCounted);
+  step_cost_us = 2000;
+  for (unsigned long i = 0; i < 3UL * 3600 * 10; i++) {
+    scheduler.tick();
+    mockAdvanceMicros(100000 - step_cost_us);
+  }
+
+  CHECK_EQ(fetches, 3 * 3600 * 10);
+  CHECK_EQ(scheduler.getDutyCyclePermille(), 20);
+
+  scheduler.resetStats();
+  CHECK_EQ(scheduler.getDutyCyclePermille(), 0);
+}
+
+int main() {
+  RUN_TEST(testDeadlineOrder);
+  RUN_TEST(testPeriodGrid);
+  RUN_TEST(testStartFailure);
+  RUN_TEST(testReadyTimeout);
+  RUN_TEST(testReadyWithoutStart);
+  RUN_TEST(testFetchTimeout);
+  RUN_TEST(testLoopLatency);
+  RUN_TEST(testDutyCycleLongRun);
+  return hostTestResult();
+}
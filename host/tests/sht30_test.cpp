@@ -0,0 +1,274 @@
+#include "host_test.h"
+#include "mock_hardware.h"
+#include "sht30_model.h"
+#include "sht30.h"
+
+// SHT30 driver against the command level model: single shots, periodic
+// acquisition with NO_DATA between results, and the checkStatus()
+// recovery after the sensor lost its periodic mode
+
+// One LSB of the raw values, in hundredths
+#define TEMPERATURE_TOLERANCE 1
+#define HUMIDITY_TOLERANCE    1
+
+// Periodic mode, 2 mps with high repeatability
+#define SHT30_CMD_PERIODIC_2_HIGH 0x2236
+
+static void checkReading(SHT30Model& model, int16_t temperature, uint16_t humidity) {
+  CHECK_NEAR(temperature, model.temperature * 100, TEMPERATURE_TOLERANCE);
+  CHECK_NEAR(humidity, model.humidity * 100, HUMIDITY_TOLERANCE);
+}
+
+// Commands cost bus time and the 1 ms command spacing, so the periodic
+// cases move the clock to times relative to the start of the acquisition
+static void advanceTo(uint64_t start_us, uint32_t ms) {
+  uint64_t now = mockMicros64();
+  CHECK(now <= start_us + ms * 1000ULL);
+  mockAdvanceMicros(start_us + ms * 1000ULL - now);
+}
+
+static void testSingleShot() {
+  SHT30Model model;
+  SHT30 sensor;
+  int16_t temperature;
+  uint16_t humidity;
+  mockSetClockStep(0);
+  model.attach();
+  model.temperature = -12.34f;
+  model.humidity = 87.65f;
+
+  CHECK_EQ(sensor.init(), SHT30_OK);
+
+  // Clock stretching holds the bus for the measurement time
+  uint64_t start = mockMicros64();
+  CHECK_EQ(sensor.readTempHumidityCenti(&temperature, &humidity), SHT30_OK);
+  CHECK((mockMicros64() - start) / 1000 == 15);
+  checkReading(model, temperature, humidity);
+
+  CHECK_EQ(sensor.readTempHumidityCenti(&temperature, &humidity, SHT30_Repeatability::LOW, 0), SHT30_OK);
+  checkReading(model, temperature, humidity);
+
+  float t, h;
+  CHECK_EQ(sensor.readTempHumidity(&t, &h, SHT30_Repeatability::MEDIUM), SHT30_OK);
+  CHECK_NEAR(t, model.temperature, 0.011);
+  CHECK_NEAR(h, model.humidity, 0.011);
+
+  model.corrupt_crc = true;
+  CHECK_EQ(sensor.readTempHumidityCenti(&temperature, &humidity), SHT30_ERROR_CRC);
+  CHECK_EQ(sensor.getLastError(), SHT30_ERROR_CRC);
+}
+
+static void testNonBlockingSingleShot() {
+  SHT30Model model;
+  SHT30 sensor;
+  int16_t temperature;
+  uint16_t humidity;
+  mockSetClockStep(0);
+  model.attach();
+
+  CHECK_EQ(sensor.init(), SHT30_OK);
+  CHECK_EQ(sensor.startMeasurement(), SHT30_OK);
+  CHECK(!sensor.isMeasurementReady());
+
+  // Fetching early is NACKed by the sensor
+  CHECK_EQ(sensor.fetchMeasurementCenti(&temperature, &humidity), SHT30_ERROR_NO_DATA);
+
+  mockAdvanceMillis(15);
+  CHECK(sensor.isMeasurementReady());
+  CHECK_EQ(sensor.fetchMeasurementCenti(&temperature, &humidity), SHT30_OK);
+  checkReading(model, temperature, humidity);
+
+  // The result is read once
+  CHECK_EQ(sensor.fetchMeasurementCenti(&temperature, &humidity), SHT30_ERROR_NO_DATA);
+}
+
+static void testPeriodic() {
+  static const uint8_t RATES[] = {SHT30_Rate::MPS_0_5, SHT30_Rate::MPS_1, SHT30_Rate::MPS_2,
+                                  SHT30_Rate::MPS_4, SHT30_Rate::MPS_10};
+  static const uint32_t PERIODS_MS[] = {2000, 1000, 500, 250, 100};
+
+  for (int i = 0; i < 5; i++) {
+    mockReset();
+    mockSetClockStep(0);
+    SHT30Model model;
+    SHT30 sensor;
+    int16_t temperature;
+    uint16_t humidity;
+    model.attach();
+
+    CHECK_EQ(sensor.init(), SHT30_OK);
+    uint64_t start = mockMicros64();
+    CHECK_EQ(sensor.startPeriodic(RATES[i]), SHT30_OK);
+    CHECK(sensor.isPeriodic());
+    CHECK(model.isPeriodic());
+    CHECK_EQ(model.getPeriodMs(), PERIODS_MS[i]);
+
+    // Nothing before the first measurement is done
+    CHECK_EQ(sensor.fetchCenti(&temperature, &humidity), SHT30_ERROR_NO_DATA);
+    advanceTo(start, 16);
+    CHECK_EQ(sensor.fetchCenti(&temperature, &humidity), SHT30_OK);
+    checkReading(model, temperature, humidity);
+
+    // One result per period, NO_DATA in between
+    model.temperature = 30.0f;
+    CHECK_EQ(sensor.fetchCenti(&temperature, &humidity), SHT30_ERROR_NO_DATA);
+    advanceTo(start, 14 + PERIODS_MS[i]);
+    CHECK_EQ(sensor.fetchCenti(&temperature, &humidity), SHT30_ERROR_NO_DATA);
+    advanceTo(start, 16 + PERIODS_MS[i]);
+    CHECK_EQ(sensor.fetchCenti(&temperature, &humidity), SHT30_OK);
+    checkReading(model, temperature, humidity);
+    CHECK_EQ(model.fetches, 2);
+    CHECK_EQ(model.empty_fetches, 3);
+
+    // Only fetch, break and reset are accepted while it runs
+    uint16_t status;
+    CHECK(sensor.readStatusRegister(&status) != SHT30_OK);
+    CHECK(model.nacked_commands > 0);
+
+    CHECK_EQ(sensor.stopPeriodic(), SHT30_OK);
+    CHECK(!sensor.isPeriodic());
+    CHECK(!model.isPeriodic());
+    CHECK_EQ(sensor.readTempHumidityCenti(&temperature, &humidity), SHT30_OK);
+  }
+}
+
+static void testART() {
+  SHT30Model model;
+  SHT30 sensor;
+  int16_t temperature;
+  uint16_t humidity;
+  mockSetClockStep(0);
+  model.attach();
+
+  CHECK_EQ(sensor.init(), SHT30_OK);
+  CHECK_EQ(sensor.startART(), SHT30_OK);
+  CHECK_EQ(model.getPeriodMs(), 250);
+
+  // Switching the rate breaks the running acquisition first
+  CHECK_EQ(sensor.startPeriodic(SHT30_Rate::MPS_10), SHT30_OK);
+  CHECK_EQ(model.getPeriodMs(), 100);
+  CHECK_EQ(model.nacked_commands, 0);
+  mockAdvanceMillis(20);
+  CHECK_EQ(sensor.fetchCenti(&temperature, &humidity), SHT30_OK);
+}
+
+static void testCheckStatusRecovery() {
+  SHT30Model model;
+  SHT30 sensor;
+  int16_t temperature;
+  uint16_t humidity;
+  uint16_t status;
+  mockSetClockStep(0);
+  model.attach();
+
+  CHECK_EQ(sensor.init(), SHT30_OK);
+  CHECK_EQ(sensor.startPeriodic(SHT30_Rate::MPS_1), SHT30_OK);
+
+  // The soft reset of init() is reported and cleared, the acquisition
+  // keeps running
+  CHECK_EQ(sensor.checkStatus(&status), SHT30_OK);
+  CHECK(status & SHT30_STATUS_RESET_DETECTED);
+  CHECK(sensor.isPeriodic());
+  CHECK(model.isPeriodic());
+  CHECK_EQ(model.status & SHT30_STATUS_RESET_DETECTED, 0);
+
+  CHECK_EQ(sensor.checkStatus(&status), SHT30_OK);
+  CHECK_EQ(status & SHT30_STATUS_RESET_DETECTED, 0);
+
+  // A brown-out drops the sensor to idle single shot mode: fetches only
+  // ever see NO_DATA until checkStatus() restarts the acquisition
+  mockAdvanceMillis(1100);
+  model.powerCycle();
+  for (int i = 0; i < 3; i++) {
+    mockAdvanceMillis(1000);
+    CHECK_EQ(sensor.fetchCenti(&temperature, &humidity), SHT30_ERROR_NO_DATA);
+  }
+
+  CHECK_EQ(sensor.checkStatus(&status), SHT30_OK);
+  CHECK(status & SHT30_STATUS_RESET_DETECTED);
+  CHECK(sensor.isPeriodic());
+  CHECK(model.isPeriodic());
+  CHECK_EQ(model.getPeriodMs(), 1000);
+
+  mockAdvanceMillis(15);
+  CHECK_EQ(sensor.fetchCenti(&temperature, &humidity), SHT30_OK);
+  checkReading(model, temperature, humidity);
+}
+
+static void testCheckStatusRestartRetry() {
+  SHT30Model model;
+  SHT30 sensor;
+  int16_t temperature;
+  uint16_t humidity;
+  uint16_t status;
+  mockSetClockStep(0);
+  model.attach();
+
+  CHECK_EQ(sensor.init(), SHT30_OK);
+  CHECK_EQ(sensor.startPeriodic(SHT30_Rate::MPS_2), SHT30_OK);
+
+  // The restart is NACKed twice: checkStatus() and the first fetch report
+  // the error, the second fetch restarts the acquisition
+  model.nack_command = SHT30_CMD_PERIODIC_2_HIGH;
+  model.nack_count = 2;
+  CHECK_EQ(sensor.checkStatus(&status), SHT30_ERROR_I2C);
+  CHECK(!sensor.isPeriodic());
+  CHECK(!model.isPeriodic());
+  CHECK_EQ(sensor.fetchCenti(&temperature, &humidity), SHT30_ERROR_I2C);
+  CHECK(!model.isPeriodic());
+
+  CHECK_EQ(sensor.fetchCenti(&temperature, &humidity), SHT30_ERROR_NO_DATA);
+  CHECK(sensor.isPeriodic());
+  CHECK(model.isPeriodic());
+  CHECK_EQ(model.getPeriodMs(), 500);
+  mockAdvanceMillis(15);
+  CHECK_EQ(sensor.fetchCenti(&temperature, &humidity), SHT30_OK);
+  checkReading(model, temperature, humidity);
+
+  // A failed status read after the break leaves the restart pending too
+  model.nack_command = SHT30_CMD_STATUS_REGISTER;
+  model.nack_count = 1;
+  CHECK_EQ(sensor.checkStatus(&status), SHT30_ERROR_I2C);
+  CHECK(!model.isPeriodic());
+  CHECK_EQ(sensor.fetchCenti(&temperature, &humidity), SHT30_ERROR_NO_DATA);
+  CHECK(model.isPeriodic());
+
+  // Stopping drops a pending restart
+  model.nack_command = SHT30_CMD_PERIODIC_2_HIGH;
+  model.nack_count = 1;
+  CHECK_EQ(sensor.checkStatus(&status), SHT30_ERROR_I2C);
+  CHECK_EQ(sensor.stopPeriodic(), SHT30_OK);
+  CHECK(!sensor.isPeriodic());
+  CHECK_EQ(sensor.readTempHumidityCenti(&temperature, &humidity), SHT30_OK);
+  CHECK(!model.isPeriodic());
+}
+
+static void testHeaterAndMissingSensor() {
+  SHT30Model model;
+  SHT30 sensor;
+  uint16_t status;
+  mockSetClockStep(0);
+
+  CHECK_EQ(sensor.init(), SHT30_ERROR_I2C);
+
+  model.attach();
+  CHECK_EQ(sensor.init(), SHT30_OK);
+  CHECK_EQ(sensor.enableHeater(), SHT30_OK);
+  CHECK_EQ(sensor.readStatusRegister(&status), SHT30_OK);
+  CHECK(status & SHT30_STATUS_HEATER_ON);
+  CHECK_EQ(sensor.disableHeater(), SHT30_OK);
+  CHECK_EQ(sensor.clearStatusRegister(), SHT30_OK);
+  CHECK_EQ(sensor.readStatusRegister(&status), SHT30_OK);
+  CHECK_EQ(status, 0);
+}
+
+int main() {
+  RUN_TEST(testSingleShot);
+  RUN_TEST(testNonBlockingSingleShot);
+  RUN_TEST(testPeriodic);
+  RUN_TEST(testART);
+  RUN_TEST(testCheckStatusRecovery);
+  RUN_TEST(testCheckStatusRestartRetry);
+  RUN_TEST(testHeaterAndMissingSensor);
+  return hostTestResult();
+}
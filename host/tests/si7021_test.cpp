@@ -0,0 +1,148 @@
+#include "host_test.h"
+#include "mock_hardware.h"
+#include "si7021_model.h"
+#include "si7021.h"
+
+// SI7021 no-hold reads against the model that NACKs its read header until
+// the conversion is done: the polls start after the typical conversion
+// time and are paced, checksum errors are rejected
+
+static void testNoHoldRead() {
+  SI7021Model model;
+  SI7021 sensor;
+  float temperature;
+  float humidity;
+  mockSetClockStep(0);
+  model.attach();
+  model.temperature = -12.34f;
+  model.humidity = 67.89f;
+
+  CHECK_EQ(sensor.init(), 0);
+  mockResetBusStats();
+  uint64_t start = mockMicros64();
+  CHECK_EQ(sensor.readTempHumidity(&temperature, &humidity), 0);
+  uint64_t elapsed = mockMicros64() - start;
+
+  CHECK_NEAR(temperature, model.temperature, 0.011);
+  CHECK_NEAR(humidity, model.humidity, 0.011);
+  // The temperature comes from the humidity conversion
+  CHECK_EQ(model.conversions, 1);
+
+  // At the typical time the first poll already gets the result: the
+  // command, the read and the temperature, nothing NACKed
+  CHECK_EQ(mockBusStats.i2c_nacks, 0);
+  CHECK_EQ(mockBusStats.i2c_bytes, 11);
+  CHECK(elapsed >= SI7021_HUMIDITY_TYPICAL_MS * 1000ULL);
+  // plus the bus time of the 11 bytes at 100 kHz
+  CHECK(elapsed < (SI7021_HUMIDITY_TYPICAL_MS + 2) * 1000ULL);
+}
+
+static void testSlowConversion() {
+  SI7021Model model;
+  SI7021 sensor;
+  float temperature;
+  float humidity;
+  mockSetClockStep(0);
+  model.attach();
+  model.humidity_conversion_us = SI7021_HUMIDITY_CONVERSION_MS * 1000;
+
+  CHECK_EQ(sensor.init(), 0);
+  mockResetBusStats();
+  uint64_t start = mockMicros64();
+  CHECK_EQ(sensor.readTempHumidity(&temperature, &humidity), 0);
+  uint64_t elapsed = mockMicros64() - start;
+  CHECK_NEAR(humidity, model.humidity, 0.011);
+
+  // One NACKed poll per interval between the typical and the real time,
+  // and the result within one interval of the conversion end
+  uint32_t polls = (SI7021_HUMIDITY_CONVERSION_MS - SI7021_HUMIDITY_TYPICAL_MS) / SI7021_POLL_INTERVAL_MS;
+  CHECK(mockBusStats.i2c_nacks >= polls - 1 && mockBusStats.i2c_nacks <= polls + 1);
+  CHECK(elapsed >= SI7021_HUMIDITY_CONVERSION_MS * 1000ULL);
+  CHECK(elapsed <= (SI7021_HUMIDITY_CONVERSION_MS + SI7021_POLL_INTERVAL_MS + 1) * 1000ULL);
+}
+
+static void testTimeout() {
+  SI7021Model model;
+  SI7021 sensor;
+  float temperature;
+  float humidity;
+  mockSetClockStep(0);
+  model.attach();
+  model.humidity_conversion_us = 200000;
+
+  CHECK_EQ(sensor.init(), 0);
+  mockResetBusStats();
+  uint64_t start = mockMicros64();
+  CHECK_EQ(sensor.readTempHumidity(&temperature, &humidity), 1);
+  uint64_t elapsed = mockMicros64() - start;
+
+  // Gives up after the timeout, with paced polls on the way
+  CHECK(elapsed > SI7021_CONVERSION_TIMEOUT_MS * 1000ULL);
+  CHECK(elapsed <= (SI7021_CONVERSION_TIMEOUT_MS + 2 * SI7021_POLL_INTERVAL_MS + 1) * 1000ULL);
+  CHECK(mockBusStats.i2c_nacks <=
+        (SI7021_CONVERSION_TIMEOUT_MS - SI7021_HUMIDITY_TYPICAL_MS) / SI7021_POLL_INTERVAL_MS + 2);
+
+  // Without a sensor the command is NACKed right away
+  mockDetachI2C(SI7021_ADDRESS);
+  start = mockMicros64();
+  CHECK_EQ(sensor.readTempHumidity(&temperature, &humidity), 1);
+  CHECK(mockMicros64() - start < 1000);
+}
+
+static void testChecksum() {
+  SI7021Model model;
+  SI7021 sensor;
+  float temperature;
+  float humidity;
+  uint16_t humidity_centi;
+  mockSetClockStep(0);
+  model.attach();
+
+  CHECK_EQ(sensor.init(), 0);
+  model.corrupt_crc = true;
+
+  // Rejected on the no-hold, hold and non-blocking paths
+  CHECK_EQ(sensor.readTempHumidity(&temperature, &humidity), 1);
+  CHECK_EQ(sensor.readHumidity(), -999);
+  CHECK_EQ(sensor.readTemperature(), -999);
+  CHECK_EQ(sensor.startHumidityMeasurement(), 0);
+  mockAdvanceMillis(SI7021_HUMIDITY_CONVERSION_MS);
+  CHECK(sensor.isMeasurementReady());
+  CHECK_EQ(sensor.fetchHumidityCenti(&humidity_centi), 1);
+
+  // The temperature read after a humidity conversion has no checksum
+  CHECK(sensor.readTemperatureFromHumidity() != -999);
+
+  model.corrupt_crc = false;
+  CHECK_EQ(sensor.readTempHumidity(&temperature, &humidity), 0);
+  CHECK_NEAR(humidity, model.humidity, 0.011);
+}
+
+static void testNoHoldReadQueued() {
+  SI7021Model model;
+  SI7021 sensor;
+  float temperature;
+  float humidity;
+  // The queued transfers finish as the clock moves, keep the default step
+  model.attach();
+  model.humidity_conversion_us = 19000;
+
+  CHECK_EQ(sensor.init(), 0);
+  CHECK_EQ(i2cAsync.begin(), 0);
+  mockResetBusStats();
+  CHECK_EQ(sensor.readTempHumidity(&temperature, &humidity), 0);
+  CHECK_NEAR(temperature, model.temperature, 0.011);
+  CHECK_NEAR(humidity, model.humidity, 0.011);
+  CHECK_EQ(model.conversions, 1);
+  CHECK(mockBusStats.i2c_nacks <= (19 - SI7021_HUMIDITY_TYPICAL_MS) / SI7021_POLL_INTERVAL_MS + 1);
+  i2cAsync.end();
+}
+
+int main() {
+  RUN_TEST(testNoHoldRead);
+  RUN_TEST(testSlowConversion);
+  RUN_TEST(testTimeout);
+  RUN_TEST(testChecksum);
+  RUN_TEST(testNoHoldReadQueued);
+  return hostTestResult();
+}
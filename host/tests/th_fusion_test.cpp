@@ -0,0 +1,200 @@
+#include <random>
+#include "host_test.h"
+#include "th_fusion.h"
+
+// Synthetic room traces through ThFusion: 500 units with biases drawn
+// from the datasheet accuracies, sensor noise and slow changes of the
+// air. Reading both sensors every period and reading them in turn must
+// give the same fused error, below that of either sensor alone.
+
+#define UNITS      500
+#define PERIOD_MS  2000
+#define STEPS      1800   // one hour
+#define SETTLE     100    // steps before the errors count
+
+struct Rms {
+  double sum;
+  long count;
+
+  void add(double error) {
+    sum += error * error;
+    count++;
+  }
+
+  double value() const { return count > 0 ? sqrt(sum / count) : 0; }
+};
+
+static void testReplay() {
+  std::mt19937 rng(1);
+  std::normal_distribution<double> normal(0, 1);
+  Rms si_temp = {}, sht_temp = {}, both_temp = {}, alternate_temp = {};
+  Rms si_hum = {}, sht_hum = {}, both_hum = {}, alternate_hum = {};
+  long both_reads = 0;
+  long alternate_reads = 0;
+  long missing = 0;
+
+  for (int unit = 0; unit < UNITS; unit++) {
+    double si_temp_bias = 0.4 * normal(rng);
+    double sht_temp_bias = 0.2 * normal(rng);
+    double si_hum_bias = 3.0 * normal(rng);
+    double sht_hum_bias = 2.0 * normal(rng);
+    double phase = unit * 0.1;
+
+    ThFusion both;
+    ThFusion alternate;
+    both.setSamplePeriod(PERIOD_MS);
+    alternate.setSamplePeriod(2 * PERIOD_MS);
+
+    for (int step = 0; step < STEPS; step++) {
+      unsigned long now = (unsigned long)step * PERIOD_MS;
+      double temp = 22 + 1.5 * sin(now / 600000.0 + phase) + 0.3 * sin(now / 90000.0);
+      double hum = 45 + 8 * sin(now / 900000.0 + phase);
+
+      int16_t si_t = (int16_t)lround((temp + si_temp_bias + 0.02 * normal(rng)) * 100);
+      int16_t sht_t = (int16_t)lround((temp + sht_temp_bias + 0.02 * normal(rng)) * 100);
+      uint16_t si_h = (uint16_t)lround((hum + si_hum_bias + 0.05 * normal(rng)) * 100);
+      uint16_t sht_h = (uint16_t)lround((hum + sht_hum_bias + 0.05 * normal(rng)) * 100);
+
+      both.addSample(ThSensor::SI7021, si_t, si_h, now);
+      both.addSample(ThSensor::SHT30, sht_t, sht_h, now);
+      both_reads += 2;
+      if (step % 2 == 0) {
+        alternate.addSample(ThSensor::SI7021, si_t, si_h, now);
+      } else {
+        alternate.addSample(ThSensor::SHT30, sht_t, sht_h, now);
+      }
+      alternate_reads++;
+
+      if (step < SETTLE) {
+        continue;
+      }
+
+      si_temp.add(si_t / 100.0 - temp);
+      sht_temp.add(sht_t / 100.0 - temp);
+      si_hum.add(si_h / 100.0 - hum);
+      sht_hum.add(sht_h / 100.0 - hum);
+
+      ThFusionReading reading;
+      if (both.getReading(now, &reading)) {
+        both_temp.add(reading.temp_centi / 100.0 - temp);
+        both_hum.add(reading.hum_centi / 100.0 - hum);
+      } else {
+        missing++;
+      }
+      if (alternate.getReading(now, &reading)) {
+        alternate_temp.add(reading.temp_centi / 100.0 - temp);
+        alternate_hum.add(reading.hum_centi / 100.0 - hum);
+      } else {
+        missing++;
+      }
+    }
+  }
+
+  printf("  temperature RMS: SI7021 %.3f SHT30 %.3f fused %.3f alternating %.3f C\n",
+         si_temp.value(), sht_temp.value(), both_temp.value(), alternate_temp.value());
+  printf("  humidity RMS:    SI7021 %.3f SHT30 %.3f fused %.3f alternating %.3f %%RH\n",
+         si_hum.value(), sht_hum.value(), both_hum.value(), alternate_hum.value());
+
+  // Half the sensor reads, and a valid reading every period
+  CHECK_EQ(alternate_reads * 2, both_reads);
+  CHECK_EQ(missing, 0);
+
+  // The sensors alone are as accurate as their datasheets
+  CHECK_NEAR(si_temp.value(), 0.4, 0.04);
+  CHECK_NEAR(sht_temp.value(), 0.2, 0.02);
+  CHECK_NEAR(si_hum.value(), 3.0, 0.3);
+  CHECK_NEAR(sht_hum.value(), 2.0, 0.2);
+
+  // Fused beats the better sensor, by the inverse-variance weighting
+  // about sqrt(1 / (1/0.4^2 + 1/0.2^2)) = 0.18 C and 1.66 %RH
+  CHECK(both_temp.value() < 0.19);
+  CHECK(both_hum.value() < 1.8);
+  CHECK(both_temp.value() < sht_temp.value());
+  CHECK(both_hum.value() < sht_hum.value());
+
+  // Alternating costs no accuracy
+  CHECK_NEAR(alternate_temp.value(), both_temp.value(), 0.005);
+  CHECK_NEAR(alternate_hum.value(), both_hum.value(), 0.05);
+}
+
+static void testAlternatingOffset() {
+  ThFusion fusion;
+  ThFusionReading reading = {};
+  int lowest = 32767;
+  int highest = -32768;
+  fusion.setSamplePeriod(2 * PERIOD_MS);
+
+  // A constant offset must not make the fused value follow whichever
+  // sensor was read last
+  for (int step = 0; step < 200; step++) {
+    unsigned long now = (unsigned long)step * PERIOD_MS;
+    if (step % 2 == 0) {
+      fusion.addSample(ThSensor::SI7021, 2240, 5000, now);
+    } else {
+      fusion.addSample(ThSensor::SHT30, 2200, 4800, now);
+    }
+    CHECK(fusion.getReading(now, &reading));
+    if (step > 50) {
+      lowest = reading.temp_centi < lowest ? reading.temp_centi : lowest;
+      highest = reading.temp_centi > highest ? reading.temp_centi : highest;
+    }
+  }
+
+  CHECK(highest - lowest <= 1);
+  CHECK(lowest >= 2200 && highest <= 2240);
+  CHECK_EQ(fusion.getTempOffsetCenti(), 40);
+  CHECK_EQ(fusion.getHumOffsetCenti(), 200);
+  CHECK_EQ(reading.status, 0);
+}
+
+static void testDriftAndFailure() {
+  ThFusion fusion;
+  ThFusionReading reading = {};
+  int drift_step = -1;
+  int failed_step = -1;
+  fusion.setSamplePeriod(2 * PERIOD_MS);
+
+  // The SI7021 drifts away by 0.02 C per step from step 100, the SHT30
+  // stops answering at step 300. It has no sample yet at step 0.
+  for (int step = 0; step < 400; step++) {
+    unsigned long now = (unsigned long)step * PERIOD_MS;
+    long drift = step >= 100 ? (step - 100) * 2 : 0;
+    if (step % 2 == 0) {
+      fusion.addSample(ThSensor::SI7021, (int16_t)(2200 + drift), 4500, now);
+    } else if (step < 300) {
+      fusion.addSample(ThSensor::SHT30, 2200, 4500, now);
+    }
+    CHECK(fusion.getReading(now, &reading));
+    if (drift_step < 0 && (reading.status & ThFusionStatus::TEMP_DRIFT)) {
+      drift_step = step;
+    }
+    if (step > 10 && failed_step < 0 && (reading.status & ThFusionStatus::SHT30_FAILED)) {
+      failed_step = step;
+    }
+    CHECK(!(reading.status & ThFusionStatus::SI7021_FAILED));
+    CHECK(!(reading.status & ThFusionStatus::HUM_DRIFT));
+  }
+
+  // Flagged once the offset passed TH_FUSION_TEMP_DRIFT_CENTI, late by
+  // the offset filter
+  CHECK(drift_step > 100 + TH_FUSION_TEMP_DRIFT_CENTI / 2);
+  CHECK(drift_step < 100 + TH_FUSION_TEMP_DRIFT_CENTI);
+  // Stale after TH_FUSION_STALE_PERIODS sample periods without a sample
+  CHECK(failed_step > 300);
+  CHECK(failed_step <= 300 + TH_FUSION_STALE_PERIODS * 2);
+
+  // An invalidated sensor is left out at once
+  fusion.addSample(ThSensor::SHT30, 2200, 4500, 400UL * PERIOD_MS);
+  fusion.invalidate(ThSensor::SHT30);
+  CHECK(fusion.getReading(400UL * PERIOD_MS, &reading));
+  CHECK(reading.status & ThFusionStatus::SHT30_FAILED);
+  fusion.invalidate(ThSensor::SI7021);
+  CHECK(!fusion.getReading(400UL * PERIOD_MS, &reading));
+}
+
+int main() {
+  RUN_TEST(testReplay);
+  RUN_TEST(testAlternatingOffset);
+  RUN_TEST(testDriftAndFailure);
+  return hostTestResult();
+}
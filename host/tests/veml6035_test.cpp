@@ -0,0 +1,191 @@
+#include "host_test.h"
+#include "mock_hardware.h"
+#include "veml6035_model.h"
+#include "veml6035.h"
+
+// VEML6035 driver against the register model: blocking reads wait for a
+// conversion of the current integration time, the resolution matches the
+// datasheet table for every configuration
+
+static const uint8_t INTEGRATION_TIMES[] = {
+    IntegrationTime::MS_25, IntegrationTime::MS_50, IntegrationTime::MS_100,
+    IntegrationTime::MS_200, IntegrationTime::MS_400, IntegrationTime::MS_800,
+};
+
+static uint16_t configFor(uint8_t it) {
+    return it << 6;
+}
+
+static void testReadWaitsForIntegration() {
+    VEML6035Model model;
+    VEML6035 sensor;
+    mockSetClockStep(0);
+    model.attach();
+
+    CHECK_EQ(sensor.init(configFor(IntegrationTime::MS_25)), 0);
+
+    for (uint8_t it : INTEGRATION_TIMES) {
+        uint16_t config = configFor(it);
+        uint32_t it_ms = VEML6035Model::integrationMs(config);
+        CHECK_EQ(sensor.setConfig(config), 0);
+        CHECK_EQ(sensor.getIntegrationTimeMs(), it_ms);
+
+        // The first read after a configuration change waits a full
+        // integration, not a fixed time
+        model.lux = 10.0f + it_ms / 100.0f;
+        uint64_t start = mockMicros64();
+        float lux = sensor.readAmbientLight();
+        uint64_t elapsed_ms = (mockMicros64() - start) / 1000;
+        CHECK_EQ(elapsed_ms, it_ms);
+        CHECK_NEAR(lux, model.lux, sensor.getLuxResolutionValue());
+
+        // The next one waits for the next conversion and sees the new light
+        model.lux *= 2;
+        start = mockMicros64();
+        lux = sensor.readAmbientLight();
+        elapsed_ms = (mockMicros64() - start) / 1000;
+        CHECK(elapsed_ms + 1 >= it_ms && elapsed_ms <= it_ms);
+        CHECK_NEAR(lux, model.lux, sensor.getLuxResolutionValue());
+
+        CHECK_NEAR(sensor.readWhiteChannel(), model.lux, sensor.getLuxResolutionValue());
+    }
+}
+
+static void testReadAfterIdleDoesNotWait() {
+    VEML6035Model model;
+    VEML6035 sensor;
+    mockSetClockStep(0);
+    model.attach();
+
+    CHECK_EQ(sensor.init(configFor(IntegrationTime::MS_800)), 0);
+    mockAdvanceMillis(1000);
+
+    uint64_t start = mockMicros64();
+    CHECK_NEAR(sensor.readAmbientLight(), model.lux, sensor.getLuxResolutionValue());
+    CHECK(mockMicros64() - start < 1000);
+}
+
+static void testResolutionTable() {
+    int mismatches = 0;
+
+    for (uint8_t it : INTEGRATION_TIMES) {
+        for (uint16_t bits = 0; bits < 8; bits++) {
+            VEML6035 sensor;
+            uint16_t config = configFor(it) | (bits << 10);
+            sensor.setConfig(config);
+            uint32_t resolution = (uint32_t)lroundf(sensor.getLuxResolutionValue() * 10000.0f);
+            mismatches += resolution != VEML6035Model::resolution(config);
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+
+    // Integer path of the fetches
+    CHECK_EQ(VEML6035::countsToMilliLux(65535, 4096), 26843136);
+    CHECK_EQ(VEML6035::countsToMilliLux(1, 4), 0);
+    CHECK_EQ(VEML6035::countsToMilliLux(3, 4), 1);
+}
+
+static void testNonBlockingRead() {
+    VEML6035Model model;
+    VEML6035 sensor;
+    mockSetClockStep(0);
+    model.attach();
+    model.lux = 321.0f;
+
+    CHECK_EQ(sensor.init(configFor(IntegrationTime::MS_100)), 0);
+    CHECK_EQ(sensor.startAmbientLight(), 0);
+
+    int polls = 0;
+    while (!sensor.isAmbientLightReady()) {
+        mockAdvanceMillis(10);
+        polls++;
+    }
+    CHECK_EQ(polls, 10);
+
+    uint32_t millilux;
+    CHECK_EQ(sensor.fetchAmbientLightMilli(&millilux), 0);
+    CHECK_NEAR(millilux, 321000, 13);
+}
+
+static void testMissingSensor() {
+    VEML6035 sensor;
+    mockSetClockStep(0);
+
+    CHECK(sensor.init() != 0);
+    CHECK_EQ(sensor.readAmbientLight(), -999);
+}
+
+// Counts of the model's light inside the current threshold window
+static bool windowHoldsLight(VEML6035Model& model) {
+    uint16_t counts = VEML6035Model::counts(model.lux, model.getRegister(VEML6035_CONFIG_ADDRESS));
+    return model.getRegister(VEML6035_LTW_ADDRESS) <= counts && counts <= model.getRegister(VEML6035_HTW_ADDRESS);
+}
+
+static double tolerance(VEML6035& sensor, double lux) {
+    return sensor.getLuxResolutionValue() + lux * 0.005;
+}
+
+// The setup of main.ino from darkness to direct sunlight: auto ranging
+// settles before the event mode sets its first window, which then holds
+// the light in counts of the final range, and follows a change
+static void testEventModeLuxSweep() {
+    const double full_scale = 65535 * 0.4096;
+
+    for (double lux = 0.01; lux <= 100000; lux *= sqrt(10.0)) {
+        mockReset();
+        mockSetClockStep(0);
+        VEML6035Model model;
+        VEML6035 sensor;
+        model.lux = lux;
+        model.attach();
+
+        CHECK_EQ(sensor.init(), 0);
+        CHECK_EQ(sensor.setAutoRange(true), 0);
+
+        uint32_t millilux = 0;
+        CHECK_EQ(sensor.readAmbientLightMilli(&millilux), 0);
+        if (lux < full_scale) {
+            CHECK_NEAR(millilux / 1000.0, lux, tolerance(sensor, lux));
+        } else {
+            CHECK_EQ(sensor.getRange(), VEML6035_RANGE_COUNT - 1);
+            CHECK_NEAR(millilux / 1000.0, full_scale, 1);
+        }
+
+        CHECK_EQ(sensor.enableEventMode(25, 1.0, PowerSafeModeWaitTime::S_16), 0);
+        CHECK(windowHoldsLight(model));
+
+        // Constant light raises no event
+        bool changed = true;
+        for (int i = 0; i < 5; i++) {
+            mockAdvanceMillis(2000);
+            CHECK_EQ(sensor.readEventMilli(&changed, &millilux), 0);
+            CHECK(!changed);
+        }
+
+        if (lux < 2.5 || lux >= full_scale) {
+            continue;
+        }
+
+        // 40 % less light leaves the window and moves it to the new value
+        model.lux = lux * 0.6;
+        mockAdvanceMillis(2000);
+        CHECK_EQ(sensor.readEventMilli(&changed, &millilux), 0);
+        CHECK(changed);
+        CHECK_NEAR(millilux / 1000.0, model.lux, tolerance(sensor, model.lux) * 2);
+
+        mockAdvanceMillis(2000);
+        CHECK(windowHoldsLight(model));
+        CHECK_EQ(sensor.readEventMilli(&changed, &millilux), 0);
+        CHECK(!changed);
+    }
+}
+
+int main() {
+    RUN_TEST(testReadWaitsForIntegration);
+    RUN_TEST(testReadAfterIdleDoesNotWait);
+    RUN_TEST(testResolutionTable);
+    RUN_TEST(testNonBlockingRead);
+    RUN_TEST(testMissingSensor);
+    RUN_TEST(testEventModeLuxSweep);
+    return hostTestResult();
+}
@@ -0,0 +1,141 @@
+#include "actigraphy.h"
+#include "movement_kernel.h"
+#include <string.h>
+#include <math.h>
+
+// Cole-Kripke weights, oldest epoch first, the scored epoch has 1408
+static const uint16_t WINDOW_WEIGHTS[ACTIGRAPHY_WINDOW] = {404, 598, 326, 441, 1408, 508, 350};
+static const uint32_t WINDOW_WEIGHT_SUM = 404 + 598 + 326 + 441 + 1408 + 508 + 350;
+
+Actigraphy::Actigraphy() {
+  setSampleRate(ACTIGRAPHY_SAMPLE_RATE_HZ);
+  reset();
+}
+
+bool Actigraphy::setSampleRate(float rate_hz) {
+  if (!(rate_hz >= ACTIGRAPHY_MIN_RATE_HZ && rate_hz <= ACTIGRAPHY_MAX_RATE_HZ)) {
+    return false;
+  }
+
+  // First order RC filters in Q15: high-pass RC / (RC + dt), low-pass
+  // dt / (RC + dt), at 50 Hz 31770 and 8971
+  float dt = 1.0f / rate_hz;
+  float high_rc = 1.0f / (2.0f * (float)M_PI * ACTIGRAPHY_HIGH_PASS_HZ);
+  float low_rc = 1.0f / (2.0f * (float)M_PI * ACTIGRAPHY_LOW_PASS_HZ);
+  high_pass_q15 = lroundf(high_rc / (high_rc + dt) * 32768.0f);
+  low_pass_q15 = lroundf(dt / (low_rc + dt) * 32768.0f);
+
+  sample_rate_hz = rate_hz;
+  epoch_samples = (uint16_t)lroundf(rate_hz * ACTIGRAPHY_EPOCH_SECONDS);
+  return true;
+}
+
+void Actigraphy::reset() {
+  previous_magnitude = 0;
+  high_pass = 0;
+  band_pass = 0;
+  primed = false;
+  crossing_side = 0;
+
+  activity_sum = 0;
+  zero_crossings = 0;
+  time_above = 0;
+  samples = 0;
+
+  epoch_index = 0;
+  memset(window_activity, 0, sizeof(window_activity));
+  memset(window_crossings, 0, sizeof(window_crossings));
+  window_count = 0;
+  still_epochs = 0;
+
+  memset(&last_epoch, 0, sizeof(last_epoch));
+  last_epoch.stage = SleepStage::UNKNOWN;
+}
+
+bool Actigraphy::addSample(int16_t x, int16_t y, int16_t z) {
+  int32_t magnitude = (int32_t)isqrt32(movementSquare(x, y, z)) << 4;
+
+  if (!primed) {
+    previous_magnitude = magnitude;
+    primed = true;
+  }
+
+  high_pass = (int32_t)(((int64_t)high_pass_q15 * (high_pass + magnitude - previous_magnitude)) >> 15);
+  previous_magnitude = magnitude;
+  band_pass += (int32_t)(((int64_t)low_pass_q15 * (high_pass - band_pass)) >> 15);
+
+  int32_t value = band_pass >> 4;
+  uint32_t level = value < 0 ? -value : value;
+
+  activity_sum += level;
+  if (level > ACTIGRAPHY_ABOVE_THRESHOLD) {
+    time_above++;
+  }
+
+  if (value > ACTIGRAPHY_CROSSING_BAND) {
+    if (crossing_side < 0) {
+      zero_crossings++;
+    }
+    crossing_side = 1;
+  } else if (value < -ACTIGRAPHY_CROSSING_BAND) {
+    if (crossing_side > 0) {
+      zero_crossings++;
+    }
+    crossing_side = -1;
+  }
+
+  if (++samples < epoch_samples) {
+    return false;
+  }
+
+  finishEpoch();
+  return true;
+}
+
+void Actigraphy::finishEpoch() {
+  uint64_t activity = (uint64_t)activity_sum * 1000 / ((uint32_t)ACTIGRAPHY_COUNTS_PER_G * samples);
+
+  // Newest epoch last, the scored one is ACTIGRAPHY_WINDOW_FUTURE from the end
+  memmove(window_activity, &window_activity[1], (ACTIGRAPHY_WINDOW - 1) * sizeof(window_activity[0]));
+  memmove(window_crossings, &window_crossings[1], (ACTIGRAPHY_WINDOW - 1) * sizeof(window_crossings[0]));
+  window_activity[ACTIGRAPHY_WINDOW - 1] = activity > 0xFFFF ? 0xFFFF : (uint16_t)activity;
+  window_crossings[ACTIGRAPHY_WINDOW - 1] = zero_crossings;
+  if (window_count < ACTIGRAPHY_WINDOW) {
+    window_count++;
+  }
+
+  last_epoch.index = epoch_index++;
+  last_epoch.activity_mg = window_activity[ACTIGRAPHY_WINDOW - 1];
+  last_epoch.zero_crossings = zero_crossings;
+  last_epoch.time_above_samples = time_above;
+  last_epoch.stage = window_count == ACTIGRAPHY_WINDOW ? scoreWindow() : SleepStage::UNKNOWN;
+
+  activity_sum = 0;
+  zero_crossings = 0;
+  time_above = 0;
+  samples = 0;
+}
+
+uint8_t Actigraphy::scoreWindow() {
+  uint32_t score = 0;
+
+  for (uint8_t i = 0; i < ACTIGRAPHY_WINDOW; i++) {
+    score += (uint32_t)WINDOW_WEIGHTS[i] * window_activity[i];
+  }
+
+  if (score >= ACTIGRAPHY_WAKE_MG * WINDOW_WEIGHT_SUM) {
+    still_epochs = 0;
+    return SleepStage::WAKE;
+  }
+
+  if (score < ACTIGRAPHY_DEEP_MG * WINDOW_WEIGHT_SUM &&
+      window_crossings[ACTIGRAPHY_WINDOW_PAST] <= ACTIGRAPHY_DEEP_MAX_CROSSINGS) {
+    if (still_epochs < 0xFF) {
+      still_epochs++;
+    }
+  } else {
+    still_epochs = 0;
+  }
+
+  return still_epochs >= ACTIGRAPHY_DEEP_MIN_EPOCHS ? SleepStage::DEEP : SleepStage::LIGHT;
+}
@@ -0,0 +1,118 @@
+#ifndef ACTIGRAPHY_H
+#define ACTIGRAPHY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Streaming actigraphy sleep staging on raw accelerometer samples.
+//
+// Every sample's magnitude is band-pass filtered (0.25..3 Hz, removes
+// gravity and vibration) in fixed point. Per 30 s epoch the engine keeps
+// the mean filtered magnitude (activity), the zero crossings and the time
+// above a threshold. Epochs are scored with Cole-Kripke weights over four
+// past and two future epochs, so a stage is known two epochs (1 minute)
+// after the fact. Memory use does not grow with the recording length.
+//
+// The thresholds are in milli-g of weighted mean activity and have to be
+// calibrated against reference recordings of the actual mounting.
+
+// Rate used until setSampleRate() is called, the default FIFO rate
+#define ACTIGRAPHY_SAMPLE_RATE_HZ  50
+#define ACTIGRAPHY_EPOCH_SECONDS   30
+#define ACTIGRAPHY_EPOCH_SAMPLES   (ACTIGRAPHY_SAMPLE_RATE_HZ * ACTIGRAPHY_EPOCH_SECONDS)
+
+// The 3 Hz low-pass needs a rate well above 6 Hz, an epoch has to fit the
+// 16 bit sample counters
+#define ACTIGRAPHY_MIN_RATE_HZ     10
+#define ACTIGRAPHY_MAX_RATE_HZ     1000
+
+#define ACTIGRAPHY_HIGH_PASS_HZ    0.25f
+#define ACTIGRAPHY_LOW_PASS_HZ     3.0f
+
+// Raw counts per g at the +-2 g range
+#define ACTIGRAPHY_COUNTS_PER_G    16384
+
+// Scoring window: 4 past epochs, the scored one and 2 future epochs
+#define ACTIGRAPHY_WINDOW_PAST     4
+#define ACTIGRAPHY_WINDOW_FUTURE   2
+#define ACTIGRAPHY_WINDOW          (ACTIGRAPHY_WINDOW_PAST + 1 + ACTIGRAPHY_WINDOW_FUTURE)
+
+#define ACTIGRAPHY_WAKE_MG         15
+#define ACTIGRAPHY_DEEP_MG         4
+// Deep sleep also needs few zero crossings for at least 5 minutes
+#define ACTIGRAPHY_DEEP_MAX_CROSSINGS 10
+#define ACTIGRAPHY_DEEP_MIN_EPOCHS 10
+
+// Zero crossings count from above +band to below -band and back
+#define ACTIGRAPHY_CROSSING_BAND   (ACTIGRAPHY_COUNTS_PER_G / 100)
+#define ACTIGRAPHY_ABOVE_THRESHOLD (ACTIGRAPHY_COUNTS_PER_G / 50)
+
+struct SleepStage {
+  static const uint8_t UNKNOWN = 0;
+  static const uint8_t WAKE = 1;
+  static const uint8_t LIGHT = 2;
+  static const uint8_t DEEP = 3;
+};
+
+struct ActigraphyEpoch {
+  uint32_t index;              // epoch number since reset()
+  uint16_t activity_mg;        // mean band-passed magnitude
+  uint16_t zero_crossings;
+  uint16_t time_above_samples; // samples above ACTIGRAPHY_ABOVE_THRESHOLD
+  uint8_t stage;               // stage of epoch index - ACTIGRAPHY_WINDOW_FUTURE
+};
+
+class Actigraphy {
+  private:
+    // Filter state, magnitudes with 4 fractional bits
+    int32_t previous_magnitude;
+    int32_t high_pass;
+    int32_t band_pass;
+    bool primed;
+    int8_t crossing_side;
+
+    uint32_t activity_sum;
+    uint16_t zero_crossings;
+    uint16_t time_above;
+    uint16_t samples;
+
+    float sample_rate_hz;
+    uint16_t epoch_samples;
+    int32_t high_pass_q15;
+    int32_t low_pass_q15;
+
+    uint32_t epoch_index;
+    uint16_t window_activity[ACTIGRAPHY_WINDOW];
+    uint16_t window_crossings[ACTIGRAPHY_WINDOW];
+    uint8_t window_count;
+    uint8_t still_epochs;
+
+    ActigraphyEpoch last_epoch;
+
+    void finishEpoch();
+    uint8_t scoreWindow();
+
+  public:
+    Actigraphy();
+
+    void reset();
+
+    // Derives the filter coefficients and the epoch length from the rate
+    // of the samples. Rates outside ACTIGRAPHY_MIN/MAX_RATE_HZ are rejected
+    // and keep the previous rate. Call reset() afterwards.
+    bool setSampleRate(float rate_hz);
+
+    float getSampleRate() const { return sample_rate_hz; }
+
+    uint16_t getEpochSamples() const { return epoch_samples; }
+
+    // One sample in raw counts at the configured rate, returns true
+    // when it completed an epoch, see getLastEpoch()
+    bool addSample(int16_t x, int16_t y, int16_t z);
+
+    const ActigraphyEpoch& getLastEpoch() const { return last_epoch; }
+
+    uint8_t getStage() const { return last_epoch.stage; }
+};
+
+#endif
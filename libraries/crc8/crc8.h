@@ -0,0 +1,90 @@
+#ifndef CRC8_H
+#define CRC8_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-8 with polynomial 0x31 (x^8 + x^5 + x^4 + 1) as used by the
+// Sensirion SHT3x (init 0xFF) and the Silabs Si7021 (init 0x00).
+// The lookup table is generated at compile time, so checking a
+// measurement costs one table lookup per byte.
+
+#define CRC8_POLYNOMIAL  0x31
+#define CRC8_INIT_SHT30  0xFF
+#define CRC8_INIT_SI7021 0x00
+
+// 1: 16 entry nibble table (two lookups per byte) instead of 256 entries
+#ifndef CRC8_NIBBLE_TABLE
+#define CRC8_NIBBLE_TABLE 0
+#endif
+
+// Reference implementation, one bit at a time
+constexpr uint8_t crc8ShiftBits(uint8_t crc, uint8_t bits) {
+  for (uint8_t bit = 0; bit < bits; bit++) {
+    crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ CRC8_POLYNOMIAL) : (uint8_t)(crc << 1);
+  }
+  return crc;
+}
+
+constexpr uint8_t crc8UpdateBitwise(uint8_t crc, uint8_t data) {
+  return crc8ShiftBits(crc ^ data, 8);
+}
+
+#if CRC8_NIBBLE_TABLE
+#define CRC8_TABLE_SIZE 16
+#else
+#define CRC8_TABLE_SIZE 256
+#endif
+
+struct Crc8Table {
+  uint8_t entries[CRC8_TABLE_SIZE];
+
+  constexpr Crc8Table() : entries() {
+    for (unsigned i = 0; i < CRC8_TABLE_SIZE; i++) {
+#if CRC8_NIBBLE_TABLE
+      entries[i] = crc8ShiftBits(i << 4, 4);
+#else
+      entries[i] = crc8ShiftBits(i, 8);
+#endif
+    }
+  }
+};
+
+inline constexpr Crc8Table CRC8_TABLE;
+
+constexpr uint8_t crc8Update(uint8_t crc, uint8_t data) {
+  crc ^= data;
+#if CRC8_NIBBLE_TABLE
+  crc = (uint8_t)(crc << 4) ^ CRC8_TABLE.entries[crc >> 4];
+  crc = (uint8_t)(crc << 4) ^ CRC8_TABLE.entries[crc >> 4];
+  return crc;
+#else
+  return CRC8_TABLE.entries[crc];
+#endif
+}
+
+constexpr uint8_t crc8(const uint8_t* data, size_t length, uint8_t init) {
+  uint8_t crc = init;
+  for (size_t i = 0; i < length; i++) {
+    crc = crc8Update(crc, data[i]);
+  }
+  return crc;
+}
+
+// Checks words stored as [MSB, LSB, CRC] one after another, e.g. the six
+// bytes of a temperature + humidity measurement, in a single pass
+constexpr bool crc8CheckWords(const uint8_t* data, size_t words, uint8_t init) {
+  for (size_t i = 0; i < words; i++, data += 3) {
+    if (crc8Update(crc8Update(init, data[0]), data[1]) != data[2]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Example from the SHT3x datasheet: 0xBEEF has the checksum 0x92
+inline constexpr uint8_t CRC8_SHT30_EXAMPLE[] = {0xBE, 0xEF, 0x92};
+static_assert(crc8(CRC8_SHT30_EXAMPLE, 2, CRC8_INIT_SHT30) == 0x92, "CRC-8 does not match the SHT3x datasheet");
+static_assert(crc8CheckWords(CRC8_SHT30_EXAMPLE, 1, CRC8_INIT_SHT30), "CRC-8 word check failed");
+
+#endif
@@ -0,0 +1,340 @@
+#include "i2c_async.h"
+#include "em_core.h"
+#include <string.h>
+
+#define I2C_ASYNC_INDEX(counter) ((counter) & (I2C_ASYNC_QUEUE_SIZE - 1))
+
+I2CAsync i2cAsync;
+
+#if I2C_ASYNC_OWN_IRQ
+extern "C" void I2C0_IRQHandler(void) {
+  i2cAsync.handleInterrupt();
+}
+
+extern "C" void I2C1_IRQHandler(void) {
+  i2cAsync.handleInterrupt();
+}
+#endif
+
+I2CAsync::I2CAsync() {
+  i2c = NULL;
+  irq = I2C0_IRQn;
+  running = false;
+  head = 0;
+  active = 0;
+  tail = 0;
+  started_at = 0;
+  watchdog_polls = 0;
+  blocking_pending = false;
+  error_count = 0;
+  timeout_count = 0;
+}
+
+int I2CAsync::begin(I2C_TypeDef* peripheral) {
+  if (running) {
+    return 0;
+  }
+
+  if (peripheral == I2C0) {
+    irq = I2C0_IRQn;
+  } else if (peripheral == I2C1) {
+    irq = I2C1_IRQn;
+  } else {
+    return 1;
+  }
+
+  i2c = peripheral;
+  head = 0;
+  active = 0;
+  tail = 0;
+  blocking_pending = false;
+
+  I2C_IntDisable(i2c, _I2C_IEN_MASK);
+  I2C_IntClear(i2c, _I2C_IF_MASK);
+  NVIC_ClearPendingIRQ(irq);
+#if I2C_ASYNC_OWN_IRQ
+  NVIC_EnableIRQ(irq);
+#else
+  // Wire's handler must not see the transfers, they are polled
+  NVIC_DisableIRQ(irq);
+#endif
+
+  running = true;
+  i2cTransferHook = blockingTransfer;
+  return 0;
+}
+
+void I2CAsync::end() {
+  if (!running) {
+    return;
+  }
+
+  // The watchdog bounds this
+  while (!isIdle()) {
+    service();
+  }
+
+#if I2C_ASYNC_OWN_IRQ
+  NVIC_DisableIRQ(irq);
+#else
+  I2C_IntClear(i2c, _I2C_IF_MASK);
+  NVIC_ClearPendingIRQ(irq);
+  NVIC_EnableIRQ(irq);
+#endif
+  i2cTransferHook = NULL;
+  running = false;
+}
+
+int I2CAsync::submit(uint8_t address, const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length,
+                     I2CAsyncCallback callback, void* context) {
+  if (!running || tx_length > I2C_ASYNC_MAX_TX) {
+    return -1;
+  }
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_ATOMIC();
+
+  if ((uint8_t)(tail - head) >= I2C_ASYNC_QUEUE_SIZE) {
+    CORE_EXIT_ATOMIC();
+    return -1;
+  }
+
+  I2CTransaction& transaction = queue[I2C_ASYNC_INDEX(tail)];
+  transaction.address = address;
+  if (tx_length > 0) {
+    memcpy(transaction.tx, tx, tx_length);
+  }
+  transaction.tx_length = tx_length;
+  transaction.rx = rx;
+  transaction.rx_length = rx_length;
+  transaction.callback = callback;
+  transaction.context = context;
+  transaction.result = I2C_OK;
+
+  // A blocking transfer on the bus starts the queue once it is done
+  bool idle = active == tail && !blocking_pending;
+  tail++;
+  if (idle) {
+    startNext();
+  }
+
+  CORE_EXIT_ATOMIC();
+  return 0;
+}
+
+int I2CAsync::service() {
+  int handled = 0;
+
+  if (!running) {
+    return 0;
+  }
+
+  poll();
+
+  // The slot is free again once head moved on, a callback may refill it
+  while (head != active) {
+    const I2CTransaction& transaction = queue[I2C_ASYNC_INDEX(head)];
+    I2CAsyncCallback callback = transaction.callback;
+    void* context = transaction.context;
+    uint8_t result = transaction.result;
+
+    head++;
+    if (callback != NULL) {
+      callback(result, context);
+    }
+    handled++;
+  }
+
+  return handled;
+}
+
+void I2CAsync::checkTimeout() {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_ATOMIC();
+  bool busy = blocking_pending || active != tail;
+#if !I2C_ASYNC_OWN_IRQ
+  if (busy && watchdog_polls > 0) {
+    watchdog_polls--;
+    busy = false;
+  }
+#endif
+  if (busy && millis() - started_at >= I2C_ASYNC_TIMEOUT_MS) {
+    i2c->CMD = I2C_CMD_ABORT;
+    I2C_IntDisable(i2c, _I2C_IEN_MASK);
+    I2C_IntClear(i2c, _I2C_IF_MASK);
+    timeout_count++;
+    complete(I2C_ERROR_TIMEOUT);
+  }
+  CORE_EXIT_ATOMIC();
+}
+
+void I2CAsync::poll() {
+#if !I2C_ASYNC_OWN_IRQ
+  // A transfer that ended while nobody polled completes instead of
+  // being aborted
+  handleInterrupt();
+#endif
+  checkTimeout();
+}
+
+uint8_t I2CAsync::transfer(uint8_t address, const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length) {
+  if (!running || tx_length > I2C_ASYNC_MAX_TX) {
+    return I2C_ERROR_BUS;
+  }
+
+  // The queued transactions are clocked out first, the watchdog bounds
+  // each of them. Their callbacks run from service() later.
+  while (active != tail) {
+    poll();
+  }
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_ATOMIC();
+  blocking.address = address;
+  if (tx_length > 0) {
+    memcpy(blocking.tx, tx, tx_length);
+  }
+  blocking.tx_length = tx_length;
+  blocking.rx = rx;
+  blocking.rx_length = rx_length;
+  blocking.callback = NULL;
+  blocking.context = NULL;
+  blocking.result = I2C_OK;
+  blocking_pending = true;
+
+  I2C_TransferReturn_TypeDef status = start(blocking);
+  if (status != i2cTransferInProgress) {
+    complete(transferError(status, sequence.flags));
+  }
+  CORE_EXIT_ATOMIC();
+
+  while (blocking_pending) {
+    poll();
+  }
+
+  return blocking.result;
+}
+
+void I2CAsync::handleInterrupt() {
+  if (active == tail && !blocking_pending) {
+    I2C_IntDisable(i2c, _I2C_IEN_MASK);
+    I2C_IntClear(i2c, _I2C_IF_MASK);
+    return;
+  }
+
+  I2C_TransferReturn_TypeDef status = I2C_Transfer(i2c);
+  if (status == i2cTransferInProgress) {
+    return;
+  }
+
+  complete(transferError(status, sequence.flags));
+}
+
+void I2CAsync::startNext() {
+  while (active != tail) {
+    I2C_TransferReturn_TypeDef status = start(queue[I2C_ASYNC_INDEX(active)]);
+    if (status == i2cTransferInProgress) {
+      return;
+    }
+
+    finish(transferError(status, sequence.flags));
+  }
+}
+
+I2C_TransferReturn_TypeDef I2CAsync::start(I2CTransaction& transaction) {
+  sequence.addr = transaction.address << 1;
+  if (transaction.tx_length > 0 && transaction.rx_length > 0) {
+    sequence.flags = I2C_FLAG_WRITE_READ;
+    sequence.buf[0].data = transaction.tx;
+    sequence.buf[0].len = transaction.tx_length;
+    sequence.buf[1].data = transaction.rx;
+    sequence.buf[1].len = transaction.rx_length;
+  } else if (transaction.rx_length > 0) {
+    sequence.flags = I2C_FLAG_READ;
+    sequence.buf[0].data = transaction.rx;
+    sequence.buf[0].len = transaction.rx_length;
+  } else {
+    // An empty write is the address only, see I2CRegisters::probe()
+    sequence.flags = I2C_FLAG_WRITE;
+    sequence.buf[0].data = transaction.tx;
+    sequence.buf[0].len = transaction.tx_length;
+  }
+
+  // Enables the peripheral interrupts, I2C_Transfer() takes it from there
+  started_at = millis();
+  watchdog_polls = I2C_ASYNC_TIMEOUT_POLLS + transaction.tx_length + transaction.rx_length;
+  return I2C_TransferInit(i2c, &sequence);
+}
+
+void I2CAsync::complete(uint8_t result) {
+  if (blocking_pending) {
+    blocking.result = result;
+    if (result != I2C_OK) {
+      error_count++;
+    }
+    blocking_pending = false;
+  } else {
+    finish(result);
+  }
+  startNext();
+}
+
+void I2CAsync::finish(uint8_t result) {
+  queue[I2C_ASYNC_INDEX(active)].result = result;
+  if (result != I2C_OK) {
+    error_count++;
+  }
+  active++;
+}
+
+// emlib does not tell which phase was NACKed. A device NACKs its read
+// header while it has no result, so a NACK of anything that reads counts
+// as I2C_ERROR_NO_DATA; a missing device shows up on its writes.
+uint8_t I2CAsync::transferError(I2C_TransferReturn_TypeDef status, uint16_t flags) {
+  switch (status) {
+    case i2cTransferDone:
+      return I2C_OK;
+    case i2cTransferNack:
+      return flags == I2C_FLAG_WRITE ? I2C_ERROR_NACK : I2C_ERROR_NO_DATA;
+    default:
+      return I2C_ERROR_BUS;
+  }
+}
+
+uint8_t I2CAsync::blockingTransfer(uint8_t address, const uint8_t* tx, uint8_t tx_length,
+                                   uint8_t* rx, uint8_t rx_length) {
+  return i2cAsync.transfer(address, tx, tx_length, rx, rx_length);
+}
+
+bool I2CAsyncRequest::submit(uint8_t address, const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length) {
+  if (state != IDLE) {
+    return false;
+  }
+
+  discard = false;
+  state = BUSY;
+  if (i2cAsync.submit(address, tx, tx_length, rx, rx_length, complete, this) != 0) {
+    state = IDLE;
+    return false;
+  }
+  return true;
+}
+
+uint8_t I2CAsyncRequest::take() {
+  state = IDLE;
+  return result;
+}
+
+void I2CAsyncRequest::cancel() {
+  if (state == BUSY) {
+    discard = true;
+  } else {
+    state = IDLE;
+  }
+}
+
+void I2CAsyncRequest::complete(uint8_t result, void* context) {
+  I2CAsyncRequest* request = (I2CAsyncRequest*)context;
+  request->result = result;
+  request->state = request->discard ? IDLE : DONE;
+}
@@ -0,0 +1,179 @@
+#ifndef I2C_ASYNC_H
+#define I2C_ASYNC_H
+
+#include <Arduino.h>
+#include "em_i2c.h"
+#include "i2c_register.h"
+
+// Queued I2C transactions on the peripheral Wire was set up on.
+//
+// submit() queues a transaction and returns at once, the transfer is
+// advanced by the I2C interrupt or by polling (I2C_ASYNC_OWN_IRQ) and the
+// next queued one starts right after the STOP, so loop() only pays for
+// queueing. Transactions run in the order they were submitted and
+// service() runs their callbacks in that same order, from loop() context.
+// A failed transaction reports its I2C_ERROR_* code to its own callback,
+// the ones queued behind it still run.
+//
+// While the queue is running the blocking I2CRegisters calls go through
+// transfer(): it lets the queued transactions finish on the bus, then runs
+// its own one outside the queue. It never runs callbacks, so a callback
+// may use the blocking calls as well.
+
+// 1: the library defines I2C0_IRQHandler and I2C1_IRQHandler and the
+// interrupt advances the transfers. These replace the handlers of the
+// core, Wire must not be used any more after begin(), not even after
+// end(). 0: begin() masks the I2C interrupt, service() and transfer()
+// advance the transfers by polling and end() hands the interrupt back
+// to Wire.
+//
+// Polled is the default and what the sketches get, the flag has to be
+// set for the library build. The queue then only moves while service()
+// or transfer() runs: each service() advances the transfer on the bus by
+// a step, so queued reads finish about a loop() pass per step later and
+// nothing runs while loop() is busy elsewhere. The watchdog allows for
+// that, see I2C_ASYNC_TIMEOUT_POLLS.
+#ifndef I2C_ASYNC_OWN_IRQ
+#define I2C_ASYNC_OWN_IRQ 0
+#endif
+
+// Power of two, the queue indices wrap at 256
+#define I2C_ASYNC_QUEUE_SIZE 8
+// Longest write phase, the bytes are copied into the queue
+#define I2C_ASYNC_MAX_TX     4
+// A transaction still on the bus after this is aborted, above the 23 ms
+// the SI7021 may stretch the clock in hold mode
+#define I2C_ASYNC_TIMEOUT_MS 50
+// Polled, a transaction is only aborted once it also had this many polls
+// plus one per byte, each of them a chance to advance it. A loop() slower
+// than the timeout then stretches the watchdog instead of tripping it.
+#define I2C_ASYNC_TIMEOUT_POLLS 8
+
+typedef void (*I2CAsyncCallback)(uint8_t result, void* context);
+
+struct I2CTransaction {
+  uint8_t address;
+  uint8_t tx[I2C_ASYNC_MAX_TX];
+  uint8_t tx_length;
+  uint8_t* rx;
+  uint8_t rx_length;
+  I2CAsyncCallback callback;
+  void* context;
+  uint8_t result;
+};
+
+class I2CAsync {
+  private:
+    I2C_TypeDef* i2c;
+    IRQn_Type irq;
+    bool running;
+
+    I2CTransaction queue[I2C_ASYNC_QUEUE_SIZE];
+    I2C_TransferSeq_TypeDef sequence;
+
+    // The transfer() on the bus instead of the active queue slot
+    I2CTransaction blocking;
+    volatile bool blocking_pending;
+
+    // head: oldest transaction whose callback has not run yet
+    // active: transaction on the bus, equal to tail while the bus is idle
+    // tail: next free slot
+    volatile uint8_t head;
+    volatile uint8_t active;
+    volatile uint8_t tail;
+    volatile unsigned long started_at;
+    // Polls the transfer on the bus gets before the watchdog may fire
+    volatile uint16_t watchdog_polls;
+
+    volatile unsigned long error_count;
+    unsigned long timeout_count;
+
+    // Called with the interrupt masked or from the interrupt itself
+    void startNext();
+    I2C_TransferReturn_TypeDef start(I2CTransaction& transaction);
+    // Ends the blocking transfer or the active slot, then starts the next
+    void complete(uint8_t result);
+    void finish(uint8_t result);
+
+    // Aborts a transfer on the bus for longer than I2C_ASYNC_TIMEOUT_MS,
+    // polled only once its I2C_ASYNC_TIMEOUT_POLLS are used up as well
+    void checkTimeout();
+    // Watchdog, and without I2C_ASYNC_OWN_IRQ advances the transfer
+    void poll();
+
+    static uint8_t transferError(I2C_TransferReturn_TypeDef status, uint16_t flags);
+    static uint8_t blockingTransfer(uint8_t address, const uint8_t* tx, uint8_t tx_length,
+                                    uint8_t* rx, uint8_t rx_length);
+
+  public:
+    I2CAsync();
+
+    // Takes over the transfers of a peripheral Wire.begin() already routed
+    // and clocked. Returns 0 on success.
+    int begin(I2C_TypeDef* peripheral = I2C0);
+
+    // Lets the queue drain, then hands the bus back to Wire, see
+    // I2C_ASYNC_OWN_IRQ
+    void end();
+
+    bool isRunning() const { return running; }
+
+    // Queues tx, then a repeated start and rx_length bytes into rx. Either
+    // part may be empty, rx has to stay valid until the callback ran.
+    // Returns 0, or -1 if the queue is full or the write is too long.
+    int submit(uint8_t address, const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length,
+               I2CAsyncCallback callback, void* context);
+
+    // Runs the callbacks of finished transactions and aborts a stuck one,
+    // call once per loop(). Returns the number of callbacks run.
+    int service();
+
+    // Waits until the queue is off the bus, then runs the transaction
+    // until it finished. Runs no callbacks.
+    uint8_t transfer(uint8_t address, const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length);
+
+    bool isIdle() const { return head == tail; }
+
+    uint8_t getQueued() const { return (uint8_t)(tail - head); }
+
+    unsigned long getErrorCount() const { return error_count; }
+
+    unsigned long getTimeoutCount() const { return timeout_count; }
+
+    // I2C interrupt, advances the transfer on the bus. Without
+    // I2C_ASYNC_OWN_IRQ it is polled instead.
+    void handleInterrupt();
+};
+
+extern I2CAsync i2cAsync;
+
+// One outstanding transaction of a driver, for drivers that poll: the
+// ready check submits it and looks again on the next call.
+class I2CAsyncRequest {
+  private:
+    static const uint8_t IDLE = 0;
+    static const uint8_t BUSY = 1;
+    static const uint8_t DONE = 2;
+
+    uint8_t state = IDLE;
+    bool discard = false;
+    uint8_t result = I2C_OK;
+
+    static void complete(uint8_t result, void* context);
+
+  public:
+    // Returns false if one is still in flight or the queue is full
+    bool submit(uint8_t address, const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length);
+
+    bool isBusy() const { return state == BUSY; }
+
+    bool isDone() const { return state == DONE; }
+
+    // Result of the finished transaction, the request is free afterwards
+    uint8_t take();
+
+    // Drops the result of the transaction in flight or not yet taken
+    void cancel();
+};
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef I2C_REGISTER_H
+#define I2C_REGISTER_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// Register access shared by the I2C sensor drivers.
+//
+// A read writes the register or command and continues with a repeated
+// start into the read phase, so it is one transaction: START, address,
+// register, repeated START, address, data, STOP. Values wider than a byte
+// are assembled in the byte order given as template argument. Everything
+// returns I2C_OK or one of the I2C_ERROR_* codes, the drivers map them to
+// their own error values.
+
+#define I2C_OK            0
+#define I2C_ERROR_NACK    1  // address or a written byte not acknowledged
+#define I2C_ERROR_NO_DATA 2  // read header not acknowledged, e.g. result not ready
+#define I2C_ERROR_SHORT   3  // the device sent fewer bytes than requested
+#define I2C_ERROR_BUS     4  // any other endTransmission() failure
+#define I2C_ERROR_TIMEOUT 5  // aborted by the I2CAsync watchdog
+
+// Counts the bus conditions of every transfer, for the benchmark sketch.
+// The drivers are compiled separately, so set it for the whole build
+// (e.g. compiler.cpp.extra_flags=-DI2C_REGISTER_STATS=1).
+#ifndef I2C_REGISTER_STATS
+#define I2C_REGISTER_STATS 0
+#endif
+
+struct I2CByteOrder {
+  static const uint8_t LSB_FIRST = 0;
+  static const uint8_t MSB_FIRST = 1;
+};
+
+struct I2CBusStats {
+  uint32_t starts;           // including repeated starts
+  uint32_t repeated_starts;
+  uint32_t stops;
+  uint32_t bytes;            // address, written and read bytes
+};
+
+inline I2CBusStats i2cBusStats = {0, 0, 0, 0};
+
+inline void i2cResetBusStats() {
+  i2cBusStats = {0, 0, 0, 0};
+}
+
+// Set while I2CAsync owns the peripheral: the blocking calls then go
+// through its queue instead of Wire, so they never collide with a
+// transfer in flight. Without rx_length the write ends with a STOP.
+typedef uint8_t (*I2CTransferHook)(uint8_t address, const uint8_t* tx, uint8_t tx_length,
+                                   uint8_t* rx, uint8_t rx_length);
+
+inline I2CTransferHook i2cTransferHook = NULL;
+
+class I2CRegisters {
+  private:
+    uint8_t address;
+    TwoWire* wire;
+
+    static uint8_t transmitError(uint8_t result) {
+      if (result == 0) {
+        return I2C_OK;
+      }
+      return result == 2 || result == 3 ? I2C_ERROR_NACK : I2C_ERROR_BUS;
+    }
+
+    static void count(uint8_t starts, uint8_t repeated, uint8_t stops, uint8_t bytes) {
+#if I2C_REGISTER_STATS
+      i2cBusStats.starts += starts;
+      i2cBusStats.repeated_starts += repeated;
+      i2cBusStats.stops += stops;
+      i2cBusStats.bytes += bytes;
+#else
+      (void)starts;
+      (void)repeated;
+      (void)stops;
+      (void)bytes;
+#endif
+    }
+
+  public:
+    explicit I2CRegisters(uint8_t address, TwoWire& wire = Wire) : address(address), wire(&wire) {}
+
+    uint8_t getAddress() const { return address; }
+
+    // Writes tx, then reads rx_length bytes after a repeated start. Without
+    // rx_length the write ends with a STOP, without tx_length it is a plain read.
+    uint8_t transfer(const uint8_t* tx, uint8_t tx_length, uint8_t* rx, uint8_t rx_length) {
+      if (i2cTransferHook != NULL) {
+        count(tx_length > 0 && rx_length > 0 ? 2 : 1, tx_length > 0 && rx_length > 0 ? 1 : 0, 1,
+              (tx_length > 0 ? 1 + tx_length : 0) + (rx_length > 0 ? 1 + rx_length : 0));
+        return i2cTransferHook(address, tx, tx_length, rx, rx_length);
+      }
+
+      if (tx_length > 0) {
+        wire->beginTransmission(address);
+        wire->write(tx, tx_length);
+        uint8_t result = transmitError(wire->endTransmission(rx_length == 0));
+        count(1, 0, rx_length == 0 ? 1 : 0, 1 + tx_length);
+        if (result != I2C_OK || rx_length == 0) {
+          return result;
+        }
+      }
+
+      uint8_t received = wire->requestFrom(address, rx_length);
+      count(1, tx_length > 0 ? 1 : 0, 1, 1 + received);
+      for (uint8_t i = 0; i < received && i < rx_length; i++) {
+        rx[i] = wire->read();
+      }
+
+      // A NACKed read header returns nothing at all
+      if (received == 0) {
+        return I2C_ERROR_NO_DATA;
+      }
+      return received == rx_length ? I2C_OK : I2C_ERROR_SHORT;
+    }
+
+    // Register or command of one byte, then a burst of length bytes
+    uint8_t read(uint8_t reg, uint8_t* buffer, uint8_t length) {
+      return transfer(&reg, 1, buffer, length);
+    }
+
+    // 16 bit command sent MSB first, then a burst of length bytes
+    uint8_t readCommand(uint16_t command, uint8_t* buffer, uint8_t length) {
+      uint8_t tx[2] = {(uint8_t)(command >> 8), (uint8_t)command};
+      return transfer(tx, 2, buffer, length);
+    }
+
+    // Read phase only, for results of an earlier command
+    uint8_t receive(uint8_t* buffer, uint8_t length) {
+      return transfer(NULL, 0, buffer, length);
+    }
+
+    uint8_t write(const uint8_t* data, uint8_t length) {
+      if (i2cTransferHook != NULL) {
+        count(1, 0, 1, 1 + length);
+        return i2cTransferHook(address, data, length, NULL, 0);
+      }
+
+      wire->beginTransmission(address);
+      wire->write(data, length);
+      uint8_t result = transmitError(wire->endTransmission());
+      count(1, 0, 1, 1 + length);
+      return result;
+    }
+
+    uint8_t writeByte(uint8_t value) {
+      return write(&value, 1);
+    }
+
+    uint8_t writeCommand(uint16_t command) {
+      uint8_t tx[2] = {(uint8_t)(command >> 8), (uint8_t)command};
+      return write(tx, 2);
+    }
+
+    // Address only, I2C_OK if a device acknowledges it
+    uint8_t probe() {
+      return write(NULL, 0);
+    }
+
+    // Typed register reads and writes, T is uint8_t, uint16_t or uint32_t
+    template <typename T, uint8_t order>
+    uint8_t readValue(uint8_t reg, T* value) {
+      uint8_t data[sizeof(T)];
+      uint8_t result = read(reg, data, sizeof(T));
+      if (result != I2C_OK) {
+        return result;
+      }
+
+      *value = 0;
+      for (uint8_t i = 0; i < sizeof(T); i++) {
+        uint8_t next = order == I2CByteOrder::MSB_FIRST ? data[i] : data[sizeof(T) - 1 - i];
+        *value = (T)((*value << 8) | next);
+      }
+      return I2C_OK;
+    }
+
+    template <typename T, uint8_t order>
+    uint8_t writeValue(uint8_t reg, T value) {
+      uint8_t data[1 + sizeof(T)];
+      data[0] = reg;
+      for (uint8_t i = 0; i < sizeof(T); i++) {
+        uint8_t shift = 8 * (order == I2CByteOrder::MSB_FIRST ? sizeof(T) - 1 - i : i);
+        data[1 + i] = (uint8_t)(value >> shift);
+      }
+      return write(data, sizeof(data));
+    }
+
+    uint8_t readU8(uint8_t reg, uint8_t* value) { return readValue<uint8_t, I2CByteOrder::MSB_FIRST>(reg, value); }
+    uint8_t readU16LE(uint8_t reg, uint16_t* value) { return readValue<uint16_t, I2CByteOrder::LSB_FIRST>(reg, value); }
+    uint8_t readU16BE(uint8_t reg, uint16_t* value) { return readValue<uint16_t, I2CByteOrder::MSB_FIRST>(reg, value); }
+    uint8_t writeU8(uint8_t reg, uint8_t value) { return writeValue<uint8_t, I2CByteOrder::MSB_FIRST>(reg, value); }
+    uint8_t writeU16LE(uint8_t reg, uint16_t value) { return writeValue<uint16_t, I2CByteOrder::LSB_FIRST>(reg, value); }
+    uint8_t writeU16BE(uint8_t reg, uint16_t value) { return writeValue<uint16_t, I2CByteOrder::MSB_FIRST>(reg, value); }
+};
+
+#endif
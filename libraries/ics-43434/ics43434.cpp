@@ -1,15 +1,136 @@
 #include "ics43434.h"
 #include "pins_arduino.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_usart.h"
+#include "dmadrv.h"
+
+// Arduino pin numbers encode the GPIO port in the upper bits
+#define MIC_PORT(pin) ((GPIO_Port_TypeDef)((pin) >> 4))
+#define MIC_PIN(pin)  ((pin) & 0x0F)
+
+ICS43434::ICS43434() {
+    dma_channel = 0;
+    blocks_filled = 0;
+    blocks_consumed = 0;
+    overruns = 0;
+    running = false;
+    block_fn = NULL;
+    block_context = NULL;
+}
+
+int ICS43434::init(uint32_t sample_rate) {
+    if (running) {
+        end();
+    }
 
-void ICS43434::init(){
     pinMode(PIN_MIC_ENABLE, OUTPUT);
     digitalWrite(PIN_MIC_ENABLE, HIGH);
-    pinMode(MIC_SCK, OUTPUT);
-    pinMode(MIC_SD, INPUT);
-    pinMode(MIC_WS, OUTPUT);
-    delay(100);
 
-    while(1){
+    CMU_ClockEnable(cmuClock_GPIO, true);
+    CMU_ClockEnable(cmuClock_USART0, true);
+
+    GPIO_PinModeSet(MIC_PORT(MIC_SCK), MIC_PIN(MIC_SCK), gpioModePushPull, 0);
+    GPIO_PinModeSet(MIC_PORT(MIC_WS), MIC_PIN(MIC_WS), gpioModePushPull, 0);
+    GPIO_PinModeSet(MIC_PORT(MIC_SD), MIC_PIN(MIC_SD), gpioModeInput, 0);
+
+    // WS comes from the automatic chip select of the I2S frame
+    USART_InitI2s_TypeDef i2s = USART_INITI2S_DEFAULT;
+    i2s.sync.enable = usartDisable;
+    i2s.sync.baudrate = sample_rate * ICS43434_BITS_PER_FRAME;
+    i2s.sync.databits = usartDatabits8;
+    i2s.sync.master = true;
+    i2s.sync.msbf = true;
+    i2s.sync.autoTx = true;
+    i2s.sync.autoCsEnable = true;
+    i2s.format = usartI2sFormatW32D24;
+    i2s.justify = usartI2sJustifyLeft;
+    i2s.delay = true;
+    i2s.dmaSplit = false;
+    i2s.mono = true;
+    USART_InitI2s(USART0, &i2s);
+
+    GPIO->USARTROUTE[USART_NUM(USART0)].RXROUTE = (MIC_PORT(MIC_SD) << _GPIO_USART_RXROUTE_PORT_SHIFT) |
+                                                  (MIC_PIN(MIC_SD) << _GPIO_USART_RXROUTE_PIN_SHIFT);
+    GPIO->USARTROUTE[USART_NUM(USART0)].CLKROUTE = (MIC_PORT(MIC_SCK) << _GPIO_USART_CLKROUTE_PORT_SHIFT) |
+                                                   (MIC_PIN(MIC_SCK) << _GPIO_USART_CLKROUTE_PIN_SHIFT);
+    GPIO->USARTROUTE[USART_NUM(USART0)].CSROUTE = (MIC_PORT(MIC_WS) << _GPIO_USART_CSROUTE_PORT_SHIFT) |
+                                                  (MIC_PIN(MIC_WS) << _GPIO_USART_CSROUTE_PIN_SHIFT);
+    GPIO->USARTROUTE[USART_NUM(USART0)].ROUTEEN = GPIO_USART_ROUTEEN_RXPEN | GPIO_USART_ROUTEEN_CLKPEN |
+                                                  GPIO_USART_ROUTEEN_CSPEN;
+
+    Ecode_t result = DMADRV_Init();
+    if (result != ECODE_EMDRV_DMADRV_OK && result != ECODE_EMDRV_DMADRV_ALREADY_INITIALIZED) {
+        return 1;
+    }
+    if (DMADRV_AllocateChannel(&dma_channel, NULL) != ECODE_EMDRV_DMADRV_OK) {
+        return 1;
+    }
+
+    blocks_filled = 0;
+    blocks_consumed = 0;
+
+    // Two linked descriptors, the LDMA switches buffers on its own
+    if (DMADRV_PeripheralMemoryPingPong(dma_channel, dmadrvPeripheralSignal_USART0_RXDATAV,
+                                        buffers[0], buffers[1], (void*)&USART0->RXDATA, true,
+                                        ICS43434_BLOCK_SAMPLES * 3, dmadrvDataSize1, dmaBlockDone, this) != ECODE_EMDRV_DMADRV_OK) {
+        DMADRV_FreeChannel(dma_channel);
+        return 1;
+    }
+
+    USART_Enable(USART0, usartEnableRx);
+    running = true;
+    return 0;
+}
+
+void ICS43434::end() {
+    if (running) {
+        USART_Enable(USART0, usartDisable);
+        DMADRV_StopTransfer(dma_channel);
+        DMADRV_FreeChannel(dma_channel);
+        USART_Reset(USART0);
+        GPIO->USARTROUTE[USART_NUM(USART0)].ROUTEEN = 0;
+        CMU_ClockEnable(cmuClock_USART0, false);
+        running = false;
+    }
+
+    GPIO_PinModeSet(MIC_PORT(MIC_SCK), MIC_PIN(MIC_SCK), gpioModeDisabled, 0);
+    GPIO_PinModeSet(MIC_PORT(MIC_WS), MIC_PIN(MIC_WS), gpioModeDisabled, 0);
+    GPIO_PinModeSet(MIC_PORT(MIC_SD), MIC_PIN(MIC_SD), gpioModeDisabled, 0);
+    digitalWrite(PIN_MIC_ENABLE, LOW);
+}
+
+void ICS43434::setBlockCallback(ICS43434BlockFn fn, void* context) {
+    block_fn = fn;
+    block_context = context;
+}
 
+// Runs in the LDMA interrupt, sequence counts the completed blocks from 1
+bool ICS43434::dmaBlockDone(unsigned int, unsigned int sequence, void* context) {
+    ICS43434* mic = (ICS43434*)context;
+    mic->blocks_filled = sequence;
+    return true;
+}
+
+int ICS43434::service() {
+    uint32_t filled = blocks_filled;
+    int handled = 0;
+
+    // Only the block before the one being filled is still intact
+    if (filled - blocks_consumed > 1) {
+        overruns += filled - blocks_consumed - 1;
+        blocks_consumed = filled - 1;
+    }
+
+    while (blocks_consumed != filled) {
+        int32_t* samples = ics43434Unpack24(buffers[blocks_consumed % 2], ICS43434_BLOCK_SAMPLES);
+        blocks_consumed++;
+
+        if (blocks_consumed > ICS43434_STARTUP_BLOCKS && block_fn != NULL) {
+            block_fn(samples, ICS43434_BLOCK_SAMPLES, block_context);
+            handled++;
+        }
     }
-}
\ No newline at end of file
+
+    return handled;
+}
@@ -1,22 +1,60 @@
 #ifndef ICS43434_H
 #define ICS43434_H
 
+#include <Arduino.h>
+#include "ics43434_pcm.h"
 
+// Arduino pin numbers of the I2S lines
 #define MIC_SCK (20)
 #define MIC_SD (21)
 #define MIC_WS (22)
 
-
+// The mic clocks 64 SCK cycles per frame, 24 bit data in the left 32 bit slot
+#define ICS43434_BITS_PER_FRAME      64
+#define ICS43434_DEFAULT_SAMPLE_RATE 16000
+// 16 ms at 16 kHz, the time service() has to pick up a full block
+#define ICS43434_BLOCK_SAMPLES       256
+// The output settles 2^18 SCK cycles after the clock starts, these blocks
+// are dropped
+#define ICS43434_STARTUP_BLOCKS      ((262144 / ICS43434_BITS_PER_FRAME + ICS43434_BLOCK_SAMPLES - 1) / ICS43434_BLOCK_SAMPLES)
+
+// Gets every full block as sign extended 24 bit samples
+typedef void (*ICS43434BlockFn)(const int32_t* samples, size_t count, void* context);
+
+// I2S capture of the ICS-43434 on USART0: the LDMA fills two blocks in
+// turn, so the capture never waits for loop(). service() unpacks each
+// full block in place and hands it to the callback, it has to be called
+// at least once per block time.
 class ICS43434 {
 public:
     ICS43434();
 
-    void init();
+    // Powers the mic and starts the capture, returns 0 on success
+    int init(uint32_t sample_rate = ICS43434_DEFAULT_SAMPLE_RATE);
     void end();
 
+    void setBlockCallback(ICS43434BlockFn fn, void* context);
+
+    // Returns the number of blocks handed to the callback
+    int service();
 
+    bool isRunning() const { return running; }
+    // Blocks overwritten by the DMA before service() got to them
+    unsigned long getOverrunCount() const { return overruns; }
 
 private:
+    // Room for the unpacked int32 samples, the DMA fills the first 3 bytes per sample
+    uint32_t buffers[2][ICS43434_BLOCK_SAMPLES];
+    unsigned int dma_channel;
+    volatile uint32_t blocks_filled;
+    uint32_t blocks_consumed;
+    unsigned long overruns;
+    bool running;
+
+    ICS43434BlockFn block_fn;
+    void* block_context;
+
+    static bool dmaBlockDone(unsigned int channel, unsigned int sequence, void* context);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,28 @@
+#include "ics43434_pcm.h"
+
+int32_t* ics43434Unpack24(void* buffer, size_t count) {
+    const uint8_t* packed = (const uint8_t*)buffer;
+    int32_t* samples = (int32_t*)buffer;
+
+    // Back to front: sample i is written to bytes 4i..4i+3, past the packed
+    // bytes of every sample before it
+    for (size_t i = count; i-- > 0;) {
+        const uint8_t* b = &packed[3 * i];
+        samples[i] = (int32_t)(((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8)) >> 8;
+    }
+
+    return samples;
+}
+
+int16_t* ics43434Unpack24To16(void* buffer, size_t count) {
+    const uint8_t* packed = (const uint8_t*)buffer;
+    int16_t* samples = (int16_t*)buffer;
+
+    // Front to back: sample i ends at byte 2i+1, before its own packed bytes
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* b = &packed[3 * i];
+        samples[i] = (int16_t)(((uint16_t)b[0] << 8) | b[1]);
+    }
+
+    return samples;
+}
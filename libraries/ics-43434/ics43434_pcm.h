@@ -0,0 +1,18 @@
+#ifndef ICS43434_PCM_H
+#define ICS43434_PCM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Unpacking of the 24 bit samples the I2S receiver stores as 3 bytes each,
+// MSB first, at the start of a DMA block. Both conversions work in place
+// on the block, no Arduino headers so they build on a PC too.
+
+// Sign extends count samples into int32 (full scale +-2^23), the buffer
+// must be count * 4 bytes long. Returns the buffer as int32.
+int32_t* ics43434Unpack24(void* buffer, size_t count);
+
+// Keeps the upper 16 bits of count samples, returns the buffer as int16
+int16_t* ics43434Unpack24To16(void* buffer, size_t count);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef INT_MATH_H
+#define INT_MATH_H
+
+#include <stdint.h>
+
+// Integer math shared by the movement kernel and the sensor fusion, for
+// the hot paths that must not pull in the float or double library
+
+// Floor of the square root, bit by bit without a divide
+inline uint32_t isqrt32(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+
+  while (bit > value) {
+    bit >>= 2;
+  }
+
+  while (bit != 0) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  return root;
+}
+
+#endif
@@ -4,6 +4,12 @@
 // Calculations and initialization processes are based on the sensor datasheet
 // https://cdn-shop.adafruit.com/product-files/5591/LTR-329ALS-01-Lite-On-datasheet-140998467.pdf
 
+// Gain factor per ALS_GAIN code, codes 4 and 5 are reserved
+static const uint8_t GAIN_FACTORS[8] = {1, 2, 4, 8, 1, 1, 48, 96};
+
+// Integration time per ALS_INT code in 50 ms steps
+static const uint8_t INTEGRATION_STEPS[8] = {2, 1, 4, 8, 3, 5, 6, 7};
+
 LTR329::LTR329() {
 }
 
@@ -29,49 +35,25 @@ int LTR329::init(uint8_t gain_config_value, uint8_t mr_and_it_config_value) {
     
     delay(100);
     
-    // Read Part ID and Manufacturer ID to verify sensor presence
-    Wire.beginTransmission(LTR329_ADDRESS);
-    Wire.write(LTR329_PART_ID);
-    if (Wire.endTransmission() == 0 && Wire.requestFrom(LTR329_ADDRESS, 1) == 1) {
-        uint8_t part_id = Wire.read();
-        Serial.print("Part ID: 0x");
-        Serial.println(part_id, HEX);
-    }
-    
-    Wire.beginTransmission(LTR329_ADDRESS);
-    Wire.write(LTR329_MANUFAC_ID);
-    if (Wire.endTransmission() == 0 && Wire.requestFrom(LTR329_ADDRESS, 1) == 1) {
-        uint8_t manufac_id = Wire.read();
-        Serial.print("Manufacturer ID: 0x");
-        Serial.println(manufac_id, HEX);
+    // Part ID and Manufacturer ID are adjacent, verify the sensor in one read
+    uint8_t ids[2];
+    if (readRegisters(LTR329_PART_ID, ids, 2) != 0) {
+        return -1;
     }
-    
-    // Read back control register to verify settings
-    Wire.beginTransmission(LTR329_ADDRESS);
-    Wire.write(LTR329_ALS_CONTR);
-    if (Wire.endTransmission() == 0 && Wire.requestFrom(LTR329_ADDRESS, 1) == 1) {
-        uint8_t control_reg = Wire.read();
-        Serial.print("Control Register: 0x");
-        Serial.println(control_reg, HEX);
+
+    if (ids[0] != PART_ID_RESET_VALUE || ids[1] != MANUFAC_ID_RESET_VALUE) {
+        return -1;
     }
     
     return 0;
 }
 
 int LTR329::setGain(uint8_t configValue) {
-    Serial.print("Gain Config value: ");
-    Serial.println(configValue);
-    
-    Wire.beginTransmission(LTR329_ADDRESS);
-    Wire.write(LTR329_ALS_CONTR);
-    Wire.write(configValue);
-    uint8_t result = Wire.endTransmission();
-    if (result != 0) {
-        Serial.print("I2C write error: ");
-        Serial.println(result);
+    if (writeRegister(LTR329_ALS_CONTR, configValue) != 0) {
         return -1;
     }
-    Serial.println("Gain setting written successfully");
+
+    gain = (configValue >> LTR329_CONTR_GAIN_SHIFT) & 0x07;
     return 0;
 }
 
@@ -80,21 +62,17 @@ int LTR329::setGain(char als_mode, char sw_reset, uint8_t gain) {
     
     configValue |= (als_mode & 0x01);
     configValue |= (sw_reset & 0x01) << 1;
-    configValue |= (gain & 0x07) << 2;
+    configValue |= (gain & 0x07) << LTR329_CONTR_GAIN_SHIFT;
     
     return setGain(configValue);
 }
 
 int LTR329::setMeasurementRate(uint8_t configValue){
-    Serial.print("Measurement Rate Config value: ");
-    Serial.println(configValue);
-
-    Wire.beginTransmission(LTR329_ADDRESS);
-    Wire.write(LTR329_ALS_MEAS_RATE);
-    Wire.write(configValue);
-    if (Wire.endTransmission() != 0) {
+    if (writeRegister(LTR329_ALS_MEAS_RATE, configValue) != 0) {
         return -1;
     }
+
+    integration_time = (configValue >> LTR329_RATE_IT_SHIFT) & 0x07;
     return 0;
 }
 
@@ -103,97 +81,92 @@ int LTR329::setMeasurementRate(uint8_t als_meas_rate, uint8_t als_it){
    uint8_t configValue = 0;
     
     configValue |= (als_meas_rate & 0x07);
-    configValue |= (als_it & 0x07) << 3;
+    configValue |= (als_it & 0x07) << LTR329_RATE_IT_SHIFT;
     
     return setMeasurementRate(configValue);
 }
 
 int LTR329::isNewDataAndValid(){
-    Wire.beginTransmission(LTR329_ADDRESS);
-    Wire.write(LTR329_ALS_STATUS);
-    if (Wire.endTransmission() != 0) {
-        return -1;
-    }
-    
-    if (Wire.requestFrom(LTR329_ADDRESS, 1) != 1) {
+    uint8_t response;
+    if (readRegisters(LTR329_ALS_STATUS, &response, 1) != 0) {
         return -1;
     }
-    
-    uint8_t response = Wire.read();
-    uint8_t status = (response & 0x04) >> 2;
-    uint8_t valid = (response & 0x80) >> 7;
-    Serial.print("ALS Status Data: ");
-    Serial.print(response);
-    Serial.print(" Status: ");
-    Serial.print(status);
-    Serial.print(" Valid: ");
-    Serial.print(valid);
-    Serial.println("");
-
-    if(status == 1 && valid == 0){
+
+    if ((response & LTR329_STATUS_NEW_DATA) && !(response & LTR329_STATUS_INVALID)) {
         return 0;
     }
     
     return 1;
-    
 }
 
-uint16_t LTR329::readASLChannel1(){
-    Wire.beginTransmission(LTR329_ADDRESS);
-    Wire.write(LTR329_ALS_DATA_CH1_0);
-    if (Wire.endTransmission() != 0) {
-        return -1;
-    }
-    
-    if (Wire.requestFrom(LTR329_ADDRESS, 1) != 1) {
+int LTR329::readChannels(uint16_t* ch0, uint16_t* ch1){
+    // Reading from CH1_0 locks the data until CH0_1 was read
+    uint8_t data[4];
+    if (readRegisters(LTR329_ALS_DATA_CH1_0, data, 4) != 0) {
         return -1;
     }
-    uint8_t lowByte = Wire.read();
-    
-    Wire.beginTransmission(LTR329_ADDRESS);
-    Wire.write(LTR329_ALS_DATA_CH1_1);
-    if (Wire.endTransmission() != 0) {
-        return -1;
-    }
-    
-    if (Wire.requestFrom(LTR329_ADDRESS, 1) != 1) {
+
+    *ch1 = (data[1] << 8) | data[0];
+    *ch0 = (data[3] << 8) | data[2];
+    return 0;
+}
+
+int LTR329::readASLChannel1(uint16_t* value){
+    uint8_t data[2];
+    if (readRegisters(LTR329_ALS_DATA_CH1_0, data, 2) != 0) {
         return -1;
     }
-    uint8_t highByte = Wire.read();
 
-    uint16_t value = (highByte << 8) | lowByte;
-    
-    
-    return value;
-    
+    *value = (data[1] << 8) | data[0];
+    return 0;
 }
 
-uint16_t LTR329::readASLChannel0(){
-    Wire.beginTransmission(LTR329_ADDRESS);
-    Wire.write(LTR329_ALS_DATA_CH0_0);
-    if (Wire.endTransmission() != 0) {
+int LTR329::readASLChannel0(uint16_t* value){
+    uint8_t data[2];
+    if (readRegisters(LTR329_ALS_DATA_CH0_0, data, 2) != 0) {
         return -1;
     }
-    
-    if (Wire.requestFrom(LTR329_ADDRESS, 1) != 1) {
+
+    *value = (data[1] << 8) | data[0];
+    return 0;
+}
+
+int LTR329::readLux(float* lux){
+    uint16_t ch0, ch1;
+    if (readChannels(&ch0, &ch1) != 0) {
         return -1;
     }
-    uint8_t lowByte = Wire.read();
-    
-    Wire.beginTransmission(LTR329_ADDRESS);
-    Wire.write(LTR329_ALS_DATA_CH0_1);
-    if (Wire.endTransmission() != 0) {
-        return -1;
+
+    *lux = computeLux(ch0, ch1, gain, integration_time);
+    return 0;
+}
+
+float LTR329::computeLux(uint16_t ch0, uint16_t ch1, uint8_t gain, uint8_t integration_time){
+    uint32_t sum = (uint32_t)ch0 + ch1;
+    if (sum == 0) {
+        return 0.0f;
     }
-    
-    if (Wire.requestFrom(LTR329_ADDRESS, 1) != 1) {
-        return -1;
+
+    float ratio = (float)ch1 / sum;
+    float counts;
+    if (ratio < 0.45f) {
+        counts = 1.7743f * ch0 + 1.1059f * ch1;
+    } else if (ratio < 0.64f) {
+        counts = 4.2785f * ch0 - 1.9548f * ch1;
+    } else if (ratio < 0.85f) {
+        counts = 0.5926f * ch0 + 0.1185f * ch1;
+    } else {
+        return 0.0f;
     }
-    uint8_t highByte = Wire.read();
 
-    uint16_t value = (highByte << 8) | lowByte;
-    
-    
-    return value;
-    
-}
\ No newline at end of file
+    // ALS_INT is in units of 100 ms
+    return counts / (GAIN_FACTORS[gain & 0x07] * INTEGRATION_STEPS[integration_time & 0x07] * 0.5f);
+}
+
+int LTR329::readRegisters(uint8_t reg, uint8_t* buffer, uint8_t length){
+    return bus.read(reg, buffer, length) == I2C_OK ? 0 : -1;
+}
+
+int LTR329::writeRegister(uint8_t reg, uint8_t value){
+    return bus.writeU8(reg, value) == I2C_OK ? 0 : -1;
+}
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include "i2c_register.h"
 
 // All addresses are according to the sensors' datasheet
 // https://www.vishay.com/docs/84889/LTR329.pdf
@@ -33,6 +34,14 @@
 #define PART_ID_RESET_VALUE 0xA0
 #define MANUFAC_ID_RESET_VALUE 0x05
 
+// ALS_STATUS bits
+#define LTR329_STATUS_NEW_DATA   0x04
+#define LTR329_STATUS_INVALID    0x80
+
+// Field positions in ALS_CONTR and ALS_MEAS_RATE
+#define LTR329_CONTR_GAIN_SHIFT  2
+#define LTR329_RATE_IT_SHIFT     3
+
 
 struct ALSGain{
     static const uint8_t X_1 = 0x00;     // 1 lux to 64k lux (default)
@@ -80,17 +89,36 @@ public:
 
     int setMeasurementRate(uint8_t measurement_rate, uint8_t integration_time);
 
-    uint16_t readASLChannel0();
+    // Both channels in one repeated start read of 0x88..0x8B, which the
+    // sensor keeps from the same conversion. Returns 0 on success.
+    int readChannels(uint16_t* ch0, uint16_t* ch1);
 
-    uint16_t readASLChannel1();
-    
+    int readASLChannel0(uint16_t* value);
+
+    int readASLChannel1(uint16_t* value);
+
+    // Lux from both channels with the configured gain and integration time
+    int readLux(float* lux);
+
+    // Datasheet formula on the CH1 / (CH0 + CH1) ratio, 0 above 0.85
+    static float computeLux(uint16_t ch0, uint16_t ch1, uint8_t gain, uint8_t integration_time);
+
+    // 0 if a new valid conversion is available, 1 if not, -1 on bus errors
     int isNewDataAndValid();
 
 private:
-    static constexpr uint8_t DEFAULT_ALS_GAIN_CONFIG = 0x03;
+    // Active mode at gain 1, bit 1 would start a software reset instead
+    static constexpr uint8_t DEFAULT_ALS_GAIN_CONFIG = 0x01;
     static constexpr uint8_t DEFAULT_ALS_MEASURMENT_CONFIG = 0x03;
 
+    I2CRegisters bus{LTR329_ADDRESS};
+
+    // Gain and integration time codes of the last successful writes
+    uint8_t gain = ALSGain::X_1;
+    uint8_t integration_time = ALSIntegrationTime::MS_100;
 
+    int readRegisters(uint8_t reg, uint8_t* buffer, uint8_t length);
+    int writeRegister(uint8_t reg, uint8_t value);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "sensor_config.h"
+#include "crc8.h"
+
+#define SENSOR_CONFIG_MAGIC_0 'S'
+#define SENSOR_CONFIG_MAGIC_1 'C'
+#define SENSOR_CONFIG_CRC_INIT 0xFF
+
+static void putU32(uint8_t* buffer, uint32_t value) {
+  for (uint8_t i = 0; i < 4; i++) {
+    buffer[i] = (value >> (8 * i)) & 0xFF;
+  }
+}
+
+static uint32_t getU32(const uint8_t* buffer) {
+  return buffer[0] | (buffer[1] << 8) | ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+static bool validPeriod(uint32_t period_ms, uint32_t max_ms) {
+  return period_ms >= SENSOR_CONFIG_MIN_PERIOD_MS && period_ms <= max_ms;
+}
+
+void sensorConfigDefaults(SensorConfig* config) {
+  config->si7021_period_ms = 60000;
+  config->sht30_period_ms = 60000;
+  config->veml6035_period_ms = 1000;
+  config->imu_period_ms = 200;
+  config->update_period_ms = 5000;
+}
+
+size_t sensorConfigEncode(const SensorConfig* config, uint8_t* buffer, size_t length) {
+  if (length < SENSOR_CONFIG_SIZE) {
+    return 0;
+  }
+
+  buffer[0] = SENSOR_CONFIG_VERSION;
+  putU32(&buffer[1], config->si7021_period_ms);
+  putU32(&buffer[5], config->sht30_period_ms);
+  putU32(&buffer[9], config->veml6035_period_ms);
+  putU32(&buffer[13], config->imu_period_ms);
+  putU32(&buffer[17], config->update_period_ms);
+
+  return SENSOR_CONFIG_SIZE;
+}
+
+bool sensorConfigDecode(const uint8_t* buffer, size_t length, SensorConfig* config) {
+  SensorConfig decoded;
+
+  if (length < SENSOR_CONFIG_SIZE || buffer[0] != SENSOR_CONFIG_VERSION) {
+    return false;
+  }
+
+  decoded.si7021_period_ms = getU32(&buffer[1]);
+  decoded.sht30_period_ms = getU32(&buffer[5]);
+  decoded.veml6035_period_ms = getU32(&buffer[9]);
+  decoded.imu_period_ms = getU32(&buffer[13]);
+  decoded.update_period_ms = getU32(&buffer[17]);
+
+  if (!validPeriod(decoded.si7021_period_ms, SENSOR_CONFIG_MAX_PERIOD_MS) ||
+      !validPeriod(decoded.sht30_period_ms, SENSOR_CONFIG_MAX_PERIOD_MS) ||
+      !validPeriod(decoded.veml6035_period_ms, SENSOR_CONFIG_MAX_PERIOD_MS) ||
+      !validPeriod(decoded.imu_period_ms, SENSOR_CONFIG_MAX_IMU_PERIOD_MS) ||
+      !validPeriod(decoded.update_period_ms, SENSOR_CONFIG_MAX_PERIOD_MS)) {
+    return false;
+  }
+
+  *config = decoded;
+  return true;
+}
+
+size_t sensorConfigStore(const SensorConfig* config, uint8_t* buffer, size_t length) {
+  if (length < SENSOR_CONFIG_STORED_SIZE) {
+    return 0;
+  }
+
+  buffer[0] = SENSOR_CONFIG_MAGIC_0;
+  buffer[1] = SENSOR_CONFIG_MAGIC_1;
+  sensorConfigEncode(config, &buffer[2], SENSOR_CONFIG_SIZE);
+  buffer[2 + SENSOR_CONFIG_SIZE] = crc8(&buffer[2], SENSOR_CONFIG_SIZE, SENSOR_CONFIG_CRC_INIT);
+
+  return SENSOR_CONFIG_STORED_SIZE;
+}
+
+bool sensorConfigLoad(const uint8_t* buffer, size_t length, SensorConfig* config) {
+  if (length < SENSOR_CONFIG_STORED_SIZE ||
+      buffer[0] != SENSOR_CONFIG_MAGIC_0 || buffer[1] != SENSOR_CONFIG_MAGIC_1) {
+    return false;
+  }
+
+  if (crc8(&buffer[2], SENSOR_CONFIG_SIZE, SENSOR_CONFIG_CRC_INIT) != buffer[2 + SENSOR_CONFIG_SIZE]) {
+    return false;
+  }
+
+  return sensorConfigDecode(&buffer[2], SENSOR_CONFIG_SIZE, config);
+}
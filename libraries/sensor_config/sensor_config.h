@@ -0,0 +1,52 @@
+#ifndef SENSOR_CONFIG_H
+#define SENSOR_CONFIG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Per-sensor sampling periods, written by a central over BLE and kept in
+// non-volatile memory so a reset does not fall back to the defaults.
+//
+// Layout (little endian):
+//   0      version
+//   1..4   SI7021 period, ms
+//   5..8   SHT30 period, ms
+//   9..12  VEML6035 period, ms (status poll period in event mode)
+//   13..16 IMU FIFO drain period, ms
+//   17..20 BLE update period, ms
+//
+// Stored as [magic 'S' 'C'][config][CRC-8 of the config].
+
+#define SENSOR_CONFIG_VERSION 1
+#define SENSOR_CONFIG_SIZE    21
+#define SENSOR_CONFIG_STORED_SIZE (2 + SENSOR_CONFIG_SIZE + 1)
+
+#define SENSOR_CONFIG_MIN_PERIOD_MS 50
+#define SENSOR_CONFIG_MAX_PERIOD_MS 3600000UL
+// The 32 sample IMU ring holds 640 ms at 50 Hz
+#define SENSOR_CONFIG_MAX_IMU_PERIOD_MS 500
+
+struct SensorConfig {
+  uint32_t si7021_period_ms;
+  uint32_t sht30_period_ms;
+  uint32_t veml6035_period_ms;
+  uint32_t imu_period_ms;
+  uint32_t update_period_ms;
+};
+
+// Temperature and humidity once per minute, light events polled every
+// second, motion at the FIFO drain rate
+void sensorConfigDefaults(SensorConfig* config);
+
+// Returns the number of bytes written, 0 if the buffer is too small
+size_t sensorConfigEncode(const SensorConfig* config, uint8_t* buffer, size_t length);
+
+// Returns false for truncated configs, unknown versions or periods out of range
+bool sensorConfigDecode(const uint8_t* buffer, size_t length, SensorConfig* config);
+
+size_t sensorConfigStore(const SensorConfig* config, uint8_t* buffer, size_t length);
+
+// Returns false if the stored bytes are not a valid config, e.g. erased memory
+bool sensorConfigLoad(const uint8_t* buffer, size_t length, SensorConfig* config);
+
+#endif
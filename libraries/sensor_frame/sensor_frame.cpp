@@ -0,0 +1,91 @@
+#include "sensor_frame.h"
+
+static void putU16(uint8_t* buffer, uint16_t value) {
+  buffer[0] = value & 0xFF;
+  buffer[1] = value >> 8;
+}
+
+static void putU32(uint8_t* buffer, uint32_t value) {
+  putU16(buffer, value & 0xFFFF);
+  putU16(buffer + 2, value >> 16);
+}
+
+static uint16_t getU16(const uint8_t* buffer) {
+  return buffer[0] | (buffer[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t* buffer) {
+  return getU16(buffer) | ((uint32_t)getU16(buffer + 2) << 16);
+}
+
+size_t sensorFrameSize(uint8_t version) {
+  return version < 2 ? SENSOR_FRAME_V1_SIZE : SENSOR_FRAME_SIZE;
+}
+
+size_t sensorFrameEncode(const SensorFrame* frame, uint8_t* buffer, size_t length) {
+  if (length < SENSOR_FRAME_SIZE) {
+    return 0;
+  }
+
+  buffer[0] = SENSOR_FRAME_VERSION;
+  buffer[1] = frame->valid;
+  putU16(&buffer[2], frame->sequence);
+  putU32(&buffer[4], frame->timestamp_ms);
+
+  putU16(&buffer[8], (uint16_t)frame->si7021_temp_centi);
+  putU16(&buffer[10], frame->si7021_hum_centi);
+  putU16(&buffer[12], (uint16_t)frame->sht30_temp_centi);
+  putU16(&buffer[14], frame->sht30_hum_centi);
+  putU32(&buffer[16], frame->veml6035_millilux);
+
+  buffer[20] = (frame->imu_state & SENSOR_FRAME_IMU_STATE_MASK) |
+               (frame->imu_asleep ? SENSOR_FRAME_IMU_ASLEEP : 0) |
+               ((frame->sleep_stage << SENSOR_FRAME_SLEEP_STAGE_SHIFT) & SENSOR_FRAME_SLEEP_STAGE_MASK) |
+               ((frame->posture << SENSOR_FRAME_POSTURE_SHIFT) & SENSOR_FRAME_POSTURE_MASK);
+  putU16(&buffer[21], frame->imu_intensity_milli);
+  putU16(&buffer[23], frame->imu_movements_per_minute);
+  putU16(&buffer[25], frame->imu_still_minutes);
+
+  putU16(&buffer[27], (uint16_t)frame->fused_temp_centi);
+  putU16(&buffer[29], frame->fused_hum_centi);
+  buffer[31] = frame->fusion_status;
+
+  return SENSOR_FRAME_SIZE;
+}
+
+bool sensorFrameDecode(const uint8_t* buffer, size_t length, SensorFrame* frame) {
+  if (length < 1 || buffer[0] < 1 || length < sensorFrameSize(buffer[0])) {
+    return false;
+  }
+
+  frame->version = buffer[0];
+  frame->valid = buffer[1];
+  frame->sequence = getU16(&buffer[2]);
+  frame->timestamp_ms = getU32(&buffer[4]);
+
+  frame->si7021_temp_centi = (int16_t)getU16(&buffer[8]);
+  frame->si7021_hum_centi = getU16(&buffer[10]);
+  frame->sht30_temp_centi = (int16_t)getU16(&buffer[12]);
+  frame->sht30_hum_centi = getU16(&buffer[14]);
+  frame->veml6035_millilux = getU32(&buffer[16]);
+
+  frame->imu_state = buffer[20] & SENSOR_FRAME_IMU_STATE_MASK;
+  frame->imu_asleep = (buffer[20] & SENSOR_FRAME_IMU_ASLEEP) != 0;
+  frame->sleep_stage = (buffer[20] & SENSOR_FRAME_SLEEP_STAGE_MASK) >> SENSOR_FRAME_SLEEP_STAGE_SHIFT;
+  frame->posture = (buffer[20] & SENSOR_FRAME_POSTURE_MASK) >> SENSOR_FRAME_POSTURE_SHIFT;
+  frame->imu_intensity_milli = getU16(&buffer[21]);
+  frame->imu_movements_per_minute = getU16(&buffer[23]);
+  frame->imu_still_minutes = getU16(&buffer[25]);
+
+  if (frame->version >= 2) {
+    frame->fused_temp_centi = (int16_t)getU16(&buffer[27]);
+    frame->fused_hum_centi = getU16(&buffer[29]);
+    frame->fusion_status = buffer[31];
+  } else {
+    frame->fused_temp_centi = 0;
+    frame->fused_hum_centi = 0;
+    frame->fusion_status = 0;
+  }
+
+  return true;
+}
@@ -0,0 +1,86 @@
+#ifndef SENSOR_FRAME_H
+#define SENSOR_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Packed, versioned snapshot of all sensor values, sent as one BLE
+// notification instead of one notification per value.
+//
+// Layout (little endian):
+//   0      version
+//   1      valid flags (SENSOR_FRAME_*_VALID)
+//   2..3   sequence number
+//   4..7   timestamp, ms since boot
+//   8..9   SI7021 temperature, 0.01 C
+//   10..11 SI7021 humidity, 0.01 %RH
+//   12..13 SHT30 temperature, 0.01 C
+//   14..15 SHT30 humidity, 0.01 %RH
+//   16..19 VEML6035 ambient light, 0.001 lux
+//   20     IMU bits 1:0 activity state, bit 2 likely asleep,
+//          bits 4:3 sleep stage (actigraphy.h SleepStage),
+//          bits 7:5 posture (posture.h Posture)
+//   21..22 IMU movement intensity, 0.001 g
+//   23..24 IMU movements per minute
+//   25..26 IMU still duration, minutes
+// Version 2:
+//   27..28 fused SI7021/SHT30 temperature, 0.01 C
+//   29..30 fused SI7021/SHT30 humidity, 0.01 %RH
+//   31     fusion status (th_fusion.h ThFusionStatus)
+//
+// Newer versions only append fields, so a decoder accepts any version
+// that is at least as long as the layout it knows.
+
+#define SENSOR_FRAME_VERSION 2
+#define SENSOR_FRAME_SIZE    32
+#define SENSOR_FRAME_V1_SIZE 27
+
+#define SENSOR_FRAME_SI7021_VALID   0x01
+#define SENSOR_FRAME_SHT30_VALID    0x02
+#define SENSOR_FRAME_VEML6035_VALID 0x04
+#define SENSOR_FRAME_IMU_VALID      0x08
+#define SENSOR_FRAME_FUSED_VALID    0x10
+
+#define SENSOR_FRAME_IMU_STATE_MASK 0x03
+#define SENSOR_FRAME_IMU_ASLEEP     0x04
+#define SENSOR_FRAME_SLEEP_STAGE_SHIFT 3
+#define SENSOR_FRAME_SLEEP_STAGE_MASK  0x18
+#define SENSOR_FRAME_POSTURE_SHIFT     5
+#define SENSOR_FRAME_POSTURE_MASK      0xE0
+
+struct SensorFrame {
+  uint8_t version;
+  uint8_t valid;
+  uint16_t sequence;
+  uint32_t timestamp_ms;
+
+  int16_t si7021_temp_centi;
+  uint16_t si7021_hum_centi;
+  int16_t sht30_temp_centi;
+  uint16_t sht30_hum_centi;
+  uint32_t veml6035_millilux;
+
+  uint8_t imu_state;
+  bool imu_asleep;
+  uint8_t sleep_stage;
+  uint8_t posture;
+  uint16_t imu_intensity_milli;
+  uint16_t imu_movements_per_minute;
+  uint16_t imu_still_minutes;
+
+  // Zero in version 1 frames
+  int16_t fused_temp_centi;
+  uint16_t fused_hum_centi;
+  uint8_t fusion_status;
+};
+
+// Encoded length of a frame of the given version
+size_t sensorFrameSize(uint8_t version);
+
+// Returns the number of bytes written, 0 if the buffer is too small
+size_t sensorFrameEncode(const SensorFrame* frame, uint8_t* buffer, size_t length);
+
+// Returns false for truncated frames or unknown versions
+bool sensorFrameDecode(const uint8_t* buffer, size_t length, SensorFrame* frame);
+
+#endif
@@ -0,0 +1,315 @@
+#include "sensor_history.h"
+#include <string.h>
+
+#define HISTORY_FIELDS 15
+// Blocks stored by version 1 firmware have no fused fields
+#define HISTORY_FIELDS_V1 12
+
+// Fields of a frame in delta record order, signed values sign extended
+static void toFields(const SensorFrame& frame, uint32_t* fields) {
+  fields[0] = frame.timestamp_ms;
+  fields[1] = frame.valid;
+  fields[2] = frame.sequence;
+  fields[3] = (uint32_t)(int32_t)frame.si7021_temp_centi;
+  fields[4] = frame.si7021_hum_centi;
+  fields[5] = (uint32_t)(int32_t)frame.sht30_temp_centi;
+  fields[6] = frame.sht30_hum_centi;
+  fields[7] = frame.veml6035_millilux;
+  fields[8] = (frame.imu_state & SENSOR_FRAME_IMU_STATE_MASK) | (frame.imu_asleep ? SENSOR_FRAME_IMU_ASLEEP : 0) |
+              ((frame.sleep_stage << SENSOR_FRAME_SLEEP_STAGE_SHIFT) & SENSOR_FRAME_SLEEP_STAGE_MASK) |
+              ((frame.posture << SENSOR_FRAME_POSTURE_SHIFT) & SENSOR_FRAME_POSTURE_MASK);
+  fields[9] = frame.imu_intensity_milli;
+  fields[10] = frame.imu_movements_per_minute;
+  fields[11] = frame.imu_still_minutes;
+  fields[12] = (uint32_t)(int32_t)frame.fused_temp_centi;
+  fields[13] = frame.fused_hum_centi;
+  fields[14] = frame.fusion_status;
+}
+
+static void fromFields(const uint32_t* fields, SensorFrame* frame) {
+  frame->timestamp_ms = fields[0];
+  frame->valid = (uint8_t)fields[1];
+  frame->sequence = (uint16_t)fields[2];
+  frame->si7021_temp_centi = (int16_t)fields[3];
+  frame->si7021_hum_centi = (uint16_t)fields[4];
+  frame->sht30_temp_centi = (int16_t)fields[5];
+  frame->sht30_hum_centi = (uint16_t)fields[6];
+  frame->veml6035_millilux = fields[7];
+  frame->imu_state = fields[8] & SENSOR_FRAME_IMU_STATE_MASK;
+  frame->imu_asleep = (fields[8] & SENSOR_FRAME_IMU_ASLEEP) != 0;
+  frame->sleep_stage = (fields[8] & SENSOR_FRAME_SLEEP_STAGE_MASK) >> SENSOR_FRAME_SLEEP_STAGE_SHIFT;
+  frame->posture = (fields[8] & SENSOR_FRAME_POSTURE_MASK) >> SENSOR_FRAME_POSTURE_SHIFT;
+  frame->imu_intensity_milli = (uint16_t)fields[9];
+  frame->imu_movements_per_minute = (uint16_t)fields[10];
+  frame->imu_still_minutes = (uint16_t)fields[11];
+  frame->fused_temp_centi = (int16_t)fields[12];
+  frame->fused_hum_centi = (uint16_t)fields[13];
+  frame->fusion_status = (uint8_t)fields[14];
+}
+
+static size_t putVarint(uint8_t* buffer, int32_t value) {
+  uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+  size_t n = 0;
+
+  while (zigzag >= 0x80) {
+    buffer[n++] = (zigzag & 0x7F) | 0x80;
+    zigzag >>= 7;
+  }
+  buffer[n++] = zigzag;
+
+  return n;
+}
+
+// Returns the number of bytes consumed, 0 if the varint is truncated
+static size_t getVarint(const uint8_t* buffer, size_t length, int32_t* value) {
+  uint32_t zigzag = 0;
+
+  for (size_t n = 0; n < length && n < 5; n++) {
+    zigzag |= (uint32_t)(buffer[n] & 0x7F) << (7 * n);
+    if ((buffer[n] & 0x80) == 0) {
+      *value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+      return n + 1;
+    }
+  }
+
+  return 0;
+}
+
+static size_t encodeDelta(const SensorFrame& previous, const SensorFrame& frame, uint8_t* buffer) {
+  uint32_t before[HISTORY_FIELDS], after[HISTORY_FIELDS];
+  size_t n = 0;
+
+  toFields(previous, before);
+  toFields(frame, after);
+
+  for (uint8_t i = 0; i < HISTORY_FIELDS; i++) {
+    n += putVarint(&buffer[n], (int32_t)(after[i] - before[i]));
+  }
+
+  return n;
+}
+
+SensorHistory::SensorHistory() {
+  clear();
+}
+
+void SensorHistory::clear() {
+  first_id = 0;
+  block_count = 0;
+  sealed = false;
+  record_count = 0;
+  memset(block_used, 0, sizeof(block_used));
+  memset(block_records, 0, sizeof(block_records));
+  memset(&previous, 0, sizeof(previous));
+}
+
+void SensorHistory::append(const SensorFrame& frame) {
+  uint8_t record[SENSOR_HISTORY_MAX_RECORD];
+  size_t record_length = 0;
+  uint16_t slot = (first_id + block_count - 1) % SENSOR_HISTORY_BLOCKS;
+  bool new_block = block_count == 0 || sealed;
+
+  if (!new_block) {
+    record_length = encodeDelta(previous, frame, record);
+    new_block = block_used[slot] + record_length > SENSOR_HISTORY_BLOCK_SIZE;
+  }
+
+  if (new_block) {
+    if (block_count == SENSOR_HISTORY_BLOCKS) {
+      record_count -= block_records[first_id % SENSOR_HISTORY_BLOCKS];
+      first_id++;
+      block_count--;
+    }
+
+    slot = (first_id + block_count) % SENSOR_HISTORY_BLOCKS;
+    block_count++;
+    block_used[slot] = sensorFrameEncode(&frame, blocks[slot], SENSOR_HISTORY_BLOCK_SIZE);
+    block_records[slot] = 1;
+    sealed = false;
+  } else {
+    memcpy(&blocks[slot][block_used[slot]], record, record_length);
+    block_used[slot] += record_length;
+    block_records[slot]++;
+  }
+
+  previous = frame;
+  record_count++;
+}
+
+void SensorHistory::seal() {
+  sealed = true;
+}
+
+const uint8_t* SensorHistory::getBlock(uint32_t id, uint16_t* length) const {
+  if (id < first_id || id >= first_id + block_count) {
+    return NULL;
+  }
+
+  uint16_t slot = id % SENSOR_HISTORY_BLOCKS;
+  *length = block_used[slot];
+  return blocks[slot];
+}
+
+uint32_t SensorHistory::getStoredBytes() const {
+  uint32_t bytes = 0;
+
+  for (uint16_t i = 0; i < block_count; i++) {
+    bytes += block_used[(first_id + i) % SENSOR_HISTORY_BLOCKS];
+  }
+
+  return bytes;
+}
+
+SensorHistoryReader::SensorHistoryReader() {
+  history = NULL;
+  block_id = 0;
+  end_id = 0;
+  offset = 0;
+  block_length = 0;
+}
+
+void SensorHistoryReader::begin(SensorHistory& source) {
+  source.seal();
+  history = &source;
+  block_id = source.getFirstBlockId();
+  end_id = source.getEndBlockId();
+  offset = 0;
+  block_length = 0;
+}
+
+size_t SensorHistoryReader::read(uint8_t* buffer, size_t length) {
+  size_t n = 0;
+
+  while (history != NULL && n < length) {
+    if (offset == 0) {
+      // Skip blocks dropped since begin(), a zero length ends the stream
+      block_length = 0;
+      while (block_id < end_id && history->getBlock(block_id, &block_length) == NULL) {
+        block_id++;
+      }
+    }
+
+    if (offset < 2) {
+      buffer[n++] = offset == 0 ? block_length & 0xFF : block_length >> 8;
+      offset++;
+    } else {
+      uint16_t current_length;
+      const uint8_t* data = history->getBlock(block_id, &current_length);
+      size_t chunk = block_length - (offset - 2);
+      if (chunk > length - n) {
+        chunk = length - n;
+      }
+
+      // A block dropped halfway through is padded, the receiver rejects it
+      if (data != NULL) {
+        memcpy(&buffer[n], &data[offset - 2], chunk);
+      } else {
+        memset(&buffer[n], 0, chunk);
+      }
+      n += chunk;
+      offset += chunk;
+    }
+
+    if (offset == block_length + 2) {
+      offset = 0;
+      if (block_length == 0) {
+        history = NULL;
+      } else {
+        block_id++;
+      }
+    }
+  }
+
+  return n;
+}
+
+SensorHistoryParser::SensorHistoryParser() {
+  reset();
+}
+
+void SensorHistoryParser::reset() {
+  block_length = 0;
+  received = 0;
+  header_bytes = 0;
+  complete = false;
+  failed = false;
+}
+
+bool SensorHistoryParser::feed(const uint8_t* data, size_t length, SensorHistoryFrameFn fn, void* context) {
+  size_t i = 0;
+
+  while (i < length && !complete && !failed) {
+    if (header_bytes < 2) {
+      block_length |= data[i++] << (8 * header_bytes);
+      header_bytes++;
+
+      if (header_bytes == 2) {
+        if (block_length == 0) {
+          complete = true;
+        } else if (block_length > SENSOR_HISTORY_BLOCK_SIZE) {
+          failed = true;
+        }
+        received = 0;
+      }
+      continue;
+    }
+
+    size_t chunk = block_length - received;
+    if (chunk > length - i) {
+      chunk = length - i;
+    }
+    memcpy(&block[received], &data[i], chunk);
+    received += chunk;
+    i += chunk;
+
+    if (received == block_length) {
+      if (sensorHistoryDecodeBlock(block, block_length, fn, context) < 0) {
+        failed = true;
+      }
+      header_bytes = 0;
+      block_length = 0;
+    }
+  }
+
+  return !complete && !failed;
+}
+
+size_t sensorHistoryChunkSize(const uint8_t* command, size_t length) {
+  if (length < SENSOR_HISTORY_CMD_LENGTH || command[1] < SENSOR_HISTORY_MIN_CHUNK_SIZE) {
+    return SENSOR_HISTORY_MIN_CHUNK_SIZE;
+  }
+  return command[1] > SENSOR_HISTORY_CHUNK_SIZE ? SENSOR_HISTORY_CHUNK_SIZE : command[1];
+}
+
+int sensorHistoryDecodeBlock(const uint8_t* data, size_t length, SensorHistoryFrameFn fn, void* context) {
+  SensorFrame frame;
+  uint32_t fields[HISTORY_FIELDS];
+  int frames = 1;
+
+  if (!sensorFrameDecode(data, length, &frame)) {
+    return -1;
+  }
+  fn(frame, context);
+
+  size_t pos = sensorFrameSize(frame.version);
+  uint8_t field_count = frame.version < 2 ? HISTORY_FIELDS_V1 : HISTORY_FIELDS;
+  toFields(frame, fields);
+
+  while (pos < length) {
+    for (uint8_t i = 0; i < field_count; i++) {
+      int32_t delta;
+      size_t n = getVarint(&data[pos], length - pos, &delta);
+      if (n == 0) {
+        return -1;
+      }
+      fields[i] += (uint32_t)delta;
+      pos += n;
+    }
+
+    fromFields(fields, &frame);
+    fn(frame, context);
+    frames++;
+  }
+
+  return frames;
+}
@@ -0,0 +1,128 @@
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sensor_frame.h"
+
+// RAM bounded history of sensor frames, kept while no central is connected
+// and downloaded in bulk after a reconnect.
+//
+// Frames are stored in fixed size blocks. Every block starts with a full
+// packed frame (sensor_frame.h) followed by delta records: one zigzag
+// varint per field holding the difference to the previous frame, so slowly
+// changing values take one byte each. When all blocks are in use the
+// oldest block is dropped. With one frame per minute the default 48 blocks
+// (12 KB) cover a whole night.
+//
+// Download stream: every block as [u16 length, little endian][block bytes],
+// terminated by a zero length.
+
+#define SENSOR_HISTORY_BLOCK_SIZE 256
+#define SENSOR_HISTORY_BLOCKS     48
+
+// Worst case delta record: 15 fields, 5 varint bytes each
+#define SENSOR_HISTORY_MAX_RECORD 75
+
+// BLE download protocol: the client writes a command to the control
+// characteristic, the server notifies the stream on the data
+// characteristic in chunks of [u8 chunk counter][stream bytes]. The
+// download command carries the chunk size the client's negotiated MTU
+// fits as a second byte, notifications longer than the MTU would be cut.
+// All chunks but the last one have that size.
+#define SENSOR_HISTORY_CMD_DOWNLOAD 0x01
+#define SENSOR_HISTORY_CMD_CLEAR    0x02
+#define SENSOR_HISTORY_CMD_LENGTH   2
+// Fills a 247 byte ATT MTU
+#define SENSOR_HISTORY_CHUNK_SIZE   244
+// Fills the default 23 byte ATT MTU, used when the command has no size
+#define SENSOR_HISTORY_MIN_CHUNK_SIZE 20
+
+class SensorHistory {
+  private:
+    uint8_t blocks[SENSOR_HISTORY_BLOCKS][SENSOR_HISTORY_BLOCK_SIZE];
+    uint16_t block_used[SENSOR_HISTORY_BLOCKS];
+    uint8_t block_records[SENSOR_HISTORY_BLOCKS];
+
+    // Blocks are numbered continuously, block id % SENSOR_HISTORY_BLOCKS is the slot
+    uint32_t first_id;
+    uint16_t block_count;
+    bool sealed;
+
+    SensorFrame previous;
+    uint32_t record_count;
+
+  public:
+    SensorHistory();
+
+    void clear();
+
+    void append(const SensorFrame& frame);
+
+    // Starts a new block with the next append, so the blocks up to here
+    // no longer change while they are downloaded
+    void seal();
+
+    uint32_t getFirstBlockId() const { return first_id; }
+    uint32_t getEndBlockId() const { return first_id + block_count; }
+
+    // Returns NULL if the block was dropped or does not exist yet
+    const uint8_t* getBlock(uint32_t id, uint16_t* length) const;
+
+    uint32_t getRecordCount() const { return record_count; }
+
+    // Bytes in use, compare with getRecordCount() * SENSOR_FRAME_SIZE
+    uint32_t getStoredBytes() const;
+};
+
+// Produces the download stream of all blocks sealed by begin()
+class SensorHistoryReader {
+  private:
+    const SensorHistory* history;
+    uint32_t block_id;
+    uint32_t end_id;
+    uint16_t offset;
+    uint16_t block_length;
+
+  public:
+    SensorHistoryReader();
+
+    void begin(SensorHistory& history);
+
+    // Fills up to length bytes of the stream, returns 0 once it is complete
+    size_t read(uint8_t* buffer, size_t length);
+
+    bool isActive() const { return history != NULL; }
+};
+
+typedef void (*SensorHistoryFrameFn)(const SensorFrame& frame, void* context);
+
+// Reassembles the download stream and calls fn for every stored frame
+class SensorHistoryParser {
+  private:
+    uint8_t block[SENSOR_HISTORY_BLOCK_SIZE];
+    uint16_t block_length;
+    uint16_t received;
+    uint8_t header_bytes;
+    bool complete;
+    bool failed;
+
+  public:
+    SensorHistoryParser();
+
+    void reset();
+
+    // Returns false once the stream is complete or malformed
+    bool feed(const uint8_t* data, size_t length, SensorHistoryFrameFn fn, void* context);
+
+    bool isComplete() const { return complete; }
+    bool hasFailed() const { return failed; }
+};
+
+// Chunk size of a download command, clamped to the sizes above
+size_t sensorHistoryChunkSize(const uint8_t* command, size_t length);
+
+// Decodes one block, returns the number of frames or -1 if it is malformed
+int sensorHistoryDecodeBlock(const uint8_t* data, size_t length, SensorHistoryFrameFn fn, void* context);
+
+#endif
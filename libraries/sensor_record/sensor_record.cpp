@@ -0,0 +1,238 @@
+#include "sensor_record.h"
+#include <string.h>
+#include <math.h>
+
+#define SENSOR_RECORD_CRC_SIZE 2
+
+static void putU32(uint8_t* buffer, uint32_t value) {
+  for (uint8_t i = 0; i < 4; i++) {
+    buffer[i] = (value >> (8 * i)) & 0xFF;
+  }
+}
+
+static uint32_t getU32(const uint8_t* buffer) {
+  return buffer[0] | (buffer[1] << 8) | ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+uint16_t sensorRecordCrc16(const uint8_t* data, size_t length) {
+  uint16_t crc = 0xFFFF;
+
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+
+  return crc;
+}
+
+size_t sensorRecordEncode(const SensorRecord* record, uint8_t* buffer, size_t length) {
+  uint8_t raw[SENSOR_RECORD_PAYLOAD_SIZE + SENSOR_RECORD_CRC_SIZE];
+
+  if (length < SENSOR_RECORD_MAX_ENCODED) {
+    return 0;
+  }
+
+  raw[0] = record->type;
+  putU32(&raw[1], record->sequence);
+  sensorFrameEncode(&record->frame, &raw[5], SENSOR_FRAME_SIZE);
+
+  uint16_t crc = sensorRecordCrc16(raw, SENSOR_RECORD_PAYLOAD_SIZE);
+  raw[SENSOR_RECORD_PAYLOAD_SIZE] = crc & 0xFF;
+  raw[SENSOR_RECORD_PAYLOAD_SIZE + 1] = crc >> 8;
+
+  // COBS: every code byte gives the distance to the next zero
+  buffer[0] = 0x00;
+  size_t code_pos = 1;
+  size_t n = 2;
+  uint8_t code = 1;
+
+  for (size_t i = 0; i < sizeof(raw); i++) {
+    if (raw[i] == 0) {
+      buffer[code_pos] = code;
+      code_pos = n++;
+      code = 1;
+    } else {
+      buffer[n++] = raw[i];
+      code++;
+      if (code == 0xFF) {
+        buffer[code_pos] = code;
+        code_pos = n++;
+        code = 1;
+      }
+    }
+  }
+  buffer[code_pos] = code;
+  buffer[n++] = 0x00;
+
+  return n;
+}
+
+SensorRecordDecoder::SensorRecordDecoder() {
+  error_count = 0;
+  reset();
+}
+
+void SensorRecordDecoder::reset() {
+  encoded_length = 0;
+  overflow = false;
+  memset(&record, 0, sizeof(record));
+}
+
+bool SensorRecordDecoder::feed(uint8_t byte) {
+  if (byte != 0x00) {
+    if (encoded_length < sizeof(encoded)) {
+      encoded[encoded_length++] = byte;
+    } else {
+      overflow = true;
+    }
+    return false;
+  }
+
+  // An empty frame is just a repeated delimiter
+  if (encoded_length == 0 && !overflow) {
+    return false;
+  }
+
+  bool valid = !overflow && decode();
+  if (!valid) {
+    error_count++;
+  }
+
+  encoded_length = 0;
+  overflow = false;
+  return valid;
+}
+
+bool SensorRecordDecoder::decode() {
+  uint8_t raw[SENSOR_RECORD_PAYLOAD_SIZE + SENSOR_RECORD_CRC_SIZE];
+  size_t n = 0;
+  size_t i = 0;
+
+  while (i < encoded_length) {
+    uint8_t code = encoded[i++];
+    if (code == 0 || i + code - 1 > encoded_length) {
+      return false;
+    }
+
+    for (uint8_t j = 1; j < code; j++) {
+      if (n == sizeof(raw)) {
+        return false;
+      }
+      raw[n++] = encoded[i++];
+    }
+
+    // The implicit zero after the last block is not part of the data
+    if (code != 0xFF && i < encoded_length) {
+      if (n == sizeof(raw)) {
+        return false;
+      }
+      raw[n++] = 0;
+    }
+  }
+
+  // Records of version 1 firmware carry the shorter frame
+  if (n != sizeof(raw) && n != 5 + SENSOR_FRAME_V1_SIZE + SENSOR_RECORD_CRC_SIZE) {
+    return false;
+  }
+
+  size_t payload_length = n - SENSOR_RECORD_CRC_SIZE;
+  uint16_t crc = raw[payload_length] | (raw[payload_length + 1] << 8);
+  if (crc != sensorRecordCrc16(raw, payload_length)) {
+    return false;
+  }
+
+  SensorRecord decoded;
+  decoded.type = raw[0];
+  decoded.sequence = getU32(&raw[1]);
+  if (!sensorFrameDecode(&raw[5], payload_length - 5, &decoded.frame)) {
+    return false;
+  }
+
+  record = decoded;
+  return true;
+}
+
+void sensorSnapshotClear(SensorSnapshot* snapshot) {
+  snapshot->si7021_t = -999.0f;
+  snapshot->si7021_h = -999.0f;
+  snapshot->sht30_t = -999.0f;
+  snapshot->sht30_h = -999.0f;
+  snapshot->veml6035_l = -999.0f;
+  snapshot->fused_t = -999.0f;
+  snapshot->fused_h = -999.0f;
+  snapshot->fusion_status = 0;
+  snapshot->imu_data.current_state = STILL;
+  snapshot->imu_data.movement_intensity = 0;
+  snapshot->imu_data.movements_per_minute = 0;
+  snapshot->imu_data.is_likely_asleep = false;
+  snapshot->imu_data.still_duration_minutes = 0;
+  snapshot->sleep_stage = 0;
+  snapshot->posture = 0;
+}
+
+void sensorFrameToSnapshot(const SensorFrame& frame, SensorSnapshot* snapshot) {
+  sensorSnapshotClear(snapshot);
+
+  if (frame.valid & SENSOR_FRAME_SI7021_VALID) {
+    snapshot->si7021_t = frame.si7021_temp_centi / 100.0f;
+    snapshot->si7021_h = frame.si7021_hum_centi / 100.0f;
+  }
+  if (frame.valid & SENSOR_FRAME_SHT30_VALID) {
+    snapshot->sht30_t = frame.sht30_temp_centi / 100.0f;
+    snapshot->sht30_h = frame.sht30_hum_centi / 100.0f;
+  }
+  if (frame.valid & SENSOR_FRAME_VEML6035_VALID) {
+    snapshot->veml6035_l = frame.veml6035_millilux / 1000.0f;
+  }
+  if (frame.valid & SENSOR_FRAME_FUSED_VALID) {
+    snapshot->fused_t = frame.fused_temp_centi / 100.0f;
+    snapshot->fused_h = frame.fused_hum_centi / 100.0f;
+  }
+  snapshot->fusion_status = frame.fusion_status;
+
+  snapshot->imu_data.current_state = (ActivityState)frame.imu_state;
+  snapshot->imu_data.movement_intensity = frame.imu_intensity_milli / 1000.0f;
+  snapshot->imu_data.movements_per_minute = frame.imu_movements_per_minute;
+  snapshot->imu_data.is_likely_asleep = frame.imu_asleep;
+  snapshot->imu_data.still_duration_minutes = frame.imu_still_minutes;
+  snapshot->sleep_stage = frame.sleep_stage;
+  snapshot->posture = frame.posture;
+}
+
+void sensorSnapshotToFrame(const SensorSnapshot& snapshot, SensorFrame* frame) {
+  memset(frame, 0, sizeof(*frame));
+  frame->version = SENSOR_FRAME_VERSION;
+
+  if (snapshot.si7021_t != -999.0f && snapshot.si7021_h != -999.0f) {
+    frame->valid |= SENSOR_FRAME_SI7021_VALID;
+    frame->si7021_temp_centi = (int16_t)lroundf(snapshot.si7021_t * 100.0f);
+    frame->si7021_hum_centi = (uint16_t)lroundf(snapshot.si7021_h * 100.0f);
+  }
+  if (snapshot.sht30_t != -999.0f && snapshot.sht30_h != -999.0f) {
+    frame->valid |= SENSOR_FRAME_SHT30_VALID;
+    frame->sht30_temp_centi = (int16_t)lroundf(snapshot.sht30_t * 100.0f);
+    frame->sht30_hum_centi = (uint16_t)lroundf(snapshot.sht30_h * 100.0f);
+  }
+  if (snapshot.veml6035_l != -999.0f) {
+    frame->valid |= SENSOR_FRAME_VEML6035_VALID;
+    frame->veml6035_millilux = (uint32_t)lroundf(snapshot.veml6035_l * 1000.0f);
+  }
+  if (snapshot.fused_t != -999.0f && snapshot.fused_h != -999.0f) {
+    frame->valid |= SENSOR_FRAME_FUSED_VALID;
+    frame->fused_temp_centi = (int16_t)lroundf(snapshot.fused_t * 100.0f);
+    frame->fused_hum_centi = (uint16_t)lroundf(snapshot.fused_h * 100.0f);
+  }
+  frame->fusion_status = snapshot.fusion_status;
+
+  const MovementData& imu_data = snapshot.imu_data;
+  frame->valid |= SENSOR_FRAME_IMU_VALID;
+  frame->imu_state = (uint8_t)imu_data.current_state;
+  frame->imu_asleep = imu_data.is_likely_asleep;
+  frame->imu_intensity_milli = (uint16_t)lroundf(imu_data.movement_intensity * 1000.0f);
+  frame->imu_movements_per_minute = (uint16_t)imu_data.movements_per_minute;
+  frame->imu_still_minutes = imu_data.still_duration_minutes > 0xFFFF ? 0xFFFF : imu_data.still_duration_minutes;
+  frame->sleep_stage = snapshot.sleep_stage;
+  frame->posture = snapshot.posture;
+}
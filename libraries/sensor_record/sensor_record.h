@@ -0,0 +1,84 @@
+#ifndef SENSOR_RECORD_H
+#define SENSOR_RECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sensor_frame.h"
+#include "movement_data.h"
+
+// Binary serial records, a compact alternative to the JSON lines.
+//
+// Payload (little endian):
+//   0      record type (SENSOR_RECORD_LIVE / SENSOR_RECORD_HISTORY)
+//   1..4   record sequence number
+//   5..36  packed sensor frame (sensor_frame.h), 5..31 for a version 1 frame
+// followed by a CRC-16/CCITT-FALSE of the payload, low byte first. The
+// whole record is COBS encoded and enclosed in 0x00 delimiters, so text
+// lines or garbage in between cost no valid record.
+//
+// No Arduino headers: the decoder builds on a host as well.
+
+#define SENSOR_RECORD_LIVE    0x01
+#define SENSOR_RECORD_HISTORY 0x02
+
+#define SENSOR_RECORD_PAYLOAD_SIZE (5 + SENSOR_FRAME_SIZE)
+// Payload + CRC, one COBS code byte per 254 bytes and both delimiters
+#define SENSOR_RECORD_MAX_ENCODED (SENSOR_RECORD_PAYLOAD_SIZE + 2 + 1 + 2)
+
+struct SensorRecord {
+  uint8_t type;
+  uint32_t sequence;
+  SensorFrame frame;
+};
+
+// Sensor values as floats, -999 where the frame has no valid value
+struct SensorSnapshot {
+  float si7021_t, si7021_h;
+  float sht30_t, sht30_h;
+  float veml6035_l;
+  float fused_t, fused_h;
+  uint8_t fusion_status;
+  MovementData imu_data;
+  uint8_t sleep_stage;
+  uint8_t posture;
+};
+
+// Returns the number of bytes written including the delimiters, 0 if the
+// buffer is too small
+size_t sensorRecordEncode(const SensorRecord* record, uint8_t* buffer, size_t length);
+
+// Reassembles records from a byte stream
+class SensorRecordDecoder {
+  private:
+    uint8_t encoded[SENSOR_RECORD_MAX_ENCODED];
+    uint8_t encoded_length;
+    bool overflow;
+    SensorRecord record;
+    uint32_t error_count;
+
+    bool decode();
+
+  public:
+    SensorRecordDecoder();
+
+    void reset();
+
+    // Returns true when byte completed a valid record, see getRecord()
+    bool feed(uint8_t byte);
+
+    const SensorRecord& getRecord() const { return record; }
+
+    // Frames dropped because of a bad length, COBS code or CRC
+    uint32_t getErrorCount() const { return error_count; }
+};
+
+uint16_t sensorRecordCrc16(const uint8_t* data, size_t length);
+
+void sensorSnapshotClear(SensorSnapshot* snapshot);
+
+void sensorFrameToSnapshot(const SensorFrame& frame, SensorSnapshot* snapshot);
+
+// Values at -999 are left out of the valid flags, the IMU is always valid
+void sensorSnapshotToFrame(const SensorSnapshot& snapshot, SensorFrame* frame);
+
+#endif
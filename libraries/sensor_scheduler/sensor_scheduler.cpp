@@ -0,0 +1,196 @@
+#include "sensor_scheduler.h"
+
+SensorScheduler::SensorScheduler() {
+  task_count = 0;
+  resetStats();
+}
+
+int SensorScheduler::addTask(const char* name, unsigned long period_ms,
+                             SensorStartFn start, SensorReadyFn ready, SensorFetchFn fetch,
+                             unsigned long conversion_ms, unsigned long timeout_ms) {
+  if (task_count >= SENSOR_SCHEDULER_MAX_TASKS || fetch == NULL) {
+    return -1;
+  }
+
+  SensorTask& task = tasks[task_count];
+  task.name = name;
+  task.period_ms = period_ms;
+  task.conversion_ms = conversion_ms;
+  task.timeout_ms = timeout_ms;
+  task.start = start;
+  task.ready = ready;
+  task.fetch = fetch;
+  task.state = SensorTaskState::IDLE;
+  task.next_start = millis();
+  task.deadline = task.next_start;
+  task.started_at = 0;
+  task.error_count = 0;
+  task.busy_us = 0;
+
+  return task_count++;
+}
+
+void SensorScheduler::tick() {
+  unsigned long tick_start = micros();
+
+  if (has_ticked) {
+    unsigned long gap = tick_start - last_tick_us;
+    if (gap > worst_loop_us) {
+      worst_loop_us = gap;
+    }
+  }
+  has_ticked = true;
+  last_tick_us = tick_start;
+  elapsed_us += tick_start - stats_last_us;
+  stats_last_us = tick_start;
+
+  unsigned long now = millis();
+  uint16_t stepped = 0;
+
+  // Each task runs at most one step per tick, most overdue first
+  for (uint8_t n = 0; n < task_count; n++) {
+    int next = -1;
+    long most_overdue = -1;
+
+    for (uint8_t i = 0; i < task_count; i++) {
+      if ((stepped & (1 << i)) || !isDue(tasks[i], now)) {
+        continue;
+      }
+
+      long overdue = (long)(now - tasks[i].deadline);
+      if (overdue > most_overdue) {
+        most_overdue = overdue;
+        next = i;
+      }
+    }
+
+    if (next < 0) {
+      break;
+    }
+
+    stepped |= (1 << next);
+    unsigned long step_start = micros();
+    step(tasks[next], now);
+    tasks[next].busy_us += micros() - step_start;
+  }
+
+  unsigned long spent = micros() - tick_start;
+  if (spent > worst_tick_us) {
+    worst_tick_us = spent;
+  }
+  busy_us += spent;
+}
+
+int SensorScheduler::setPeriod(int task, unsigned long period_ms) {
+  if (task < 0 || task >= task_count) {
+    return 1;
+  }
+
+  SensorTask& changed = tasks[task];
+  changed.next_start = changed.next_start - changed.period_ms + period_ms;
+  changed.period_ms = period_ms;
+  if (changed.state == SensorTaskState::IDLE) {
+    changed.deadline = changed.next_start;
+  }
+
+  return 0;
+}
+
+unsigned long SensorScheduler::getPeriod(int task) const {
+  if (task < 0 || task >= task_count) {
+    return 0;
+  }
+  return tasks[task].period_ms;
+}
+
+unsigned long SensorScheduler::getErrorCount(int task) const {
+  if (task < 0 || task >= task_count) {
+    return 0;
+  }
+  return tasks[task].error_count;
+}
+
+unsigned long SensorScheduler::getBusyMicros(int task) const {
+  if (task < 0 || task >= task_count) {
+    return 0;
+  }
+  return tasks[task].busy_us;
+}
+
+unsigned long SensorScheduler::getDutyCyclePermille() const {
+  uint64_t elapsed = elapsed_us + (micros() - stats_last_us);
+  if (elapsed == 0) {
+    return 0;
+  }
+  return (unsigned long)(busy_us * 1000 / elapsed);
+}
+
+void SensorScheduler::resetStats() {
+  has_ticked = false;
+  last_tick_us = 0;
+  worst_loop_us = 0;
+  worst_tick_us = 0;
+  busy_us = 0;
+  elapsed_us = 0;
+  stats_last_us = micros();
+  for (uint8_t i = 0; i < task_count; i++) {
+    tasks[i].busy_us = 0;
+  }
+}
+
+bool SensorScheduler::isDue(const SensorTask& task, unsigned long now) {
+  return (long)(now - task.deadline) >= 0;
+}
+
+void SensorScheduler::step(SensorTask& task, unsigned long now) {
+  int result;
+
+  if (task.state == SensorTaskState::IDLE) {
+    task.started_at = now;
+
+    // Keep the period grid, but do not try to catch up on missed periods
+    task.next_start += task.period_ms;
+    if ((long)(now - task.next_start) >= 0) {
+      task.next_start = now + task.period_ms;
+    }
+
+    if (task.start != NULL) {
+      if (task.start() != SENSOR_TASK_OK) {
+        finish(task, true);
+        return;
+      }
+
+      task.state = SensorTaskState::CONVERTING;
+      task.deadline = now + task.conversion_ms;
+      return;
+    }
+  } else if (now - task.started_at >= task.timeout_ms) {
+    finish(task, true);
+    return;
+  }
+
+  // Without start the task waits here from the time it is due
+  if (task.ready != NULL && !task.ready()) {
+    task.state = SensorTaskState::CONVERTING;
+    return;
+  }
+
+  result = task.fetch();
+
+  if (result == SENSOR_TASK_PENDING) {
+    task.state = SensorTaskState::CONVERTING;
+    task.deadline = now + task.conversion_ms;
+    return;
+  }
+
+  finish(task, result != SENSOR_TASK_OK);
+}
+
+void SensorScheduler::finish(SensorTask& task, bool failed) {
+  if (failed) {
+    task.error_count++;
+  }
+
+  task.state = SensorTaskState::IDLE;
+  task.deadline = task.next_start;
+}
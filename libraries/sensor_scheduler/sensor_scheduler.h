@@ -0,0 +1,100 @@
+#ifndef SENSOR_SCHEDULER_H
+#define SENSOR_SCHEDULER_H
+
+#include <Arduino.h>
+
+// Cooperative scheduler for sensors split into "start conversion / poll
+// ready / fetch result" steps. Every tick() only issues short bus
+// transactions and never delays, so BLE.poll() keeps being serviced while
+// the sensors are converting.
+
+#define SENSOR_SCHEDULER_MAX_TASKS 8
+
+// Return values of the fetch callback
+#define SENSOR_TASK_OK       0
+#define SENSOR_TASK_ERROR    1
+#define SENSOR_TASK_PENDING  2   // another conversion was started, poll again
+
+// start/fetch return SENSOR_TASK_*, ready returns true once the result can be fetched.
+// start and ready are optional: without start the fetch runs as soon as the
+// task is due and ready, without ready the result is fetched after conversion_ms.
+typedef int (*SensorStartFn)();
+typedef bool (*SensorReadyFn)();
+typedef int (*SensorFetchFn)();
+
+struct SensorTaskState {
+  static const uint8_t IDLE = 0;
+  static const uint8_t CONVERTING = 1;
+};
+
+struct SensorTask {
+  const char* name;
+  unsigned long period_ms;
+  unsigned long conversion_ms;
+  unsigned long timeout_ms;
+  SensorStartFn start;
+  SensorReadyFn ready;
+  SensorFetchFn fetch;
+
+  uint8_t state;
+  unsigned long deadline;
+  unsigned long next_start;
+  unsigned long started_at;
+  unsigned long error_count;
+  unsigned long busy_us;
+};
+
+class SensorScheduler {
+  private:
+    SensorTask tasks[SENSOR_SCHEDULER_MAX_TASKS];
+    uint8_t task_count;
+
+    unsigned long last_tick_us;
+    bool has_ticked;
+    unsigned long worst_loop_us;
+    unsigned long worst_tick_us;
+    // Summed per tick in 64 bit, micros() differences over the whole
+    // statistics window would wrap after 71 minutes
+    uint64_t busy_us;
+    uint64_t elapsed_us;
+    unsigned long stats_last_us;
+
+    bool isDue(const SensorTask& task, unsigned long now);
+    void step(SensorTask& task, unsigned long now);
+    void finish(SensorTask& task, bool failed);
+
+  public:
+    SensorScheduler();
+
+    // Returns the task index or -1 when the table is full
+    int addTask(const char* name, unsigned long period_ms,
+                SensorStartFn start, SensorReadyFn ready, SensorFetchFn fetch,
+                unsigned long conversion_ms = 0, unsigned long timeout_ms = 1000);
+
+    // Dispatches all due steps in deadline order, call once per loop()
+    void tick();
+
+    // Changes the period of a running task, the next start keeps the phase
+    // of the last one. Returns 0 on success.
+    int setPeriod(int task, unsigned long period_ms);
+
+    unsigned long getPeriod(int task) const;
+
+    // Worst gap between two tick() calls, i.e. the worst-case loop latency
+    unsigned long getWorstLoopLatencyMicros() const { return worst_loop_us; }
+
+    // Worst time spent inside a single tick()
+    unsigned long getWorstTickMicros() const { return worst_tick_us; }
+
+    unsigned long getErrorCount(int task) const;
+
+    // Time spent in the steps of a task since resetStats(), mostly bus time
+    unsigned long getBusyMicros(int task) const;
+
+    // Share of the time since resetStats() spent inside tick(), in 1/1000
+    unsigned long getDutyCyclePermille() const;
+
+    void resetStats();
+};
+
+#endif
@@ -1,11 +1,10 @@
 #include "sht30.h"
 
-// CRC-8 polynomial: 0x31 (x^8 + x^5 + x^4 + 1)
-const uint8_t CRC8_POLYNOMIAL = 0x31;
-
-SHT30::SHT30(uint8_t address) {
-  _address = address;
+SHT30::SHT30(uint8_t address) : _bus(address) {
   _lastError = SHT30_OK;
+  _measurementDeadline = 0;
+  _periodicCommand = 0;
+  _restartCommand = 0;
 }
 
 int SHT30::init() {
@@ -19,45 +18,100 @@ int SHT30::init() {
 
 uint8_t SHT30::readTempHumidity(float* temperature, float* humidity, 
                                uint8_t repeatability, int clockStretching) {
-  uint8_t buffer[6];
+  int16_t temperatureCenti;
+  uint16_t humidityCenti;
+  
+  if (readTempHumidityCenti(&temperatureCenti, &humidityCenti, repeatability, clockStretching) == SHT30_OK) {
+    *temperature = temperatureCenti / 100.0f;
+    *humidity = humidityCenti / 100.0f;
+  }
+  return _lastError;
+}
+
+uint8_t SHT30::readTempHumidityCenti(int16_t* temperature, uint16_t* humidity, 
+                                    uint8_t repeatability, int clockStretching) {
   uint16_t command = getCommand(repeatability, clockStretching);
   
+  // With clock stretching the sensor holds the read phase until it is done
+  if (clockStretching) {
+    uint8_t buffer[6];
+    if (readCommand(command, buffer, 6) != SHT30_OK) {
+      return _lastError;
+    }
+    return decodeMeasurement(buffer, temperature, humidity);
+  }
+  
   if (sendCommand(command) != SHT30_OK) {
     return _lastError;
   }
   
   // Wait for measurement to complete based on repeatability
-  uint16_t measurementTime;
-  switch (repeatability) {
-    case SHT30_Repeatability::HIGH:
-      measurementTime = clockStretching ? 0 : 15;  // 15ms for high repeatability
-      break;
-    case SHT30_Repeatability::MEDIUM:
-      measurementTime = clockStretching ? 0 : 6;   // 6ms for medium repeatability
-      break;
-    case SHT30_Repeatability::LOW:
-      measurementTime = clockStretching ? 0 : 4;   // 4ms for low repeatability
-      break;
-    default:
-      measurementTime = 15;
-      break;
+  delay(getMeasurementTime(repeatability));
+  
+  return fetchMeasurementCenti(temperature, humidity);
+}
+
+uint8_t SHT30::startMeasurement(uint8_t repeatability) {
+  if (writeCommand(getCommand(repeatability, 0)) != SHT30_OK) {
+    return _lastError;
   }
   
-  if (measurementTime > 0) {
-    delay(measurementTime);
+  _measurementDeadline = millis() + getMeasurementTime(repeatability);
+  return _lastError;
+}
+
+bool SHT30::isMeasurementReady() {
+  if (_periodicCommand == 0 && (long)(millis() - _measurementDeadline) < 0) {
+    return false;
   }
   
-  // Read measurement data (6 bytes: temp MSB, temp LSB, temp CRC, hum MSB, hum LSB, hum CRC)
-  if (readData(buffer, 6) != SHT30_OK) {
-    return _lastError;
+  if (!i2cAsync.isRunning() || _request.isDone()) {
+    return true;
   }
   
-  if (verifyCRC(&buffer[0], 2, buffer[2]) != 0) {
-    _lastError = SHT30_ERROR_CRC;
+  // A full queue is retried on the next poll
+  if (!_request.isBusy()) {
+    if (_periodicCommand != 0) {
+      uint8_t command[2] = {SHT30_CMD_FETCH_DATA >> 8, SHT30_CMD_FETCH_DATA & 0xFF};
+      _request.submit(_bus.getAddress(), command, 2, _result, 6);
+    } else {
+      _request.submit(_bus.getAddress(), NULL, 0, _result, 6);
+    }
+  }
+  return false;
+}
+
+uint8_t SHT30::fetchMeasurement(float* temperature, float* humidity) {
+  int16_t temperatureCenti;
+  uint16_t humidityCenti;
+  
+  if (fetchMeasurementCenti(&temperatureCenti, &humidityCenti) == SHT30_OK) {
+    *temperature = temperatureCenti / 100.0f;
+    *humidity = humidityCenti / 100.0f;
+  }
+  return _lastError;
+}
+
+uint8_t SHT30::fetchMeasurementCenti(int16_t* temperature, uint16_t* humidity) {
+  uint8_t buffer[6];
+  
+  if (_request.isDone()) {
+    if (setBusError(_request.take()) != SHT30_OK) {
+      return _lastError;
+    }
+    return decodeMeasurement(_result, temperature, humidity);
+  }
+  
+  // Read measurement data (6 bytes: temp MSB, temp LSB, temp CRC, hum MSB, hum LSB, hum CRC)
+  if (readData(buffer, 6) != SHT30_OK) {
     return _lastError;
   }
   
-  if (verifyCRC(&buffer[3], 2, buffer[5]) != 0) {
+  return decodeMeasurement(buffer, temperature, humidity);
+}
+
+uint8_t SHT30::decodeMeasurement(const uint8_t* buffer, int16_t* temperature, uint16_t* humidity) {
+  if (!crc8CheckWords(buffer, 2, CRC8_INIT_SHT30)) {
     _lastError = SHT30_ERROR_CRC;
     return _lastError;
   }
@@ -65,14 +119,137 @@ uint8_t SHT30::readTempHumidity(float* temperature, float* humidity,
   uint16_t rawTemp = (buffer[0] << 8) | buffer[1];
   uint16_t rawHum = (buffer[3] << 8) | buffer[4];
   
-  *temperature = -45.0 + 175.0 * ((float)rawTemp / 65535.0);
+  *temperature = convertTemperatureCenti(rawTemp);
   
-  *humidity = 100.0 * ((float)rawHum / 65535.0);
+  *humidity = convertHumidityCenti(rawHum);
   
   _lastError = SHT30_OK;
   return _lastError;
 }
 
+uint8_t SHT30::startPeriodic(uint8_t rate, uint8_t repeatability) {
+  uint16_t command = getPeriodicCommand(rate, repeatability);
+  
+  if (_periodicCommand != 0 && stopPeriodic() != SHT30_OK) {
+    return _lastError;
+  }
+  
+  if (sendCommand(command) != SHT30_OK) {
+    return _lastError;
+  }
+  
+  _periodicCommand = command;
+  _restartCommand = 0;
+  return _lastError;
+}
+
+uint8_t SHT30::startART() {
+  if (_periodicCommand != 0 && stopPeriodic() != SHT30_OK) {
+    return _lastError;
+  }
+  
+  if (sendCommand(SHT30_CMD_ART) != SHT30_OK) {
+    return _lastError;
+  }
+  
+  _periodicCommand = SHT30_CMD_ART;
+  _restartCommand = 0;
+  return _lastError;
+}
+
+uint8_t SHT30::stopPeriodic() {
+  // sendCommand waits the 1 ms the sensor needs to abort the measurement
+  if (sendCommand(SHT30_CMD_BREAK) != SHT30_OK) {
+    return _lastError;
+  }
+  
+  _periodicCommand = 0;
+  _restartCommand = 0;
+  return _lastError;
+}
+
+bool SHT30::isPeriodic() {
+  return _periodicCommand != 0;
+}
+
+uint8_t SHT30::fetch(float* temperature, float* humidity) {
+  int16_t temperatureCenti;
+  uint16_t humidityCenti;
+  
+  if (fetchCenti(&temperatureCenti, &humidityCenti) == SHT30_OK) {
+    *temperature = temperatureCenti / 100.0f;
+    *humidity = humidityCenti / 100.0f;
+  }
+  return _lastError;
+}
+
+uint8_t SHT30::fetchCenti(int16_t* temperature, uint16_t* humidity) {
+  uint8_t buffer[6];
+  
+  if (_restartCommand != 0 && restartPeriodic() != SHT30_OK) {
+    return _lastError;
+  }
+  
+  if (_request.isDone()) {
+    if (setBusError(_request.take()) != SHT30_OK) {
+      return _lastError;
+    }
+    return decodeMeasurement(_result, temperature, humidity);
+  }
+  
+  // The sensor NACKs the read header if there is no new result
+  if (readCommand(SHT30_CMD_FETCH_DATA, buffer, 6) != SHT30_OK) {
+    return _lastError;
+  }
+  
+  return decodeMeasurement(buffer, temperature, humidity);
+}
+
+uint8_t SHT30::checkStatus(uint16_t* status) {
+  // Only fetch and break are accepted during periodic acquisition
+  if (_periodicCommand != 0) {
+    uint16_t periodicCommand = _periodicCommand;
+    if (stopPeriodic() != SHT30_OK) {
+      return _lastError;
+    }
+    _restartCommand = periodicCommand;
+  }
+  
+  if (readStatusRegister(status) != SHT30_OK) {
+    return _lastError;
+  }
+  
+  if ((*status & SHT30_STATUS_RESET_DETECTED) && clearStatusRegister() != SHT30_OK) {
+    return _lastError;
+  }
+  
+  if (_restartCommand != 0) {
+    restartPeriodic();
+  }
+  
+  return _lastError;
+}
+
+uint8_t SHT30::restartPeriodic() {
+  if (sendCommand(_restartCommand) != SHT30_OK) {
+    return _lastError;
+  }
+  
+  _periodicCommand = _restartCommand;
+  _restartCommand = 0;
+  return _lastError;
+}
+
+// T = -45 + 175 * raw / 65535 and RH = 100 * raw / 65535 in hundredths,
+// rounded. The products stay below 2^31.
+int16_t SHT30::convertTemperatureCenti(uint16_t raw) {
+  return (int16_t)((int32_t)((17500UL * raw + 32767) / 65535) - 4500);
+}
+
+uint16_t SHT30::convertHumidityCenti(uint16_t raw) {
+  return (uint16_t)((10000UL * raw + 32767) / 65535);
+}
+
 uint8_t SHT30::readTemperature(float* temperature, uint8_t repeatability, int clockStretching) {
   float dummy_humidity;
   return readTempHumidity(temperature, &dummy_humidity, repeatability, clockStretching);
@@ -87,6 +264,8 @@ uint8_t SHT30::softReset() {
   uint8_t result = sendCommand(SHT30_CMD_SOFT_RESET);
   if (result == SHT30_OK) {
     delay(2);  // Wait 2ms for reset to complete
+    _periodicCommand = 0;
+    _restartCommand = 0;
   }
   return result;
 }
@@ -102,15 +281,11 @@ uint8_t SHT30::disableHeater() {
 uint8_t SHT30::readStatusRegister(uint16_t* status) {
   uint8_t buffer[3];
   
-  if (sendCommand(SHT30_CMD_STATUS_REGISTER) != SHT30_OK) {
-    return _lastError;
-  }
-  
-  if (readData(buffer, 3) != SHT30_OK) {
+  if (readCommand(SHT30_CMD_STATUS_REGISTER, buffer, 3) != SHT30_OK) {
     return _lastError;
   }
   
-  if (verifyCRC(&buffer[0], 2, buffer[2]) != 0) {
+  if (!crc8CheckWords(buffer, 1, CRC8_INIT_SHT30)) {
     _lastError = SHT30_ERROR_CRC;
     return _lastError;
   }
@@ -125,8 +300,7 @@ uint8_t SHT30::clearStatusRegister() {
 }
 
 int SHT30::isConnected() {
-  Wire.beginTransmission(_address);
-  return Wire.endTransmission();
+  return _bus.probe();
 }
 
 uint8_t SHT30::getLastError() {
@@ -134,62 +308,46 @@ uint8_t SHT30::getLastError() {
 }
 
 
-uint8_t SHT30::calculateCRC(const uint8_t* data, uint8_t length) {
-  uint8_t crc = 0xFF;  // Initial value
-  
-  for (uint8_t i = 0; i < length; i++) {
-    crc ^= data[i];
-    for (uint8_t bit = 8; bit > 0; --bit) {
-      if (crc & 0x80) {
-        crc = (crc << 1) ^ CRC8_POLYNOMIAL;
-      } else {
-        crc = (crc << 1);
-      }
-    }
+uint8_t SHT30::setBusError(uint8_t result) {
+  switch (result) {
+    case I2C_OK:
+      _lastError = SHT30_OK;
+      break;
+    case I2C_ERROR_NO_DATA:
+    case I2C_ERROR_SHORT:
+      _lastError = SHT30_ERROR_NO_DATA;
+      break;
+    case I2C_ERROR_TIMEOUT:
+      _lastError = SHT30_ERROR_TIMEOUT;
+      break;
+    default:
+      _lastError = SHT30_ERROR_I2C;
+      break;
   }
-  
-  return crc;
+  return _lastError;
 }
 
-int SHT30::verifyCRC(const uint8_t* data, uint8_t length, uint8_t expectedCRC) {
-  return (calculateCRC(data, length) == expectedCRC) ? 0 : 1;
+uint8_t SHT30::writeCommand(uint16_t command) {
+  // A new command makes a result read ahead stale
+  _request.cancel();
+  return setBusError(_bus.writeCommand(command));
 }
 
 uint8_t SHT30::sendCommand(uint16_t command) {
-  Wire.beginTransmission(_address);
-  Wire.write(command >> 8);    // MSB
-  Wire.write(command & 0xFF);  // LSB
-  
-  uint8_t result = Wire.endTransmission();
-  if (result != 0) {
-    _lastError = SHT30_ERROR_I2C;
+  if (writeCommand(command) != SHT30_OK) {
     return _lastError;
   }
   
   delay(1);  // Minimum waiting time between commands
-  _lastError = SHT30_OK;
   return _lastError;
 }
 
 uint8_t SHT30::readData(uint8_t* buffer, uint8_t length) {
-  uint8_t bytesRead = Wire.requestFrom(_address, length);
-  
-  if (bytesRead != length) {
-    _lastError = SHT30_ERROR_NO_DATA;
-    return _lastError;
-  }
-  
-  for (uint8_t i = 0; i < length; i++) {
-    if (Wire.available()) {
-      buffer[i] = Wire.read();
-    } else {
-      _lastError = SHT30_ERROR_NO_DATA;
-      return _lastError;
-    }
-  }
-  
-  _lastError = SHT30_OK;
-  return _lastError;
+  return setBusError(_bus.receive(buffer, length));
+}
+
+uint8_t SHT30::readCommand(uint16_t command, uint8_t* buffer, uint8_t length) {
+  return setBusError(_bus.readCommand(command, buffer, length));
 }
 
 uint16_t SHT30::getCommand(uint8_t repeatability, int clockStretching) {
@@ -216,4 +374,37 @@ uint16_t SHT30::getCommand(uint8_t repeatability, int clockStretching) {
         return SHT30_CMD_MEASURE_HIGH_REP_NOSTRETCH;
     }
   }
-}
\ No newline at end of file
+}
+
+uint16_t SHT30::getPeriodicCommand(uint8_t rate, uint8_t repeatability) {
+  // Rows: 0.5, 1, 2, 4, 10 mps. Columns: high, medium, low repeatability
+  static const uint16_t commands[5][3] = {
+    {0x2032, 0x2024, 0x202F},
+    {0x2130, 0x2126, 0x212D},
+    {0x2236, 0x2220, 0x222B},
+    {0x2334, 0x2322, 0x2329},
+    {0x2737, 0x2721, 0x272A}
+  };
+  
+  if (rate > SHT30_Rate::MPS_10) {
+    rate = SHT30_Rate::MPS_1;
+  }
+  if (repeatability > SHT30_Repeatability::LOW) {
+    repeatability = SHT30_Repeatability::HIGH;
+  }
+  
+  return commands[rate][repeatability];
+}
+
+uint16_t SHT30::getMeasurementTime(uint8_t repeatability) {
+  switch (repeatability) {
+    case SHT30_Repeatability::HIGH:
+      return 15;  // 15ms for high repeatability
+    case SHT30_Repeatability::MEDIUM:
+      return 6;   // 6ms for medium repeatability
+    case SHT30_Repeatability::LOW:
+      return 4;   // 4ms for low repeatability
+    default:
+      return 15;
+  }
+}
@@ -4,6 +4,9 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include "crc8.h"
+#include "i2c_register.h"
+#include "i2c_async.h"
 
 // addresses are according to the sensor datasheet
 // https://cdn-shop.adafruit.com/product-files/5064/5064_Sensirion_Humidity_Sensors_SHT3x_Datasheet_digital.pdf
@@ -21,6 +24,11 @@
 #define SHT30_CMD_MEASURE_MEDIUM_REP_NOSTRETCH 0x240B // Medium repeatability without clock stretching
 #define SHT30_CMD_MEASURE_LOW_REP_NOSTRETCH   0x2416  // Low repeatability without clock stretching
 
+// Periodic data acquisition, see getPeriodicCommand() for the mps commands
+#define SHT30_CMD_ART           0x2B32  // accelerated response time, 4 mps
+#define SHT30_CMD_FETCH_DATA    0xE000
+#define SHT30_CMD_BREAK         0x3093
+
 // Other commands
 #define SHT30_CMD_SOFT_RESET    0x30A2
 #define SHT30_CMD_HEATER_ENABLE 0x306D
@@ -28,6 +36,13 @@
 #define SHT30_CMD_STATUS_REGISTER 0xF32D
 #define SHT30_CMD_CLEAR_STATUS  0x3041
 
+// Status register bits
+#define SHT30_STATUS_ALERT_PENDING   0x8000
+#define SHT30_STATUS_HEATER_ON       0x2000
+#define SHT30_STATUS_RESET_DETECTED  0x0010
+#define SHT30_STATUS_COMMAND_FAILED  0x0002
+#define SHT30_STATUS_CHECKSUM_FAILED 0x0001
+
 // Error codes
 #define SHT30_OK                0
 #define SHT30_ERROR_TIMEOUT     1
@@ -42,17 +57,37 @@ struct SHT30_Repeatability {
   static const uint8_t LOW = 2;
 };
 
+// Measurements per second of the periodic mode
+struct SHT30_Rate {
+  static const uint8_t MPS_0_5 = 0;
+  static const uint8_t MPS_1 = 1;
+  static const uint8_t MPS_2 = 2;
+  static const uint8_t MPS_4 = 3;
+  static const uint8_t MPS_10 = 4;
+};
+
 class SHT30 {
 private:
-  uint8_t _address;
+  I2CRegisters _bus;
   uint8_t _lastError;
+  unsigned long _measurementDeadline;
+  uint16_t _periodicCommand;  // 0 in single shot mode
+  uint16_t _restartCommand;   // periodic mode checkStatus() still has to restart, 0 if none
+  I2CAsyncRequest _request;   // single shot result read ahead by isMeasurementReady()
+  uint8_t _result[6];
   
   
-  uint8_t calculateCRC(const uint8_t* data, uint8_t length);
-  int verifyCRC(const uint8_t* data, uint8_t length, uint8_t expectedCRC);
+  uint8_t setBusError(uint8_t result);
+  uint8_t writeCommand(uint16_t command);
   uint8_t sendCommand(uint16_t command);
+  uint16_t getMeasurementTime(uint8_t repeatability);
   uint8_t readData(uint8_t* buffer, uint8_t length);
+  uint8_t restartPeriodic();
+  // Command, repeated start and the read in one transaction
+  uint8_t readCommand(uint16_t command, uint8_t* buffer, uint8_t length);
+  uint8_t decodeMeasurement(const uint8_t* buffer, int16_t* temperature, uint16_t* humidity);
   uint16_t getCommand(uint8_t repeatability, int clockStretching);
+  uint16_t getPeriodicCommand(uint8_t rate, uint8_t repeatability);
 
 public:
   
@@ -66,6 +101,12 @@ public:
                           uint8_t repeatability = SHT30_Repeatability::HIGH,
                           int clockStretching = 1);
   
+  // Integer variants in hundredths of a degree and a %RH, the float
+  // readers are derived from them
+  uint8_t readTempHumidityCenti(int16_t* temperature, uint16_t* humidity,
+                               uint8_t repeatability = SHT30_Repeatability::HIGH,
+                               int clockStretching = 1);
+  
   
   uint8_t readTemperature(float* temperature, 
                          uint8_t repeatability = SHT30_Repeatability::HIGH,
@@ -75,6 +116,33 @@ public:
                       uint8_t repeatability = SHT30_Repeatability::HIGH,
                       int clockStretching = 1);
   
+  // Non-blocking single shot: start without clock stretching, poll
+  // isMeasurementReady() and fetch the result once the conversion is done.
+  // While i2cAsync is running the result is read in the background and
+  // isMeasurementReady() only reports true once it arrived.
+  uint8_t startMeasurement(uint8_t repeatability = SHT30_Repeatability::HIGH);
+  bool isMeasurementReady();
+  uint8_t fetchMeasurement(float* temperature, float* humidity);
+  uint8_t fetchMeasurementCenti(int16_t* temperature, uint16_t* humidity);
+  
+  // Periodic mode: the sensor measures on its own and fetch() reads the
+  // latest result in one transaction. fetch() returns SHT30_ERROR_NO_DATA
+  // while there is no new result since the last fetch. With i2cAsync
+  // running, isMeasurementReady() reads it in the background first.
+  uint8_t startPeriodic(uint8_t rate, uint8_t repeatability = SHT30_Repeatability::HIGH);
+  uint8_t startART();
+  uint8_t stopPeriodic();
+  bool isPeriodic();
+  uint8_t fetch(float* temperature, float* humidity);
+  uint8_t fetchCenti(int16_t* temperature, uint16_t* humidity);
+  
+  // Reads the status register and restarts the periodic mode if the
+  // sensor went through a reset, which drops it back to single shot mode.
+  // A restart that fails is retried by the next fetch(), which returns the
+  // error until it succeeds; startPeriodic(), startART(), stopPeriodic()
+  // and softReset() replace it.
+  uint8_t checkStatus(uint16_t* status);
+  
   
   uint8_t softReset();
   uint8_t enableHeater();
@@ -85,6 +153,10 @@ public:
   
   int isConnected();
   uint8_t getLastError();
+  
+  // Datasheet conversions of a raw reading, without any float math
+  static int16_t convertTemperatureCenti(uint16_t raw);
+  static uint16_t convertHumidityCenti(uint16_t raw);
 };
 
 #endif 
\ No newline at end of file
@@ -15,9 +15,7 @@ int SI7021::init() {
 }
 
 int SI7021::reset() {
-    Wire.beginTransmission(SI7021_ADDRESS);
-    Wire.write(SI7021_RESET);
-    if (Wire.endTransmission() != 0) {
+    if (bus.writeByte(SI7021_RESET) != I2C_OK) {
         return 1;
     }
     delay(100); 
@@ -25,69 +23,242 @@ int SI7021::reset() {
 }
 
 float SI7021::readHumidity() {
-    Wire.beginTransmission(SI7021_ADDRESS);
-    Wire.write(SI7021_MEASURE_HUMIDITY_HOLD);
-    if (Wire.endTransmission() != 0) {
+    uint16_t rawHumidity;
+    if (readRawValue(SI7021_MEASURE_HUMIDITY_HOLD, &rawHumidity, true) != 0) {
         return ERROR_VALUE;
     }
     
-    delay(30); 
-    
-    Wire.requestFrom(SI7021_ADDRESS, 2);
-    if (Wire.available() != 2) {
+    return convertHumidity(rawHumidity);
+}
+
+float SI7021::readTemperature() {
+    uint16_t rawTemperature;
+    if (readRawValue(SI7021_MEASURE_TEMP_HOLD, &rawTemperature, true) != 0) {
         return ERROR_VALUE;
     }
     
-    uint16_t rawHumidity = Wire.read() << 8;
-    rawHumidity |= Wire.read();
-    
-    float humidity = ((float)rawHumidity * 125.0 / 65536.0) - 6.0;
-    
-    
-    if (humidity < 0) humidity = 0;
-    if (humidity > 100) humidity = 100;
-    
-    return humidity;
+    return convertTemperature(rawTemperature);
 }
 
-float SI7021::readTemperature() {
-    Wire.beginTransmission(SI7021_ADDRESS);
-    Wire.write(SI7021_MEASURE_TEMP_HOLD);
-    if (Wire.endTransmission() != 0) {
+float SI7021::readTemperatureFromHumidity() {
+    uint16_t rawTemperature;
+    if (readTemperatureFromHumidityRaw(&rawTemperature) != 0) {
         return ERROR_VALUE;
     }
     
-    delay(30); 
-    
-    Wire.requestFrom(SI7021_ADDRESS, 2);
-    if (Wire.available() != 2) {
+    return convertTemperature(rawTemperature);
+}
+
+int SI7021::readTemperatureFromHumidityCenti(int16_t* temperature) {
+    uint16_t rawTemperature;
+    if (readTemperatureFromHumidityRaw(&rawTemperature) != 0) {
+        return 1;
+    }
+
+    *temperature = convertTemperatureCenti(rawTemperature);
+    return 0;
+}
+
+int SI7021::readTempHumidity(float* temperature, float* humidity) {
+    if (startHumidityMeasurement() != 0) {
+        return 1;
+    }
+
+    // Polls before the typical time only cost bus time
+    unsigned long start = millis();
+    delay(SI7021_HUMIDITY_TYPICAL_MS);
+    while (!isMeasurementReady()) {
+        // Runs the poll callbacks while the queue is up, no-op otherwise
+        i2cAsync.service();
+        if (millis() - start > SI7021_CONVERSION_TIMEOUT_MS) {
+            return 1;
+        }
+        delay(SI7021_POLL_INTERVAL_MS);
+    }
+
+    *humidity = fetchHumidity();
+    if (*humidity == ERROR_VALUE) {
+        return 1;
+    }
+
+    *temperature = readTemperatureFromHumidity();
+    if (*temperature == ERROR_VALUE) {
+        return 1;
+    }
+
+    return 0;
+}
+
+int SI7021::startHumidityMeasurement() {
+    return startMeasurement(SI7021_MEASURE_HUMIDITY_NO_HOLD);
+}
+
+int SI7021::startTemperatureMeasurement() {
+    return startMeasurement(SI7021_MEASURE_TEMP_NO_HOLD);
+}
+
+bool SI7021::isMeasurementReady() {
+    if (i2cAsync.isRunning()) {
+        return pollMeasurementAsync();
+    }
+
+    if (measurement_ready) {
+        return true;
+    }
+
+    // The chip NACKs its read address until the conversion is done
+    if (bus.receive(measurement, 3) != I2C_OK) {
+        return false;
+    }
+
+    measurement_ready = true;
+    return true;
+}
+
+bool SI7021::pollMeasurementAsync() {
+    if (request.isBusy()) {
+        return false;
+    }
+
+    if (request.isDone()) {
+        uint8_t result = request.take();
+        if (!measurement_ready) {
+            measurement_ready = result == I2C_OK;
+        } else {
+            // On failure readTemperatureFromHumidity() reads it itself
+            rh_temperature_ready = result == I2C_OK;
+            prefetch_temperature = false;
+        }
+    }
+
+    // A full queue is retried on the next poll
+    if (!measurement_ready) {
+        request.submit(SI7021_ADDRESS, NULL, 0, measurement, 3);
+        return false;
+    }
+
+    if (!prefetch_temperature) {
+        return true;
+    }
+
+    uint8_t command = SI7021_READ_TEMP_FROM_RH;
+    if (!request.submit(SI7021_ADDRESS, &command, 1, rh_temperature, 2)) {
+        prefetch_temperature = false;
+        return true;
+    }
+    return false;
+}
+
+float SI7021::fetchHumidity() {
+    uint16_t rawHumidity;
+    if (fetchRawValue(&rawHumidity) != 0) {
         return ERROR_VALUE;
     }
     
-    uint16_t rawTemperature = Wire.read() << 8;
-    rawTemperature |= Wire.read();
-    
-    float temperature = ((float)rawTemperature * 175.72 / 65536.0) - 46.85;
-    
-    return temperature;
+    return convertHumidity(rawHumidity);
 }
 
-float SI7021::readTemperatureFromHumidity() {
-    Wire.beginTransmission(SI7021_ADDRESS);
-    Wire.write(SI7021_READ_TEMP_FROM_RH);
-    if (Wire.endTransmission() != 0) {
+float SI7021::fetchTemperature() {
+    uint16_t rawTemperature;
+    if (fetchRawValue(&rawTemperature) != 0) {
         return ERROR_VALUE;
     }
     
-    Wire.requestFrom(SI7021_ADDRESS, 2);
-    if (Wire.available() != 2) {
-        return ERROR_VALUE;
+    return convertTemperature(rawTemperature);
+}
+
+int SI7021::fetchHumidityCenti(uint16_t* humidity) {
+    uint16_t rawHumidity;
+    if (fetchRawValue(&rawHumidity) != 0) {
+        return 1;
+    }
+
+    *humidity = convertHumidityCenti(rawHumidity);
+    return 0;
+}
+
+int SI7021::fetchTemperatureCenti(int16_t* temperature) {
+    uint16_t rawTemperature;
+    if (fetchRawValue(&rawTemperature) != 0) {
+        return 1;
+    }
+
+    *temperature = convertTemperatureCenti(rawTemperature);
+    return 0;
+}
+
+int SI7021::startMeasurement(uint8_t command) {
+    request.cancel();
+    measurement_ready = false;
+    rh_temperature_ready = false;
+    prefetch_temperature = command == SI7021_MEASURE_HUMIDITY_NO_HOLD;
+
+    if (bus.writeByte(command) != I2C_OK) {
+        return 1;
     }
     
-    uint16_t rawTemperature = Wire.read() << 8;
-    rawTemperature |= Wire.read();
+    return 0;
+}
+
+int SI7021::fetchRawValue(uint16_t* raw) {
+    if (!measurement_ready && !isMeasurementReady()) {
+        return 1;
+    }
+    measurement_ready = false;
+
+    if (!crc8CheckWords(measurement, 1, CRC8_INIT_SI7021)) {
+        return 1;
+    }
+
+    *raw = (measurement[0] << 8) | measurement[1];
+    return 0;
+}
+
+int SI7021::readTemperatureFromHumidityRaw(uint16_t* raw) {
+    if (rh_temperature_ready) {
+        rh_temperature_ready = false;
+        *raw = (rh_temperature[0] << 8) | rh_temperature[1];
+        return 0;
+    }
+
+    return readRawValue(SI7021_READ_TEMP_FROM_RH, raw, false);
+}
+
+int SI7021::readRawValue(uint8_t command, uint16_t* raw, bool checksum) {
+    uint8_t data[3];
+    uint8_t length = checksum ? 3 : 2;
+
+    if (bus.read(command, data, length) != I2C_OK) {
+        return 1;
+    }
+
+    if (checksum && !crc8CheckWords(data, 1, CRC8_INIT_SI7021)) {
+        return 1;
+    }
+
+    *raw = (data[0] << 8) | data[1];
+    return 0;
+}
+
+// RH = 125 * raw / 65536 - 6 and T = 175.72 * raw / 65536 - 46.85 in
+// hundredths, rounded. The products stay below 2^31.
+uint16_t SI7021::convertHumidityCenti(uint16_t raw) {
+    int32_t humidity = (int32_t)((12500UL * raw + 32768) >> 16) - 600;
     
-    float temperature = ((float)rawTemperature * 175.72 / 65536.0) - 46.85;
+    if (humidity < 0) humidity = 0;
+    if (humidity > 10000) humidity = 10000;
     
-    return temperature;
+    return humidity;
+}
+
+int16_t SI7021::convertTemperatureCenti(uint16_t raw) {
+    return (int16_t)((int32_t)((17572UL * raw + 32768) >> 16) - 4685);
+}
+
+float SI7021::convertHumidity(uint16_t raw) {
+    return convertHumidityCenti(raw) / 100.0f;
+}
+
+float SI7021::convertTemperature(uint16_t raw) {
+    return convertTemperatureCenti(raw) / 100.0f;
 }
\ No newline at end of file
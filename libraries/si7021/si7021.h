@@ -3,6 +3,9 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include "crc8.h"
+#include "i2c_register.h"
+#include "i2c_async.h"
 
 // addresses are according to the sensor datasheet
 // https://www.silabs.com/documents/public/data-sheets/Si7021-A20.pdf
@@ -19,6 +22,16 @@
 #define SI7021_READ_TEMP_FROM_RH         0xE0
 #define SI7021_RESET                     0xFE
 
+// Maximum conversion times (12-bit RH + 14-bit temperature)
+#define SI7021_HUMIDITY_CONVERSION_MS    23
+#define SI7021_TEMP_CONVERSION_MS        11
+// Typical humidity conversion time, polling before that only costs bus time
+#define SI7021_HUMIDITY_TYPICAL_MS       17
+// Give up polling a no-hold conversion after this
+#define SI7021_CONVERSION_TIMEOUT_MS     50
+// Time between two polls of a blocking no-hold read after the typical time
+#define SI7021_POLL_INTERVAL_MS          1
+
 class SI7021 {
 public:
     SI7021();
@@ -33,13 +46,82 @@ public:
     
     
     float readTemperatureFromHumidity();
+
+    // One no-hold humidity conversion and the temperature it measured
+    // along the way. Waits the typical conversion time, then polls every
+    // SI7021_POLL_INTERVAL_MS until the chip stops NACKing. Returns 0 on
+    // success.
+    int readTempHumidity(float* temperature, float* humidity);
     
     
     int reset();
 
+    // Non-blocking measurement: start a no-hold conversion, poll
+    // isMeasurementReady() and fetch the result once it is done.
+    // isMeasurementReady() reads the result as soon as the chip ACKs.
+    // While i2cAsync is running the polls go through its queue, and after
+    // a humidity conversion the temperature is read ahead as well, so
+    // fetchHumidity() and readTemperatureFromHumidity() need no bus time.
+    int startHumidityMeasurement();
+
+    int startTemperatureMeasurement();
+
+    bool isMeasurementReady();
+
+    float fetchHumidity();
+
+    float fetchTemperature();
+
+    // Integer variants in hundredths of a %RH and a degree, the floats
+    // above are derived from them. Return 0 on success.
+    int fetchHumidityCenti(uint16_t* humidity);
+
+    int fetchTemperatureCenti(int16_t* temperature);
+
+    int readTemperatureFromHumidityCenti(int16_t* temperature);
+
+    // Datasheet conversions of a raw reading, without any float math
+    static uint16_t convertHumidityCenti(uint16_t raw);
+
+    static int16_t convertTemperatureCenti(uint16_t raw);
+
 private:
     
     static constexpr float ERROR_VALUE = -999.0;
+
+    I2CRegisters bus{SI7021_ADDRESS};
+
+    // MSB, LSB and checksum of the finished no-hold conversion
+    uint8_t measurement[3];
+
+    bool measurement_ready = false;
+
+    // Temperature of the last humidity conversion, read ahead by the queue
+    uint8_t rh_temperature[2];
+
+    bool rh_temperature_ready = false;
+
+    bool prefetch_temperature = false;
+
+    I2CAsyncRequest request;
+
+    bool pollMeasurementAsync();
+
+    int startMeasurement(uint8_t command);
+
+    int fetchRawValue(uint16_t* raw);
+
+    // Sends command and reads its result after a repeated start, in hold
+    // mode the chip stretches the clock until the conversion is done. The
+    // read temperature from RH command has no checksum.
+    int readRawValue(uint8_t command, uint16_t* raw, bool checksum);
+
+    // Uses the temperature read ahead by the queue if there is one
+    int readTemperatureFromHumidityRaw(uint16_t* raw);
+
+    float convertHumidity(uint16_t raw);
+
+    float convertTemperature(uint16_t raw);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef MOVEMENT_DATA_H
+#define MOVEMENT_DATA_H
+
+// Result types of the movement analysis, kept free of Arduino headers so
+// host side decoders can use them too.
+
+enum ActivityState {
+  STILL = 0,
+  MOVING = 1,
+  ACTIVE = 2
+};
+
+struct MovementData {
+  ActivityState current_state;
+  float movement_intensity;
+  int movements_per_minute;
+  bool is_likely_asleep;
+  unsigned long still_duration_minutes;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#include "movement_kernel.h"
+#include <string.h>
+
+// The dual 16 bit multiplies of arm_acle.h belong to the SIMD32 group
+#if defined(__ARM_FEATURE_DSP) && defined(__ARM_FEATURE_SIMD32)
+#include <arm_acle.h>
+#define MOVEMENT_KERNEL_DSP 1
+#else
+#define MOVEMENT_KERNEL_DSP 0
+#endif
+
+static_assert(MOVEMENT_STILL_SQ < MOVEMENT_ACTIVE_SQ, "active threshold must be above the movement threshold");
+
+void movementSquares(const int16_t (*xyz)[3], uint8_t count, uint32_t* squares) {
+  for (uint8_t i = 0; i < count; i++) {
+#if MOVEMENT_KERNEL_DSP
+    // x | y << 16 as one word, then x * x + y * y at once. 2 * 32768^2
+    // wraps the signed result, it is exact as unsigned.
+    uint32_t xy;
+    memcpy(&xy, xyz[i], sizeof(xy));
+    squares[i] = (uint32_t)__smuad(xy, xy) + (uint32_t)((int32_t)xyz[i][2] * xyz[i][2]);
+#else
+    squares[i] = movementSquare(xyz[i][0], xyz[i][1], xyz[i][2]);
+#endif
+  }
+}
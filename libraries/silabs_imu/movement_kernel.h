@@ -0,0 +1,56 @@
+#ifndef MOVEMENT_KERNEL_H
+#define MOVEMENT_KERNEL_H
+
+#include <stdint.h>
+#include "movement_data.h"
+#include "int_math.h"
+
+// Fixed-point movement detection on the dynamic acceleration (posture.h),
+// 16384 counts per g. Squared magnitudes are compared against squared
+// thresholds, so classifying a sample needs no square root. With the DSP
+// extension (Cortex-M33) the x/y pair of a sample is squared and summed by
+// a single dual multiply.
+
+#define MOVEMENT_COUNTS_PER_G 16384
+
+// Thresholds in g, a sample is STILL while the dynamic acceleration stays
+// below the movement threshold and ACTIVE once it reaches the active one
+#define MOVEMENT_THRESHOLD 0.15
+#define ACTIVE_THRESHOLD   0.5
+
+// Smallest integer square that is not below (g * 16384)^2
+constexpr uint32_t movementSquareCeil(double g) {
+  return (uint32_t)(g * MOVEMENT_COUNTS_PER_G * g * MOVEMENT_COUNTS_PER_G) +
+         ((double)(uint32_t)(g * MOVEMENT_COUNTS_PER_G * g * MOVEMENT_COUNTS_PER_G) < g * MOVEMENT_COUNTS_PER_G * g * MOVEMENT_COUNTS_PER_G ? 1 : 0);
+}
+
+// |d| < threshold <=> d^2 < ceil(threshold^2) for integer squares. As
+// constants the double math is guaranteed to stay in the compiler.
+constexpr uint32_t MOVEMENT_STILL_SQ = movementSquareCeil(MOVEMENT_THRESHOLD);
+constexpr uint32_t MOVEMENT_ACTIVE_SQ = movementSquareCeil(ACTIVE_THRESHOLD);
+
+// x^2 + y^2 + z^2 of one sample, at most 3 * 32768^2 so it fits unsigned
+inline uint32_t movementSquare(int16_t x, int16_t y, int16_t z) {
+  return (uint32_t)((int32_t)x * x) + (uint32_t)((int32_t)y * y) + (uint32_t)((int32_t)z * z);
+}
+
+// Counts to milli-g, rounded, for at most the 56756 counts of a full
+// scale sample
+inline uint16_t movementMilliG(uint32_t counts) {
+  return (uint16_t)((counts * 1000 + MOVEMENT_COUNTS_PER_G / 2) / MOVEMENT_COUNTS_PER_G);
+}
+
+// Squared magnitudes of count samples stored as x, y, z triplets
+void movementSquares(const int16_t (*xyz)[3], uint8_t count, uint32_t* squares);
+
+inline ActivityState movementClassify(uint32_t square) {
+  if (square < MOVEMENT_STILL_SQ) {
+    return STILL;
+  }
+  if (square < MOVEMENT_ACTIVE_SQ) {
+    return MOVING;
+  }
+  return ACTIVE;
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include "posture.h"
+#include <math.h>
+
+static int16_t clamp16(int32_t value) {
+  if (value > INT16_MAX) return INT16_MAX;
+  if (value < INT16_MIN) return INT16_MIN;
+  return (int16_t)value;
+}
+
+PostureTracker::PostureTracker() {
+  setSampleRate(POSTURE_DEFAULT_RATE_HZ);
+  reset();
+}
+
+void PostureTracker::reset() {
+  gravity[0] = gravity[1] = gravity[2] = 0;
+  primed = false;
+  posture = Posture::UNKNOWN;
+  candidate = Posture::UNKNOWN;
+  candidate_samples = 0;
+  changes = 0;
+}
+
+void PostureTracker::setSampleRate(float rate_hz) {
+  if (rate_hz <= 0) {
+    return;
+  }
+
+  // alpha = 1 - e^(-2 pi fc / fs), at least one step so gravity never freezes
+  float alpha = 1.0f - expf(-2.0f * (float)M_PI * POSTURE_GRAVITY_CUTOFF_HZ / rate_hz);
+  long q15 = lroundf(alpha * 32768.0f);
+  alpha_q15 = q15 < 1 ? 1 : (q15 > 32768 ? 32768 : q15);
+
+  float hold = POSTURE_HOLD_SECONDS * rate_hz;
+  hold_samples = hold < 1 ? 1 : (hold > 0xFFFF ? 0xFFFF : (uint16_t)hold);
+}
+
+bool PostureTracker::update(int16_t x, int16_t y, int16_t z, int16_t* dynamic) {
+  int16_t sample[3] = {x, y, z};
+
+  if (!primed) {
+    for (uint8_t i = 0; i < 3; i++) {
+      gravity[i] = (int32_t)sample[i] << 4;
+    }
+    primed = true;
+  }
+
+  for (uint8_t i = 0; i < 3; i++) {
+    gravity[i] += (int32_t)(((int64_t)alpha_q15 * (((int32_t)sample[i] << 4) - gravity[i])) >> 15);
+    dynamic[i] = clamp16(sample[i] - (gravity[i] >> 4));
+  }
+
+  uint8_t current = classify();
+  if (current == Posture::UNKNOWN || current == posture) {
+    candidate = posture;
+    candidate_samples = 0;
+    return false;
+  }
+
+  if (current != candidate) {
+    candidate = current;
+    candidate_samples = 0;
+  }
+
+  if (++candidate_samples < hold_samples) {
+    return false;
+  }
+
+  posture = candidate;
+  candidate_samples = 0;
+  changes++;
+  return true;
+}
+
+uint8_t PostureTracker::classify() const {
+  // Units of 16 counts (about 1 mg) keep the squares in 32 bits
+  int32_t g[3];
+  uint32_t square[3];
+  uint8_t axis = 0;
+
+  for (uint8_t i = 0; i < 3; i++) {
+    g[i] = gravity[i] >> 8;
+    square[i] = (uint32_t)(g[i] * g[i]);
+    if (square[i] > square[axis]) {
+      axis = i;
+    }
+  }
+
+  uint32_t total = square[0] + square[1] + square[2];
+  if (total == 0 || square[axis] * 100 <= total * POSTURE_AXIS_PERCENT) {
+    return Posture::UNKNOWN;
+  }
+
+  // At rest the accelerometer reads +1 g along the axis pointing up
+  switch (axis) {
+    case 0:
+      return g[0] > 0 ? Posture::RIGHT : Posture::LEFT;
+    case 1:
+      return g[1] > 0 ? Posture::UPRIGHT : Posture::INVERTED;
+    default:
+      return g[2] > 0 ? Posture::SUPINE : Posture::PRONE;
+  }
+}
+
+void PostureTracker::getGravity(int16_t* xyz) const {
+  for (uint8_t i = 0; i < 3; i++) {
+    xyz[i] = clamp16(gravity[i] >> 4);
+  }
+}
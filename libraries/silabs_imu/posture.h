@@ -0,0 +1,71 @@
+#ifndef POSTURE_H
+#define POSTURE_H
+
+#include <stdint.h>
+
+// Gravity removal and posture tracking on raw accelerometer samples.
+//
+// A first order low-pass per axis follows the gravity vector, the sample
+// minus that estimate is the dynamic acceleration of the body. Unlike
+// | |a| - 1 g | it does not depend on the sensor's scale error and it
+// also shows slow rolls, whose magnitude stays at 1 g. The posture is the
+// axis the gravity estimate points along, a change is reported once the
+// new posture held for POSTURE_HOLD_SECONDS. Constant memory, fixed point
+// per sample.
+//
+// Mounting: board on the chest, z out of its top side, x towards the
+// wearer's left and y towards the head.
+
+#define POSTURE_GRAVITY_CUTOFF_HZ 0.3f
+#define POSTURE_HOLD_SECONDS      2
+// Rate used until setSampleRate() is called, the default FIFO rate
+#define POSTURE_DEFAULT_RATE_HZ   50.0f
+// The dominant axis needs more than 60 % of |g|^2, about 40 degrees tilt
+#define POSTURE_AXIS_PERCENT      60
+
+struct Posture {
+  static const uint8_t UNKNOWN = 0;
+  static const uint8_t SUPINE = 1;
+  static const uint8_t PRONE = 2;
+  static const uint8_t LEFT = 3;
+  static const uint8_t RIGHT = 4;
+  static const uint8_t UPRIGHT = 5;
+  // Head down, e.g. a handstand or the board mounted upside down
+  static const uint8_t INVERTED = 6;
+};
+
+class PostureTracker {
+  private:
+    // Gravity estimate in counts with 4 fractional bits
+    int32_t gravity[3];
+    bool primed;
+    uint16_t alpha_q15;
+    uint16_t hold_samples;
+
+    uint8_t posture;
+    uint8_t candidate;
+    uint16_t candidate_samples;
+    uint32_t changes;
+
+    uint8_t classify() const;
+
+  public:
+    PostureTracker();
+
+    void reset();
+
+    // Derives the filter coefficient and the hold time from the rate
+    // update() is called at
+    void setSampleRate(float rate_hz);
+
+    // Filters one sample in raw counts, writes the dynamic acceleration in
+    // counts and returns true when the posture changed
+    bool update(int16_t x, int16_t y, int16_t z, int16_t* dynamic);
+
+    uint8_t getPosture() const { return posture; }
+    uint32_t getChangeCount() const { return changes; }
+    // Gravity estimate in raw counts
+    void getGravity(int16_t* xyz) const;
+};
+
+#endif
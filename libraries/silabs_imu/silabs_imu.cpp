@@ -1,13 +1,44 @@
 #include "silabs_imu.h"
 
+// Set by the INT pin interrupt, there is only one IMU on the board
+static volatile bool womInterrupt = false;
+
+static void womIsr() {
+  womInterrupt = true;
+}
+
 SilabsIMU::SilabsIMU() {
   imuInitialized = false;
   movement_count = 0;
   sample_count = 0;
   movement_sum = 0;
+  intensity_milli_g = 0;
+  memset(last_sample, 0, sizeof(last_sample));
+  sample_state = STILL;
+  posture_changed = false;
   last_movement_time = 0;
   last_minute_update = 0;
 
+  spi_read_clock = IMU_SPI_READ_CLOCK_MAX;
+
+  fifoEnabled = false;
+  fifo_divider = IMU_FIFO_DEFAULT_DIVIDER;
+  fifo_dlpf = IMU_FIFO_DEFAULT_DLPF;
+  fifo_head = 0;
+  fifo_count = 0;
+  fifo_overflows = 0;
+
+  sample_fn = NULL;
+  sample_context = NULL;
+
+  womEnabled = false;
+  power_mode = IMUPowerMode::FULL;
+  wom_threshold = IMU_WOM_DEFAULT_THRESHOLD_MG / IMU_WOM_THRESHOLD_LSB_MG;
+  wom_int_pin = -1;
+  wom_burst_ms = IMU_WOM_DEFAULT_BURST_MS;
+  last_motion_ms = 0;
+  wake_count = 0;
+
   movement.current_state = STILL;
   movement.movement_intensity = 0;
   movement.movements_per_minute = 0;
@@ -24,9 +55,6 @@ bool SilabsIMU::begin() {
   digitalWrite(IMU_CS_PIN, HIGH);
 
   SPI.begin();
-  SPI.setClockDivider(16);
-  SPI.setDataMode(SPI_MODE0);
-  SPI.setBitOrder(MSBFIRST);
 
   if (initIMU()) {
     imuInitialized = true;
@@ -58,41 +86,314 @@ bool SilabsIMU::readIMU() {
     return false;
   }
 
-  int16_t accel_x_raw = (buffer[0] << 8) | buffer[1];
-  int16_t accel_y_raw = (buffer[2] << 8) | buffer[3];
-  int16_t accel_z_raw = (buffer[4] << 8) | buffer[5];
+  setReading(buffer);
+
+  return true;
+}
+
+void SilabsIMU::setReading(const uint8_t* raw) {
+  int16_t accel_x_raw = (raw[0] << 8) | raw[1];
+  int16_t accel_y_raw = (raw[2] << 8) | raw[3];
+  int16_t accel_z_raw = (raw[4] << 8) | raw[5];
+
+  last_sample[0] = accel_x_raw;
+  last_sample[1] = accel_y_raw;
+  last_sample[2] = accel_z_raw;
 
   imu.accel_x = accel_x_raw / 16384.0f;
   imu.accel_y = accel_y_raw / 16384.0f;
   imu.accel_z = accel_z_raw / 16384.0f;
 
+  if (sample_fn != NULL) {
+    sample_fn(accel_x_raw, accel_y_raw, accel_z_raw, sample_context);
+  }
+}
+
+void SilabsIMU::setSampleCallback(IMUSampleFn fn, void* context) {
+  sample_fn = fn;
+  sample_context = context;
+}
+
+void SilabsIMU::setSampleRate(float rate_hz) {
+  posture.setSampleRate(rate_hz);
+}
+
+IMUReading SilabsIMU::getIMUReading() const {
+  IMUReading reading = imu;
+  reading.total_acceleration = isqrt32(movementSquare(last_sample[0], last_sample[1], last_sample[2])) *
+                               (1.0f / MOVEMENT_COUNTS_PER_G);
+  return reading;
+}
+
+bool SilabsIMU::takePostureChange() {
+  bool changed = posture_changed;
+  posture_changed = false;
+  return changed;
+}
+
+bool SilabsIMU::enableFifo(uint8_t sample_rate_divider, uint8_t dlpf_cfg) {
+  if (!imuInitialized) {
+    return false;
+  }
+
+  // The divider only applies with the DLPF enabled (config 1..6)
+  if (dlpf_cfg < 1) dlpf_cfg = 1;
+  if (dlpf_cfg > 6) dlpf_cfg = 6;
+
+  fifo_divider = sample_rate_divider;
+  fifo_dlpf = dlpf_cfg;
+
+  writeRegister(ICM20689_USER_CTRL, 0x00);
+  writeRegister(ICM20689_SMPLRT_DIV, sample_rate_divider);
+  writeRegister(ICM20689_CONFIG, ICM20689_CONFIG_FIFO_MODE | dlpf_cfg);
+  writeRegister(ICM20689_ACCEL_CONFIG2, dlpf_cfg);
+  writeRegister(ICM20689_FIFO_EN, ICM20689_FIFO_EN_ACCEL);
+  setSampleRate(1000.0f / (1 + sample_rate_divider));
+
+  resetFifo();
+  fifoEnabled = true;
   return true;
 }
 
+void SilabsIMU::disableFifo() {
+  writeRegister(ICM20689_FIFO_EN, 0x00);
+  writeRegister(ICM20689_USER_CTRL, 0x00);
+  fifoEnabled = false;
+  fifo_divider = IMU_FIFO_DEFAULT_DIVIDER;
+  fifo_dlpf = IMU_FIFO_DEFAULT_DLPF;
+  fifo_head = 0;
+  fifo_count = 0;
+}
+
+void SilabsIMU::resetFifo() {
+  writeRegister(ICM20689_USER_CTRL, ICM20689_USER_CTRL_FIFO_RST);
+  writeRegister(ICM20689_USER_CTRL, ICM20689_USER_CTRL_FIFO_EN);
+}
+
+bool SilabsIMU::enableWakeOnMotion(uint16_t threshold_mg, int int_pin, unsigned long burst_ms) {
+  if (!fifoEnabled) {
+    return false;
+  }
+
+  uint16_t threshold = threshold_mg / IMU_WOM_THRESHOLD_LSB_MG;
+  wom_threshold = threshold > 0xFF ? 0xFF : (threshold < 1 ? 1 : threshold);
+  wom_burst_ms = burst_ms;
+  wom_int_pin = int_pin;
+
+  if (wom_int_pin >= 0) {
+    pinMode(wom_int_pin, INPUT);
+    attachInterrupt(digitalPinToInterrupt(wom_int_pin), womIsr, RISING);
+  }
+
+  womEnabled = true;
+  enterWakeOnMotion();
+  return true;
+}
+
+void SilabsIMU::disableWakeOnMotion() {
+  if (!womEnabled) {
+    return;
+  }
+
+  if (wom_int_pin >= 0) {
+    detachInterrupt(digitalPinToInterrupt(wom_int_pin));
+  }
+
+  womEnabled = false;
+  if (power_mode == IMUPowerMode::WAKE_ON_MOTION) {
+    leaveLowPower();
+  }
+  power_mode = IMUPowerMode::FULL;
+}
+
+void SilabsIMU::enterWakeOnMotion() {
+  disableFifo();
+
+  writeRegister(ICM20689_PWR_MGMT_1, 0x00);
+  writeRegister(ICM20689_PWR_MGMT_2, ICM20689_PWR_MGMT_2_GYRO_STBY);
+  writeRegister(ICM20689_ACCEL_CONFIG2, ICM20689_ACCEL_CONFIG2_WOM);
+  writeRegister(ICM20689_SMPLRT_DIV, IMU_WOM_DIVIDER);
+  writeRegister(ICM20689_INT_PIN_CFG, ICM20689_INT_PIN_CFG_LATCH);
+  writeRegister(ICM20689_INT_ENABLE, ICM20689_INT_WOM);
+  writeRegister(ICM20689_ACCEL_WOM_X_THR, wom_threshold);
+  writeRegister(ICM20689_ACCEL_WOM_Y_THR, wom_threshold);
+  writeRegister(ICM20689_ACCEL_WOM_Z_THR, wom_threshold);
+  writeRegister(ICM20689_ACCEL_INTEL_CTRL, ICM20689_ACCEL_INTEL_EN | ICM20689_ACCEL_INTEL_MODE);
+
+  // Drop a stale latched interrupt before the first low power sample
+  readRegister(ICM20689_INT_STATUS);
+  womInterrupt = false;
+
+  writeRegister(ICM20689_PWR_MGMT_1, ICM20689_PWR_MGMT_1_CYCLE);
+  power_mode = IMUPowerMode::WAKE_ON_MOTION;
+}
+
+void SilabsIMU::leaveLowPower() {
+  writeRegister(ICM20689_PWR_MGMT_1, 0x00);
+  writeRegister(ICM20689_ACCEL_INTEL_CTRL, 0x00);
+  writeRegister(ICM20689_INT_ENABLE, 0x00);
+
+  enableFifo(fifo_divider, fifo_dlpf);
+}
+
+void SilabsIMU::enterBurst() {
+  leaveLowPower();
+  power_mode = IMUPowerMode::BURST;
+  last_motion_ms = millis();
+  wake_count++;
+}
+
+bool SilabsIMU::wokeUp() {
+  if (wom_int_pin >= 0) {
+    if (!womInterrupt) {
+      return false;
+    }
+    womInterrupt = false;
+  }
+
+  // Reading INT_STATUS also releases the latched INT pin
+  return (readRegister(ICM20689_INT_STATUS) & ICM20689_INT_WOM) != 0;
+}
+
+uint8_t SilabsIMU::serviceWakeOnMotion() {
+  if (!womEnabled) {
+    return power_mode;
+  }
+
+  unsigned long now = millis();
+
+  if (power_mode == IMUPowerMode::WAKE_ON_MOTION) {
+    if (wokeUp()) {
+      enterBurst();
+    } else {
+      // Below the threshold the wearer is still, keep the still duration
+      // running without samples
+      sample_state = STILL;
+      intensity_milli_g = 0;
+      movement.movement_intensity = 0;
+      updateMovementState();
+    }
+  } else if (power_mode == IMUPowerMode::BURST) {
+    // Any moving sample of the burst so far extends it
+    if ((long)(last_movement_time - last_motion_ms) > 0) {
+      last_motion_ms = last_movement_time;
+    }
+    if (now - last_motion_ms >= wom_burst_ms) {
+      enterWakeOnMotion();
+    }
+  }
+
+  return power_mode;
+}
+
+int SilabsIMU::readFifo() {
+  if (!fifoEnabled) {
+    return 0;
+  }
+
+  // A full FIFO may end in a partial sample, drop it all to stay aligned
+  if (readRegister(ICM20689_INT_STATUS) & ICM20689_INT_STATUS_FIFO_OFLOW) {
+    fifo_overflows++;
+    resetFifo();
+    return -1;
+  }
+
+  uint8_t count_buffer[2];
+  if (!readRegisters(ICM20689_FIFO_COUNTH, count_buffer, 2)) {
+    return 0;
+  }
+
+  uint16_t available = (((count_buffer[0] & 0x1F) << 8) | count_buffer[1]) / IMU_FIFO_SAMPLE_BYTES;
+
+  if (fifo_count == 0) {
+    fifo_head = 0;
+  }
+
+  // One burst into the contiguous free space behind the newest sample
+  uint8_t tail = (fifo_head + fifo_count) % IMU_FIFO_RING_SAMPLES;
+  uint8_t space = (tail >= fifo_head && fifo_count < IMU_FIFO_RING_SAMPLES)
+                    ? IMU_FIFO_RING_SAMPLES - tail
+                    : IMU_FIFO_RING_SAMPLES - fifo_count;
+  uint8_t samples = available < space ? available : space;
+
+  if (samples == 0) {
+    return 0;
+  }
+
+  if (!readRegisters(ICM20689_FIFO_R_W, fifo_ring[tail], samples * IMU_FIFO_SAMPLE_BYTES)) {
+    return 0;
+  }
+
+  fifo_count += samples;
+  return samples;
+}
+
+int SilabsIMU::processFifo() {
+  int16_t dynamic[IMU_FIFO_RING_SAMPLES][3];
+  uint32_t squares[IMU_FIFO_RING_SAMPLES];
+  int processed = 0;
+
+  // The gravity filter runs sample by sample, the squared magnitudes of
+  // each contiguous run of the ring in one kernel call. The ring wraps at
+  // most once.
+  while (fifo_count > 0) {
+    uint8_t run = IMU_FIFO_RING_SAMPLES - fifo_head;
+    if (run > fifo_count) {
+      run = fifo_count;
+    }
+
+    for (uint8_t i = 0; i < run; i++) {
+      setReading(fifo_ring[fifo_head + i]);
+      trackPosture(dynamic[i]);
+    }
+
+    movementSquares(dynamic, run, squares);
+
+    for (uint8_t i = 0; i < run; i++) {
+      accumulateMovement(squares[i]);
+      updateMovementState();
+      incrementSampleCount();
+    }
+
+    fifo_head = (fifo_head + run) % IMU_FIFO_RING_SAMPLES;
+    fifo_count -= run;
+    processed += run;
+  }
+
+  return processed;
+}
+
 void SilabsIMU::calculateMovement() {
-  imu.total_acceleration = sqrt(
-    imu.accel_x * imu.accel_x +
-    imu.accel_y * imu.accel_y +
-    imu.accel_z * imu.accel_z
-  );
+  int16_t dynamic[1][3];
+  uint32_t square;
 
-  float movement_magnitude = fabs(imu.total_acceleration - 1.0);
+  trackPosture(dynamic[0]);
+  movementSquares(dynamic, 1, &square);
+  accumulateMovement(square);
+}
+
+void SilabsIMU::trackPosture(int16_t* dynamic) {
+  if (posture.update(last_sample[0], last_sample[1], last_sample[2], dynamic)) {
+    posture_changed = true;
+  }
+}
+
+void SilabsIMU::accumulateMovement(uint32_t square) {
+  // The state comes from the squared thresholds, the root is only needed
+  // for the intensity average
+  uint32_t deviation = isqrt32(square);
 
-  movement.movement_intensity = movement_magnitude;
-  movement_sum += movement_magnitude;
+  sample_state = movementClassify(square);
+  intensity_milli_g = movementMilliG(deviation);
+  movement.movement_intensity = intensity_milli_g / 1000.0f;
+  movement_sum += deviation;
 }
 
 void SilabsIMU::updateMovementState() {
   unsigned long current_time = millis();
 
-  if (movement.movement_intensity < MOVEMENT_THRESHOLD) {
-    movement.current_state = STILL;
-  } else if (movement.movement_intensity < ACTIVE_THRESHOLD) {
-    movement.current_state = MOVING;
-    movement_count++;
-    last_movement_time = current_time;
-  } else {
-    movement.current_state = ACTIVE;
+  movement.current_state = sample_state;
+  if (sample_state != STILL) {
     movement_count++;
     last_movement_time = current_time;
   }
@@ -110,7 +411,8 @@ void SilabsIMU::updateMinutelyStats() {
   movement.movements_per_minute = movement_count;
 
   if (sample_count > 0) {
-    movement.movement_intensity = movement_sum / sample_count;
+    intensity_milli_g = movementMilliG((movement_sum + sample_count / 2) / sample_count);
+    movement.movement_intensity = intensity_milli_g / 1000.0f;
   }
 
   movement_count = 0;
@@ -178,29 +480,40 @@ void SilabsIMU::printSummary() {
   Serial.println("------------------------\n");
 }
 
+void SilabsIMU::setSpiReadClock(uint32_t clock_hz) {
+  spi_read_clock = clock_hz > IMU_SPI_READ_CLOCK_MAX ? IMU_SPI_READ_CLOCK_MAX : clock_hz;
+}
+
 uint8_t SilabsIMU::readRegister(uint8_t reg) {
+  SPI.beginTransaction(SPISettings(IMU_SPI_REGISTER_CLOCK, MSBFIRST, SPI_MODE0));
   digitalWrite(IMU_CS_PIN, LOW);
   SPI.transfer(reg | SPI_READ_BIT);
   uint8_t data = SPI.transfer(0x00);
   digitalWrite(IMU_CS_PIN, HIGH);
+  SPI.endTransaction();
   return data;
 }
 
 bool SilabsIMU::readRegisters(uint8_t reg, uint8_t* buffer, uint8_t length) {
+  // Clock the whole burst as one buffer transfer instead of byte by byte
+  memset(buffer, 0x00, length);
+
+  SPI.beginTransaction(SPISettings(spi_read_clock, MSBFIRST, SPI_MODE0));
   digitalWrite(IMU_CS_PIN, LOW);
   SPI.transfer(reg | SPI_READ_BIT);
-  for (uint8_t i = 0; i < length; i++) {
-    buffer[i] = SPI.transfer(0x00);
-  }
+  SPI.transfer(buffer, length);
   digitalWrite(IMU_CS_PIN, HIGH);
+  SPI.endTransaction();
   return true;
 }
 
 void SilabsIMU::writeRegister(uint8_t reg, uint8_t value) {
+  SPI.beginTransaction(SPISettings(IMU_SPI_REGISTER_CLOCK, MSBFIRST, SPI_MODE0));
   digitalWrite(IMU_CS_PIN, LOW);
   SPI.transfer(reg | SPI_WRITE_BIT);
   SPI.transfer(value);
   digitalWrite(IMU_CS_PIN, HIGH);
+  SPI.endTransaction();
   delayMicroseconds(10);
 }
 
@@ -3,7 +3,9 @@
 
 #include <Arduino.h>
 #include <SPI.h>
-#include <math.h>
+#include "movement_data.h"
+#include "movement_kernel.h"
+#include "posture.h"
 
 #define SENSOR_ENABLE_PIN  PC9
 #define IMU_CS_PIN         PA7
@@ -15,29 +17,76 @@
 #define SPI_READ_BIT             0x80
 #define SPI_WRITE_BIT            0x00
 
-#define MOVEMENT_THRESHOLD       0.15
-#define ACTIVE_THRESHOLD         0.5
+// SPI clocks: all registers are accessible at 1 MHz, sensor, interrupt
+// and FIFO data can be read at up to 8 MHz
+#define IMU_SPI_REGISTER_CLOCK   1000000
+#define IMU_SPI_READ_CLOCK_MAX   8000000
+
+// FIFO registers
+#define ICM20689_SMPLRT_DIV      0x19
+#define ICM20689_CONFIG          0x1A
+#define ICM20689_ACCEL_CONFIG2   0x1D
+#define ICM20689_FIFO_EN         0x23
+#define ICM20689_INT_STATUS      0x3A
+#define ICM20689_USER_CTRL       0x6A
+#define ICM20689_FIFO_COUNTH     0x72
+#define ICM20689_FIFO_R_W        0x74
+
+#define ICM20689_CONFIG_FIFO_MODE      0x40  // stop writing when the FIFO is full
+#define ICM20689_FIFO_EN_ACCEL         0x08
+#define ICM20689_USER_CTRL_FIFO_EN     0x40
+#define ICM20689_USER_CTRL_FIFO_RST    0x04
+#define ICM20689_INT_STATUS_FIFO_OFLOW 0x10
+
+// Wake on motion registers
+#define ICM20689_ACCEL_WOM_X_THR   0x20
+#define ICM20689_ACCEL_WOM_Y_THR   0x21
+#define ICM20689_ACCEL_WOM_Z_THR   0x22
+#define ICM20689_INT_PIN_CFG       0x37
+#define ICM20689_INT_ENABLE        0x38
+#define ICM20689_ACCEL_INTEL_CTRL  0x69
+#define ICM20689_PWR_MGMT_2        0x6C
+
+#define ICM20689_PWR_MGMT_1_CYCLE      0x20  // duty cycled low power accel
+#define ICM20689_PWR_MGMT_2_GYRO_STBY  0x07  // accel on, all gyro axes off
+#define ICM20689_INT_PIN_CFG_LATCH     0x20  // INT held until INT_STATUS is read
+#define ICM20689_INT_WOM               0xE0  // WOM_X/Y/Z in INT_ENABLE and INT_STATUS
+#define ICM20689_ACCEL_INTEL_EN        0x80
+#define ICM20689_ACCEL_INTEL_MODE      0x40  // compare with the previous sample
+#define ICM20689_ACCEL_CONFIG2_WOM     0x01  // 218 Hz DLPF, 4 sample average
+
+// Threshold LSB is 4 mg, 0..1020 mg
+#define IMU_WOM_THRESHOLD_LSB_MG       4
+#define IMU_WOM_DEFAULT_THRESHOLD_MG   40
+// Low power rate 1 kHz / (1 + divider), 99 gives 10 Hz
+#define IMU_WOM_DIVIDER                99
+// A burst ends after this long without movement
+#define IMU_WOM_DEFAULT_BURST_MS       10000
+
+// 1 kHz internal rate / (1 + divider): 19 gives 50 Hz, 9 gives 100 Hz
+#define IMU_FIFO_DEFAULT_DIVIDER 19
+// Accel DLPF config 4: 21.2 Hz bandwidth, below Nyquist at 50 Hz
+#define IMU_FIFO_DEFAULT_DLPF    4
+#define IMU_FIFO_SAMPLE_BYTES    6
+// Ring capacity in samples, one burst must fit into readRegisters' length
+#define IMU_FIFO_RING_SAMPLES    32
+
 #define SAMPLES_PER_MINUTE       300
 
-enum ActivityState {
-  STILL = 0,
-  MOVING = 1,
-  ACTIVE = 2
+struct IMUPowerMode {
+  static const uint8_t FULL = 0;            // polled or FIFO, always on
+  static const uint8_t WAKE_ON_MOTION = 1;  // low power, waiting for INT
+  static const uint8_t BURST = 2;           // FIFO sampling after a wake up
 };
 
+// Called with every raw accelerometer sample, 16384 counts per g
+typedef void (*IMUSampleFn)(int16_t x, int16_t y, int16_t z, void* context);
+
 struct IMUReading {
   float accel_x, accel_y, accel_z;
   float total_acceleration;
 };
 
-struct MovementData {
-  ActivityState current_state;
-  float movement_intensity;
-  int movements_per_minute;
-  bool is_likely_asleep;
-  unsigned long still_duration_minutes;
-};
-
 class SilabsIMU {
   private:
     IMUReading imu;
@@ -46,13 +95,51 @@ class SilabsIMU {
 
     int movement_count;
     int sample_count;
-    float movement_sum;
+    // Sum of the dynamic acceleration in counts, averaged in
+    // updateMinutelyStats()
+    uint32_t movement_sum;
+    // movement.movement_intensity in milli-g, the float is derived from it
+    uint16_t intensity_milli_g;
+    int16_t last_sample[3];
+    ActivityState sample_state;
+
+    PostureTracker posture;
+    bool posture_changed;
     unsigned long last_movement_time;
     unsigned long last_minute_update;
 
+    uint32_t spi_read_clock;
+
+    bool fifoEnabled;
+    uint8_t fifo_divider;
+    uint8_t fifo_dlpf;
+    uint8_t fifo_ring[IMU_FIFO_RING_SAMPLES][IMU_FIFO_SAMPLE_BYTES];
+    uint8_t fifo_head;
+    uint8_t fifo_count;
+    unsigned long fifo_overflows;
+
+    IMUSampleFn sample_fn;
+    void* sample_context;
+
+    bool womEnabled;
+    uint8_t power_mode;
+    uint8_t wom_threshold;
+    int wom_int_pin;
+    unsigned long wom_burst_ms;
+    unsigned long last_motion_ms;
+    unsigned long wake_count;
+
     uint8_t readRegister(uint8_t reg);
     bool readRegisters(uint8_t reg, uint8_t* buffer, uint8_t length);
     void writeRegister(uint8_t reg, uint8_t value);
+    void setReading(const uint8_t* raw);
+    void trackPosture(int16_t* dynamic);
+    void accumulateMovement(uint32_t square);
+    void resetFifo();
+    void enterWakeOnMotion();
+    void leaveLowPower();
+    void enterBurst();
+    bool wokeUp();
 
   public:
     SilabsIMU();
@@ -67,9 +154,58 @@ class SilabsIMU {
     void incrementSampleCount();
     bool shouldUpdateMinutelyStats();
 
-    IMUReading getIMUReading() const { return imu; }
+    // FIFO mode: the IMU samples at 1 kHz / (1 + divider) on its own and
+    // readFifo() drains the accumulated samples in a single burst
+    bool enableFifo(uint8_t sample_rate_divider = IMU_FIFO_DEFAULT_DIVIDER,
+                    uint8_t dlpf_cfg = IMU_FIFO_DEFAULT_DLPF);
+    void disableFifo();
+    // Returns the number of samples moved into the ring, -1 on FIFO overflow
+    int readFifo();
+    // Runs every buffered sample through the movement detection
+    int processFifo();
+    bool isFifoEnabled() const { return fifoEnabled; }
+    // Rate of the samples handed out in FIFO mode
+    float getFifoSampleRate() const { return 1000.0f / (1 + fifo_divider); }
+    // Hands out every sample read in FIFO or polled mode, NULL to disable
+    void setSampleCallback(IMUSampleFn fn, void* context);
+    // Rate of the readIMU() calls in polled mode, enableFifo() sets it from
+    // the divider. Tunes the gravity filter and the posture hold time.
+    void setSampleRate(float rate_hz);
+    unsigned long getFifoOverflowCount() const { return fifo_overflows; }
+
+    // Wake on motion: the gyro is switched off and the accelerometer runs
+    // duty cycled at IMU_WOM_DIVIDER, raising INT once any axis moves more
+    // than threshold_mg between two samples. serviceWakeOnMotion() then
+    // starts a FIFO burst and goes back to sleep once the burst saw no
+    // movement for burst_ms. Needs enableFifo() first. Without int_pin
+    // (-1) the latched INT_STATUS register is read on every call instead,
+    // one register read per tick while the wearer is still.
+    bool enableWakeOnMotion(uint16_t threshold_mg = IMU_WOM_DEFAULT_THRESHOLD_MG, int int_pin = -1,
+                            unsigned long burst_ms = IMU_WOM_DEFAULT_BURST_MS);
+    void disableWakeOnMotion();
+    // Call before draining the FIFO, returns the IMUPowerMode. While it
+    // is WAKE_ON_MOTION there is nothing to read.
+    uint8_t serviceWakeOnMotion();
+    bool isWakeOnMotionEnabled() const { return womEnabled; }
+    uint8_t getPowerMode() const { return power_mode; }
+    unsigned long getWakeCount() const { return wake_count; }
+
+    IMUReading getIMUReading() const;
     MovementData getMovementData() const { return movement; }
+
+    // Movement intensity of getMovementData() in milli-g
+    uint16_t getMovementIntensityMilliG() const { return intensity_milli_g; }
+
+    // Posture (posture.h) of the gravity estimate
+    uint8_t getPosture() const { return posture.getPosture(); }
+    uint32_t getPostureChangeCount() const { return posture.getChangeCount(); }
+    // True once per posture change since the last call
+    bool takePostureChange();
     bool isInitialized() const { return imuInitialized; }
+
+    // Clock of the burst data reads, clamped to IMU_SPI_READ_CLOCK_MAX
+    void setSpiReadClock(uint32_t clock_hz);
+    uint32_t getSpiReadClock() const { return spi_read_clock; }
 };
 
 #endif
\ No newline at end of file
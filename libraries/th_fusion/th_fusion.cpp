@@ -0,0 +1,220 @@
+#include "th_fusion.h"
+#include "int_math.h"
+
+// Half the squared difference of two successive samples estimates the
+// noise variance, averaged over about 8 samples
+static void updateNoise(uint32_t* noise_var, int32_t difference) {
+  if (difference > 20000) {
+    difference = 20000;
+  } else if (difference < -20000) {
+    difference = -20000;
+  }
+
+  int32_t sample = (int32_t)((uint32_t)(difference * difference) / 2);
+  *noise_var = (uint32_t)((int32_t)*noise_var + (sample - (int32_t)*noise_var) / 8);
+}
+
+ThFusion::ThFusion() {
+  // Typical accuracy from the datasheets
+  setAccuracy(ThSensor::SI7021, 40, 300);
+  setAccuracy(ThSensor::SHT30, 20, 200);
+  sample_period_ms = 2000;
+  reset();
+}
+
+void ThFusion::reset() {
+  for (uint8_t i = 0; i < TH_FUSION_SENSORS; i++) {
+    channels[i].valid = false;
+    channels[i].temp = 0;
+    channels[i].hum = 0;
+    channels[i].time = 0;
+    channels[i].temp_noise_var = 0;
+    channels[i].hum_noise_var = 0;
+  }
+
+  temp_offset_q4 = 0;
+  hum_offset_q4 = 0;
+  offset_valid = false;
+}
+
+void ThFusion::setAccuracy(uint8_t sensor, uint16_t temp_centi, uint16_t hum_centi) {
+  if (sensor >= TH_FUSION_SENSORS) {
+    return;
+  }
+
+  // A zero variance would take all the weight
+  if (temp_centi == 0) {
+    temp_centi = 1;
+  }
+  if (hum_centi == 0) {
+    hum_centi = 1;
+  }
+
+  channels[sensor].temp_accuracy_var = (uint32_t)temp_centi * temp_centi;
+  channels[sensor].hum_accuracy_var = (uint32_t)hum_centi * hum_centi;
+}
+
+void ThFusion::setSamplePeriod(unsigned long period_ms) {
+  sample_period_ms = period_ms > 0 ? period_ms : 1;
+}
+
+void ThFusion::addSample(uint8_t sensor, int16_t temp_centi, uint16_t hum_centi, unsigned long now) {
+  if (sensor >= TH_FUSION_SENSORS) {
+    return;
+  }
+
+  Channel& channel = channels[sensor];
+
+  // Samples further apart mostly measure the change of the air
+  if (channel.valid && now - channel.time <= 2 * sample_period_ms) {
+    updateNoise(&channel.temp_noise_var, (int32_t)temp_centi - channel.temp);
+    updateNoise(&channel.hum_noise_var, (int32_t)hum_centi - channel.hum);
+  }
+
+  channel.valid = true;
+  channel.temp = temp_centi;
+  channel.hum = hum_centi;
+  channel.time = now;
+
+  // Offset from this sample and the latest one of the other sensor, the
+  // air changes little in between when they are at most a period apart
+  const Channel& si7021 = channels[ThSensor::SI7021];
+  const Channel& sht30 = channels[ThSensor::SHT30];
+  const Channel& other = channels[TH_FUSION_SENSORS - 1 - sensor];
+  if (!other.valid || now - other.time > sample_period_ms) {
+    return;
+  }
+
+  int32_t temp_q4 = ((int32_t)si7021.temp - sht30.temp) * 16;
+  int32_t hum_q4 = ((int32_t)si7021.hum - sht30.hum) * 16;
+  if (offset_valid) {
+    // Slow average over about 16 pairs
+    temp_offset_q4 += (temp_q4 - temp_offset_q4) / 16;
+    hum_offset_q4 += (hum_q4 - hum_offset_q4) / 16;
+  } else {
+    temp_offset_q4 = temp_q4;
+    hum_offset_q4 = hum_q4;
+    offset_valid = true;
+  }
+}
+
+void ThFusion::invalidate(uint8_t sensor) {
+  if (sensor < TH_FUSION_SENSORS) {
+    channels[sensor].valid = false;
+  }
+}
+
+bool ThFusion::isFresh(const Channel& channel, unsigned long now) const {
+  return channel.valid && now - channel.time <= TH_FUSION_STALE_PERIODS * sample_period_ms;
+}
+
+uint32_t ThFusion::ageVariance(unsigned long age_ms, uint32_t rate_centi_per_s) {
+  uint32_t change = (uint32_t)((uint64_t)age_ms * rate_centi_per_s / 1000);
+  if (change > 10000) {
+    change = 10000;
+  }
+  return change * change;
+}
+
+// Inverse-variance weighted mean of a and b, rounded, and its variance
+int32_t ThFusion::fuse(int32_t a, uint32_t a_var, int32_t b, uint32_t b_var, uint32_t* var) {
+  uint64_t sum = (uint64_t)a_var + b_var;
+  int64_t weighted = (int64_t)a * b_var + (int64_t)b * a_var;
+
+  *var = (uint32_t)((uint64_t)a_var * b_var / sum);
+  if (weighted < 0) {
+    return -(int32_t)((-weighted + (int64_t)(sum / 2)) / (int64_t)sum);
+  }
+  return (int32_t)((weighted + (int64_t)(sum / 2)) / (int64_t)sum);
+}
+
+bool ThFusion::getReading(unsigned long now, ThFusionReading* reading) const {
+  const Channel& si7021 = channels[ThSensor::SI7021];
+  const Channel& sht30 = channels[ThSensor::SHT30];
+  bool si7021_fresh = isFresh(si7021, now);
+  bool sht30_fresh = isFresh(sht30, now);
+
+  reading->status = 0;
+  if (!si7021_fresh) {
+    reading->status |= ThFusionStatus::SI7021_FAILED;
+  }
+  if (!sht30_fresh) {
+    reading->status |= ThFusionStatus::SHT30_FAILED;
+  }
+  if (offset_valid) {
+    int32_t temp_offset = temp_offset_q4 / 16;
+    int32_t hum_offset = hum_offset_q4 / 16;
+    if (temp_offset > TH_FUSION_TEMP_DRIFT_CENTI || temp_offset < -TH_FUSION_TEMP_DRIFT_CENTI) {
+      reading->status |= ThFusionStatus::TEMP_DRIFT;
+    }
+    if (hum_offset > TH_FUSION_HUM_DRIFT_CENTI || hum_offset < -TH_FUSION_HUM_DRIFT_CENTI) {
+      reading->status |= ThFusionStatus::HUM_DRIFT;
+    }
+  }
+
+  if (!si7021_fresh && !sht30_fresh) {
+    return false;
+  }
+
+  uint32_t si7021_temp_var = si7021.temp_accuracy_var + si7021.temp_noise_var;
+  uint32_t si7021_hum_var = si7021.hum_accuracy_var + si7021.hum_noise_var;
+  uint32_t sht30_temp_var = sht30.temp_accuracy_var + sht30.temp_noise_var;
+  uint32_t sht30_hum_var = sht30.hum_accuracy_var + sht30.hum_noise_var;
+
+  // Both aligned values estimate the weighted mean of the two sensors:
+  // each one takes its share of the offset by its variance
+  int32_t si7021_temp = si7021.temp;
+  int32_t si7021_hum = si7021.hum;
+  int32_t sht30_temp = sht30.temp;
+  int32_t sht30_hum = sht30.hum;
+  if (offset_valid) {
+    int64_t temp_share = (int64_t)temp_offset_q4 * si7021_temp_var / ((int64_t)si7021_temp_var + sht30_temp_var);
+    int64_t hum_share = (int64_t)hum_offset_q4 * si7021_hum_var / ((int64_t)si7021_hum_var + sht30_hum_var);
+    si7021_temp -= (int32_t)(temp_share / 16);
+    si7021_hum -= (int32_t)(hum_share / 16);
+    sht30_temp += (int32_t)((temp_offset_q4 - temp_share) / 16);
+    sht30_hum += (int32_t)((hum_offset_q4 - hum_share) / 16);
+  }
+
+  int32_t temp, hum;
+  uint32_t temp_var, hum_var;
+  if (si7021_fresh && sht30_fresh) {
+    unsigned long si7021_age = now - si7021.time;
+    unsigned long sht30_age = now - sht30.time;
+    temp = fuse(si7021_temp, si7021_temp_var + ageVariance(si7021_age, TH_FUSION_TEMP_RATE_CENTI_PER_S),
+                sht30_temp, sht30_temp_var + ageVariance(sht30_age, TH_FUSION_TEMP_RATE_CENTI_PER_S), &temp_var);
+    hum = fuse(si7021_hum, si7021_hum_var + ageVariance(si7021_age, TH_FUSION_HUM_RATE_CENTI_PER_S),
+               sht30_hum, sht30_hum_var + ageVariance(sht30_age, TH_FUSION_HUM_RATE_CENTI_PER_S), &hum_var);
+  } else if (si7021_fresh) {
+    unsigned long age = now - si7021.time;
+    temp = si7021_temp;
+    hum = si7021_hum;
+    temp_var = si7021_temp_var + ageVariance(age, TH_FUSION_TEMP_RATE_CENTI_PER_S);
+    hum_var = si7021_hum_var + ageVariance(age, TH_FUSION_HUM_RATE_CENTI_PER_S);
+  } else {
+    unsigned long age = now - sht30.time;
+    temp = sht30_temp;
+    hum = sht30_hum;
+    temp_var = sht30_temp_var + ageVariance(age, TH_FUSION_TEMP_RATE_CENTI_PER_S);
+    hum_var = sht30_hum_var + ageVariance(age, TH_FUSION_HUM_RATE_CENTI_PER_S);
+  }
+
+  if (temp < -32768) {
+    temp = -32768;
+  } else if (temp > 32767) {
+    temp = 32767;
+  }
+  if (hum < 0) {
+    hum = 0;
+  } else if (hum > 10000) {
+    hum = 10000;
+  }
+
+  uint32_t temp_sigma = isqrt32(temp_var);
+  uint32_t hum_sigma = isqrt32(hum_var);
+  reading->temp_centi = (int16_t)temp;
+  reading->hum_centi = (uint16_t)hum;
+  reading->temp_sigma_centi = temp_sigma > 0xFFFF ? 0xFFFF : temp_sigma;
+  reading->hum_sigma_centi = hum_sigma > 0xFFFF ? 0xFFFF : hum_sigma;
+  return true;
+}
@@ -0,0 +1,113 @@
+#ifndef TH_FUSION_H
+#define TH_FUSION_H
+
+#include <stdint.h>
+
+// Fuses the SI7021 and SHT30 temperature/humidity readings into one value.
+//
+// Both sensors measure the same air, so they mostly differ by a slowly
+// changing offset. The offset is tracked from pairs of recent samples and
+// each sensor is aligned to the inverse-variance weighted mean of both
+// before fusing, so the fused value does not jump whichever sensor was
+// sampled last. A sensor's variance is its accuracy plus a running noise
+// estimate from successive samples plus the change expected since its
+// last sample, so the sensors may be sampled in turn at half rate each.
+//
+// Everything is integer, in the 0.01 C and 0.01 %RH units of
+// sensor_frame.h.
+
+struct ThSensor {
+  static const uint8_t SI7021 = 0;
+  static const uint8_t SHT30 = 1;
+};
+
+#define TH_FUSION_SENSORS 2
+
+// Status bits of a fused reading
+struct ThFusionStatus {
+  static const uint8_t SI7021_FAILED = 0x01;  // no valid sample within the stale time
+  static const uint8_t SHT30_FAILED = 0x02;
+  static const uint8_t TEMP_DRIFT = 0x04;     // the sensors disagree on the temperature
+  static const uint8_t HUM_DRIFT = 0x08;      // the sensors disagree on the humidity
+};
+
+// Offsets beyond this flag the sensors as drifting apart, a bit over
+// three times their combined typical accuracy
+#define TH_FUSION_TEMP_DRIFT_CENTI 150
+#define TH_FUSION_HUM_DRIFT_CENTI  1000
+
+// Change of the air between two samples, the variance of a sample grows
+// with the square of its age times this
+#define TH_FUSION_TEMP_RATE_CENTI_PER_S 2
+#define TH_FUSION_HUM_RATE_CENTI_PER_S  10
+
+// A sensor without a valid sample for this many sample periods failed
+#define TH_FUSION_STALE_PERIODS 3
+
+struct ThFusionReading {
+  int16_t temp_centi;
+  uint16_t hum_centi;
+  // One standard deviation of the fused values
+  uint16_t temp_sigma_centi;
+  uint16_t hum_sigma_centi;
+  uint8_t status;
+};
+
+class ThFusion {
+  private:
+    struct Channel {
+      bool valid;
+      int16_t temp;
+      uint16_t hum;
+      unsigned long time;
+
+      // Datasheet accuracy squared and the running noise estimate, centi^2
+      uint32_t temp_accuracy_var;
+      uint32_t hum_accuracy_var;
+      uint32_t temp_noise_var;
+      uint32_t hum_noise_var;
+    };
+
+    Channel channels[TH_FUSION_SENSORS];
+
+    // SI7021 minus SHT30, 1/16 centi
+    int32_t temp_offset_q4;
+    int32_t hum_offset_q4;
+    bool offset_valid;
+
+    unsigned long sample_period_ms;
+
+    bool isFresh(const Channel& channel, unsigned long now) const;
+
+    static uint32_t ageVariance(unsigned long age_ms, uint32_t rate_centi_per_s);
+
+    static int32_t fuse(int32_t a, uint32_t a_var, int32_t b, uint32_t b_var, uint32_t* var);
+
+  public:
+    ThFusion();
+
+    void reset();
+
+    // One standard deviation of a sensor, 0.01 C and 0.01 %RH
+    void setAccuracy(uint8_t sensor, uint16_t temp_centi, uint16_t hum_centi);
+
+    // Time between two samples of the same sensor, sets the stale time and
+    // how far apart two samples may be to update the offset
+    void setSamplePeriod(unsigned long period_ms);
+
+    unsigned long getSamplePeriod() const { return sample_period_ms; }
+
+    void addSample(uint8_t sensor, int16_t temp_centi, uint16_t hum_centi, unsigned long now);
+
+    // A failed read, the sensor is left out until its next valid sample
+    void invalidate(uint8_t sensor);
+
+    // Returns false while no sensor has a fresh sample
+    bool getReading(unsigned long now, ThFusionReading* reading) const;
+
+    // SI7021 minus SHT30, 0.01 C and 0.01 %RH
+    int16_t getTempOffsetCenti() const { return (int16_t)(temp_offset_q4 / 16); }
+    int16_t getHumOffsetCenti() const { return (int16_t)(hum_offset_q4 / 16); }
+};
+
+#endif
@@ -3,7 +3,34 @@
 // Calculations and initialization processes are based on the sensor datasheet
 // https://www.vishay.com/docs/84889/veml6035.pdf
 
+struct LuxRange {
+    uint16_t config;
+    float resolution;
+    // Lux below which the next finer range is used
+    float down_lux;
+};
+
+static constexpr uint16_t rangeConfig(uint8_t it, uint8_t gain, uint8_t dg, uint8_t sens) {
+    return (it << 6) | (gain << 10) | (dg << 11) | (sens << 12);
+}
+
+static constexpr LuxRange luxRange(uint8_t it, uint8_t gain, uint8_t dg, uint8_t sens, float resolution) {
+    return { rangeConfig(it, gain, dg, sens), resolution, 0.4f * 65535 * resolution };
+}
+
+// Resolutions from the datasheet, bright light keeps the integration short
+static constexpr LuxRange LUX_RANGES[VEML6035_RANGE_COUNT] = {
+    luxRange(IntegrationTime::MS_800, 1, 1, 0, 0.0004f),  // up to 26 lux
+    luxRange(IntegrationTime::MS_200, 1, 1, 0, 0.0016f),  // up to 105 lux
+    luxRange(IntegrationTime::MS_100, 0, 0, 0, 0.0128f),  // up to 839 lux
+    luxRange(IntegrationTime::MS_50,  0, 0, 0, 0.0256f),  // up to 1678 lux
+    luxRange(IntegrationTime::MS_25,  0, 0, 0, 0.0512f),  // up to 3355 lux
+    luxRange(IntegrationTime::MS_25,  0, 0, 1, 0.4096f),  // up to 26843 lux
+};
+
 VEML6035::VEML6035() {
+    resolution = computeResolution(config_value);
+    lux_resolution = computeLuxResolution(config_value);
 }
 
 static void enableSensor(){
@@ -45,149 +72,370 @@ int VEML6035::init(char sd, char int_en, char channel_en, char int_channel, uint
 
 int VEML6035::setConfig(uint16_t configValue) {
     config_value = configValue;  
-    
-    uint8_t configBytes[] = {
-        (uint8_t)(configValue & 0xFF),        // LSB
-        (uint8_t)((configValue >> 8) & 0xFF)  // MSB
-    };
-    
-    Wire.beginTransmission(VEML6035_ADDRESS);
-    Wire.write(VEML6035_CONFIG_ADDRESS);
-    Wire.write(configBytes, 2);
-    if (Wire.endTransmission() != 0) {
-        return 1;
-    }
+    resolution = computeResolution(configValue);
+    lux_resolution = computeLuxResolution(configValue);
 
-    return 0;
+    int result = writeRegister(VEML6035_CONFIG_ADDRESS, configValue);
+
+    // The write restarts the integration
+    integration_start = millis();
+    config_start = integration_start;
+    return result;
 }
 
 uint16_t VEML6035::getConfig(){
     return config_value;
 }
 
-int VEML6035::setHighTresholdWindow(uint8_t htw) {
-    Wire.beginTransmission(VEML6035_ADDRESS);
-    Wire.write(VEML6035_HTW_ADDRESS);
-    Wire.write(htw);
-    if (Wire.endTransmission() != 0) {
-        return 1;
+uint16_t VEML6035::getIntegrationTimeMs() {
+    uint8_t it = (config_value >> 6) & 0x0F;
+
+    switch(it) {
+        case IntegrationTime::MS_25:  return 25;
+        case IntegrationTime::MS_50:  return 50;
+        case IntegrationTime::MS_100: return 100;
+        case IntegrationTime::MS_200: return 200;
+        case IntegrationTime::MS_400: return 400;
+        case IntegrationTime::MS_800: return 800;
+        default:     return 100;
     }
-    delay(100); 
+}
 
+int VEML6035::startAmbientLight() {
+    request.cancel();
+    integration_start = millis();
     return 0;
 }
 
-int VEML6035::setLowTresholdWindow(uint8_t ltw) {
-    Wire.beginTransmission(VEML6035_ADDRESS);
-    Wire.write(VEML6035_LTW_ADDRESS);
-    Wire.write(ltw);
-    if (Wire.endTransmission() != 0) {
+bool VEML6035::isAmbientLightReady() {
+    if (millis() - integration_start < getIntegrationTimeMs()) {
+        return false;
+    }
+
+    if (!i2cAsync.isRunning() || request.isDone()) {
+        return true;
+    }
+
+    // A full queue is retried on the next poll
+    if (!request.isBusy()) {
+        uint8_t reg = VEML6035_ALS_OUTPUT;
+        request.submit(VEML6035_ADDRESS, &reg, 1, als_output, 2);
+    }
+    return false;
+}
+
+float VEML6035::fetchAmbientLight() {
+    uint16_t rawAmbientLight;
+    if (fetchRawAmbientLight(&rawAmbientLight) != 0) {
+        return ERROR_VALUE;
+    }
+
+    float lux = (float)rawAmbientLight * lux_resolution;
+    updateRange(rawAmbientLight);
+    return lux;
+}
+
+int VEML6035::fetchAmbientLightMilli(uint32_t* millilux) {
+    uint16_t rawAmbientLight;
+    if (fetchRawAmbientLight(&rawAmbientLight) != 0) {
         return 1;
     }
-    delay(100); 
 
-    
+    *millilux = countsToMilliLux(rawAmbientLight, resolution);
+    updateRange(rawAmbientLight);
     return 0;
 }
 
+int VEML6035::fetchRawAmbientLight(uint16_t* raw) {
+    if (request.isDone()) {
+        if (request.take() != I2C_OK) {
+            return 1;
+        }
+        *raw = als_output[0] | (als_output[1] << 8);
+        return 0;
+    }
+
+    return readRegister(VEML6035_ALS_OUTPUT, raw);
+}
+
+// All registers are 16 bit, transferred LSB first
+int VEML6035::readRegister(uint8_t reg, uint16_t* value) {
+    return bus.readU16LE(reg, value) == I2C_OK ? 0 : 1;
+}
+
+int VEML6035::writeRegister(uint8_t reg, uint16_t value) {
+    return bus.writeU16LE(reg, value) == I2C_OK ? 0 : 1;
+}
+
+int VEML6035::setHighTresholdWindow(uint16_t htw) {
+    return writeRegister(VEML6035_HTW_ADDRESS, htw);
+}
+
+int VEML6035::setLowTresholdWindow(uint16_t ltw) {
+    return writeRegister(VEML6035_LTW_ADDRESS, ltw);
+}
+
 int VEML6035::setPowerSaveMode(char psm_enabled, uint8_t psm_wait_time) {
-    Wire.beginTransmission(VEML6035_ADDRESS);
-    Wire.write(VEML6035_PSM_ADDRESS);
-    uint8_t psm = (psm_enabled & 0x01);
+    uint16_t psm = (psm_enabled & 0x01);
     psm |= (psm_wait_time & 0x03) << 1; 
-    Wire.write(psm);
-    if (Wire.endTransmission() != 0) {
-        return 1;
-    }
-    
-    delay(100); 
 
-    
-    return 0;
+    return writeRegister(VEML6035_PSM_ADDRESS, psm);
 }
 
-float VEML6035::readAmbientLight() {
-    Wire.beginTransmission(VEML6035_ADDRESS);
-    Wire.write(VEML6035_ALS_OUTPUT);
-    if (Wire.endTransmission() != 0) {
-        return ERROR_VALUE;
+void VEML6035::waitForIntegration() {
+    unsigned long elapsed = millis() - integration_start;
+    uint16_t integration_ms = getIntegrationTimeMs();
+
+    if (elapsed < integration_ms) {
+        delay(integration_ms - elapsed);
     }
-    
-    delay(125); 
-    
-    Wire.requestFrom(VEML6035_ADDRESS, 2);
-    if (Wire.available() != 2) {
+    integration_start = millis();
+}
+
+float VEML6035::readAmbientLight() {
+    uint16_t rawAmbientLight;
+
+    waitForIntegration();
+
+    if (readRegister(VEML6035_ALS_OUTPUT, &rawAmbientLight) != 0) {
         return ERROR_VALUE;
     }
-    
-    uint16_t rawAmbientLight = Wire.read() << 8;
-    rawAmbientLight |= Wire.read();
-    float luxResolution = getLuxResolutionValue();
-    float luxValue = (float)rawAmbientLight * luxResolution;
+
+    float luxValue = (float)rawAmbientLight * lux_resolution;
+    updateRange(rawAmbientLight);
     return luxValue;
 }
 
-float VEML6035::readWhiteChannel() {
-    Wire.beginTransmission(VEML6035_ADDRESS);
-    Wire.write(VEML6035_WCH_OUTPUT);
-    if (Wire.endTransmission() != 0) {
-        return ERROR_VALUE;
+int VEML6035::readAmbientLightMilli(uint32_t* millilux) {
+    uint16_t raw;
+
+    // Each range change needs another conversion, at most one per range
+    for (uint8_t i = 0; i < VEML6035_RANGE_COUNT; i++) {
+        waitForIntegration();
+
+        if (readRegister(VEML6035_ALS_OUTPUT, &raw) != 0) {
+            return 1;
+        }
+
+        *millilux = countsToMilliLux(raw, resolution);
+        if (!updateRange(raw)) {
+            break;
+        }
     }
-    
-    delay(125); 
-    
-    Wire.requestFrom(VEML6035_ADDRESS, 2);
-    if (Wire.available() != 2) {
+
+    return 0;
+}
+
+float VEML6035::readWhiteChannel() {
+    uint16_t rawWhiteChannel;
+
+    waitForIntegration();
+
+    if (readRegister(VEML6035_WCH_OUTPUT, &rawWhiteChannel) != 0) {
         return ERROR_VALUE;
     }
-    
-    uint16_t rawWhiteChannel = Wire.read() << 8;
-    rawWhiteChannel |= Wire.read();
-    float luxResolution = getLuxResolutionValue();
 
-    float whiteValue = (float)rawWhiteChannel * luxResolution;
+    float whiteValue = (float)rawWhiteChannel * lux_resolution;
     return whiteValue;
 }
 
 float VEML6035::readInterruptStatus() {
-    Wire.beginTransmission(VEML6035_ADDRESS);
-    Wire.write(VEML6035_INT_STATUS);
-    if (Wire.endTransmission() != 0) {
+    uint16_t rawIntStatus;
+    if (readRegister(VEML6035_INT_STATUS, &rawIntStatus) != 0) {
         return ERROR_VALUE;
     }
     
-    delay(10); 
-    
-    Wire.requestFrom(VEML6035_ADDRESS, 2);
-    if (Wire.available() != 2) {
-        return ERROR_VALUE;
-    }
-    
-    uint16_t rawIntStatus = Wire.read() << 8;
-    rawIntStatus |= Wire.read();
-    
     return (float)rawIntStatus;
 }
 
+int VEML6035::setEventWindow(uint16_t raw) {
+    uint32_t margin = (uint32_t)raw * event_window_percent / 100;
+    uint32_t min_margin = (uint32_t)(event_min_window_lux / lux_resolution);
+    if (margin < min_margin) {
+        margin = min_margin;
+    }
+
+    uint16_t low = raw > margin ? raw - margin : 0;
+    uint16_t high = raw + margin < 0xFFFF ? raw + margin : 0xFFFF;
+
+    if (setLowTresholdWindow(low) != 0 || setHighTresholdWindow(high) != 0) {
+        return 1;
+    }
+
+    return 0;
+}
+
+int VEML6035::enableEventMode(uint8_t window_percent, float min_window_lux, uint8_t psm_wait_time, int int_pin) {
+    uint16_t raw;
+
+    event_window_percent = window_percent;
+    event_min_window_lux = min_window_lux;
+    event_int_pin = int_pin;
+
+    // Centre the first window on the last conversion, which has to be one
+    // of the current range for the window to be in its counts
+    unsigned long elapsed = millis() - config_start;
+    if (elapsed < getIntegrationTimeMs()) {
+        delay(getIntegrationTimeMs() - elapsed);
+    }
+
+    if (readRegister(VEML6035_ALS_OUTPUT, &raw) != 0 || setEventWindow(raw) != 0) {
+        return 1;
+    }
+
+    if (setPowerSaveMode(1, psm_wait_time) != 0) {
+        return 1;
+    }
+
+    uint16_t config = (config_value | VEML6035_CONFIG_INT_EN) & ~VEML6035_CONFIG_INT_CHANNEL;
+    if (setConfig(config) != 0) {
+        return 1;
+    }
+
+    if (event_int_pin >= 0) {
+        pinMode(event_int_pin, INPUT_PULLUP);
+    }
+
+    // Drop an interrupt that was pending from before
+    readRegister(VEML6035_INT_STATUS, &raw);
+
+    event_mode = true;
+    return 0;
+}
+
+int VEML6035::disableEventMode() {
+    event_mode = false;
+
+    if (setConfig(config_value & ~VEML6035_CONFIG_INT_EN) != 0) {
+        return 1;
+    }
+
+    return setPowerSaveMode(0, PowerSafeModeWaitTime::S_04);
+}
+
+bool VEML6035::isEventModeEnabled() {
+    return event_mode;
+}
+
+int VEML6035::readEvent(bool* changed, float* lux) {
+    uint32_t millilux;
+    int result = readEventMilli(changed, &millilux);
+
+    if (*changed) {
+        *lux = millilux / 1000.0f;
+    }
+    return result;
+}
+
+int VEML6035::readEventMilli(bool* changed, uint32_t* millilux) {
+    uint16_t status, raw;
+
+    *changed = false;
+
+    // The INT line is active low, while it is high there is nothing to read
+    if (event_int_pin >= 0 && digitalRead(event_int_pin) == HIGH) {
+        return 0;
+    }
+
+    if (readRegister(VEML6035_INT_STATUS, &status) != 0) {
+        return 1;
+    }
+
+    if ((status & (VEML6035_INT_TH_HIGH | VEML6035_INT_TH_LOW)) == 0) {
+        return 0;
+    }
+
+    if (readRegister(VEML6035_ALS_OUTPUT, &raw) != 0) {
+        return 1;
+    }
+
+    uint16_t lastResolution = resolution;
+    *millilux = countsToMilliLux(raw, resolution);
+    *changed = true;
+
+    // The window is in counts of the range the next conversions use
+    if (updateRange(raw)) {
+        uint32_t counts = (uint32_t)raw * lastResolution / resolution;
+        raw = counts < 0xFFFF ? counts : 0xFFFF;
+    }
+
+    return setEventWindow(raw);
+}
+
+int VEML6035::setAutoRange(bool enabled) {
+    auto_range = enabled;
+    if (!enabled) {
+        return 0;
+    }
+
+    range = VEML6035_RANGE_DEFAULT;
+    return setConfig((config_value & ~VEML6035_CONFIG_RANGE_MASK) | LUX_RANGES[range].config);
+}
+
+bool VEML6035::isAutoRangeEnabled() {
+    return auto_range;
+}
+
+uint8_t VEML6035::getRange() {
+    return range;
+}
+
+bool VEML6035::updateRange(uint16_t raw) {
+    if (!auto_range) {
+        return false;
+    }
+
+    uint8_t target = range;
+
+    if (raw >= VEML6035_RANGE_UP_COUNTS) {
+        // A saturated count says nothing about how far off the range is
+        target = raw == 0xFFFF ? VEML6035_RANGE_COUNT - 1 : range + 1;
+        if (target >= VEML6035_RANGE_COUNT) {
+            target = VEML6035_RANGE_COUNT - 1;
+        }
+    } else {
+        float lux = (float)raw * lux_resolution;
+        while (target > 0 && lux < LUX_RANGES[target - 1].down_lux) {
+            target--;
+        }
+    }
+
+    if (target == range) {
+        return false;
+    }
+
+    range = target;
+    setConfig((config_value & ~VEML6035_CONFIG_RANGE_MASK) | LUX_RANGES[range].config);
+    return true;
+}
+
 float VEML6035::getLuxResolutionValue() {
-    uint8_t it = (config_value >> 6) & 0x0F;
+    return lux_resolution;
+}
+
+float VEML6035::computeLuxResolution(uint16_t config) {
+    return computeResolution(config) / 10000.0f;
+}
+
+uint16_t VEML6035::computeResolution(uint16_t config) {
+    uint8_t it = (config >> 6) & 0x0F;
     
-    uint8_t gain = (config_value >> 10) & 0x01;
+    uint8_t gain = (config >> 10) & 0x01;
     
-    uint8_t dg = (config_value >> 11) & 0x01;
+    uint8_t dg = (config >> 11) & 0x01;
     
-    uint8_t sens = (config_value >> 12) & 0x01;
+    uint8_t sens = (config >> 12) & 0x01;
     
-    // Base resolution values for DG=0, GAIN=0, SENS=0 
-    float baseResolution;
+    // Base resolution values for DG=0, GAIN=0, SENS=0, in 0.1 mlux/count
+    uint16_t baseResolution;
     switch(it) {
-        case IntegrationTime::MS_25:  baseResolution = 0.0512; break;  // 0.0512 lux/count 
-        case IntegrationTime::MS_50:  baseResolution = 0.0256; break;  // 0.0256 lux/count 
-        case IntegrationTime::MS_100: baseResolution = 0.0128; break;  // 0.0128 lux/count 
-        case IntegrationTime::MS_200: baseResolution = 0.0064;  break;  // 0.0064 lux/count  
-        case IntegrationTime::MS_400: baseResolution = 0.0032;  break;  // 0.0032 lux/count 
-        case IntegrationTime::MS_800: baseResolution = 0.0016;  break;  // 0.0016 lux/count
-        default:     baseResolution = 0.0128; break;  // Default to 100ms
+        case IntegrationTime::MS_25:  baseResolution = 512; break;  // 0.0512 lux/count 
+        case IntegrationTime::MS_50:  baseResolution = 256; break;  // 0.0256 lux/count 
+        case IntegrationTime::MS_100: baseResolution = 128; break;  // 0.0128 lux/count 
+        case IntegrationTime::MS_200: baseResolution = 64;  break;  // 0.0064 lux/count  
+        case IntegrationTime::MS_400: baseResolution = 32;  break;  // 0.0032 lux/count 
+        case IntegrationTime::MS_800: baseResolution = 16;  break;  // 0.0016 lux/count
+        default:     baseResolution = 128; break;  // Default to 100ms
     }
     
     // Apply GAIN adjustment 
@@ -206,4 +454,9 @@ float VEML6035::getLuxResolutionValue() {
     }
     
     return baseResolution;
-}
\ No newline at end of file
+}
+
+// At most 65535 counts of 409.6 mlux, fits 32 bits
+uint32_t VEML6035::countsToMilliLux(uint16_t raw, uint16_t resolution) {
+    return ((uint32_t)raw * resolution + 5) / 10;
+}
@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include "i2c_register.h"
+#include "i2c_async.h"
 
 // All addresses are according to the sensors' datasheet
 // https://www.vishay.com/docs/84889/veml6035.pdf
@@ -35,6 +37,24 @@ struct PersistenceSettings{
     static const uint8_t EIGHT = 0x03;
 };
 
+// Interrupt status register bits, cleared by reading the register
+#define VEML6035_INT_TH_HIGH 0x8000
+#define VEML6035_INT_TH_LOW  0x4000
+
+// Configuration register bits used by the event mode
+#define VEML6035_CONFIG_INT_EN      0x0002
+#define VEML6035_CONFIG_INT_CHANNEL 0x0008
+
+// Auto ranging steps through IT/GAIN/DG/SENS settings, range 0 is the
+// most sensitive one. A range is left upwards above 80 % of full scale
+// and downwards once the light fits into 40 % of the next finer range.
+#define VEML6035_RANGE_COUNT     6
+#define VEML6035_RANGE_DEFAULT   2
+#define VEML6035_RANGE_UP_COUNTS 52428
+
+// Config bits set by the auto ranging: IT, GAIN, DG and SENS
+#define VEML6035_CONFIG_RANGE_MASK 0x1FC0
+
 struct PowerSafeModeWaitTime{
     static const uint8_t S_04 = 0x00;
     static const uint8_t S_08 = 0x01;
@@ -57,10 +77,11 @@ public:
     int init(char sd, char int_en, char channel_en, char int_channel, uint8_t als_pers, uint8_t als_it, char gain, char dg, char sens);
     
     
-    int setHighTresholdWindow(uint8_t htw);
+    // Thresholds are raw ALS counts, see getLuxResolutionValue()
+    int setHighTresholdWindow(uint16_t htw);
 
     
-    int setLowTresholdWindow(uint8_t ltw);
+    int setLowTresholdWindow(uint16_t ltw);
 
     
     int setPowerSaveMode(char psm_enabled, uint8_t psm_wait_time);
@@ -69,24 +90,123 @@ public:
     int setConfig(uint16_t config_value);
 
     
+    // Blocking reads, wait for a conversion of the current configuration
     float readAmbientLight();
     
     
     float readWhiteChannel();
 
+    // Blocking integer read in milli-lux. With auto ranging it reads again
+    // until the range fits the light, for a first value before the event
+    // mode. Returns 0 on success.
+    int readAmbientLightMilli(uint32_t* millilux);
+
     
     float readInterruptStatus();
     
     
+    // Lux per count of the current configuration, cached by setConfig()
     float getLuxResolutionValue();
 
+    // Picks IT/GAIN/DG/SENS from every reading, starting at VEML6035_RANGE_DEFAULT
+    int setAutoRange(bool enabled);
+
+    bool isAutoRangeEnabled();
+
+    uint8_t getRange();
+
     uint16_t getConfig();
+
+    // Integration time in ms of the current configuration
+    uint16_t getIntegrationTimeMs();
+
+    // Non-blocking read: the sensor converts continuously, so start only
+    // marks the beginning of a fresh integration period to wait for. While
+    // i2cAsync is running the output is read in the background and
+    // isAmbientLightReady() only reports true once it arrived.
+    int startAmbientLight();
+
+    bool isAmbientLightReady();
+
+    float fetchAmbientLight();
+
+    // Integer variant in milli-lux, returns 0 on success
+    int fetchAmbientLightMilli(uint32_t* millilux);
+
+    // Event mode: the sensor converts in power save mode and only raises
+    // its interrupt when the light leaves a window around the last value.
+    // The window is window_percent of the value, but at least min_window_lux
+    // so darkness does not trigger on noise. int_pin is the optional,
+    // active low INT line, without it the status register is polled.
+    int enableEventMode(uint8_t window_percent = 25, float min_window_lux = 1.0,
+                        uint8_t psm_wait_time = PowerSafeModeWaitTime::S_16, int int_pin = -1);
+
+    int disableEventMode();
+
+    bool isEventModeEnabled();
+
+    // Sets changed and the new lux once the light left the window, the
+    // window is then moved to the new value. Returns 0 on success.
+    int readEvent(bool* changed, float* lux);
+
+    int readEventMilli(bool* changed, uint32_t* millilux);
+
+    // Counts times a resolution in 0.1 mlux/count, without any float math
+    static uint32_t countsToMilliLux(uint16_t raw, uint16_t resolution);
     
 
 private:
+    I2CRegisters bus{VEML6035_ADDRESS};
 
     uint16_t config_value = 0;
 
+    float lux_resolution;
+
+    // lux_resolution in 0.1 mlux/count, exact for every configuration
+    uint16_t resolution;
+
+    bool auto_range = false;
+
+    uint8_t range = VEML6035_RANGE_DEFAULT;
+
+    unsigned long integration_start = 0;
+
+    // Time of the last config write, the output is in the resolution of
+    // config_value one integration time later
+    unsigned long config_start = 0;
+
+    I2CAsyncRequest request;
+
+    uint8_t als_output[2];
+
+    bool event_mode = false;
+
+    uint8_t event_window_percent = 25;
+
+    float event_min_window_lux = 1.0;
+
+    int event_int_pin = -1;
+
+    int readRegister(uint8_t reg, uint16_t* value);
+
+    // Waits for the rest of the integration since the last configuration
+    // or blocking read, so the output holds a conversion made after it
+    void waitForIntegration();
+
+    // Output read ahead by the queue, or read now
+    int fetchRawAmbientLight(uint16_t* raw);
+
+    int writeRegister(uint8_t reg, uint16_t value);
+
+    int setEventWindow(uint16_t raw);
+
+    // Switches the range for the next reading, returns true if it changed
+    bool updateRange(uint16_t raw);
+
+    static float computeLuxResolution(uint16_t config);
+
+    static uint16_t computeResolution(uint16_t config);
+
     
     static constexpr float ERROR_VALUE = -999.0;
     
@@ -5,12 +5,52 @@
 #include "sht30.h"
 #include "pins_arduino.h"
 #include <silabs_imu.h>
+#include "sensor_scheduler.h"
+#include "i2c_async.h"
+#include "sensor_frame.h"
+#include "sensor_history.h"
+#include "sensor_config.h"
+#include "actigraphy.h"
+#include "th_fusion.h"
+#include <EEPROM.h>
+
+// Also publish every value on its own characteristic for old clients
+#define LEGACY_CHARACTERISTICS 0
+
+// Let the SHT30 measure periodically and only fetch its results
+#define SHT30_PERIODIC_MODE 1
+
+// Only read the light when it leaves a window around the last value
+// (lights switched on/off) instead of every VEML6035 period
+#define VEML6035_EVENT_MODE 1
+// INT line of the VEML6035 if it is wired, -1 polls the status register
+#define VEML6035_INT_PIN -1
+
+// Queue the sensor reads, loop() only queues them and picks the results
+// up on a later pass. The library is built polled (I2C_ASYNC_OWN_IRQ 0),
+// the i2cAsync.service() of every pass advances the transfers.
+#define I2C_ASYNC 1
+
+// Read the SI7021 and the SHT30 in turn, each at half the SI7021 period,
+// and ship one fused temperature/humidity from both
+#define TH_FUSION_ALTERNATE 1
+
+// Keep the IMU in low power wake on motion while the wearer is still and
+// only sample the FIFO for a burst after it wakes up
+#define IMU_WAKE_ON_MOTION 1
+// INT line of the ICM-20689 if it is wired, -1 polls INT_STATUS
+#define IMU_INT_PIN -1
 
 SilabsIMU imu;
 SI7021 si7021_ths;
 VEML6035 veml6035_als;
 SHT30 sht30_ths;
 MovementData movementData;
+SensorScheduler scheduler;
+SensorHistory history;
+SensorHistoryReader historyReader;
+Actigraphy actigraphy;
+ThFusion thFusion;
 
 bool imuSetupFailed = false;
 bool si7021SetupFailed = false;
@@ -34,9 +74,20 @@ const char IMU_MI_UUID[] = "12345678-1234-5678-1234-56789abcdef7";
 const char IMU_MPM_UUID[] = "12345678-1234-5678-1234-56789abcdef8";
 const char IMU_ILA_UUID[] = "12345678-1234-5678-1234-56789abcdef9";
 const char IMU_SDM_UUID[] = "12345678-1234-5678-1234-56789abcdee0";
+const char SENSOR_FRAME_UUID[] = "12345678-1234-5678-1234-56789abcdee1";
+const char HISTORY_CONTROL_UUID[] = "12345678-1234-5678-1234-56789abcdee2";
+const char HISTORY_DATA_UUID[] = "12345678-1234-5678-1234-56789abcdee3";
+const char CONFIG_UUID[] = "12345678-1234-5678-1234-56789abcdee4";
 
 // BLE service and characteristics
 BLEService sensorService(SERVICE_UUID);
+// The frame is longer than the default 20 byte notification payload, the
+// client negotiates a larger MTU in discoverAttributes()
+BLECharacteristic sensor_frame_char(SENSOR_FRAME_UUID, BLERead | BLENotify, SENSOR_FRAME_SIZE);
+BLECharacteristic history_control_char(HISTORY_CONTROL_UUID, BLEWrite, SENSOR_HISTORY_CMD_LENGTH);
+BLECharacteristic history_data_char(HISTORY_DATA_UUID, BLENotify, SENSOR_HISTORY_CHUNK_SIZE);
+BLECharacteristic config_char(CONFIG_UUID, BLERead | BLEWrite, SENSOR_CONFIG_SIZE);
+#if LEGACY_CHARACTERISTICS
 BLECharacteristic si7021_t_char(SI7021_T_UUID, BLERead | BLENotify, sizeof(float));
 BLECharacteristic si7021_h_char(SI7021_H_UUID, BLERead | BLENotify, sizeof(float));
 BLECharacteristic sht30_t_char(SHT30_T_UUID, BLERead | BLENotify, sizeof(float));
@@ -47,12 +98,385 @@ BLECharacteristic imu_mi_char(IMU_MI_UUID, BLERead | BLENotify, sizeof(float));
 BLECharacteristic imu_mpm_char(IMU_MPM_UUID, BLERead | BLENotify, sizeof(int));
 BLECharacteristic imu_ila_char(IMU_ILA_UUID, BLERead | BLENotify, sizeof(bool));
 BLECharacteristic imu_sdm_char(IMU_SDM_UUID, BLERead | BLENotify, sizeof(unsigned long));
+#endif
 
 unsigned long lastUpdate = 0;
-const unsigned long updateInterval = 5000;
+uint16_t frameSequence = 0;
+
+// A frame is stored in the history every minute, connected or not
+unsigned long lastHistoryRecord = 0;
+const unsigned long historyInterval = 60000;
+
+// History chunk waiting to be notified, the client picks the size
+uint8_t historyChunk[SENSOR_HISTORY_CHUNK_SIZE];
+size_t historyChunkLength = 0;
+size_t historyChunkSize = SENSOR_HISTORY_MIN_CHUNK_SIZE;
+uint8_t historyChunkCounter = 0;
+
+// Sampling periods of the scheduler tasks and the BLE update period, set
+// over BLE and kept in EEPROM. In FIFO mode the IMU samples at 50 Hz on
+// its own and its period is only the FIFO drain period.
+SensorConfig sensorConfig;
+
+// Scheduler task indices, -1 if the sensor failed to set up. thTask reads
+// both temperature/humidity sensors in turn and replaces their own tasks.
+int si7021Task = -1, sht30Task = -1, thTask = -1, veml6035Task = -1, imuTask = -1;
+
+// Latest sensor values in the fixed point units of sensor_frame.h, only
+// the BLE characteristics and Serial output convert them to float
+int16_t si7021TempCenti = 0, sht30TempCenti = 0;
+uint16_t si7021HumCenti = 0, sht30HumCenti = 0;
+uint32_t veml6035MilliLux = 0;
+uint16_t movementIntensityMilli = 0;
+// False until the first successful reading and after a failed one
+bool si7021Valid = false, sht30Valid = false, veml6035Valid = false;
+
+uint8_t sht30MissedFetches = 0;
+
+// Set by a light event, the next frame is sent without waiting for the update period
+bool lightChanged = false;
+// Set by the IMU task on a posture change, sends a frame right away
+bool postureChanged = false;
+
+// Last IMU sample and the time the sleep staging was fed up to, see feedStillSamples()
+int16_t lastImuSample[3] = {0, 0, ACTIGRAPHY_COUNTS_PER_G};
+unsigned long stillFedUntil = 0;
+
+// Scheduler tasks: one humidity conversion for the SI7021, which measures
+// the temperature as well, one single shot for the SHT30, one integration
+// period for the VEML6035
+int si7021Start()
+{
+  return si7021_ths.startHumidityMeasurement() == 0 ? SENSOR_TASK_OK : SENSOR_TASK_ERROR;
+}
+
+bool si7021Ready()
+{
+  return si7021_ths.isMeasurementReady();
+}
+
+int si7021Fetch()
+{
+  si7021Valid = si7021_ths.fetchHumidityCenti(&si7021HumCenti) == 0 &&
+                si7021_ths.readTemperatureFromHumidityCenti(&si7021TempCenti) == 0;
+
+  if (!si7021Valid)
+  {
+    thFusion.invalidate(ThSensor::SI7021);
+    Serial.println("Error reading temperature/humidity sensor data");
+    return SENSOR_TASK_ERROR;
+  }
+
+  thFusion.addSample(ThSensor::SI7021, si7021TempCenti, si7021HumCenti, millis());
+  return SENSOR_TASK_OK;
+}
+
+int sht30Start()
+{
+  return sht30_ths.startMeasurement(SHT30_Repeatability::HIGH) == SHT30_OK ? SENSOR_TASK_OK : SENSOR_TASK_ERROR;
+}
+
+bool sht30Ready()
+{
+  return sht30_ths.isMeasurementReady();
+}
+
+int sht30Fetch()
+{
+  uint8_t result = sht30_ths.fetchMeasurementCenti(&sht30TempCenti, &sht30HumCenti);
+
+  sht30Valid = result == SHT30_OK;
+  if (!sht30Valid)
+  {
+    thFusion.invalidate(ThSensor::SHT30);
+    Serial.print("Error: ");
+    Serial.println(result);
+    return SENSOR_TASK_ERROR;
+  }
+
+  thFusion.addSample(ThSensor::SHT30, sht30TempCenti, sht30HumCenti, millis());
+  return SENSOR_TASK_OK;
+}
+
+// Periodic mode: the SHT30 measures once per second by itself
+int sht30FetchPeriodic()
+{
+  int16_t t;
+  uint16_t h;
+  uint8_t result = sht30_ths.fetchCenti(&t, &h);
+
+  if (result == SHT30_OK)
+  {
+    sht30TempCenti = t;
+    sht30HumCenti = h;
+    sht30Valid = true;
+    sht30MissedFetches = 0;
+    thFusion.addSample(ThSensor::SHT30, t, h, millis());
+    return SENSOR_TASK_OK;
+  }
+
+  // Missing a result now and then is clock drift, several in a row
+  // mean the sensor was reset and stopped measuring
+  if (result == SHT30_ERROR_NO_DATA && ++sht30MissedFetches < 3)
+  {
+    return SENSOR_TASK_OK;
+  }
+
+  uint16_t status;
+  sht30MissedFetches = 0;
+  sht30_ths.checkStatus(&status);
+
+  sht30Valid = false;
+  thFusion.invalidate(ThSensor::SHT30);
+  Serial.print("Error: ");
+  Serial.println(result);
+  return SENSOR_TASK_ERROR;
+}
+
+// Alternating mode: one task reads the SI7021 and the SHT30 in turn, the
+// fusion carries the value of the sensor not read this time
+uint8_t thTurn = ThSensor::SHT30;
+
+int thStart()
+{
+  // Moves on even if the last turn failed, so a dead sensor does not
+  // starve the other one
+  thTurn = thTurn == ThSensor::SI7021 ? ThSensor::SHT30 : ThSensor::SI7021;
+  if (thTurn == ThSensor::SI7021)
+    return si7021Start();
+
+  // The periodic SHT30 measures by itself
+  return sht30_ths.isPeriodic() ? SENSOR_TASK_OK : sht30Start();
+}
+
+bool thReady()
+{
+  return thTurn == ThSensor::SI7021 ? si7021Ready() : sht30Ready();
+}
+
+int thFetch()
+{
+  if (thTurn == ThSensor::SI7021)
+    return si7021Fetch();
+  return sht30_ths.isPeriodic() ? sht30FetchPeriodic() : sht30Fetch();
+}
+
+int veml6035Start()
+{
+  return veml6035_als.startAmbientLight() == 0 ? SENSOR_TASK_OK : SENSOR_TASK_ERROR;
+}
+
+bool veml6035Ready()
+{
+  return veml6035_als.isAmbientLightReady();
+}
+
+int veml6035Fetch()
+{
+  veml6035Valid = veml6035_als.fetchAmbientLightMilli(&veml6035MilliLux) == 0;
+
+  if (!veml6035Valid)
+  {
+    Serial.println("Error reading light sensor data");
+    return SENSOR_TASK_ERROR;
+  }
+
+  return SENSOR_TASK_OK;
+}
+
+// Event mode: one status register read per period, the value only when it changed
+int veml6035Event()
+{
+  bool changed;
+  uint32_t millilux;
+
+  if (veml6035_als.readEventMilli(&changed, &millilux) != 0)
+  {
+    Serial.println("Error reading light sensor data");
+    return SENSOR_TASK_ERROR;
+  }
 
+  if (changed)
+  {
+    veml6035MilliLux = millilux;
+    veml6035Valid = true;
+    lightChanged = true;
+  }
+
+  return SENSOR_TASK_OK;
+}
+
+// Every FIFO sample goes into the sleep staging, tuned to the FIFO rate
+void imuSample(int16_t x, int16_t y, int16_t z, void *context)
+{
+  actigraphy.addSample(x, y, z);
+  lastImuSample[0] = x;
+  lastImuSample[1] = y;
+  lastImuSample[2] = z;
+}
+
+// The IMU does not sample while it waits for motion, the wearer is still
+// then, so the sleep staging gets the last sample repeated at its rate
+void feedStillSamples(unsigned long now)
+{
+  const unsigned long samplePeriod = lroundf(1000.0f / actigraphy.getSampleRate());
+
+  while (now - stillFedUntil >= samplePeriod)
+  {
+    actigraphy.addSample(lastImuSample[0], lastImuSample[1], lastImuSample[2]);
+    stillFedUntil += samplePeriod;
+  }
+}
+
+int imuFetch()
+{
+  unsigned long now = millis();
+
+  if (imu.serviceWakeOnMotion() == IMUPowerMode::WAKE_ON_MOTION)
+  {
+    feedStillSamples(now);
+  }
+  else if (imu.isFifoEnabled())
+  {
+    stillFedUntil = now;
+
+    // Drain everything sampled since the last tick in one burst
+    if (imu.readFifo() < 0)
+    {
+      Serial.println("IMU FIFO overflow");
+    }
+    imu.processFifo();
+  }
+  else
+  {
+    if (!imu.readIMU())
+    {
+      return SENSOR_TASK_ERROR;
+    }
+
+    imu.calculateMovement();
+    imu.updateMovementState();
+    imu.incrementSampleCount();
+  }
+
+  if (imu.takePostureChange())
+  {
+    postureChanged = true;
+    Serial.print("Posture changed: ");
+    Serial.println(imu.getPosture());
+  }
 
+  // Update every minute (10 seconds for demo)
+  if (imu.shouldUpdateMinutelyStats())
+  {
+    imu.updateMinutelyStats();
+    movementData = imu.getMovementData();
+    movementIntensityMilli = imu.getMovementIntensityMilliG();
+  }
+
+  return SENSOR_TASK_OK;
+}
+
+void loadConfig()
+{
+  uint8_t stored[SENSOR_CONFIG_STORED_SIZE];
+
+  for (size_t i = 0; i < sizeof(stored); i++)
+  {
+    stored[i] = EEPROM.read(i);
+  }
+
+  if (!sensorConfigLoad(stored, sizeof(stored), &sensorConfig))
+  {
+    Serial.println("No stored sampling config, using defaults");
+    sensorConfigDefaults(&sensorConfig);
+  }
+}
+
+void saveConfig()
+{
+  uint8_t stored[SENSOR_CONFIG_STORED_SIZE];
+  size_t length = sensorConfigStore(&sensorConfig, stored, sizeof(stored));
+
+  // update() skips unchanged bytes and saves flash wear
+  for (size_t i = 0; i < length; i++)
+  {
+    EEPROM.update(i, stored[i]);
+  }
+}
+
+// Slowest periodic SHT30 rate that still has a new result for every fetch
+uint8_t sht30RateForPeriod(unsigned long period)
+{
+  if (period < 250)
+    return SHT30_Rate::MPS_10;
+  if (period < 500)
+    return SHT30_Rate::MPS_4;
+  if (period < 1000)
+    return SHT30_Rate::MPS_2;
+  if (period < 2000)
+    return SHT30_Rate::MPS_1;
+  return SHT30_Rate::MPS_0_5;
+}
+
+void applyConfig()
+{
+  scheduler.setPeriod(si7021Task, sensorConfig.si7021_period_ms);
+  scheduler.setPeriod(sht30Task, sensorConfig.sht30_period_ms);
+  scheduler.setPeriod(thTask, sensorConfig.si7021_period_ms);
+  scheduler.setPeriod(veml6035Task, sensorConfig.veml6035_period_ms);
+  scheduler.setPeriod(imuTask, sensorConfig.imu_period_ms);
+
+  // Polled samples arrive at the task rate, the FIFO sets its own
+  if (!imu.isFifoEnabled() && !imu.isWakeOnMotionEnabled())
+  {
+    imu.setSampleRate(1000.0f / sensorConfig.imu_period_ms);
+  }
 
+  // Alternating, each sensor is read every other task period
+  unsigned long sht30Period = sensorConfig.sht30_period_ms;
+  if (thTask >= 0)
+  {
+    sht30Period = 2 * sensorConfig.si7021_period_ms;
+    thFusion.setSamplePeriod(sht30Period);
+  }
+  else
+  {
+    thFusion.setSamplePeriod(max(sensorConfig.si7021_period_ms, sensorConfig.sht30_period_ms));
+  }
+
+  if (sht30_ths.isPeriodic())
+  {
+    sht30_ths.startPeriodic(sht30RateForPeriod(sht30Period));
+  }
+
+  uint8_t encoded[SENSOR_CONFIG_SIZE];
+  sensorConfigEncode(&sensorConfig, encoded, sizeof(encoded));
+  config_char.writeValue(encoded, sizeof(encoded));
+}
+
+void handleConfigWrite()
+{
+  if (!config_char.written())
+  {
+    return;
+  }
+
+  SensorConfig received;
+  if (sensorConfigDecode(config_char.value(), config_char.valueLength(), &received))
+  {
+    sensorConfig = received;
+    saveConfig();
+    Serial.println("Sampling config updated");
+  }
+  else
+  {
+    Serial.println("Invalid sampling config ignored");
+  }
+
+  // Also puts the current config back if the written one was rejected
+  applyConfig();
+}
 
 void setup()
 {
@@ -60,10 +484,41 @@ void setup()
   Serial.begin(115200);
 
   Wire.begin();
+#if I2C_ASYNC
+  if (i2cAsync.begin() != 0)
+  {
+    Serial.println("I2C queue setup failed, reading the sensors blocking");
+  }
+#endif
+
+  loadConfig();
 
   if (imu.begin())
   {
     Serial.println("IMU initialized successfully!");
+
+    if (imu.enableFifo())
+    {
+      imu.setSampleCallback(imuSample, NULL);
+
+      if (!actigraphy.setSampleRate(imu.getFifoSampleRate()))
+      {
+        Serial.println("IMU FIFO rate not supported by the sleep staging");
+      }
+      actigraphy.reset();
+
+#if IMU_WAKE_ON_MOTION
+      stillFedUntil = millis();
+      if (!imu.enableWakeOnMotion(IMU_WOM_DEFAULT_THRESHOLD_MG, IMU_INT_PIN))
+      {
+        Serial.println("IMU wake on motion setup failed, sampling continuously");
+      }
+#endif
+    }
+    else
+    {
+      Serial.println("IMU FIFO setup failed, polling single samples");
+    }
   }
   else
   {
@@ -92,6 +547,13 @@ void setup()
   else
   {
     Serial.println("SHT30 Temperature & Humidity Sensor Ready");
+
+#if SHT30_PERIODIC_MODE
+    if (sht30_ths.startPeriodic(sht30RateForPeriod(sensorConfig.sht30_period_ms)) != SHT30_OK)
+    {
+      Serial.println("SHT30 periodic mode failed, using single shots");
+    }
+#endif
   }
 
   if (veml6035_als.init() != 0)
@@ -103,6 +565,64 @@ void setup()
   else
   {
     Serial.println("Ambient Light Sensor Ready");
+
+    // Fine ranges in the dark, short integration under room lighting
+    veml6035_als.setAutoRange(true);
+
+#if VEML6035_EVENT_MODE
+    // First value, the event mode only reports changes. The window is set
+    // in counts of the range this settles on.
+    veml6035Valid = veml6035_als.readAmbientLightMilli(&veml6035MilliLux) == 0;
+    if (veml6035_als.enableEventMode(25, 1.0, PowerSafeModeWaitTime::S_16, VEML6035_INT_PIN) != 0)
+    {
+      Serial.println("Ambient Light Sensor event mode failed, polling");
+    }
+#endif
+  }
+
+  // Alternating needs both sensors, with one left it is read at its own period
+  bool thAlternate = TH_FUSION_ALTERNATE && !si7021SetupFailed && !sht30SetupFailed;
+
+  if (thAlternate)
+  {
+    // The SHT30 converts in under 16 ms, within the SI7021 timings
+    thTask = scheduler.addTask("SI7021/SHT30", sensorConfig.si7021_period_ms, thStart, thReady, thFetch,
+                               SI7021_HUMIDITY_TYPICAL_MS, SI7021_CONVERSION_TIMEOUT_MS);
+  }
+
+  if (!si7021SetupFailed && !thAlternate)
+  {
+    si7021Task = scheduler.addTask("SI7021", sensorConfig.si7021_period_ms, si7021Start, si7021Ready, si7021Fetch,
+                                   SI7021_HUMIDITY_TYPICAL_MS, SI7021_CONVERSION_TIMEOUT_MS);
+  }
+
+  if (!sht30SetupFailed && !thAlternate)
+  {
+    if (sht30_ths.isPeriodic())
+    {
+      sht30Task = scheduler.addTask("SHT30", sensorConfig.sht30_period_ms, NULL, sht30Ready, sht30FetchPeriodic);
+    }
+    else
+    {
+      sht30Task = scheduler.addTask("SHT30", sensorConfig.sht30_period_ms, sht30Start, sht30Ready, sht30Fetch);
+    }
+  }
+
+  if (!veml6035SetupFailed)
+  {
+    if (veml6035_als.isEventModeEnabled())
+    {
+      veml6035Task = scheduler.addTask("VEML6035", sensorConfig.veml6035_period_ms, NULL, NULL, veml6035Event);
+    }
+    else
+    {
+      veml6035Task = scheduler.addTask("VEML6035", sensorConfig.veml6035_period_ms, veml6035Start, veml6035Ready, veml6035Fetch);
+    }
+  }
+
+  if (!imuSetupFailed)
+  {
+    imuTask = scheduler.addTask("IMU", sensorConfig.imu_period_ms, NULL, NULL, imuFetch);
   }
 
   Serial.println("=== ArduinoBLE Multi-Sensor Server ===");
@@ -119,6 +639,11 @@ void setup()
   BLE.setAdvertisedService(sensorService);
 
   // Add characteristics
+  sensorService.addCharacteristic(sensor_frame_char);
+  sensorService.addCharacteristic(history_control_char);
+  sensorService.addCharacteristic(history_data_char);
+  sensorService.addCharacteristic(config_char);
+#if LEGACY_CHARACTERISTICS
   sensorService.addCharacteristic(si7021_t_char);
   sensorService.addCharacteristic(si7021_h_char);
   sensorService.addCharacteristic(sht30_t_char);
@@ -129,8 +654,12 @@ void setup()
   sensorService.addCharacteristic(imu_mpm_char);
   sensorService.addCharacteristic(imu_ila_char);
   sensorService.addCharacteristic(imu_sdm_char);
+#endif
   BLE.addService(sensorService);
 
+  // Publishes the loaded config on its characteristic
+  applyConfig();
+
   if (!BLE.advertise())
   {
     Serial.println("ERROR: BLE.advertise() failed!");
@@ -142,146 +671,218 @@ void setup()
   }
 }
 
-void loop()
+// Values are sent as fixed point, see sensor_frame.h for the units
+void buildSensorFrame(SensorFrame *frame, unsigned long now)
 {
-  float si7021_h = -999.0, si7021_t = -999.0, sht30_h = -999.0, sht30_t = -999.0, veml6035_l = -999.0;
-  if (!si7021SetupFailed)
-  {
-    si7021_h = si7021_ths.readHumidity();
-    si7021_t = si7021_ths.readTemperature();
+  memset(frame, 0, sizeof(*frame));
+  frame->version = SENSOR_FRAME_VERSION;
+  frame->sequence = frameSequence++;
+  frame->timestamp_ms = now;
 
-    if (si7021_h == -999 || si7021_t == -999)
-    {
-     Serial.println("Error reading temperature/humidity sensor data");
-    }
-   
+  if (si7021Valid)
+  {
+    frame->valid |= SENSOR_FRAME_SI7021_VALID;
+    frame->si7021_temp_centi = si7021TempCenti;
+    frame->si7021_hum_centi = si7021HumCenti;
   }
-
-  if (!sht30SetupFailed)
+  if (sht30Valid)
   {
-
-    uint8_t result = sht30_ths.readTempHumidity(&sht30_t, &sht30_h, SHT30_Repeatability::HIGH);
-
-    if (result != SHT30_OK)
-    {
-     sht30_h = -999.0;
-      sht30_t = -999.0;
-      Serial.print("Error: ");
-      Serial.println(result);
-    }
-   
+    frame->valid |= SENSOR_FRAME_SHT30_VALID;
+    frame->sht30_temp_centi = sht30TempCenti;
+    frame->sht30_hum_centi = sht30HumCenti;
+  }
+  if (veml6035Valid)
+  {
+    frame->valid |= SENSOR_FRAME_VEML6035_VALID;
+    frame->veml6035_millilux = veml6035MilliLux;
   }
 
-  if (!veml6035SetupFailed)
+  ThFusionReading fused;
+  if (thFusion.getReading(now, &fused))
   {
+    frame->valid |= SENSOR_FRAME_FUSED_VALID;
+    frame->fused_temp_centi = fused.temp_centi;
+    frame->fused_hum_centi = fused.hum_centi;
+  }
+  frame->fusion_status = fused.status;
+  if (!imuSetupFailed)
+  {
+    frame->valid |= SENSOR_FRAME_IMU_VALID;
+    frame->imu_state = (uint8_t)movementData.current_state;
+    frame->imu_asleep = movementData.is_likely_asleep;
+    frame->imu_intensity_milli = movementIntensityMilli;
+    frame->imu_movements_per_minute = (uint16_t)movementData.movements_per_minute;
+    frame->imu_still_minutes = movementData.still_duration_minutes > 0xFFFF ? 0xFFFF : movementData.still_duration_minutes;
+    frame->sleep_stage = actigraphy.getStage();
+    frame->posture = imu.getPosture();
+  }
+}
 
-    veml6035_l = veml6035_als.readAmbientLight();
+#if LEGACY_CHARACTERISTICS
+// The old characteristics carry floats, converted from the fixed point values here
+void writeLegacyFloat(BLECharacteristic &characteristic, const char *label, float value)
+{
+  characteristic.writeValue((byte *)&value, sizeof(value));
+  Serial.print(label);
+  Serial.println(value);
+}
 
-    if (veml6035_l == -999)
-    {
-       Serial.println("Error reading light sensor data");
-      }
+void writeLegacyCharacteristics()
+{
+  if (si7021Valid)
+  {
+    writeLegacyFloat(si7021_t_char, "SI7021 Temperature: ", si7021TempCenti / 100.0f);
+    writeLegacyFloat(si7021_h_char, "SI7021 Humidity: ", si7021HumCenti / 100.0f);
+  }
+  if (sht30Valid)
+  {
+    writeLegacyFloat(sht30_t_char, "SHT30 Temperature: ", sht30TempCenti / 100.0f);
+    writeLegacyFloat(sht30_h_char, "SHT30 Humidity: ", sht30HumCenti / 100.0f);
+  }
+  if (veml6035Valid)
+  {
+    writeLegacyFloat(veml6035_char, "VEML6035 Light: ", veml6035MilliLux / 1000.0f);
   }
 
+  // Send IMU data individually
   if (!imuSetupFailed)
   {
+    uint8_t currentState = (uint8_t)movementData.current_state;
+    imu_cs_char.writeValue((byte *)&currentState, sizeof(currentState));
+    Serial.print("IMU Current State: ");
+    Serial.println(currentState);
+
+    imu_mi_char.writeValue((byte *)&movementData.movement_intensity, sizeof(movementData.movement_intensity));
+    Serial.print("IMU Movement Intensity: ");
+    Serial.println(movementData.movement_intensity);
+
+    imu_mpm_char.writeValue((byte *)&movementData.movements_per_minute, sizeof(movementData.movements_per_minute));
+    Serial.print("IMU Movements Per Minute: ");
+    Serial.println(movementData.movements_per_minute);
+
+    imu_ila_char.writeValue((byte *)&movementData.is_likely_asleep, sizeof(movementData.is_likely_asleep));
+    Serial.print("IMU Is Likely Asleep: ");
+    Serial.println(movementData.is_likely_asleep);
+
+    imu_sdm_char.writeValue((byte *)&movementData.still_duration_minutes, sizeof(movementData.still_duration_minutes));
+    Serial.print("IMU Still Duration Minutes: ");
+    Serial.println(movementData.still_duration_minutes);
+  }
+}
+#endif
+
+void handleHistoryControl()
+{
+  if (!history_control_char.written() || history_control_char.valueLength() < 1)
+  {
+    return;
+  }
+
+  uint8_t command = history_control_char.value()[0];
 
-    static unsigned long last_sample = 0;
-    unsigned long current_time = millis();
+  if (command == SENSOR_HISTORY_CMD_DOWNLOAD)
+  {
+    historyReader.begin(history);
+    historyChunkLength = 0;
+    historyChunkCounter = 0;
+    historyChunkSize = sensorHistoryChunkSize(history_control_char.value(), history_control_char.valueLength());
+
+    Serial.print("History download: ");
+    Serial.print(history.getRecordCount());
+    Serial.print(" records in ");
+    Serial.print(history.getStoredBytes());
+    Serial.println(" bytes");
+  }
+  else if (command == SENSOR_HISTORY_CMD_CLEAR)
+  {
+    history.clear();
+    Serial.println("History cleared");
+  }
+}
 
-    // Sample at 5Hz (every 200ms)
-    if (current_time - last_sample >= 200)
+// One chunk per loop() pass keeps the BLE stack and the scheduler serviced
+void sendHistoryChunk()
+{
+  if (historyChunkLength == 0)
+  {
+    if (!historyReader.isActive())
     {
-      last_sample = current_time;
+      return;
+    }
 
-      if (imu.readIMU())
-      {
-        imu.calculateMovement();
-        imu.updateMovementState();
-        imu.incrementSampleCount();
-
-        // Update every minute (10 seconds for demo)
-        if (imu.shouldUpdateMinutelyStats())
-        {
-          imu.updateMinutelyStats();
-          movementData = imu.getMovementData();
-        }
-      }
+    historyChunk[0] = historyChunkCounter;
+    size_t length = historyReader.read(&historyChunk[1], historyChunkSize - 1);
+    if (length == 0)
+    {
+      return;
     }
+    historyChunkLength = length + 1;
+  }
+
+  if (history_data_char.writeValue(historyChunk, historyChunkLength))
+  {
+    historyChunkCounter++;
+    historyChunkLength = 0;
   }
+}
+
+void loop()
+{
+  // Callbacks of the I2C transfers finished since the last pass
+  i2cAsync.service();
+
+  // Start, poll and fetch whatever sensor work is due, never blocks
+  scheduler.tick();
 
   BLEDevice central = BLE.central();
 
   // Poll BLE stack
   BLE.poll();
 
+  unsigned long recordTime = millis();
+  if (recordTime - lastHistoryRecord >= historyInterval)
+  {
+    lastHistoryRecord = recordTime;
+
+    SensorFrame frame;
+    buildSensorFrame(&frame, recordTime);
+    history.append(frame);
+  }
+
   if (central)
   {
     if (central.connected())
     {
+      handleHistoryControl();
+      handleConfigWrite();
+      sendHistoryChunk();
+
       // Update sensor values at intervals
 
       unsigned long now = millis();
-      if (now - lastUpdate >= updateInterval)
+      if (now - lastUpdate >= sensorConfig.update_period_ms || lightChanged || postureChanged)
       {
         lastUpdate = now;
-
-        // Write values
-        if (si7021_t != -999.0)
-        {
-          si7021_t_char.writeValue((byte *)&si7021_t, sizeof(si7021_t));
-          Serial.print("SI7021 Temperature: ");
-          Serial.println(si7021_t);
-        }
-        if (si7021_h != -999.0)
-        {
-          si7021_h_char.writeValue((byte *)&si7021_h, sizeof(si7021_h));
-          Serial.print("SI7021 Humidity: ");
-          Serial.println(si7021_h);
-        }
-        if (sht30_t != -999.0)
-        {
-          sht30_t_char.writeValue((byte *)&sht30_t, sizeof(sht30_t));
-          Serial.print("SHT30 Temperature: ");
-          Serial.println(sht30_t);
-        }
-        if (sht30_h != -999.0)
-        {
-          sht30_h_char.writeValue((byte *)&sht30_h, sizeof(sht30_h));
-          Serial.print("SHT30 Humidity: ");
-          Serial.println(sht30_h);
-        }
-        if (veml6035_l != -999.0)
-        {
-          veml6035_char.writeValue((byte *)&veml6035_l, sizeof(veml6035_l));
-          Serial.print("VEML6035 Light: ");
-          Serial.println(veml6035_l);
-        }
-
-        // Send IMU data individually
-        if (!imuSetupFailed)
-        {
-          uint8_t currentState = (uint8_t)movementData.current_state;
-          imu_cs_char.writeValue((byte *)&currentState, sizeof(currentState));
-          Serial.print("IMU Current State: ");
-          Serial.println(currentState);
-
-          imu_mi_char.writeValue((byte *)&movementData.movement_intensity, sizeof(movementData.movement_intensity));
-          Serial.print("IMU Movement Intensity: ");
-          Serial.println(movementData.movement_intensity);
-
-          imu_mpm_char.writeValue((byte *)&movementData.movements_per_minute, sizeof(movementData.movements_per_minute));
-          Serial.print("IMU Movements Per Minute: ");
-          Serial.println(movementData.movements_per_minute);
-
-          imu_ila_char.writeValue((byte *)&movementData.is_likely_asleep, sizeof(movementData.is_likely_asleep));
-          Serial.print("IMU Is Likely Asleep: ");
-          Serial.println(movementData.is_likely_asleep);
-
-          imu_sdm_char.writeValue((byte *)&movementData.still_duration_minutes, sizeof(movementData.still_duration_minutes));
-          Serial.print("IMU Still Duration Minutes: ");
-          Serial.println(movementData.still_duration_minutes);
-        }
+        lightChanged = false;
+        postureChanged = false;
+
+        SensorFrame frame;
+        uint8_t packedFrame[SENSOR_FRAME_SIZE];
+        buildSensorFrame(&frame, now);
+        size_t frameLength = sensorFrameEncode(&frame, packedFrame, sizeof(packedFrame));
+        sensor_frame_char.writeValue(packedFrame, frameLength);
+        Serial.print("Sensor frame sent: #");
+        Serial.println(frame.sequence);
+
+#if LEGACY_CHARACTERISTICS
+        writeLegacyCharacteristics();
+#endif
+
+        Serial.print("Worst loop latency (us): ");
+        Serial.println(scheduler.getWorstLoopLatencyMicros());
+        Serial.print("Scheduler duty cycle (permille): ");
+        Serial.println(scheduler.getDutyCyclePermille());
+        scheduler.resetStats();
       }
     }
     else